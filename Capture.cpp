@@ -0,0 +1,530 @@
+#include "Capture.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	static_assert(std::endian::native == std::endian::little, "Captures are read in place, as little endian");
+	static_assert(sizeof(capture::FileHeader) % alignof(capture::Record) == 0, "Records must start aligned");
+	static_assert(sizeof(capture::Record) == 16, "The record header is part of the file format");
+
+	constexpr char MAGIC[8] = { 'A', '4', 'C', 'A', 'P', 'T', 'U', 'R' };
+
+	// Records are written out once the buffer holds this many bytes
+	constexpr size_t FLUSH_BYTES = 1024 * 1024;
+
+	// Every record starts on this boundary
+	constexpr size_t RECORD_ALIGNMENT = alignof(capture::Record);
+
+	constexpr size_t NO_RECORD = ~(size_t)0;
+
+	// Largest record the 32 bit size in its header describes
+	constexpr size_t MAX_RECORD_BYTES = 0xFFFFFFFFu & ~(RECORD_ALIGNMENT - 1);
+
+	size_t alignRecord(size_t bytes)
+	{
+		return (bytes + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+	}
+
+	// text in UTF-16, whatever the size of wchar_t
+	std::u16string toUtf16(const wchar_t* text, size_t length)
+	{
+		std::u16string utf16;
+		utf16.reserve(length);
+		for (size_t i = 0; i < length; i++)
+		{
+			std::uint32_t c = (std::uint32_t)text[i];
+			if (c >= 0x10000 && c <= 0x10FFFF)
+			{
+				c -= 0x10000;
+				utf16.push_back((char16_t)(0xD800 + (c >> 10)));
+				utf16.push_back((char16_t)(0xDC00 + (c & 0x3FF)));
+			}
+			else
+			{
+				utf16.push_back((char16_t)c);
+			}
+		}
+		return utf16;
+	}
+
+	// Bytes the payload of record needs, in 64 bits so that no count overflows
+	std::uint64_t viewPayloadBytes(const capture::Record& record)
+	{
+		using capture::Op;
+		const std::uint64_t count = record.count;
+		switch (record.op)
+		{
+		case Op::Pen:
+			return sizeof(capture::PenData);
+		case Op::Font:
+			return sizeof(capture::FontData) + count * sizeof(char16_t);
+		case Op::Canvas:
+			return sizeof(capture::CanvasData);
+		case Op::Clear:
+			return sizeof(capture::ClearData);
+		case Op::Buffering:
+			return sizeof(capture::BufferingData);
+		case Op::Present:
+			return 0;
+		case Op::Text:
+			return sizeof(capture::TextData) + count * sizeof(char16_t);
+		default:
+			return count * capture::viewArity(record.op) * sizeof(float);
+		}
+	}
+
+	[[noreturn]] void throwCorrupt()
+	{
+		throw std::runtime_error("corrupt capture file");
+	}
+
+	// Maps the whole file read only; size is set to its length
+	const unsigned char* mapFile(const std::string& path, size_t& size)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std::runtime_error("cannot open " + path);
+		}
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length) || (unsigned long long)length.QuadPart > (size_t)-1)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("cannot map " + path);
+		}
+		size = (size_t)length.QuadPart;
+		if (size == 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+		// The view keeps the mapping and the file open on its own
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+#else
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			throw std::runtime_error("cannot open " + path);
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			throw std::runtime_error("cannot map " + path);
+		}
+		size = (size_t)status.st_size;
+		if (size == 0)
+		{
+			close(file);
+			return nullptr;
+		}
+		// The mapping keeps the file open on its own
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			view = nullptr;
+		}
+		else
+		{
+			madvise(view, size, MADV_SEQUENTIAL);
+		}
+#endif
+		if (!view)
+		{
+			throw std::runtime_error("cannot map " + path);
+		}
+		return static_cast<const unsigned char*>(view);
+	}
+
+	void unmapFile(const unsigned char* data, size_t size)
+	{
+		if (!data)
+		{
+			return;
+		}
+#ifdef _WIN32
+		(void)size;
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<unsigned char*>(data), size);
+#endif
+	}
+}
+
+std::uint32_t capture::viewArity(Op op)
+{
+	switch (op)
+	{
+	case Op::Line:
+	case Op::Ellipse:
+	case Op::FilledEllipse:
+	case Op::Rectangle:
+	case Op::FilledRectangle:
+	case Op::Lines:
+	case Op::FilledEllipses:
+	case Op::FilledRectangles:
+		return 4;
+	case Op::Arc:
+		return 6;
+	case Op::Polygon:
+	case Op::FilledPolygon:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+std::wstring capture::toWide(const char16_t* text, size_t length)
+{
+	std::wstring wide;
+	wide.reserve(length);
+	for (size_t i = 0; i < length; i++)
+	{
+		std::uint32_t c = text[i];
+		// Surrogate pairs become one character where wchar_t holds it
+		if (sizeof(wchar_t) > 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < length && text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000)
+		{
+			c = 0x10000 + ((c - 0xD800) << 10) + (text[i + 1] - 0xDC00u);
+			i++;
+		}
+		wide.push_back((wchar_t)c);
+	}
+	return wide;
+}
+
+/*******************************************************************************
+*  Writer.
+*******************************************************************************/
+
+capture::Writer::Writer(const std::string& path, int width, int height, bool isDoubleBuffered)
+	:
+	path(path),
+	stream(path, std::ios::binary),
+	openRecord(NO_RECORD)
+{
+	if (!stream)
+	{
+		throw std::runtime_error("cannot open " + path + " for writing");
+	}
+	buffer.reserve(2 * FLUSH_BYTES);
+
+	FileHeader header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	buffer.resize(sizeof(header));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	// What is drawn next lands on this canvas
+	setCanvasSize(width, height);
+	setDoubleBuffering(isDoubleBuffered);
+}
+
+void capture::Writer::addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2)
+{
+	float* c = addCall(pen, Op::Line);
+	c[0] = (float)x1;
+	c[1] = (float)y1;
+	c[2] = (float)x2;
+	c[3] = (float)y2;
+}
+
+void capture::Writer::addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	float* c = addCall(pen, isFill ? Op::FilledEllipse : Op::Ellipse);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+}
+
+void capture::Writer::addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep)
+{
+	float* c = addCall(pen, Op::Arc);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+	c[4] = (float)start;
+	c[5] = (float)sweep;
+}
+
+void capture::Writer::addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	float* c = addCall(pen, isFill ? Op::FilledRectangle : Op::Rectangle);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+}
+
+void capture::Writer::addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill)
+{
+	// A polygon cannot be split across records like the batches
+	if (2 * n * sizeof(float) > MAX_RECORD_BYTES - sizeof(Record))
+	{
+		isTooLarge = true;
+		return;
+	}
+	addBatch(pen, isFill ? Op::FilledPolygon : Op::Polygon, xy, n);
+}
+
+void capture::Writer::addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, size_t length, double x, double y)
+{
+	const std::uint32_t penIndex = usePen(pen);
+	const std::uint32_t fontIndex = useFont(font);
+	const std::u16string utf16 = toUtf16(text, length);
+	if (utf16.size() * sizeof(char16_t) > MAX_RECORD_BYTES - sizeof(Record) - sizeof(TextData))
+	{
+		isTooLarge = true;
+		return;
+	}
+	unsigned char* payload = beginRecord(Op::Text, penIndex, (std::uint32_t)utf16.size(),
+		sizeof(TextData) + utf16.size() * sizeof(char16_t));
+	const TextData data{ fontIndex, (float)x, (float)y, 0 };
+	std::memcpy(payload, &data, sizeof(data));
+	std::memcpy(payload + sizeof(data), utf16.data(), utf16.size() * sizeof(char16_t));
+}
+
+void capture::Writer::addLines(const cwt::Pen& pen, const double* segments, size_t n)
+{
+	addBatch(pen, Op::Lines, segments, n);
+}
+
+void capture::Writer::addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	addBatch(pen, Op::FilledEllipses, boxes, n);
+}
+
+void capture::Writer::addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	addBatch(pen, Op::FilledRectangles, boxes, n);
+}
+
+void capture::Writer::setCanvasSize(int width, int height)
+{
+	const CanvasData data{ width, height };
+	std::memcpy(beginRecord(Op::Canvas, 0, 0, sizeof(data)), &data, sizeof(data));
+}
+
+void capture::Writer::clear(const cwt::ColorRgba& color)
+{
+	const ClearData data{ color.pack(), 0 };
+	std::memcpy(beginRecord(Op::Clear, 0, 0, sizeof(data)), &data, sizeof(data));
+}
+
+void capture::Writer::setDoubleBuffering(bool enabled)
+{
+	const BufferingData data{ enabled ? 1u : 0u, 0 };
+	std::memcpy(beginRecord(Op::Buffering, 0, 0, sizeof(data)), &data, sizeof(data));
+}
+
+void capture::Writer::present()
+{
+	beginRecord(Op::Present, 0, 0, 0);
+}
+
+void capture::Writer::finish()
+{
+	flush();
+	stream.close();
+	if (!stream)
+	{
+		throw std::runtime_error("error while writing " + path);
+	}
+	if (isTooLarge)
+	{
+		throw std::runtime_error("a polygon or text too large for a record was left out of " + path);
+	}
+}
+
+unsigned char* capture::Writer::beginRecord(Op op, std::uint32_t pen, std::uint32_t count, size_t payload)
+{
+	if (buffer.size() >= FLUSH_BYTES)
+	{
+		flush();
+	}
+	openRecord = NO_RECORD;
+
+	const size_t at = buffer.size();
+	const size_t bytes = alignRecord(sizeof(Record) + payload);
+	buffer.resize(at + bytes);
+	Record* record = reinterpret_cast<Record*>(buffer.data() + at);
+	record->bytes = (std::uint32_t)bytes;
+	record->op = op;
+	record->pen = pen;
+	record->count = count;
+	return buffer.data() + at + sizeof(Record);
+}
+
+float* capture::Writer::addCall(const cwt::Pen& pen, Op op)
+{
+	const std::uint32_t penIndex = usePen(pen);
+	const size_t bytes = viewArity(op) * sizeof(float);
+	if (openRecord != NO_RECORD && buffer.size() < FLUSH_BYTES)
+	{
+		Record* record = reinterpret_cast<Record*>(buffer.data() + openRecord);
+		if (record->op == op && record->pen == penIndex)
+		{
+			// Every arity is even, so the record stays aligned
+			record->bytes += (std::uint32_t)bytes;
+			record->count++;
+			const size_t at = buffer.size();
+			buffer.resize(at + bytes);
+			return reinterpret_cast<float*>(buffer.data() + at);
+		}
+	}
+
+	float* coords = reinterpret_cast<float*>(beginRecord(op, penIndex, 1, bytes));
+	openRecord = buffer.size() - alignRecord(sizeof(Record) + bytes);
+	return coords;
+}
+
+void capture::Writer::addBatch(const cwt::Pen& pen, Op op, const double* values, size_t n)
+{
+	const std::uint32_t penIndex = usePen(pen);
+	const size_t arity = viewArity(op);
+	// Batches too large for the size of one record go in several, drawn one
+	// after the other
+	const size_t most = (MAX_RECORD_BYTES - sizeof(Record)) / (arity * sizeof(float));
+	do
+	{
+		const size_t count = std::min(n, most);
+		float* c = reinterpret_cast<float*>(beginRecord(op, penIndex, (std::uint32_t)count, count * arity * sizeof(float)));
+		std::transform(values, values + count * arity, c, [](double v) { return (float)v; });
+		values += count * arity;
+		n -= count;
+	} while (n > 0);
+}
+
+std::uint32_t capture::Writer::usePen(const cwt::Pen& pen)
+{
+	if (hasPen && pen == lastPen)
+	{
+		return lastPenIndex;
+	}
+
+	const auto found = std::find(pens.begin(), pens.end(), pen);
+	lastPenIndex = (std::uint32_t)(found - pens.begin());
+	lastPen = pen;
+	hasPen = true;
+	if (found == pens.end())
+	{
+		pens.push_back(pen);
+		const PenData data{ pen.color.pack(), 0, pen.radius };
+		std::memcpy(beginRecord(Op::Pen, lastPenIndex, 0, sizeof(data)), &data, sizeof(data));
+	}
+	return lastPenIndex;
+}
+
+std::uint32_t capture::Writer::useFont(const cwt::Font& font)
+{
+	if (hasFont && fonts[lastFontIndex] == font)
+	{
+		return lastFontIndex;
+	}
+
+	const auto found = std::find(fonts.begin(), fonts.end(), font);
+	lastFontIndex = (std::uint32_t)(found - fonts.begin());
+	hasFont = true;
+	if (found == fonts.end())
+	{
+		fonts.push_back(font);
+		const std::wstring& name = font.viewFontName();
+		const std::u16string utf16 = toUtf16(name.data(), name.size());
+		unsigned char* payload = beginRecord(Op::Font, lastFontIndex, (std::uint32_t)utf16.size(),
+			sizeof(FontData) + utf16.size() * sizeof(char16_t));
+		const FontData data{ (std::uint32_t)font.viewFontSyle(), (std::uint32_t)font.viewFontSize() };
+		std::memcpy(payload, &data, sizeof(data));
+		std::memcpy(payload + sizeof(data), utf16.data(), utf16.size() * sizeof(char16_t));
+	}
+	return lastFontIndex;
+}
+
+void capture::Writer::flush()
+{
+	stream.write(reinterpret_cast<const char*>(buffer.data()), (std::streamsize)buffer.size());
+	buffer.clear();
+	openRecord = NO_RECORD;
+}
+
+/*******************************************************************************
+*  Reader.
+*******************************************************************************/
+
+capture::Reader::Reader(const std::string& path)
+{
+	data = mapFile(path, size);
+	FileHeader header;
+	if (size < sizeof(header))
+	{
+		unmapFile(data, size);
+		throw std::runtime_error(path + " is not a capture file");
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+	{
+		unmapFile(data, size);
+		throw std::runtime_error(path + " is not a capture file");
+	}
+	if (header.version != VERSION)
+	{
+		unmapFile(data, size);
+		throw std::runtime_error(path + " is a capture of another version");
+	}
+	pos = sizeof(header);
+}
+
+capture::Reader::~Reader()
+{
+	unmapFile(data, size);
+}
+
+const capture::Record* capture::Reader::next()
+{
+	const size_t left = size - pos;
+	if (left < sizeof(Record))
+	{
+		return nullptr;
+	}
+	const Record* record = reinterpret_cast<const Record*>(data + pos);
+	if (record->bytes < sizeof(Record) || record->bytes % RECORD_ALIGNMENT != 0 || record->op > Op::Last)
+	{
+		throwCorrupt();
+	}
+	if (record->bytes > left)
+	{
+		return nullptr;
+	}
+	if (viewPayloadBytes(*record) > record->bytes - sizeof(Record))
+	{
+		throwCorrupt();
+	}
+	// Everything drawn after it is scaled by the size of the canvas
+	if (record->op == Op::Canvas
+		&& (record->viewData<CanvasData>().width <= 0 || record->viewData<CanvasData>().height <= 0))
+	{
+		throwCorrupt();
+	}
+	pos += record->bytes;
+	return record;
+}
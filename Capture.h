@@ -0,0 +1,249 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "cwt.h"
+
+// Binary capture of the commands that reach a Render, and a reader that maps
+// the file and walks it in place.
+//
+// A capture is a FileHeader followed by records, each a Record header and a
+// payload, starting on an 8 byte boundary. Everything is little endian and
+// laid out as the structures below, so a mapped file is read without copies
+// or decoding. Coordinates are pixels of the canvas they were drawn on,
+// stored as floats; pens and fonts are defined once, by a record of their
+// own, and referred to by their index in the table those records build up.
+//
+//   op					pen		count			payload
+//
+//   Pen				index	0				PenData
+//   Font				index	name length		FontData, then the UTF-16 name
+//   Canvas				0		0				CanvasData
+//   Clear				0		0				ClearData
+//   Buffering			0		0				BufferingData
+//   Present			0		0				none
+//   Line				pen		calls			calls * (x1, y1, x2, y2)
+//   Ellipse			pen		calls			calls * (x, y, width, height)
+//   FilledEllipse		pen		calls			calls * (x, y, width, height)
+//   Arc				pen		calls			calls * (x, y, width, height, start, sweep)
+//   Rectangle			pen		calls			calls * (x, y, width, height)
+//   FilledRectangle	pen		calls			calls * (x, y, width, height)
+//   Polygon			pen		vertices		vertices * (x, y)
+//   FilledPolygon		pen		vertices		vertices * (x, y)
+//   Text				pen		text length		TextData, then the UTF-16 text
+//   Lines				pen		segments		segments * (x1, y1, x2, y2)
+//   FilledEllipses		pen		boxes			boxes * (x, y, width, height)
+//   FilledRectangles	pen		boxes			boxes * (x, y, width, height)
+//
+// Consecutive calls drawing one primitive each with the same pen share a
+// record, but are still replayed one call at a time: the render treats a
+// run of line() calls differently from one batch of lines. A batch larger
+// than the 4 GiB a record holds is split across consecutive records.
+namespace capture
+{
+	// Bumped whenever the layout changes
+	constexpr std::uint32_t VERSION = 1;
+
+	enum class Op : std::uint8_t
+	{
+		Pen,
+		Font,
+		Canvas,
+		Clear,
+		Buffering,
+		Present,
+		Line,
+		Ellipse,
+		FilledEllipse,
+		Arc,
+		Rectangle,
+		FilledRectangle,
+		Polygon,
+		FilledPolygon,
+		Text,
+		Lines,
+		FilledEllipses,
+		FilledRectangles,
+		Last = FilledRectangles
+	};
+
+	struct FileHeader
+	{
+		char magic[8];	// "A4CAPTUR"
+		std::uint32_t version;
+		std::uint32_t reserved;
+	};
+
+	struct alignas(8) Record
+	{
+		std::uint32_t bytes;	// size of the whole record, header and padding included
+		Op op;
+		std::uint8_t reserved[3];
+		std::uint32_t pen;
+		std::uint32_t count;
+
+		// The payload, right after the header
+		template <class Data>
+		const Data& viewData() const
+		{
+			return *reinterpret_cast<const Data*>(this + 1);
+		}
+
+		const float* viewCoords() const
+		{
+			return reinterpret_cast<const float*>(this + 1);
+		}
+
+		// The UTF-16 string after a payload of type Data
+		template <class Data>
+		const char16_t* viewString() const
+		{
+			return reinterpret_cast<const char16_t*>(&viewData<Data>() + 1);
+		}
+	};
+
+	struct PenData
+	{
+		std::uint32_t color;	// as cwt::ColorRgba::pack()
+		std::uint32_t reserved;
+		double radius;
+	};
+
+	struct FontData
+	{
+		std::uint32_t style;	// a cwt::Font::Style
+		std::uint32_t size;
+	};
+
+	struct CanvasData
+	{
+		std::int32_t width;
+		std::int32_t height;
+	};
+
+	struct ClearData
+	{
+		std::uint32_t color;	// as cwt::ColorRgba::pack()
+		std::uint32_t reserved;
+	};
+
+	struct BufferingData
+	{
+		std::uint32_t enabled;
+		std::uint32_t reserved;
+	};
+
+	struct TextData
+	{
+		std::uint32_t font;
+		float x;
+		float y;
+		std::uint32_t reserved;
+	};
+
+	// Coordinates per primitive of the shape ops, or 0 for the others
+	std::uint32_t viewArity(Op op);
+
+	// The length UTF-16 units of text as a wide string
+	std::wstring toWide(const char16_t* text, size_t length);
+
+	/**
+	 * Appends the commands it is given to a capture file, starting with the
+	 * canvas they are drawn on. Pens and fonts are defined the first time they
+	 * are used; the last ones used are remembered, so drawing with the same
+	 * pen over and over costs a comparison per call.
+	 *
+	 * Records are gathered in a buffer written out in large pieces. Errors
+	 * while writing, and polygons or text too large for a record, are only
+	 * reported by finish(), so that drawing never throws because of the
+	 * capture.
+	 */
+	class Writer
+	{
+	public:
+		// Throws std::runtime_error if the file cannot be created
+		Writer(const std::string& path, int width, int height, bool isDoubleBuffered);
+		Writer(const Writer&) = delete;
+		void operator=(const Writer&) = delete;
+
+		void addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2);
+		void addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		void addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep);
+		void addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		// xy holds n interleaved (x, y) pairs
+		void addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill);
+		void addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, size_t length, double x, double y);
+		void addLines(const cwt::Pen& pen, const double* segments, size_t n);
+		void addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n);
+		void addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n);
+		void setCanvasSize(int width, int height);
+		void clear(const cwt::ColorRgba& color);
+		void setDoubleBuffering(bool enabled);
+		void present();
+
+		// Writes what is buffered and closes the file. Throws
+		// std::runtime_error if anything could not be written.
+		void finish();
+
+	private:
+		// Appends a record with room for payload bytes and returns the payload
+		unsigned char* beginRecord(Op op, std::uint32_t pen, std::uint32_t count, size_t payload);
+		// Coordinates for one more call of a single primitive op, in the
+		// record of the calls before it if they used the same op and pen
+		float* addCall(const cwt::Pen& pen, Op op);
+		// Appends a batch of n primitives of op, whose coordinates values
+		// holds, in as many records as it takes
+		void addBatch(const cwt::Pen& pen, Op op, const double* values, size_t n);
+		std::uint32_t usePen(const cwt::Pen& pen);
+		std::uint32_t useFont(const cwt::Font& font);
+		void flush();
+
+		std::string path;
+		std::ofstream stream;
+		std::vector<unsigned char> buffer;
+		// Offset in buffer of the record addCall() may extend, if any
+		size_t openRecord;
+		// Pens and fonts defined so far, their index in the file being their
+		// index here; there are few, so they are searched in order
+		std::vector<cwt::Pen> pens;
+		std::vector<cwt::Font> fonts;
+		cwt::Pen lastPen{};
+		std::uint32_t lastPenIndex = 0;
+		bool hasPen = false;
+		std::uint32_t lastFontIndex = 0;
+		bool hasFont = false;
+		// Whether something was left out for not fitting a record
+		bool isTooLarge = false;
+	};
+
+	/**
+	 * Maps a capture file in memory and hands out its records in order,
+	 * pointing into the mapping: nothing is copied or decoded. The pages are
+	 * read in as the records are visited, so a capture larger than memory
+	 * is walked in one pass.
+	 */
+	class Reader
+	{
+	public:
+		// Throws std::runtime_error if the file cannot be mapped or is not a
+		// capture of this version
+		explicit Reader(const std::string& path);
+		Reader(const Reader&) = delete;
+		void operator=(const Reader&) = delete;
+		~Reader();
+
+		// The next record, or null at the end of the capture. A record cut
+		// short, as the last one of a program that crashed may be, ends the
+		// capture too. Its payload holds what its op and count call for, and
+		// a canvas is at least a pixel wide and high. Throws
+		// std::runtime_error if the file is corrupt.
+		const Record* next();
+
+	private:
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+		size_t pos = 0;
+	};
+}
@@ -0,0 +1,540 @@
+#include "CommandQueue.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	// Size of a regular chunk; a larger record gets a chunk of its own
+	constexpr size_t CHUNK_BYTES = 64 * 1024;
+	// Every record starts on this boundary
+	constexpr size_t RECORD_ALIGNMENT = 8;
+	// Largest record the 32 bit size in its header describes
+	constexpr size_t MAX_RECORD_BYTES = 0xFFFFFFFFu & ~(RECORD_ALIGNMENT - 1);
+
+	size_t alignRecord(size_t bytes)
+	{
+		return (bytes + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+	}
+
+	struct FontRecord
+	{
+		cwt::Font::Style style;
+		std::uint32_t size;
+		std::uint32_t length;	// characters in the name, null excluded
+	};
+
+	struct CanvasRecord
+	{
+		std::int32_t width;
+		std::int32_t height;
+	};
+
+	struct RecordRecord
+	{
+		std::int32_t fps;	// zero to stop recording
+	};
+
+	struct TextRecord
+	{
+		float x;
+		float y;
+	};
+}
+
+struct geom::CommandQueue::Chunk
+{
+	explicit Chunk(size_t capacity)
+		:
+		capacity(capacity),
+		bytes(new unsigned char[capacity])
+	{}
+
+	// Bytes of complete records, published by the producer
+	std::atomic<size_t> committed{ 0 };
+	// Set by the producer once it has moved on to another chunk
+	std::atomic<Chunk*> next{ nullptr };
+	const size_t capacity;
+	std::unique_ptr<unsigned char[]> bytes;
+};
+
+geom::CommandQueue::CommandQueue()
+	:
+	tail(new Chunk(CHUNK_BYTES)),
+	head(tail)
+{
+	static_assert(sizeof(Header) % RECORD_ALIGNMENT == 0, "Payloads must start aligned");
+}
+
+geom::CommandQueue::~CommandQueue()
+{
+	Chunk* chunk = head;
+	while (chunk)
+	{
+		Chunk* next = chunk->next.load(std::memory_order_relaxed);
+		delete chunk;
+		chunk = next;
+	}
+	delete spare.load(std::memory_order_relaxed);
+	delete largeSpare.load(std::memory_order_relaxed);
+}
+
+void geom::CommandQueue::addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2)
+{
+	float* c = beginCommand(pen, Op::Line, 4);
+	c[0] = (float)x1;
+	c[1] = (float)y1;
+	c[2] = (float)x2;
+	c[3] = (float)y2;
+	endRecord();
+}
+
+void geom::CommandQueue::addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	float* c = beginCommand(pen, isFill ? Op::FilledEllipse : Op::Ellipse, 4);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+	endRecord();
+}
+
+void geom::CommandQueue::addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep)
+{
+	float* c = beginCommand(pen, Op::Arc, 6);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+	c[4] = (float)start;
+	c[5] = (float)sweep;
+	endRecord();
+}
+
+void geom::CommandQueue::addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	float* c = beginCommand(pen, isFill ? Op::FilledRectangle : Op::Rectangle, 4);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+	endRecord();
+}
+
+void geom::CommandQueue::addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill)
+{
+	float* c = beginCommand(pen, isFill ? Op::FilledPolygon : Op::Polygon, 2 * n);
+	std::transform(xy, xy + 2 * n, c, [](double v) { return (float)v; });
+	endRecord();
+}
+
+void geom::CommandQueue::addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, size_t length, double x, double y)
+{
+	usePen(pen);
+	useFont(font);
+	unsigned char* payload = beginRecord(Kind::Text, sizeof(TextRecord) + (length + 1) * sizeof(wchar_t));
+	const TextRecord record{ (float)x, (float)y };
+	std::memcpy(payload, &record, sizeof(record));
+	wchar_t* copy = reinterpret_cast<wchar_t*>(payload + sizeof(record));
+	std::memcpy(copy, text, length * sizeof(wchar_t));
+	copy[length] = L'\0';
+	endRecord();
+}
+
+void geom::CommandQueue::addLines(const cwt::Pen& pen, const double* segments, size_t n)
+{
+	addBatch(pen, Op::Lines, segments, n);
+}
+
+void geom::CommandQueue::addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	addBatch(pen, Op::FilledEllipses, boxes, n);
+}
+
+void geom::CommandQueue::addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	addBatch(pen, Op::FilledRectangles, boxes, n);
+}
+
+void geom::CommandQueue::setCanvasSize(int width, int height)
+{
+	unsigned char* payload = beginRecord(Kind::Canvas, sizeof(CanvasRecord));
+	const CanvasRecord record{ width, height };
+	std::memcpy(payload, &record, sizeof(record));
+	endRecord();
+}
+
+void geom::CommandQueue::clear(const cwt::ColorRgba& color)
+{
+	unsigned char* payload = beginRecord(Kind::Clear, sizeof(color));
+	std::memcpy(payload, &color, sizeof(color));
+	endRecord();
+}
+
+void geom::CommandQueue::present()
+{
+	beginRecord(Kind::Present, 0);
+	endRecord();
+}
+
+void geom::CommandQueue::setDoubleBuffering(bool enabled)
+{
+	unsigned char* payload = beginRecord(Kind::Buffering, sizeof(enabled));
+	std::memcpy(payload, &enabled, sizeof(enabled));
+	endRecord();
+}
+
+void geom::CommandQueue::save(const char* path)
+{
+	const size_t length = std::strlen(path);
+	unsigned char* payload = beginRecord(Kind::Save, length + 1);
+	std::memcpy(payload, path, length + 1);
+	endRecord();
+}
+
+void geom::CommandQueue::saveVector(const char* path, bool isCoalesced)
+{
+	const size_t length = std::strlen(path);
+	unsigned char* payload = beginRecord(Kind::Export, sizeof(isCoalesced) + length + 1);
+	std::memcpy(payload, &isCoalesced, sizeof(isCoalesced));
+	std::memcpy(payload + sizeof(isCoalesced), path, length + 1);
+	endRecord();
+}
+
+void geom::CommandQueue::startRecording(const char* path, int fps)
+{
+	const size_t length = std::strlen(path);
+	unsigned char* payload = beginRecord(Kind::Record, sizeof(RecordRecord) + length + 1);
+	const RecordRecord record{ fps };
+	std::memcpy(payload, &record, sizeof(record));
+	std::memcpy(payload + sizeof(record), path, length + 1);
+	endRecord();
+}
+
+void geom::CommandQueue::stopRecording()
+{
+	startRecording("", 0);
+}
+
+void geom::CommandQueue::quit()
+{
+	beginRecord(Kind::Quit, 0);
+	endRecord();
+}
+
+std::uint64_t geom::CommandQueue::fence()
+{
+	const std::uint64_t epoch = ++lastEpoch;
+	unsigned char* payload = beginRecord(Kind::Fence, sizeof(epoch));
+	std::memcpy(payload, &epoch, sizeof(epoch));
+	endRecord();
+	return epoch;
+}
+
+void geom::CommandQueue::waitFor(std::uint64_t epoch)
+{
+	std::uint64_t done = completed.load(std::memory_order_acquire);
+	while (done < epoch)
+	{
+		completed.wait(done, std::memory_order_acquire);
+		done = completed.load(std::memory_order_acquire);
+	}
+}
+
+size_t geom::CommandQueue::viewPendingBytes() const
+{
+	const size_t drained = drainedBytes.load(std::memory_order_relaxed);
+	const size_t written = writtenBytes.load(std::memory_order_relaxed);
+	return written > drained ? written - drained : 0;
+}
+
+geom::Control geom::CommandQueue::drain(DisplayList& list)
+{
+	for (;;)
+	{
+		Chunk* chunk = head;
+		if (readPos == chunk->committed.load(std::memory_order_acquire))
+		{
+			Chunk* next = chunk->next.load(std::memory_order_acquire);
+			if (!next)
+			{
+				return Control{};
+			}
+			// The producer finishes a chunk before it links the next one, but
+			// records may have landed between the two loads above
+			if (readPos != chunk->committed.load(std::memory_order_acquire))
+			{
+				continue;
+			}
+			head = next;
+			readPos = 0;
+			recycle(chunk);
+			continue;
+		}
+
+		const unsigned char* record = chunk->bytes.get() + readPos;
+		Header header;
+		std::memcpy(&header, record, sizeof(header));
+		const unsigned char* payload = record + sizeof(Header);
+		readPos += header.bytes;
+		drainedBytes.store(drainedBytes.load(std::memory_order_relaxed) + header.bytes, std::memory_order_relaxed);
+
+		switch (header.kind)
+		{
+		case Kind::Pen:
+			std::memcpy(&pen, payload, sizeof(pen));
+			break;
+		case Kind::Font:
+		{
+			FontRecord fontRecord;
+			std::memcpy(&fontRecord, payload, sizeof(fontRecord));
+			const wchar_t* name = reinterpret_cast<const wchar_t*>(payload + sizeof(fontRecord));
+			font = cwt::Font(std::wstring(name, fontRecord.length), fontRecord.style, fontRecord.size);
+			break;
+		}
+		case Kind::Command:
+			list.add(header.op, pen, reinterpret_cast<const float*>(payload), header.count);
+			break;
+		case Kind::Text:
+		{
+			TextRecord textRecord;
+			std::memcpy(&textRecord, payload, sizeof(textRecord));
+			const wchar_t* text = reinterpret_cast<const wchar_t*>(payload + sizeof(textRecord));
+			list.addText(pen, font, text, textRecord.x, textRecord.y);
+			break;
+		}
+		case Kind::Canvas:
+		{
+			CanvasRecord canvasRecord;
+			std::memcpy(&canvasRecord, payload, sizeof(canvasRecord));
+			Control control;
+			control.kind = Control::Kind::Canvas;
+			control.width = canvasRecord.width;
+			control.height = canvasRecord.height;
+			return control;
+		}
+		case Kind::Clear:
+		{
+			Control control;
+			control.kind = Control::Kind::Clear;
+			std::memcpy(&control.color, payload, sizeof(control.color));
+			return control;
+		}
+		case Kind::Present:
+		{
+			Control control;
+			control.kind = Control::Kind::Present;
+			return control;
+		}
+		case Kind::Buffering:
+		{
+			Control control;
+			control.kind = Control::Kind::Buffering;
+			std::memcpy(&control.enabled, payload, sizeof(control.enabled));
+			return control;
+		}
+		case Kind::Save:
+		{
+			Control control;
+			control.kind = Control::Kind::Save;
+			control.path = reinterpret_cast<const char*>(payload);
+			return control;
+		}
+		case Kind::Export:
+		{
+			Control control;
+			control.kind = Control::Kind::Export;
+			std::memcpy(&control.enabled, payload, sizeof(control.enabled));
+			control.path = reinterpret_cast<const char*>(payload + sizeof(control.enabled));
+			return control;
+		}
+		case Kind::Record:
+		{
+			RecordRecord record;
+			std::memcpy(&record, payload, sizeof(record));
+			Control control;
+			control.kind = Control::Kind::Record;
+			control.enabled = record.fps > 0;
+			control.fps = record.fps;
+			control.path = reinterpret_cast<const char*>(payload + sizeof(record));
+			return control;
+		}
+		case Kind::Fence:
+		{
+			Control control;
+			control.kind = Control::Kind::Fence;
+			std::memcpy(&control.epoch, payload, sizeof(control.epoch));
+			return control;
+		}
+		case Kind::Quit:
+		{
+			Control control;
+			control.kind = Control::Kind::Quit;
+			return control;
+		}
+		}
+	}
+}
+
+void geom::CommandQueue::complete(std::uint64_t epoch)
+{
+	completed.store(epoch, std::memory_order_release);
+	completed.notify_all();
+}
+
+void geom::CommandQueue::waitForCommands()
+{
+	// Announce the wait before the last look at the queue; endRecord()
+	// publishes before it checks the flag, so one of the two sides always
+	// sees the other
+	const std::uint32_t seen = wakeups.load(std::memory_order_acquire);
+	consumerWaiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (hasPending())
+	{
+		consumerWaiting.store(false, std::memory_order_relaxed);
+		return;
+	}
+	wakeups.wait(seen, std::memory_order_acquire);
+}
+
+void geom::CommandQueue::detach()
+{
+	complete(UINT64_MAX);
+}
+
+unsigned char* geom::CommandQueue::beginRecord(Kind kind, size_t payload, Op op, size_t count)
+{
+	// A polygon or a text cannot be split like the batches
+	if (payload > MAX_RECORD_BYTES - sizeof(Header))
+	{
+		throw std::invalid_argument("too much data for one command");
+	}
+	const size_t bytes = alignRecord(sizeof(Header) + payload);
+	assert(count <= UINT32_MAX && "Too many coordinates for one command!");
+
+	if (writePos + bytes > tail->capacity)
+	{
+		// Reuse the chunk the consumer handed back if it is large enough
+		std::atomic<Chunk*>& slot = bytes > CHUNK_BYTES ? largeSpare : spare;
+		Chunk* chunk = slot.exchange(nullptr, std::memory_order_acquire);
+		if (chunk && chunk->capacity < bytes)
+		{
+			delete chunk;
+			chunk = nullptr;
+		}
+		if (chunk)
+		{
+			chunk->committed.store(0, std::memory_order_relaxed);
+			chunk->next.store(nullptr, std::memory_order_relaxed);
+		}
+		else
+		{
+			chunk = new Chunk((std::max)(CHUNK_BYTES, bytes));
+		}
+		tail->next.store(chunk, std::memory_order_release);
+		tail = chunk;
+		writePos = 0;
+	}
+
+	unsigned char* record = tail->bytes.get() + writePos;
+	const Header header{ (std::uint32_t)bytes, kind, op, (std::uint32_t)count };
+	std::memcpy(record, &header, sizeof(header));
+	recordBytes = bytes;
+	return record + sizeof(Header);
+}
+
+void geom::CommandQueue::endRecord()
+{
+	writePos += recordBytes;
+	writtenBytes.store(writtenBytes.load(std::memory_order_relaxed) + recordBytes, std::memory_order_relaxed);
+	tail->committed.store(writePos, std::memory_order_release);
+
+	// Pairs with the fence in waitForCommands()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (consumerWaiting.load(std::memory_order_relaxed) && consumerWaiting.exchange(false, std::memory_order_relaxed))
+	{
+		wakeups.fetch_add(1, std::memory_order_release);
+		wakeups.notify_one();
+	}
+}
+
+void geom::CommandQueue::addBatch(const cwt::Pen& pen, Op op, const double* values, size_t n)
+{
+	// As many records as the batch needs, replayed one after the other
+	const size_t perRecord = (MAX_RECORD_BYTES - sizeof(Header)) / (4 * sizeof(float));
+	while (n > 0)
+	{
+		const size_t batch = (std::min)(n, perRecord);
+		float* c = beginCommand(pen, op, 4 * batch);
+		std::transform(values, values + 4 * batch, c, [](double v) { return (float)v; });
+		endRecord();
+		values += 4 * batch;
+		n -= batch;
+	}
+}
+
+float* geom::CommandQueue::beginCommand(const cwt::Pen& pen, Op op, size_t count)
+{
+	usePen(pen);
+	return reinterpret_cast<float*>(beginRecord(Kind::Command, count * sizeof(float), op, count));
+}
+
+void geom::CommandQueue::usePen(const cwt::Pen& pen)
+{
+	if (hasPen && lastPen == pen)
+	{
+		return;
+	}
+	unsigned char* payload = beginRecord(Kind::Pen, sizeof(pen));
+	std::memcpy(payload, &pen, sizeof(pen));
+	endRecord();
+	lastPen = pen;
+	hasPen = true;
+}
+
+void geom::CommandQueue::useFont(const cwt::Font& font)
+{
+	if (hasFont && lastFont == font)
+	{
+		return;
+	}
+	const std::wstring& name = font.viewFontName();
+	unsigned char* payload = beginRecord(Kind::Font, sizeof(FontRecord) + (name.size() + 1) * sizeof(wchar_t));
+	const FontRecord record{ font.viewFontSyle(), (std::uint32_t)font.viewFontSize(), (std::uint32_t)name.size() };
+	std::memcpy(payload, &record, sizeof(record));
+	std::memcpy(payload + sizeof(record), name.c_str(), (name.size() + 1) * sizeof(wchar_t));
+	endRecord();
+	lastFont = font;
+	hasFont = true;
+}
+
+bool geom::CommandQueue::hasPending() const
+{
+	return readPos != head->committed.load(std::memory_order_acquire)
+		|| head->next.load(std::memory_order_acquire) != nullptr;
+}
+
+void geom::CommandQueue::recycle(Chunk* chunk)
+{
+	// Keep one chunk of each kind around so a steady stream does not allocate.
+	// Of two oversized chunks the larger is kept, so that a huge polygon drawn
+	// every frame keeps reusing the same one.
+	const size_t capacity = chunk->capacity;
+	std::atomic<Chunk*>& slot = capacity > CHUNK_BYTES ? largeSpare : spare;
+	Chunk* old = slot.exchange(chunk, std::memory_order_acq_rel);
+	if (old && old->capacity > capacity)
+	{
+		// Swap back unless the producer took the chunk in the meantime
+		Chunk* expected = chunk;
+		if (slot.compare_exchange_strong(expected, old, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			old = chunk;
+		}
+	}
+	delete old;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "DisplayList.h"
+#include "cwt.h"
+
+namespace geom
+{
+	// Records drain() stops at and hands back to the render thread
+	struct Control
+	{
+		enum class Kind
+		{
+			None,	// the queue is empty
+			Canvas,	// the canvas was resized to width x height
+			Clear,	// the canvas was cleared to color
+			Present,	// the frame drawn so far is to be shown
+			Buffering,	// double buffering was turned on or off
+			Save,	// the canvas on screen is to be saved to path
+			Export,	// the display list is to be written to path as vector graphics,
+					// merging shapes no larger than a pixel if enabled
+			Record,	// recording shown frames to path starts or, if not enabled, stops
+			Fence,	// everything before epoch has been drained
+			Quit	// the producer is gone
+		};
+
+		Kind kind = Kind::None;
+		int width = 0;
+		int height = 0;
+		cwt::ColorRgba color;
+		bool enabled = false;
+		const char* path = nullptr;	// valid until the next drain()
+		int fps = 0;
+		std::uint64_t epoch = 0;
+	};
+
+	/**
+	 * Single-producer/single-consumer, lock-free queue of drawing commands
+	 * between the thread that draws (StdDraw) and the render thread.
+	 *
+	 * The producer appends variable sized records to a chain of chunks and
+	 * never waits for the consumer; the consumer decodes them into its own
+	 * DisplayList, so the two threads never share one. Pens and fonts are only
+	 * sent when they change.
+	 *
+	 * fence() marks a point in the stream; once the render thread has drawn
+	 * everything before it, it calls complete(), which releases producers
+	 * blocked in waitFor(). That is how the producer gets a consistent snapshot
+	 * of what has been rendered.
+	 */
+	class CommandQueue
+	{
+	public:
+		CommandQueue();
+		CommandQueue(const CommandQueue&) = delete;
+		void operator=(const CommandQueue&) = delete;
+		~CommandQueue();
+
+		/***********************************************************************
+		*  Producer side.
+		***********************************************************************/
+
+		void addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2);
+		void addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		void addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep);
+		void addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		// xy holds n interleaved (x, y) pairs. A polygon, or a text, too large
+		// for one record throws std::invalid_argument; batches are split.
+		void addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill);
+		// text holds length characters and need not be null terminated
+		void addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, size_t length, double x, double y);
+		void addLines(const cwt::Pen& pen, const double* segments, size_t n);
+		void addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n);
+		void addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n);
+		void setCanvasSize(int width, int height);
+		void clear(const cwt::ColorRgba& color);
+		void present();
+		void setDoubleBuffering(bool enabled);
+		void save(const char* path);
+		void saveVector(const char* path, bool isCoalesced);
+		void startRecording(const char* path, int fps);
+		void stopRecording();
+		void quit();
+
+		// Marks the current end of the stream and returns its epoch
+		std::uint64_t fence();
+
+		// Blocks until the consumer has completed epoch, or has detached
+		void waitFor(std::uint64_t epoch);
+
+		// Bytes of records appended but not yet drained, from either side
+		size_t viewPendingBytes() const;
+
+		/***********************************************************************
+		*  Consumer side.
+		***********************************************************************/
+
+		// Decodes pending commands into list until a control record shows up
+		// or the queue runs dry
+		Control drain(DisplayList& list);
+
+		// Announces that everything up to epoch has been rendered
+		void complete(std::uint64_t epoch);
+
+		// Sleeps until the producer appends something
+		void waitForCommands();
+
+		// The consumer is gone for good: release every waiting producer
+		void detach();
+
+	private:
+		enum class Kind : std::uint8_t
+		{
+			Pen,
+			Font,
+			Command,
+			Text,
+			Canvas,
+			Clear,
+			Present,
+			Buffering,
+			Save,
+			Export,
+			Record,
+			Fence,
+			Quit
+		};
+
+		struct alignas(8) Header
+		{
+			std::uint32_t bytes;	// size of the whole record, header included
+			Kind kind;
+			Op op;
+			std::uint32_t count;	// number of float coordinates after the header
+		};
+
+		struct Chunk;
+
+		// Reserves room for a record of the given payload size; throws
+		// std::invalid_argument if the header cannot describe it
+		unsigned char* beginRecord(Kind kind, size_t payload, Op op = Op::Line, size_t count = 0);
+		// Publishes the record started by beginRecord
+		void endRecord();
+		float* beginCommand(const cwt::Pen& pen, Op op, size_t count);
+		// Appends n primitives of four values each, split across records
+		void addBatch(const cwt::Pen& pen, Op op, const double* values, size_t n);
+		void usePen(const cwt::Pen& pen);
+		void useFont(const cwt::Font& font);
+		bool hasPending() const;
+		void recycle(Chunk* chunk);
+
+		// Producer state
+		Chunk* tail;
+		size_t writePos = 0;
+		size_t recordBytes = 0;
+		cwt::Pen lastPen{};
+		bool hasPen = false;
+		cwt::Font lastFont;
+		bool hasFont = false;
+		std::uint64_t lastEpoch = 0;
+
+		// Consumer state
+		Chunk* head;
+		size_t readPos = 0;
+		cwt::Pen pen{};
+		cwt::Font font;
+
+		// Shared state
+		// Chunks handed back by the consumer: a regular one, and one that was
+		// made for a record larger than CHUNK_BYTES
+		std::atomic<Chunk*> spare{ nullptr };
+		std::atomic<Chunk*> largeSpare{ nullptr };
+		// Bytes of records ever appended and drained, each written by one side
+		std::atomic<size_t> writtenBytes{ 0 };
+		std::atomic<size_t> drainedBytes{ 0 };
+		std::atomic<bool> consumerWaiting{ false };
+		std::atomic<std::uint32_t> wakeups{ 0 };
+		std::atomic<std::uint64_t> completed{ 0 };
+	};
+}
@@ -0,0 +1,412 @@
+#include "DisplayList.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cwchar>
+
+std::uint32_t geom::DisplayList::hashPen(const cwt::Pen& pen)
+{
+	std::uint64_t bits;
+	std::memcpy(&bits, &pen.radius, sizeof(bits));
+	const std::uint64_t h = (bits ^ pen.color.pack()) * 0x9E3779B97F4A7C15ull;
+	return (std::uint32_t)(h >> 32);
+}
+
+void geom::DisplayList::growPenSlots()
+{
+	std::vector<PenSlot> old(std::max(penSlots.size() * 2, size_t{ 64 }), PenSlot{ EMPTY_PEN_SLOT, 0 });
+	old.swap(penSlots);
+	const size_t mask = penSlots.size() - 1;
+	for (const PenSlot& entry : old)
+	{
+		if (entry.pen == EMPTY_PEN_SLOT)
+		{
+			continue;
+		}
+		size_t slot = entry.hash & mask;
+		while (penSlots[slot].pen != EMPTY_PEN_SLOT)
+		{
+			slot = (slot + 1) & mask;
+		}
+		penSlots[slot] = entry;
+	}
+}
+
+void geom::DisplayList::addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2)
+{
+	const float c[4] = { (float)x1, (float)y1, (float)x2, (float)y2 };
+	appendLine(pen, c);
+}
+
+void geom::DisplayList::addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	if (isFill && isDot(pen, width, height))
+	{
+		addDot(pen, x, y, width, height);
+		return;
+	}
+	float* c = push(isFill ? Op::FilledEllipse : Op::Ellipse, pen, 4);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+}
+
+void geom::DisplayList::addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep)
+{
+	float* c = push(Op::Arc, pen, 6);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+	c[4] = (float)start;
+	c[5] = (float)sweep;
+}
+
+void geom::DisplayList::addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill)
+{
+	if (isFill && isDot(pen, width, height))
+	{
+		addDot(pen, x, y, width, height);
+		return;
+	}
+	float* c = push(isFill ? Op::FilledRectangle : Op::Rectangle, pen, 4);
+	c[0] = (float)x;
+	c[1] = (float)y;
+	c[2] = (float)width;
+	c[3] = (float)height;
+}
+
+void geom::DisplayList::addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill)
+{
+	pushBatch(isFill ? Op::FilledPolygon : Op::Polygon, pen, xy, 2 * n);
+}
+
+void geom::DisplayList::addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, double x, double y)
+{
+	float* c = push(Op::Text, pen, 2);
+	c[0] = (float)x;
+	c[1] = (float)y;
+
+	// count of a text command is the index of its run, not a coordinate count
+	commands.back().count = (std::uint32_t)texts.size();
+	const size_t length = std::wcslen(text) + 1;
+	wchar_t* copy = arena.allocate<wchar_t>(length);
+	std::copy(text, text + length, copy);
+	texts.push_back(TextRun{ copy, internFont(font) });
+}
+
+void geom::DisplayList::addLines(const cwt::Pen& pen, const double* segments, size_t n)
+{
+	pushBatch(Op::Lines, pen, segments, 4 * n);
+}
+
+void geom::DisplayList::addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	pushBoxes(Op::FilledEllipses, pen, boxes, 4 * n);
+}
+
+void geom::DisplayList::addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n)
+{
+	pushBoxes(Op::FilledRectangles, pen, boxes, 4 * n);
+}
+
+void geom::DisplayList::add(Op op, const cwt::Pen& pen, const float* values, size_t count)
+{
+	assert(op != Op::Text && op != Op::Dots && "Text and dot commands cannot be copied!");
+	switch (op)
+	{
+	case Op::Line:
+		appendLine(pen, values);
+		return;
+	case Op::FilledEllipse:
+	case Op::FilledRectangle:
+		if (isDot(pen, values[2], values[3]))
+		{
+			addDot(pen, values[0], values[1], values[2], values[3]);
+			return;
+		}
+		break;
+	case Op::FilledEllipses:
+	case Op::FilledRectangles:
+		pushBoxes(op, pen, values, count);
+		return;
+	default:
+		break;
+	}
+	float* c = push(op, pen, count);
+	std::copy(values, values + count, c);
+}
+
+void geom::DisplayList::setCanvasSize(int width, int height)
+{
+	if (width == slotWidth && height == slotHeight)
+	{
+		return;
+	}
+	// Slots are indexed by pixel, so they only serve one size
+	closeLayer();
+	slotWidth = width;
+	slotHeight = height;
+	slots.clear();
+	slots.shrink_to_fit();
+}
+
+void geom::DisplayList::clear()
+{
+	closeLayer();
+	commands.clear();
+	texts.clear();
+	arena.reset();
+	layers.clear();
+	pendingDots.clear();
+	openPath = SIZE_MAX;
+}
+
+size_t geom::DisplayList::viewBytes() const
+{
+	size_t bytes = commands.capacity() * sizeof(Command)
+		+ texts.capacity() * sizeof(TextRun)
+		+ arena.viewCapacity()
+		+ pens.capacity() * sizeof(cwt::Pen)
+		+ penSlots.capacity() * sizeof(PenSlot)
+		+ fonts.capacity() * sizeof(cwt::Font)
+		+ slots.capacity() * sizeof(std::uint32_t);
+	for (const std::vector<Dot>& layer : layers)
+	{
+		bytes += layer.capacity() * sizeof(Dot);
+	}
+	return bytes;
+}
+
+std::uint32_t geom::DisplayList::internPen(const cwt::Pen& pen)
+{
+	// Consecutive primitives almost always share the pen
+	if (!pens.empty() && pens[lastPen] == pen)
+	{
+		return lastPen;
+	}
+
+	if (2 * (pens.size() + 1) > penSlots.size())
+	{
+		growPenSlots();
+	}
+	const std::uint32_t hash = hashPen(pen);
+	const size_t mask = penSlots.size() - 1;
+	size_t slot = hash & mask;
+	for (; penSlots[slot].pen != EMPTY_PEN_SLOT; slot = (slot + 1) & mask)
+	{
+		if (penSlots[slot].hash == hash && pens[penSlots[slot].pen] == pen)
+		{
+			lastPen = penSlots[slot].pen;
+			return lastPen;
+		}
+	}
+	penSlots[slot] = PenSlot{ (std::uint32_t)pens.size(), hash };
+	pens.push_back(pen);
+	lastPen = penSlots[slot].pen;
+	return lastPen;
+}
+
+std::uint32_t geom::DisplayList::internFont(const cwt::Font& font)
+{
+	if (!fonts.empty() && fonts[lastFont] == font)
+	{
+		return lastFont;
+	}
+
+	// Programs use a handful of fonts, a linear scan is enough
+	for (std::uint32_t i = 0; i < fonts.size(); i++)
+	{
+		if (fonts[i] == font)
+		{
+			lastFont = i;
+			return lastFont;
+		}
+	}
+	fonts.push_back(font);
+	lastFont = (std::uint32_t)(fonts.size() - 1);
+	return lastFont;
+}
+
+float* geom::DisplayList::push(Op op, const cwt::Pen& pen, size_t count)
+{
+	closeLayer();
+	assert(count <= UINT32_MAX && "Too many coordinates for one command!");
+	float* c = arena.allocate<float>(count);
+	commands.push_back(Command{ op, internPen(pen), (std::uint32_t)count, c });
+	return c;
+}
+
+void geom::DisplayList::pushBatch(Op op, const cwt::Pen& pen, const double* values, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	float* c = push(op, pen, count);
+	for (size_t i = 0; i < count; i++)
+	{
+		c[i] = (float)values[i];
+	}
+}
+
+void geom::DisplayList::appendLine(const cwt::Pen& pen, const float* c)
+{
+	if (!commands.empty())
+	{
+		const Command& last = commands.back();
+		if (openPath == commands.size() - 1 && last.coords[last.count - 2] == c[0]
+			&& last.coords[last.count - 1] == c[1] && pens[last.pen] == pen)
+		{
+			extendPolyline(c[2], c[3]);
+			return;
+		}
+	}
+	float* line = push(Op::Line, pen, 4);
+	std::copy(c, c + 4, line);
+	openPath = commands.size() - 1;
+}
+
+void geom::DisplayList::extendPolyline(float x, float y)
+{
+	Command& last = commands.back();
+	if (last.op == Op::Line)
+	{
+		last.op = Op::Polyline;
+		polylineCoords = nullptr;
+		polylineCapacity = 0;
+	}
+	assert(last.count <= UINT32_MAX - 2 && "Too many coordinates for one command!");
+	if (last.count + 2 > polylineCapacity)
+	{
+		// Grown geometrically, leaving the old copy in the arena until clear()
+		polylineCapacity = std::max<size_t>(2 * polylineCapacity, 16);
+		float* grown = arena.allocate<float>(polylineCapacity);
+		std::copy(last.coords, last.coords + last.count, grown);
+		polylineCoords = grown;
+		last.coords = grown;
+	}
+	polylineCoords[last.count] = x;
+	polylineCoords[last.count + 1] = y;
+	last.count += 2;
+}
+
+template <class Value>
+void geom::DisplayList::pushBoxes(Op op, const cwt::Pen& pen, const Value* boxes, size_t count)
+{
+	// The boxes share the pen, so merging some into a dot layer drawn after
+	// the others looks the same
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i += 4)
+	{
+		if (!isDot(pen, boxes[i + 2], boxes[i + 3]))
+		{
+			kept += 4;
+		}
+	}
+	if (kept > 0)
+	{
+		float* c = push(op, pen, kept);
+		for (size_t i = 0; i < count; i += 4)
+		{
+			if (!isDot(pen, boxes[i + 2], boxes[i + 3]))
+			{
+				c[0] = (float)boxes[i];
+				c[1] = (float)boxes[i + 1];
+				c[2] = (float)boxes[i + 2];
+				c[3] = (float)boxes[i + 3];
+				c += 4;
+			}
+		}
+	}
+	if (kept == count)
+	{
+		return;
+	}
+	for (size_t i = 0; i < count; i += 4)
+	{
+		if (isDot(pen, boxes[i + 2], boxes[i + 3]))
+		{
+			addDot(pen, boxes[i], boxes[i + 1], boxes[i + 2], boxes[i + 3]);
+		}
+	}
+}
+
+void geom::DisplayList::addDot(const cwt::Pen& pen, double x, double y, double width, double height)
+{
+	// The dot covers the pixel its center falls in
+	const double cx = std::floor(x + width / 2);
+	const double cy = std::floor(y + height / 2);
+	if (cx < 0.0 || cy < 0.0 || cx >= slotWidth || cy >= slotHeight)
+	{
+		return;
+	}
+
+	const std::uint32_t penIndex = internPen(pen);
+	if (!isLayerOpen)
+	{
+		layerCommand = commands.size();
+		commands.push_back(Command{ Op::Dots, penIndex, (std::uint32_t)layers.size(), nullptr });
+		layers.emplace_back();
+		isLayerOpen = true;
+	}
+	if (slots.empty())
+	{
+		slots.assign((size_t)slotWidth * slotHeight, 0);
+	}
+
+	std::vector<Dot>& layer = layers.back();
+	std::uint32_t& slot = slots[(size_t)cy * slotWidth + (size_t)cx];
+	if (slot == 0)
+	{
+		dirtyDots.push_back((std::uint32_t)layer.size());
+		layer.push_back(Dot{ (std::int32_t)cx, (std::int32_t)cy, penIndex });
+		slot = (std::uint32_t)layer.size() | DIRTY_SLOT;
+		return;
+	}
+
+	Dot& dot = layer[(slot & ~DIRTY_SLOT) - 1];
+	// Only a change of pen needs the pixel to be drawn again
+	if (dot.pen != penIndex)
+	{
+		dot.pen = penIndex;
+		if (!(slot & DIRTY_SLOT))
+		{
+			dirtyDots.push_back((slot & ~DIRTY_SLOT) - 1);
+			slot |= DIRTY_SLOT;
+		}
+	}
+}
+
+void geom::DisplayList::closeLayer()
+{
+	if (!isLayerOpen)
+	{
+		return;
+	}
+	collectDirtyDots();
+	std::vector<Dot>& layer = layers.back();
+	for (const Dot& dot : layer)
+	{
+		slots[(size_t)dot.y * slotWidth + dot.x] = 0;
+	}
+	layer.shrink_to_fit();
+	isLayerOpen = false;
+}
+
+void geom::DisplayList::collectDirtyDots()
+{
+	if (!isLayerOpen)
+	{
+		return;
+	}
+	const std::vector<Dot>& layer = layers.back();
+	for (std::uint32_t i : dirtyDots)
+	{
+		const Dot& dot = layer[i];
+		slots[(size_t)dot.y * slotWidth + dot.x] &= ~DIRTY_SLOT;
+		pendingDots.push_back(PendingDot{ layerCommand, dot });
+	}
+	dirtyDots.clear();
+}
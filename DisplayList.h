@@ -0,0 +1,356 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "FrameArena.h"
+#include "cwt.h"
+
+namespace geom
+{
+	enum class Op : std::uint8_t
+	{
+		Line,
+		Ellipse,
+		FilledEllipse,
+		Arc,
+		Rectangle,
+		FilledRectangle,
+		Polygon,
+		FilledPolygon,
+		// Lines joined end to end, stroked as one path
+		Polyline,
+		Text,
+		// Batches of primitives sharing one pen
+		Lines,
+		FilledEllipses,
+		FilledRectangles,
+		// Pixels covered by dots; count is the index of the dot layer
+		Dots
+	};
+
+	// One drawing command. Its coordinates live in the frame arena of the
+	// display list, so recording a primitive never allocates on its own.
+	struct Command
+	{
+		Op op;
+		std::uint32_t pen;		// index into the pen palette
+		std::uint32_t count;	// number of coordinates, or the text run for Op::Text
+		const float* coords;	// null for Op::Dots
+	};
+
+	// One pixel of a dot layer, standing for every opaque dot merged into it:
+	// only the one drawn last shows
+	struct Dot
+	{
+		std::int32_t x;
+		std::int32_t y;
+		std::uint32_t pen;		// pen of the dot drawn last
+	};
+
+	// A pen or font as replay() hands it to a device, with the handle it is
+	// interned under. Handles stay the same for as long as the display list
+	// lives, clear() included, so devices can key what they build on them.
+	template <class Value>
+	struct Interned
+	{
+		std::uint32_t handle;
+		const Value& value;
+
+		const Value& operator*() const { return value; }
+		const Value* operator->() const { return &value; }
+	};
+
+	using PenRef = Interned<cwt::Pen>;
+	using FontRef = Interned<cwt::Font>;
+
+	struct TextRun
+	{
+		const wchar_t* text;	// null terminated, in the frame arena
+		std::uint32_t font;		// index into the font palette
+	};
+
+	/**
+	 * Compact, typed list of everything drawn on a canvas, in drawing order.
+	 * Coordinates are pixels stored as floats; pens and fonts are interned in
+	 * palettes and referenced by index.
+	 *
+	 * replay() walks a range of commands and calls, for each one, the matching
+	 * member of a device, passing pens as PenRef and fonts as FontRef:
+	 *
+	 *   line(pen, x1, y1, x2, y2)
+	 *   ellipse(pen, x, y, width, height, isFill)
+	 *   arc(pen, x, y, width, height, start, sweep)
+	 *   rectangle(pen, x, y, width, height, isFill)
+	 *   polygon(pen, xy, n, isFill)		xy holds n interleaved (x, y) pairs
+	 *   polyline(pen, xy, n)				the same, left open
+	 *   text(pen, font, text, x, y)
+	 *   lines(pen, segments, n)			n segments as (x1, y1, x2, y2)
+	 *   filledEllipses(pen, boxes, n)		n boxes as (x, y, width, height)
+	 *   filledRectangles(pen, boxes, n)	n boxes as (x, y, width, height)
+	 *
+	 * Once the canvas size is known, opaque filled boxes no larger than a pixel
+	 * are not stored as commands: runs of them are merged into a dot layer holding
+	 * at most one Dot per pixel, and dots off the canvas are dropped. A scatter
+	 * plot of any number of opaque points then costs memory in proportion to
+	 * the canvas; translucent points, which darken each other, are still
+	 * stored one by one. Dot layers are replayed as filledRectangles() of 1x1
+	 * boxes.
+	 *
+	 * A line starting where the one before ended, with the same pen, extends
+	 * it into a polyline, so that a path drawn one line() at a time is stroked
+	 * as a whole: its joints are round and a translucent pen does not darken
+	 * them. Until endPath(), or a command that is not such a line, the path is
+	 * still open and replayNew() holds it back, so it is stroked once whenever
+	 * replayNew() runs and the commands do not depend on it.
+	 *
+	 * Coordinates and text are copied once, into a FrameArena that clear()
+	 * rewinds, so a frame redrawn after clear() reuses the memory of the last.
+	 */
+	class DisplayList
+	{
+	public:
+		void addLine(const cwt::Pen& pen, double x1, double y1, double x2, double y2);
+		void addEllipse(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		void addArc(const cwt::Pen& pen, double x, double y, double width, double height, double start, double sweep);
+		void addRectangle(const cwt::Pen& pen, double x, double y, double width, double height, bool isFill);
+		// xy holds n interleaved (x, y) pairs
+		void addPolygon(const cwt::Pen& pen, const double* xy, size_t n, bool isFill);
+		void addText(const cwt::Pen& pen, const cwt::Font& font, const wchar_t* text, double x, double y);
+
+		// Batched variants: one command for n primitives, four values each
+		void addLines(const cwt::Pen& pen, const double* segments, size_t n);
+		void addFilledEllipses(const cwt::Pen& pen, const double* boxes, size_t n);
+		void addFilledRectangles(const cwt::Pen& pen, const double* boxes, size_t n);
+
+		// Appends any command but Op::Text from coordinates already in the
+		// layout replay() hands to the device
+		void add(Op op, const cwt::Pen& pen, const float* values, size_t count);
+
+		// Enables merging of dots on a width x height canvas
+		void setCanvasSize(int width, int height);
+
+		size_t size() const { return commands.size(); }
+		// Commands replayNew() hands out: all but the open path
+		size_t settledSize() const
+		{
+			return !commands.empty() && openPath == commands.size() - 1 ? openPath : commands.size();
+		}
+		bool empty() const { return commands.empty(); }
+		// Memory held, used or not
+		size_t viewBytes() const;
+
+		// Removes every command; the palettes are kept
+		void clear();
+
+		// Ends the open path, if any, so that replayNew() hands it out and the
+		// next line starts a new one
+		void endPath() { openPath = SIZE_MAX; }
+
+		// True if replayNew() from drawn has anything to draw
+		bool hasNew(size_t drawn) const
+		{
+			return drawn < settledSize() || !dirtyDots.empty() || !pendingDots.empty();
+		}
+
+		// Replays the commands from drawn on but the open path, after the dots
+		// that changed in layers already replayed, and advances drawn past them
+		template <class Device>
+		void replayNew(Device& device, size_t& drawn)
+		{
+			collectDirtyDots();
+			redrawDots.clear();
+			for (const PendingDot& pending : pendingDots)
+			{
+				if (pending.command < drawn)
+				{
+					redrawDots.push_back(pending.dot);
+				}
+			}
+			pendingDots.clear();
+			replayDots(device, redrawDots.data(), redrawDots.size());
+			const size_t end = settledSize();
+			replay(device, drawn, end);
+			drawn = end;
+		}
+
+		template <class Device>
+		void replay(Device& device, size_t begin, size_t end) const
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const Command& cmd = commands[i];
+				const PenRef pen{ cmd.pen, pens[cmd.pen] };
+				const float* c = cmd.coords;
+				switch (cmd.op)
+				{
+				case Op::Line:
+					device.line(pen, c[0], c[1], c[2], c[3]);
+					break;
+				case Op::Ellipse:
+				case Op::FilledEllipse:
+					device.ellipse(pen, c[0], c[1], c[2], c[3], cmd.op == Op::FilledEllipse);
+					break;
+				case Op::Arc:
+					device.arc(pen, c[0], c[1], c[2], c[3], c[4], c[5]);
+					break;
+				case Op::Rectangle:
+				case Op::FilledRectangle:
+					device.rectangle(pen, c[0], c[1], c[2], c[3], cmd.op == Op::FilledRectangle);
+					break;
+				case Op::Polygon:
+				case Op::FilledPolygon:
+					device.polygon(pen, c, cmd.count / 2, cmd.op == Op::FilledPolygon);
+					break;
+				case Op::Polyline:
+					device.polyline(pen, c, cmd.count / 2);
+					break;
+				case Op::Text:
+				{
+					const TextRun& run = texts[cmd.count];
+					device.text(pen, FontRef{ run.font, fonts[run.font] }, run.text, c[0], c[1]);
+					break;
+				}
+				case Op::Lines:
+					device.lines(pen, c, cmd.count / 4);
+					break;
+				case Op::FilledEllipses:
+					device.filledEllipses(pen, c, cmd.count / 4);
+					break;
+				case Op::FilledRectangles:
+					device.filledRectangles(pen, c, cmd.count / 4);
+					break;
+				case Op::Dots:
+					replayDots(device, layers[cmd.count].data(), layers[cmd.count].size());
+					break;
+				}
+			}
+		}
+
+		template <class Device>
+		void replay(Device& device) const
+		{
+			replay(device, 0, commands.size());
+		}
+
+	private:
+		// Dots are replayed in batches of up to this many pixels
+		static constexpr size_t DOT_BATCH = 256;
+		// Set in a slot when its dot changed since it was last replayed
+		static constexpr std::uint32_t DIRTY_SLOT = 0x80000000u;
+
+		// A dot that changed in a layer which may already have been replayed
+		struct PendingDot
+		{
+			size_t command;
+			Dot dot;
+		};
+
+		// Slot of the pen table: index into pens and hashPen() of the pen,
+		// which spares looking most other pens up while probing
+		struct PenSlot
+		{
+			std::uint32_t pen;
+			std::uint32_t hash;
+		};
+
+		// pen of a free slot
+		static constexpr std::uint32_t EMPTY_PEN_SLOT = 0xFFFFFFFFu;
+
+		static std::uint32_t hashPen(const cwt::Pen& pen);
+
+		// Doubles penSlots and puts every pen back in it
+		void growPenSlots();
+
+		std::uint32_t internPen(const cwt::Pen& pen);
+		std::uint32_t internFont(const cwt::Font& font);
+
+		// Appends a command and reserves count coordinates for it
+		float* push(Op op, const cwt::Pen& pen, size_t count);
+
+		// Appends a command holding a copy of count coordinates
+		void pushBatch(Op op, const cwt::Pen& pen, const double* values, size_t count);
+
+		// Appends the line (c[0], c[1])-(c[2], c[3]), extending the last
+		// command with it if it ends where the line starts
+		void appendLine(const cwt::Pen& pen, const float* c);
+		// Adds the vertex (x, y) to the last command, turning a line into a polyline
+		void extendPolyline(float x, float y);
+
+		// Appends a batch of filled boxes, merging the ones no larger than a pixel
+		template <class Value>
+		void pushBoxes(Op op, const cwt::Pen& pen, const Value* boxes, size_t count);
+
+		// Only opaque dots merge: each translucent one darkens the pixel further
+		bool isDot(const cwt::Pen& pen, double width, double height) const
+		{
+			return slotWidth > 0 && pen.color.a == 255 && std::abs(width) <= 1.0 && std::abs(height) <= 1.0;
+		}
+
+		// Merges the dot covering the box (x, y, width, height) into the open layer
+		void addDot(const cwt::Pen& pen, double x, double y, double width, double height);
+
+		// Ends the open dot layer, if any, so that later commands draw over it
+		void closeLayer();
+
+		// Moves the dots changed in the open layer to pendingDots
+		void collectDirtyDots();
+
+		// Runs of dots sharing a pen become one batch of pixel sized boxes
+		template <class Device>
+		void replayDots(Device& device, const Dot* dots, size_t n) const
+		{
+			float boxes[4 * DOT_BATCH];
+			size_t i = 0;
+			while (i < n)
+			{
+				const std::uint32_t pen = dots[i].pen;
+				size_t m = 0;
+				for (; i < n && m < DOT_BATCH && dots[i].pen == pen; i++, m++)
+				{
+					boxes[4 * m] = (float)dots[i].x;
+					boxes[4 * m + 1] = (float)dots[i].y;
+					boxes[4 * m + 2] = 1.0f;
+					boxes[4 * m + 3] = 1.0f;
+				}
+				device.filledRectangles(PenRef{ pen, pens[pen] }, boxes, m);
+			}
+		}
+
+		std::vector<Command> commands;
+		std::vector<TextRun> texts;
+		// Coordinates and characters of the commands
+		FrameArena arena;
+
+		std::vector<cwt::Pen> pens;
+		// Open addressing table of indices into pens, by hashPen(), at most
+		// half full; a new color for every primitive costs no allocation
+		std::vector<PenSlot> penSlots;
+		std::uint32_t lastPen = 0;
+
+		std::vector<cwt::Font> fonts;
+		std::uint32_t lastFont = 0;
+
+		// Index of the Op::Line or Op::Polyline command appendLine() may extend
+		size_t openPath = SIZE_MAX;
+		// Vertices of the open path once it is a polyline, with room for as
+		// many floats as polylineCapacity
+		float* polylineCoords = nullptr;
+		size_t polylineCapacity = 0;
+
+		// Dot layers; only the last one may be open to more dots
+		std::vector<std::vector<Dot>> layers;
+		bool isLayerOpen = false;
+		// Index of the Op::Dots command of the open layer
+		size_t layerCommand = 0;
+		// Canvas size the dots are merged on, 0 until it is set
+		int slotWidth = 0;
+		int slotHeight = 0;
+		// Per pixel, 1 + index of its dot in the open layer, or 0
+		std::vector<std::uint32_t> slots;
+		// Dots of the open layer changed since it was last replayed
+		std::vector<std::uint32_t> dirtyDots;
+		std::vector<PendingDot> pendingDots;
+		std::vector<Dot> redrawDots;
+	};
+}
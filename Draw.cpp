@@ -0,0 +1,888 @@
+#include "Draw.h"
+#include "ImageWriter.h"
+#include "Recorder.h"
+#include "Simd.h"
+#include "VectorWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+void renderThreadFunc(Render& render)
+{
+	render.show();
+}
+
+Draw::Draw()
+	: Draw(L"Draw")
+{
+}
+
+Draw::Draw(std::wstring title)
+	: title(std::move(title))
+{
+	updateTransform();
+}
+
+Draw::~Draw()
+{
+	// Nothing started the render thread if nothing was drawn
+	if (tRender.joinable())
+	{
+		tRender.join();
+	}
+}
+
+void Draw::setCanvasSize()
+{
+	setCanvasSize(DEFAULT_SIZE, DEFAULT_SIZE);
+}
+
+void Draw::setCanvasSize(int canvasWidth, int canvasHeight)
+{
+	if (canvasWidth <= 0)
+	{
+		throw std::invalid_argument("width must be positive");
+	}
+	if (canvasHeight <= 0)
+	{
+		throw std::invalid_argument("height must be positive");
+	}
+	width = canvasWidth;
+	height = canvasHeight;
+	updateTransform();
+	render.setCanvasSize(canvasWidth, canvasHeight);
+}
+
+void Draw::setXscale()
+{
+	setXscale(DEFAULT_XMIN, DEFAULT_XMAX);
+}
+
+void Draw::setYscale()
+{
+	setYscale(DEFAULT_YMIN, DEFAULT_YMAX);
+}
+
+void Draw::setScale()
+{
+	setXscale();
+	setYscale();
+}
+
+void Draw::setXscale(double min, double max)
+{
+	validateScale(min, max);
+	double size = max - min;
+	xmin = min - BORDER * size;
+	xmax = max + BORDER * size;
+	transform.setLogX(false);
+	updateTransform();
+}
+
+void Draw::setYscale(double min, double max)
+{
+	validateScale(min, max);
+	double size = max - min;
+	ymin = min - BORDER * size;
+	ymax = max + BORDER * size;
+	transform.setLogY(false);
+	updateTransform();
+}
+
+void Draw::setScale(double min, double max)
+{
+	setXscale(min, max);
+	setYscale(min, max);
+}
+
+void Draw::setXscaleLog(double min, double max)
+{
+	validateScale(min, max);
+	if (min <= 0 || max <= 0)
+	{
+		throw std::invalid_argument("a log scale must be positive");
+	}
+	setXscale(std::log10(min), std::log10(max));
+	transform.setLogX(true);
+}
+
+void Draw::setYscaleLog(double min, double max)
+{
+	validateScale(min, max);
+	if (min <= 0 || max <= 0)
+	{
+		throw std::invalid_argument("a log scale must be positive");
+	}
+	setYscale(std::log10(min), std::log10(max));
+	transform.setLogY(true);
+}
+
+void Draw::enablePolarCoordinates()
+{
+	transform.setPolar(true);
+}
+
+void Draw::disablePolarCoordinates()
+{
+	transform.setPolar(false);
+}
+
+void Draw::clear()
+{
+	clear(DEFAULT_CLEAR_COLOR);
+}
+
+void Draw::clear(cwt::Color color)
+{
+	render.clear(cwt::getRgba(color));
+
+	draw();
+}
+
+double Draw::getPenRadius()
+{
+	return render.viewPen().radius;
+}
+
+void Draw::setPenRadius()
+{
+	setPenRadius(DEFAULT_PEN_RADIUS);
+}
+
+void Draw::setPenRadius(double radius)
+{
+	validate(radius, "pen radius");
+	validateNonnegative(radius, "pen radius");
+
+	render.getPen().radius = radius;
+}
+
+cwt::Color Draw::getPenColor()
+{
+	const cwt::ColorRgba color = render.viewPen().color;
+	return cwt::getColor(color.r, color.g, color.b);
+}
+
+cwt::ColorRgba Draw::getPenColorRgba()
+{
+	return render.viewPen().color;
+}
+
+void Draw::setPenColor()
+{
+	setPenColor(DEFAULT_PEN_COLOR);
+}
+
+void Draw::init()
+{
+	tRender = std::thread(renderThreadFunc, std::ref(render));
+}
+
+void Draw::draw()
+{
+	if (!hasRenderInit)
+	{
+		init();
+		hasRenderInit = true;
+	}
+}
+
+void Draw::setPenColor(cwt::Color color)
+{
+	render.getPen().color = cwt::getRgba(color);
+}
+
+void Draw::setPenColor(int red, int green, int blue)
+{
+	setPenColor(red, green, blue, 255);
+}
+
+void Draw::setPenColor(int red, int green, int blue, int alpha)
+{
+	if (red < 0 || red >= 256)
+	{
+		throw std::invalid_argument("red must be between 0 and 255");
+	}
+	if (green < 0 || green >= 256)
+	{
+		throw std::invalid_argument("green must be between 0 and 255");
+	}
+	if (blue < 0 || blue >= 256)
+	{
+		throw std::invalid_argument("blue must be between 0 and 255");
+	}
+	if (alpha < 0 || alpha >= 256)
+	{
+		throw std::invalid_argument("alpha must be between 0 and 255");
+	}
+	render.getPen().color = cwt::ColorRgba{ (std::uint8_t)red, (std::uint8_t)green, (std::uint8_t)blue, (std::uint8_t)alpha };
+}
+
+void Draw::setPenColor(cwt::ColorRgba color)
+{
+	render.getPen().color = color;
+}
+
+cwt::Font Draw::getFont()
+{
+	return render.viewFont();
+}
+
+void Draw::setFont()
+{
+	setFont(DEFAULT_FONT);
+}
+
+void Draw::setFont(cwt::Font font)
+{
+	render.getFont() = font;
+}
+
+void Draw::line(double x0, double y0, double x1, double y1)
+{
+	validate(x0, "x0");
+	validate(y0, "y0");
+	validate(x1, "x1");
+	validate(y1, "y1");
+	double xs0, ys0, xs1, ys1;
+	toScreen(x0, y0, xs0, ys0);
+	toScreen(x1, y1, xs1, ys1);
+	if (!isOffCanvas(xs0, ys0, xs1 - xs0, ys1 - ys0))
+	{
+		render.drawLine(xs0, ys0, xs1, ys1);
+	}
+
+	draw();
+}
+
+void Draw::point(double x, double y)
+{
+	validate(x, "x");
+	validate(y, "y");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double scaledPenRadius = penWidth();
+	if (scaledPenRadius <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - scaledPenRadius / 2, ys - scaledPenRadius / 2, scaledPenRadius, scaledPenRadius))
+	{
+		render.fillElipse(xs - scaledPenRadius / 2, ys - scaledPenRadius / 2, scaledPenRadius, scaledPenRadius);
+	}
+	draw();
+}
+
+void Draw::circle(double x, double y, double radius)
+{
+	validate(x, "x");
+	validate(y, "y");
+	validate(radius, "radius");
+	validateNonnegative(radius, "radius");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double ws = factorX(2 * radius);
+	double hs = factorY(2 * radius);
+	if (ws <= 1 && hs <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+	{
+		render.drawElipse(xs - ws / 2, ys - hs / 2, ws, hs);
+	}
+	draw();
+}
+
+void Draw::filledCircle(double x, double y, double radius)
+{
+	validate(x, "x");
+	validate(y, "y");
+	validate(radius, "radius");
+	validateNonnegative(radius, "radius");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double ws = factorX(2 * radius);
+	double hs = factorY(2 * radius);
+	if (ws <= 1 && hs <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+	{
+		render.fillElipse(xs - ws / 2, ys - hs / 2, ws, hs);
+	}
+	draw();
+}
+
+void Draw::arc(double x, double y, double radius, double angle1, double angle2)
+{
+	validate(x, "x");
+	validate(y, "y");
+	validate(radius, "arc radius");
+	validate(angle1, "angle1");
+	validate(angle2, "angle2");
+	validateNonnegative(radius, "arc radius");
+
+	while (angle2 < angle1)
+	{
+		angle2 += 360;
+	}
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double ws = factorX(2 * radius);
+	double hs = factorY(2 * radius);
+	if (ws <= 1 && hs <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+	{
+		render.drawArc(xs - ws / 2, ys - hs / 2, ws, hs, angle1, angle2 - angle1);
+	}
+	draw();
+}
+
+void Draw::square(double x, double y, double halfLength)
+{
+	validate(x, "x");
+	validate(y, "y");
+	validate(halfLength, "halfLength");
+	validateNonnegative(halfLength, "half length");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double ws = factorX(2 * halfLength);
+	double hs = factorY(2 * halfLength);
+	if (ws <= 1 && hs <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+	{
+		render.drawRectangle(xs - ws / 2, ys - hs / 2, ws, hs);
+	}
+
+	draw();
+}
+
+void Draw::filledSquare(double x, double y, double halfLength)
+{
+	validate(x, "x");
+	validate(y, "y");
+	validate(halfLength, "halfLength");
+	validateNonnegative(halfLength, "half length");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	double ws = factorX(2 * halfLength);
+	double hs = factorY(2 * halfLength);
+	if (ws <= 1 && hs <= 1)
+	{
+		pixel(x, y);
+	}
+	else if (!isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+	{
+		render.fillRectangle(xs - ws / 2, ys - hs / 2, ws, hs);
+	}
+
+	draw();
+}
+
+void Draw::polygon(std::span<const double> x, std::span<const double> y)
+{
+	if (x.size() != y.size())
+	{
+		throw std::invalid_argument("arrays must be of the same length");
+	}
+	if (x.empty())
+	{
+		return;
+	}
+
+	if (scalePolygon(x, y))
+	{
+		render.drawPolygon(batch);
+	}
+	draw();
+}
+
+void Draw::filledPolygon(std::span<const double> x, std::span<const double> y)
+{
+	if (x.size() != y.size())
+	{
+		throw std::invalid_argument("arrays must be of the same length");
+	}
+	if (x.empty())
+	{
+		return;
+	}
+
+	if (scalePolygon(x, y))
+	{
+		render.fillPolygon(batch);
+	}
+	draw();
+}
+
+bool Draw::scalePolygon(std::span<const double> x, std::span<const double> y)
+{
+	validateAll(x, "x");
+	validateAll(y, "y");
+
+	// Scale straight into interleaved (x, y) pairs, the only copy made before
+	// the render queue
+	batch.resize(2 * x.size());
+	toScreen(x, y, batch.data(), batch.data() + 1, 2);
+
+	double xlo = batch[0];
+	double xhi = batch[0];
+	double ylo = batch[1];
+	double yhi = batch[1];
+	for (size_t i = 2; i < batch.size(); i += 2)
+	{
+		xlo = (std::min)(xlo, batch[i]);
+		xhi = (std::max)(xhi, batch[i]);
+		ylo = (std::min)(ylo, batch[i + 1]);
+		yhi = (std::max)(yhi, batch[i + 1]);
+	}
+	return !isOffCanvas(xlo, ylo, xhi - xlo, yhi - ylo);
+}
+
+void Draw::lines(std::span<const double> x0, std::span<const double> y0,
+	std::span<const double> x1, std::span<const double> y1)
+{
+	const size_t n = x0.size();
+	if (y0.size() != n || x1.size() != n || y1.size() != n)
+	{
+		throw std::invalid_argument("arrays must be of the same length");
+	}
+	validateAll(x0, "x0");
+	validateAll(y0, "y0");
+	validateAll(x1, "x1");
+	validateAll(y1, "y1");
+
+	batch.resize(4 * n);
+	toScreen(x0, y0, batch.data(), batch.data() + 1, 4);
+	toScreen(x1, y1, batch.data() + 2, batch.data() + 3, 4);
+	// Segments that miss the canvas are dropped, keeping the rest in order
+	size_t kept = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		const double* s = batch.data() + 4 * i;
+		if (!isOffCanvas(s[0], s[1], s[2] - s[0], s[3] - s[1]))
+		{
+			std::copy(s, s + 4, batch.data() + 4 * kept++);
+		}
+	}
+	batch.resize(4 * kept);
+	render.drawLines(batch);
+	draw();
+}
+
+void Draw::points(std::span<const double> x, std::span<const double> y)
+{
+	const size_t n = x.size();
+	if (y.size() != n)
+	{
+		throw std::invalid_argument("arrays must be of the same length");
+	}
+	validateAll(x, "x");
+	validateAll(y, "y");
+
+	batch.resize(4 * n);
+	double scaledPenRadius = penWidth();
+	if (scaledPenRadius <= 1)
+	{
+		toScreen(x, y, batch.data(), batch.data() + 1, 4);
+		size_t kept = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const double xs = std::round(batch[4 * i]);
+			const double ys = std::round(batch[4 * i + 1]);
+			if (!isOffCanvas(xs, ys, 1, 1))
+			{
+				batch[4 * kept] = xs;
+				batch[4 * kept + 1] = ys;
+				batch[4 * kept + 2] = 1;
+				batch[4 * kept + 3] = 1;
+				kept++;
+			}
+		}
+		batch.resize(4 * kept);
+		render.fillRectangles(batch);
+	}
+	else
+	{
+		toScreen(x, y, batch.data(), batch.data() + 1, 4, -scaledPenRadius / 2);
+		size_t kept = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const double xs = batch[4 * i];
+			const double ys = batch[4 * i + 1];
+			if (!isOffCanvas(xs, ys, scaledPenRadius, scaledPenRadius))
+			{
+				batch[4 * kept] = xs;
+				batch[4 * kept + 1] = ys;
+				batch[4 * kept + 2] = scaledPenRadius;
+				batch[4 * kept + 3] = scaledPenRadius;
+				kept++;
+			}
+		}
+		batch.resize(4 * kept);
+		render.fillElipses(batch);
+	}
+	draw();
+}
+
+void Draw::filledCircles(std::span<const double> x, std::span<const double> y, std::span<const double> r)
+{
+	const size_t n = x.size();
+	if (y.size() != n || r.size() != n)
+	{
+		throw std::invalid_argument("arrays must be of the same length");
+	}
+	validateAll(x, "x");
+	validateAll(y, "y");
+	validateAll(r, "radius");
+	validateAllNonnegative(r, "radius");
+
+	// Circles smaller than a pixel become pixels, like in filledCircle()
+	batch.clear();
+	batchPixels.clear();
+	const bool isCurved = transform.isCurved();
+	transform.visit([&](const auto& t)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				double xs, ys;
+				t.apply(x[i], y[i], xs, ys);
+				if (isCurved)
+				{
+					validateScaled(xs, ys);
+				}
+				double ws = t.lengthX(2 * r[i]);
+				double hs = t.lengthY(2 * r[i]);
+				if (isOffCanvas(xs - ws / 2, ys - hs / 2, ws, hs))
+				{
+					continue;
+				}
+				if (ws <= 1 && hs <= 1)
+				{
+					batchPixels.insert(batchPixels.end(), { std::round(xs), std::round(ys), 1, 1 });
+				}
+				else
+				{
+					batch.insert(batch.end(), { xs - ws / 2, ys - hs / 2, ws, hs });
+				}
+			}
+		});
+	render.fillElipses(batch);
+	render.fillRectangles(batchPixels);
+	draw();
+}
+
+void Draw::text(double x, double y, std::wstring_view text)
+{
+	validate(x, "x");
+	validate(y, "y");
+
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	int ws = 0;
+	int hs = 0;
+	render.GetTextExtent(text.data(), (int)text.size(), ws, hs);
+	if (!isOffCanvas(xs - ws / 2.0, ys - hs, ws, hs))
+	{
+		render.drawString(text, (double)(xs - ws / 2.0), (double)(ys - hs));
+	}
+	draw();
+}
+
+void Draw::pause(int t)
+{
+	if (t < 0)
+	{
+		throw std::invalid_argument("argument must be nonnegative");
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	auto deadline = now + std::chrono::milliseconds(t);
+	if (lastPause != std::chrono::steady_clock::time_point())
+	{
+		// Count from the previous pause, but never try to catch up on frames
+		// that already ran late
+		deadline = (std::max)(now, lastPause + std::chrono::milliseconds(t));
+	}
+	std::this_thread::sleep_until(deadline);
+	lastPause = deadline;
+}
+
+void Draw::show()
+{
+	render.present();
+
+	draw();
+}
+
+void Draw::enableDoubleBuffering()
+{
+	render.setDoubleBuffering(true);
+}
+
+void Draw::disableDoubleBuffering()
+{
+	render.setDoubleBuffering(false);
+
+	draw();
+}
+
+void Draw::finish()
+{
+	draw();
+	render.finish();
+}
+
+void Draw::save(std::string filename)
+{
+	image::Format format;
+	if (!image::findFormat(filename, format))
+	{
+		throw std::invalid_argument("Invalid image file type: " + filename);
+	}
+
+	draw();
+	render.save(filename.c_str());
+}
+
+void Draw::saveSvg(std::string filename)
+{
+	constexpr bool coalesce = false;
+	saveSvg(filename, coalesce);
+}
+
+void Draw::saveSvg(std::string filename, bool coalesce)
+{
+	image::VectorFormat format;
+	if (!image::findVectorFormat(filename, format) || format != image::VectorFormat::SVG)
+	{
+		throw std::invalid_argument("Invalid SVG file type: " + filename);
+	}
+
+	draw();
+	render.saveVector(filename.c_str(), coalesce);
+}
+
+void Draw::savePdf(std::string filename)
+{
+	constexpr bool coalesce = false;
+	savePdf(filename, coalesce);
+}
+
+void Draw::savePdf(std::string filename, bool coalesce)
+{
+	image::VectorFormat format;
+	if (!image::findVectorFormat(filename, format) || format != image::VectorFormat::PDF)
+	{
+		throw std::invalid_argument("Invalid PDF file type: " + filename);
+	}
+
+	draw();
+	render.saveVector(filename.c_str(), coalesce);
+}
+
+void Draw::startRecording(std::string filename, int fps)
+{
+	image::VideoFormat format;
+	if (!image::findVideoFormat(filename, format))
+	{
+		throw std::invalid_argument("Invalid video file type: " + filename);
+	}
+	if (fps <= 0)
+	{
+		throw std::invalid_argument("fps must be positive");
+	}
+
+	draw();
+	render.startRecording(filename.c_str(), fps);
+}
+
+void Draw::stopRecording()
+{
+	render.stopRecording();
+}
+
+void Draw::startCapture(std::string filename)
+{
+	render.startCapture(filename.c_str());
+}
+
+void Draw::stopCapture()
+{
+	render.stopCapture();
+}
+
+void Draw::enableStats()
+{
+	render.enableStats(true);
+}
+
+void Draw::disableStats()
+{
+	render.enableStats(false);
+}
+
+perf::RenderStats Draw::stats()
+{
+	return render.stats();
+}
+
+void Draw::enableStatsOverlay()
+{
+	render.setStatsOverlay(true);
+}
+
+void Draw::disableStatsOverlay()
+{
+	render.setStatsOverlay(false);
+}
+
+void Draw::startStatsLog(std::string filename, int everyFrames)
+{
+	if (everyFrames <= 0)
+	{
+		throw std::invalid_argument("everyFrames must be positive");
+	}
+	render.startStatsLog(filename.c_str(), everyFrames);
+}
+
+void Draw::stopStatsLog()
+{
+	render.stopStatsLog();
+}
+
+void Draw::validate(double x, const char* name)
+{
+	// name is a plain C string so that passing checks never build a std::string
+	if (std::isnan(x))
+	{
+		throw std::invalid_argument(std::string(name) + " is NaN");
+	}
+	if (!std::isfinite(x))
+	{
+		throw std::invalid_argument(std::string(name) + " is infinite");
+	}
+}
+
+void Draw::validateNonnegative(double x, const char* name)
+{
+	if (x < 0.0)
+	{
+		throw std::invalid_argument(std::string(name) + " negative");
+	}
+}
+
+void Draw::validateAll(std::span<const double> values, const char* name)
+{
+	// The element name is only formatted once a check has failed
+	size_t i = simd::findNonFinite(values.data(), values.size());
+	if (i < values.size())
+	{
+		validate(values[i], (std::string(name) + "[" + std::to_string(i) + "]").c_str());
+	}
+}
+
+void Draw::validateAllNonnegative(std::span<const double> values, const char* name)
+{
+	size_t i = simd::findNegative(values.data(), values.size());
+	if (i < values.size())
+	{
+		validateNonnegative(values[i], (std::string(name) + "[" + std::to_string(i) + "]").c_str());
+	}
+}
+
+bool Draw::isOffCanvas(double x, double y, double w, double h)
+{
+	// The pen may reach its whole width out of the box, plus a pixel of
+	// antialiasing
+	const double slack = penWidth() + 1;
+	const double left = (std::min)(x, x + w) - slack;
+	const double right = (std::max)(x, x + w) + slack;
+	const double top = (std::min)(y, y + h) - slack;
+	const double bottom = (std::max)(y, y + h) + slack;
+	const bool isOff = right < 0 || bottom < 0 || left > width || top > height;
+	if (isOff)
+	{
+		render.countCulled(1);
+	}
+	return isOff;
+}
+
+void Draw::updateTransform()
+{
+	transform.setScale(xmin, xmax, ymin, ymax, width, height);
+}
+
+void Draw::validateScale(double min, double max)
+{
+	validate(min, "min");
+	validate(max, "max");
+	if (max - min == 0.0)
+	{
+		throw std::invalid_argument("the min and max are the same");
+	}
+}
+
+void Draw::toScreen(double x, double y, double& xs, double& ys)
+{
+	transform.apply(x, y, xs, ys);
+	if (transform.isCurved())
+	{
+		validateScaled(xs, ys);
+	}
+}
+
+void Draw::toScreen(std::span<const double> x, std::span<const double> y,
+	double* outX, double* outY, size_t stride, double shift)
+{
+	const size_t n = (std::min)(x.size(), y.size());
+	transform.visit([&](const auto& t)
+		{
+			geom::transformPoints(t, x.data(), y.data(), n, outX, outY, stride, shift);
+		});
+	if (transform.isCurved())
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			validateScaled(outX[i * stride], outY[i * stride]);
+		}
+	}
+}
+
+void Draw::validateScaled(double xs, double ys)
+{
+	if (!std::isfinite(xs) || !std::isfinite(ys))
+	{
+		throw std::invalid_argument("coordinate is not positive on a log scale");
+	}
+}
+
+void Draw::pixel(double x, double y)
+{
+	validate(x, "x");
+	validate(y, "y");
+	double xs, ys;
+	toScreen(x, y, xs, ys);
+	xs = std::round(xs);
+	ys = std::round(ys);
+	if (!isOffCanvas(xs, ys, 1, 1))
+	{
+		render.fillRectangle(xs, ys, 1, 1);
+	}
+
+	draw();
+}
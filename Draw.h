@@ -0,0 +1,777 @@
+#pragma once
+#include "Render.h"
+#include "Transform.h"
+#include "cwt.h"
+#include <chrono>
+#include <span>
+#include <thread>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Constants
+constexpr int DEFAULT_SIZE = 512;
+constexpr double DEFAULT_PEN_RADIUS = 0.002;
+constexpr double BORDER = 0.00;
+constexpr double DEFAULT_XMIN = 0.0;
+constexpr double DEFAULT_XMAX = 1.0;
+constexpr double DEFAULT_YMIN = 0.0;
+constexpr double DEFAULT_YMAX = 1.0;
+const cwt::Color DEFAULT_PEN_COLOR = cwt::Color::BLACK;
+const cwt::Color DEFAULT_CLEAR_COLOR = cwt::Color::WHITE;
+// default font
+const cwt::Font DEFAULT_FONT = cwt::Font(L"SansSerif", cwt::Font::Style::FontStyleRegular, 16);
+
+/**
+ * A canvas of its own, with its own coordinate system, pen, font and render.
+ * Unlike StdDraw, any number of them can be created, and each one can be
+ * drawn on from a different thread at the same time. With the headless
+ * render, every canvas rasterizes into its own framebuffer, so a program can
+ * draw and save many plots without starting a process for each.
+ *
+ * A canvas must only be drawn on from one thread at a time.
+ */
+class Draw
+{
+public:
+	/**
+	 * Creates a canvas titled "Draw".
+	 */
+	Draw();
+
+	/**
+	 * Creates a canvas with the given title, shown as the window caption.
+	 *
+	 * @param  title the title of the canvas
+	 */
+	explicit Draw(std::wstring title);
+
+	Draw(const Draw&) = delete;
+	void operator=(const Draw&) = delete;
+
+	~Draw();
+
+	/**
+	 * Sets the canvas (drawing area) to be 512-by-512 pixels.
+	 * This also erases the current drawing and resets the coordinate system,
+	 * pen radius, pen color, and font back to their default values.
+	 * Ordinarily, this method is called once, at the very beginning
+	 * of a program.
+	 */
+	void setCanvasSize();
+
+	/**
+	 * Sets the canvas (drawing area) to be width-by-height pixels.
+	 * This also erases the current drawing and resets the coordinate system,
+	 * pen radius, pen color, and font back to their default values.
+	 * Ordinarily, this method is called once, at the very beginning
+	 * of a program.
+	 *
+	 * @param  canvasWidth the width as a number of pixels
+	 * @param  canvasHeight the height as a number of pixels
+	 * @throws std::invalid_argument unless both canvasWidth and canvasHeight 
+	 * are positive
+	 */
+	void setCanvasSize(int canvasWidth, int canvasHeight);
+
+	/**
+	 * Sets the <em>x</em>-scale to be the default (between 0.0 and 1.0).
+	 */
+	void setXscale();
+
+	/**
+	 * Sets the <em>y</em>-scale to be the default (between 0.0 and 1.0).
+	 */
+	void setYscale();
+
+	/**
+	 * Sets the <em>x</em>-scale and <em>y</em>-scale to be the default
+	 * (between 0.0 and 1.0).
+	 */
+	void setScale();
+
+	/**
+	 * Sets the <em>x</em>-scale to the specified range.
+	 *
+	 * @param  min the minimum value of the <em>x</em>-scale
+	 * @param  max the maximum value of the <em>x</em>-scale
+	 * @throws std::invalid_argument if {@code (max == min)}
+	 * @throws std::invalid_argument if either min or max is either NaN or infinite
+	 */
+	void setXscale(double min, double max);
+
+	/**
+	 * Sets the <em>y</em>-scale to the specified range.
+	 *
+	 * @param  min the minimum value of the <em>y</em>-scale
+	 * @param  max the maximum value of the <em>y</em>-scale
+	 * @throws std::invalid_argument if {@code (max == min)}
+	 * @throws std::invalid_argument if either min or max is either NaN or infinite
+	 */
+	void setYscale(double min, double max);
+
+	/**
+	 * Sets both the <em>x</em>-scale and <em>y</em>-scale to the (same) specified range.
+	 *
+	 * @param  min the minimum value of the <em>x</em>- and <em>y</em>-scales
+	 * @param  max the maximum value of the <em>x</em>- and <em>y</em>-scales
+	 * @throws std::invalid_argument if {@code (max == min)}
+	 * @throws std::invalid_argument if either min or max is either NaN or infinite
+	 */
+	void setScale(double min, double max);
+
+	/**
+	 * Sets the <em>x</em>-scale to a logarithmic one over the specified range:
+	 * equal ratios of <em>x</em> take equal widths on the canvas. Drawing at
+	 * an <em>x</em>-coordinate that is not positive is an error. Radii and
+	 * half lengths are measured in decades. Calling setXscale() goes back
+	 * to a linear scale.
+	 *
+	 * @param  min the minimum value of the <em>x</em>-scale
+	 * @param  max the maximum value of the <em>x</em>-scale
+	 * @throws std::invalid_argument unless both min and max are positive
+	 * @throws std::invalid_argument if {@code (max == min)}
+	 * @throws std::invalid_argument if either min or max is either NaN or infinite
+	 */
+	void setXscaleLog(double min, double max);
+
+	/**
+	 * Sets the <em>y</em>-scale to a logarithmic one over the specified range,
+	 * as setXscaleLog() does for <em>x</em>.
+	 *
+	 * @param  min the minimum value of the <em>y</em>-scale
+	 * @param  max the maximum value of the <em>y</em>-scale
+	 * @throws std::invalid_argument unless both min and max are positive
+	 * @throws std::invalid_argument if {@code (max == min)}
+	 * @throws std::invalid_argument if either min or max is either NaN or infinite
+	 */
+	void setYscaleLog(double min, double max);
+
+	/**
+	 * Enables polar coordinates. Every point passed to a drawing method is
+	 * then read as (radius, angle in degrees counterclockwise from 3 o'clock)
+	 * and converted to (<em>x</em>, <em>y</em>) before the scales apply.
+	 * Only points are converted: radii and half lengths stay lengths, and
+	 * polygon edges stay straight.
+	 */
+	void enablePolarCoordinates();
+
+	/**
+	 * Disables polar coordinates, which is the default.
+	 */
+	void disablePolarCoordinates();
+
+	/**
+	 * Clears the screen using the default background color (white).
+	 */
+	void clear();
+
+	/**
+	 * Clears the screen using the specified background color.
+	 *
+	 * @param color the color to make the background
+	 */
+	void clear(cwt::Color color);
+
+	/**
+	* Returns the current pen radius.
+	*
+	* @return the current value of the pen radius
+	*/
+	double getPenRadius();
+
+	/**
+	 * Sets the pen size to the default size (0.002).
+	 * The pen is circular, so that lines have rounded ends, and when you set the
+	 * pen radius and draw a point, you get a circle of the specified radius.
+	 * The pen radius is not affected by coordinate scaling, but follows the
+	 * canvas: strokes are the radius times its smaller side wide, 512 times
+	 * on the default canvas.
+	 */
+	void setPenRadius();
+
+	/**
+	 * Sets the radius of the pen to the specified size.
+	 * The pen is circular, so that lines have rounded ends and corners, and
+	 * when you set the pen radius and draw a point, you get a circle of the
+	 * specified radius. The pen radius is not affected by coordinate scaling,
+	 * but follows the canvas: strokes are the radius times its smaller side
+	 * wide, 512 times on the default canvas.
+	 *
+	 * @param  radius the radius of the pen
+	 * @throws std::invalid_argument if radius is negative, NaN, or infinite
+	 */
+	void setPenRadius(double radius);
+
+	/**
+	 * Returns the current pen color.
+	 *
+	 * @return the current pen color, or cwt::Color::UNDEFINED if it is not
+	 * one of the named colors
+	 */
+	cwt::Color getPenColor();
+
+	/**
+	 * Returns the current pen color, whether it has a name or not.
+	 *
+	 * @return the current pen color
+	 */
+	cwt::ColorRgba getPenColorRgba();
+
+	/**
+	 * Sets the pen color to the default color (black).
+	 */
+	void setPenColor();
+
+	/**
+	 * Sets the pen color to the specified color.
+	 * <p>
+	 * The predefined pen color names are BLACK, BLUE, CYAN, DARK_GRAY, GRAY, 
+	 * GREEN, LIGHT_GRAY, MAGENTA, ORANGE, PINK, RED, WHITE, and YELLOW.
+	 *
+	 * @param color the color to make the pen
+	 * @throws std::invalid_argument if color is null
+	 */
+	void setPenColor(cwt::Color color);
+
+	/**
+	 * Sets the pen color to the specified RGB color.
+	 *
+	 * @param  red the amount of red (between 0 and 255)
+	 * @param  green the amount of green (between 0 and 255)
+	 * @param  blue the amount of blue (between 0 and 255)
+	 * @throws std::invalid_argument if red, green, or blue is outside its 
+	 * prescribed range
+	 */
+	void setPenColor(int red, int green, int blue);
+
+	/**
+	 * Sets the pen color to the specified RGB color with an alpha value.
+	 * Everything drawn afterwards is composited over the canvas, so an alpha
+	 * of 0 draws nothing and 255 is opaque.
+	 *
+	 * @param  red the amount of red (between 0 and 255)
+	 * @param  green the amount of green (between 0 and 255)
+	 * @param  blue the amount of blue (between 0 and 255)
+	 * @param  alpha the opacity (between 0 and 255)
+	 * @throws std::invalid_argument if red, green, blue, or alpha is outside
+	 * its prescribed range
+	 */
+	void setPenColor(int red, int green, int blue, int alpha);
+
+	/**
+	 * Sets the pen color to the specified RGBA color.
+	 *
+	 * @param  color the color to make the pen
+	 */
+	void setPenColor(cwt::ColorRgba color);
+
+	/**
+	 * Returns the current font.
+	 *
+	 * @return the current font
+	 */
+	cwt::Font getFont();
+
+	/**
+	 * Sets the font to the default font (sans serif, 16 point).
+	 */
+	void setFont();
+
+	/**
+	 * Sets the font to the specified value.
+	 *
+	 * @param font the font
+	 */
+	void setFont(cwt::Font font);
+
+	/***************************************************************************
+	*  Drawing geometric shapes.
+	***************************************************************************/
+
+	/**
+	 * Draws a line segment between (x0, y0) and (x1, y1).
+	 *
+	 * @param  x0 the x-coordinate of one endpoint
+	 * @param  y0 the y-coordinate of one endpoint
+	 * @param  x1 the x-coordinate of the other endpoint
+	 * @param  y1 the y-coordinate of the other endpoint
+	 * @throws std::invalid_argument if any coordinate is either NaN or infinite
+	 */
+	void line(double x0, double y0, double x1, double y1);
+
+	/**
+	 * Draws a point centered at (x, y).
+	 * The point is a filled circle whose radius is equal to the pen radius.
+	 * To draw a single-pixel point, first set the pen radius to 0.
+	 *
+	 * @param x the x-coordinate of the point
+	 * @param y the y-coordinate of the point
+	 * @throws std::invalid_argument if either x or y is either NaN or infinite
+	 */
+	void point(double x, double y);
+
+	/**
+	 * Draws a circle of the specified radius, centered at (x, y).
+	 *
+	 * @param  x the x-coordinate of the center of the circle
+	 * @param  y the y-coordinate of the center of the circle
+	 * @param  radius the radius of the circle
+	 * @throws std::invalid_argument if radius is negative
+	 * @throws std::invalid_argument if any argument is either NaN or infinite
+	 */
+	void circle(double x, double y, double radius);
+
+	/**
+	 * Draws a filled circle of the specified radius, centered at (x, y).
+	 *
+	 * @param  x the x-coordinate of the center of the circle
+	 * @param  y the y-coordinate of the center of the circle
+	 * @param  radius the radius of the circle
+	 * @throws std::invalid_argument if radius is negative
+	 * @throws std::invalid_argument if any argument is either NaN or infinite
+	 */
+	void filledCircle(double x, double y, double radius);
+
+	/**
+	* Draws a circular arc of the specified radius,
+	* centered at (x, y), from angle1 to angle2 (in degrees).
+	*
+	* @param  x the x-coordinate of the center of the circle
+	* @param  y the y-coordinate of the center of the circle
+	* @param  radius the radius of the circle
+	* @param  angle1 the starting angle. 0 would mean an arc beginning at 3 o'clock.
+	* @param  angle2 the angle at the end of the arc. For example, if
+	*         you want a 90 degree arc, then angle2 should be angle1 + 90.
+	* @throws std::invalid_argument if {@code radius} is negative
+	* @throws std::invalid_argument if any argument is either NaN or infinite
+	*/
+	void arc(double x, double y, double radius, double angle1, double angle2);
+
+	/**
+	 * Draws a square of the specified size, centered at (x, y).
+	 *
+	 * @param  x the x-coordinate of the center of the square
+	 * @param  y the y-coordinate of the center of the square
+	 * @param  halfLength one half the length of any side of the square
+	 * @throws std::invalid_argument if halfLength is negative
+	 * @throws std::invalid_argument if any argument is either NaN or infinite
+	 */
+	void square(double x, double y, double halfLength);
+
+	/**
+	* Draws a filled square of the specified size, centered at (x, y).
+	*
+	* @param  x the x-coordinate of the center of the square
+	* @param  y the y-coordinate of the center of the square
+	* @param  halfLength one half the length of any side of the square
+	* @throws std::invalid_argument if halfLength is negative
+	* @throws std::invalid_argument if any argument is either NaN or infinite
+	*/
+	void filledSquare(double x, double y, double halfLength);
+
+	/**
+	 * Draws a polygon with the vertices
+	 * (x0, y0),
+	 * (x1, y1), ...,
+	 * (xn1, yn1).
+	 *
+	 * The coordinates are read in place and copied once, scaled, into the
+	 * render queue, so a large polygon costs no copies of its own.
+	 *
+	 * @param  x the x-coordinates of the polygon
+	 * @param  y the y-coordinates of the polygon
+	 * @throws std::invalid_argument unless {@code x[]} and {@code y[]}
+	 *         are of the same length
+	 * @throws std::invalid_argument if any coordinate is either NaN or infinite
+	 */
+	void polygon(std::span<const double> x, std::span<const double> y);
+
+	/**
+	 * Draws a filled polygon with the vertices
+	 * (x0, y0),
+	 * (x1, y1), ...,
+	 * (xn1, yn1).
+	 *
+	 * The coordinates are read in place and copied once, scaled, into the
+	 * render queue, so a large polygon costs no copies of its own.
+	 *
+	 * @param  x the x-coordinates of the polygon
+	 * @param  y the y-coordinates of the polygon
+	 * @throws std::invalid_argument unless {@code x[]} and {@code y[]}
+	 *         are of the same length
+	 * @throws std::invalid_argument if any coordinate is either NaN or infinite
+	 */
+	void filledPolygon(std::span<const double> x, std::span<const double> y);
+
+	/***************************************************************************
+	*  Drawing many shapes at once.
+	*  Each call validates and scales the whole batch in one pass and hands it
+	*  to the render as a single command, which is much cheaper than calling
+	*  the scalar version once per shape.
+	***************************************************************************/
+
+	/**
+	 * Draws the line segments between (x0[i], y0[i]) and (x1[i], y1[i]).
+	 *
+	 * @param  x0 the x-coordinates of one endpoint of each segment
+	 * @param  y0 the y-coordinates of one endpoint of each segment
+	 * @param  x1 the x-coordinates of the other endpoint of each segment
+	 * @param  y1 the y-coordinates of the other endpoint of each segment
+	 * @throws std::invalid_argument unless all spans are of the same length
+	 * @throws std::invalid_argument if any coordinate is either NaN or infinite
+	 */
+	void lines(std::span<const double> x0, std::span<const double> y0,
+		std::span<const double> x1, std::span<const double> y1);
+
+	/**
+	 * Draws the points centered at (x[i], y[i]), as point() does.
+	 *
+	 * @param  x the x-coordinates of the points
+	 * @param  y the y-coordinates of the points
+	 * @throws std::invalid_argument unless x and y are of the same length
+	 * @throws std::invalid_argument if any coordinate is either NaN or infinite
+	 */
+	void points(std::span<const double> x, std::span<const double> y);
+
+	/**
+	 * Draws the filled circles of radius r[i], centered at (x[i], y[i]).
+	 *
+	 * @param  x the x-coordinates of the centers of the circles
+	 * @param  y the y-coordinates of the centers of the circles
+	 * @param  r the radii of the circles
+	 * @throws std::invalid_argument unless x, y and r are of the same length
+	 * @throws std::invalid_argument if any radius is negative
+	 * @throws std::invalid_argument if any argument is either NaN or infinite
+	 */
+	void filledCircles(std::span<const double> x, std::span<const double> y, std::span<const double> r);
+
+	/***************************************************************************
+	*  Drawing text.
+	***************************************************************************/
+
+	/**
+	 * Writes the given text string in the current font, centered at (x, y).
+	 *
+	 * @param  x the center x-coordinate of the text
+	 * @param  y the center y-coordinate of the text
+	 * @param  text the text to write
+	 * @throws std::invalid_argument if {@code x} or {@code y} is either NaN or infinite
+	 */
+	void text(double x, double y, std::wstring_view text);
+
+	/***************************************************************************
+	*  Double buffering and animation.
+	***************************************************************************/
+
+	/**
+	 * Pauses for t milliseconds. This method is intended to support computer
+	 * animations. The time is counted from the end of the previous pause, so
+	 * a loop that draws a frame and pauses runs at a steady frame rate no
+	 * matter how long drawing the frame took.
+	 *
+	 * @param t number of milliseconds
+	 * @throws std::invalid_argument if t is negative
+	 */
+	void pause(int t);
+
+	/**
+	 * Copies the offscreen buffer to the onscreen buffer.
+	 * There is no reason to call this method unless double buffering is
+	 * enabled.
+	 */
+	void show();
+
+	/**
+	 * Enables double buffering. All subsequent calls to
+	 * drawing methods such as line(), circle(), and square()
+	 * will be deferred until the next call to show().
+	 * Useful for animations.
+	 */
+	void enableDoubleBuffering();
+
+	/**
+	 * Disables double buffering. All subsequent calls to
+	 * drawing methods such as line(), circle(), and square()
+	 * will be displayed on screen when called.
+	 * This is the default.
+	 */
+	void disableDoubleBuffering();
+
+	/**
+	 * Waits until everything drawn so far is on the canvas. Drawing happens
+	 * on a render thread of its own, so this is only needed to time it.
+	 */
+	void finish();
+
+	/***************************************************************************
+	*  Save drawing to a file.
+	***************************************************************************/
+
+	/**
+	 * Saves the drawing to using the specified filename.
+	 * The supported image formats are PNG, BMP and PPM; the format is picked
+	 * from the suffix of the filename. Everything drawn before the call is
+	 * in the saved image.
+	 *
+	 * @param  filename the name of the file with one of the required suffixes
+	 * @throws std::invalid_argument if filename does not end with .png, .bmp 
+	 *         or .ppm
+	 * @throws std::runtime_error if the file cannot be written
+	 */
+	void save(std::string filename);
+
+	/**
+	 * Saves the drawing as an SVG file, without rasterizing it. Everything
+	 * drawn since the last clear() is written in the order it was drawn; each
+	 * distinct pen and font becomes one shared style, so the file stays small
+	 * however many shapes use them.
+	 *
+	 * @param  filename the name of the file, ending with .svg
+	 * @throws std::invalid_argument if filename does not end with .svg
+	 * @throws std::runtime_error if the file cannot be written
+	 */
+	void saveSvg(std::string filename);
+
+	/**
+	 * Saves the drawing as an SVG file, as saveSvg(filename) does. If coalesce
+	 * is true, filled shapes no larger than a pixel are written as the pixel
+	 * they fall on, once for all the shapes of one color that land there.
+	 * Opaque dots are merged that way in any case; coalescing also merges
+	 * translucent ones, which then no longer darken each other.
+	 *
+	 * @param  filename the name of the file, ending with .svg
+	 * @param  coalesce whether to merge shapes no larger than a pixel
+	 * @throws std::invalid_argument if filename does not end with .svg
+	 * @throws std::runtime_error if the file cannot be written
+	 */
+	void saveSvg(std::string filename, bool coalesce);
+
+	/**
+	 * Saves the drawing as a one page PDF file, without rasterizing it, as
+	 * saveSvg(filename) does. The page is as large as the canvas, one point
+	 * per pixel.
+	 *
+	 * @param  filename the name of the file, ending with .pdf
+	 * @throws std::invalid_argument if filename does not end with .pdf
+	 * @throws std::runtime_error if the file cannot be written
+	 */
+	void savePdf(std::string filename);
+
+	/**
+	 * Saves the drawing as a one page PDF file, merging shapes no larger than
+	 * a pixel if coalesce is true, as saveSvg(filename, coalesce) does.
+	 *
+	 * @param  filename the name of the file, ending with .pdf
+	 * @param  coalesce whether to merge shapes no larger than a pixel
+	 * @throws std::invalid_argument if filename does not end with .pdf
+	 * @throws std::runtime_error if the file cannot be written
+	 */
+	void savePdf(std::string filename, bool coalesce);
+
+	/**
+	 * Starts recording every frame shown with show() to an animation file.
+	 * The format is picked from the suffix of the filename: .gif for an
+	 * animated GIF, or .y4m for an uncompressed YUV4MPEG2 stream that a video
+	 * encoder can read, for instance through a named pipe. Frames are encoded
+	 * on a thread of their own, so recording does not slow the drawing down.
+	 *
+	 * @param  filename the name of the file with one of the required suffixes
+	 * @param  fps the number of frames per second to play the recording at
+	 * @throws std::invalid_argument if filename does not end with .gif or .y4m
+	 * @throws std::invalid_argument if fps is not positive
+	 * @throws std::runtime_error if the file cannot be created
+	 */
+	void startRecording(std::string filename, int fps);
+
+	/**
+	 * Stops recording and finishes the file.
+	 *
+	 * @throws std::runtime_error if writing the recording failed
+	 */
+	void stopRecording();
+
+	/**
+	 * Starts capturing every drawing command to a binary file, which the
+	 * algs4_replay tool draws again at any size without rerunning the
+	 * program. The capture holds the commands as the render gets them, in
+	 * canvas pixels, so it costs about 16 bytes per line or filled square;
+	 * start it before drawing, or right after clear(), to capture the whole
+	 * picture.
+	 *
+	 * @param  filename the name of the capture file
+	 * @throws std::runtime_error if the file cannot be created
+	 */
+	void startCapture(std::string filename);
+
+	/**
+	 * Stops capturing and finishes the file.
+	 *
+	 * @throws std::runtime_error if writing the capture failed
+	 */
+	void stopCapture();
+
+	/***************************************************************************
+	*  Render statistics.
+	*  Off by default. A frame is one pass of the rasterizer: one per show()
+	*  with double buffering, otherwise one each time the render catches up.
+	***************************************************************************/
+
+	/**
+	 * Starts measuring every frame: rasterization time, primitives drawn by
+	 * type, primitives skipped as off the canvas, memory held by the display
+	 * list and commands still queued. The counts start over.
+	 */
+	void enableStats();
+
+	/**
+	 * Stops measuring frames. This is the default.
+	 */
+	void disableStats();
+
+	/**
+	 * Returns the statistics of the last frame measured.
+	 *
+	 * @return the statistics of the last frame
+	 */
+	perf::RenderStats stats();
+
+	/**
+	 * Shows the statistics of the last frame in the top-left corner of the
+	 * canvas. Without a window they are drawn on frames shown with show()
+	 * while double buffering, which includes saved images and recordings.
+	 */
+	void enableStatsOverlay();
+
+	/**
+	 * Hides the statistics overlay. This is the default.
+	 */
+	void disableStatsOverlay();
+
+	/**
+	 * Writes the statistics of every {@code everyFrames}-th frame to a file
+	 * while the program runs, as CSV rows or as a JSON array of objects; the
+	 * format is picked from the suffix of the filename.
+	 *
+	 * @param  filename the name of the file, ending with .csv or .json
+	 * @param  everyFrames the number of frames between two entries
+	 * @throws std::invalid_argument if filename does not end with .csv or .json
+	 * @throws std::invalid_argument if everyFrames is not positive
+	 * @throws std::runtime_error if the file cannot be created
+	 */
+	void startStatsLog(std::string filename, int everyFrames);
+
+	/**
+	 * Stops writing statistics and finishes the file.
+	 *
+	 * @throws std::runtime_error if writing the file failed
+	 */
+	void stopStatsLog();
+
+private:
+	// the render keeps a pointer to the caption, so it is declared first
+	std::wstring title;
+
+	Render render{ 
+		cwt::Pen{ cwt::ColorRgba{cwt::getRgba(cwt::Color::BLACK)}, DEFAULT_PEN_RADIUS },
+		DEFAULT_SIZE,		// Width
+		DEFAULT_SIZE,		// Height
+		title.c_str()		// Caption
+	};
+	std::thread tRender;
+	bool hasRenderInit = false;
+	
+	// Canvas size
+	int width = DEFAULT_SIZE;
+	int height = DEFAULT_SIZE;
+
+	// end of the previous pause(), frames are paced from there
+	std::chrono::steady_clock::time_point lastPause;
+
+	// scratch space for batches, reused so that batches do not allocate
+	std::vector<double> batch;
+	std::vector<double> batchPixels;
+
+	// boundary of drawing canvas, in log10 units along a log scale
+	double xmin = DEFAULT_XMIN;
+	double ymin = DEFAULT_YMIN;
+	double xmax = DEFAULT_XMAX;
+	double ymax = DEFAULT_YMAX;
+
+	// from user coordinates to pixels, recomputed whenever the scale or the
+	// canvas changes
+	geom::Transform transform;
+
+	// Init
+	void init();
+
+	// Draw
+	void draw();
+
+	// throw an std::invalid_argument if x is NaN or infinite
+	void validate(double x, const char* name);
+
+	// throw an std::invalid_argument if s is null
+	void validateNonnegative(double x, const char* name);
+
+	// throw an std::invalid_argument if any value is NaN or infinite; the
+	// message names the first offending element as name[i]
+	void validateAll(std::span<const double> values, const char* name);
+
+	// throw an std::invalid_argument if any value is negative
+	void validateAllNonnegative(std::span<const double> values, const char* name);
+
+	// throw an std::invalid_argument if s is null
+	template <class Object>
+	void validateNotNull(Object x, std::string name) 
+	{
+		if (x == nullptr)
+		{
+			throw std::invalid_argument(name + " is null");
+		}
+	}
+
+	// recomputes transform from the scale and the canvas size
+	void updateTransform();
+
+	// throw an std::invalid_argument unless min and max make a valid scale
+	void validateScale(double min, double max);
+
+	// helper functions that scale from user coordinates to screen coordinates
+	void toScreen(double x, double y, double& xs, double& ys);
+	// Width in pixels of the pen on this canvas
+	double penWidth() { return cwt::penWidth(render.viewPen(), width, height); }
+	double factorX(double w) { return transform.lengthX(w); }
+	double factorY(double h) { return transform.lengthY(h); }
+
+	// true if the pixel box (x, y, w, h), grown by the pen, misses the canvas;
+	// such primitives are dropped before they reach the render, and counted
+	// in its stats
+	bool isOffCanvas(double x, double y, double w, double h);
+
+	// toScreen over whole arrays: (outX[i * stride], outY[i * stride]) is the
+	// pixel of (x[i], y[i]) moved by shift
+	void toScreen(std::span<const double> x, std::span<const double> y,
+		double* outX, double* outY, size_t stride, double shift = 0.0);
+
+	// validates the vertices of a polygon, x and y being of the same length,
+	// and scales them into batch as (x, y) pairs, returning false when it is
+	// off the canvas
+	bool scalePolygon(std::span<const double> x, std::span<const double> y);
+
+	// throw an std::invalid_argument if the scaled point (xs, ys) has no
+	// pixel, which only happens off the domain of a log scale
+	void validateScaled(double xs, double ys);
+
+	/**
+	* Draws one pixel at (x, y).
+	* This method is private because pixels depend on the display.
+	* To achieve the same effect, set the pen radius to 0 and call point().
+	*
+	* @param  x the x-coordinate of the pixel
+	* @param  y the y-coordinate of the pixel
+	* @throws std::invalid_argument if x or y is either NaN or infinite
+	*/
+	void pixel(double x, double y);
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cwt.h"
+
+namespace text
+{
+	// Coverage bitmap of one glyph, placed relative to the pen position at the
+	// top-left corner of the line
+	struct GlyphImage
+	{
+		int left = 0;
+		int top = 0;
+		int width = 0;
+		int height = 0;
+		// width * height values from 0 (none) to 255 (full), row by row
+		std::vector<std::uint8_t> coverage;
+	};
+
+	/**
+	 * One font as the backend draws it: the GDI+ backend asks GDI for glyph
+	 * outlines, the headless backend scales its built-in bitmap font. A face
+	 * belongs to the thread that made it.
+	 */
+	class FontFace
+	{
+	public:
+		explicit FontFace(const cwt::Font& font);
+		FontFace(const FontFace&) = delete;
+		void operator=(const FontFace&) = delete;
+		~FontFace();
+
+		int viewLineHeight() const { return lineHeight; }
+		// Distance from the pen position of ch to that of the next character
+		int getAdvance(wchar_t ch);
+		void rasterize(wchar_t ch, GlyphImage& image);
+	private:
+		struct Impl;
+		std::unique_ptr<Impl> pImpl;
+		int lineHeight = 0;
+	};
+}
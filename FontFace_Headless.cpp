@@ -0,0 +1,53 @@
+#include "RenderConfig.h"
+
+#ifdef ALGS4_RENDER_HEADLESS
+#include "FontFace.h"
+#include "Raster.h"
+#include <algorithm>
+
+struct text::FontFace::Impl
+{
+	int scale;
+};
+
+text::FontFace::FontFace(const cwt::Font& font)
+	: pImpl(std::make_unique<Impl>())
+{
+	pImpl->scale = raster::glyphScale(font.viewFontSize());
+	lineHeight = raster::GLYPH_CELL_HEIGHT * pImpl->scale;
+}
+
+text::FontFace::~FontFace() = default;
+
+int text::FontFace::getAdvance(wchar_t)
+{
+	return raster::GLYPH_CELL_WIDTH * pImpl->scale;
+}
+
+void text::FontFace::rasterize(wchar_t ch, GlyphImage& image)
+{
+	const int scale = pImpl->scale;
+	const std::uint8_t* columns = raster::glyphColumns(ch);
+	image.left = 0;
+	image.top = 0;
+	image.width = 5 * scale;
+	image.height = 7 * scale;
+	image.coverage.assign((size_t)image.width * image.height, 0);
+	for (int col = 0; col < 5; col++)
+	{
+		for (int bit = 0; bit < 7; bit++)
+		{
+			if (!(columns[col] & (1 << bit)))
+			{
+				continue;
+			}
+			for (int sy = 0; sy < scale; sy++)
+			{
+				std::uint8_t* row = image.coverage.data() + (size_t)(bit * scale + sy) * image.width;
+				std::fill(row + col * scale, row + (col + 1) * scale, 255);
+			}
+		}
+	}
+}
+
+#endif // ALGS4_RENDER_HEADLESS
@@ -0,0 +1,112 @@
+#include "RenderConfig.h"
+
+#ifndef ALGS4_RENDER_HEADLESS
+#include "FontFace.h"
+#include <windows.h>
+#include <stdexcept>
+
+struct text::FontFace::Impl
+{
+	HDC hdc = nullptr;
+	HFONT hFont = nullptr;
+	HGDIOBJ hOldFont = nullptr;
+	int ascent = 0;
+	std::vector<BYTE> buffer;
+};
+
+text::FontFace::FontFace(const cwt::Font& font)
+	: pImpl(std::make_unique<Impl>())
+{
+	const cwt::Font::Style style = font.viewFontSyle();
+	const bool isBold = style == cwt::Font::Style::FontStyleBold || style == cwt::Font::Style::FontStyleBoldItalic;
+	const bool isItalic = style == cwt::Font::Style::FontStyleItalic || style == cwt::Font::Style::FontStyleBoldItalic;
+
+	// A memory DC needs no window, so faces can be made on any thread
+	pImpl->hdc = CreateCompatibleDC(nullptr);
+	// A negative height asks for the em size in pixels, like GDI+ UnitPixel
+	pImpl->hFont = CreateFontW(
+		-(int)font.viewFontSize(), 0, 0, 0,
+		isBold ? FW_BOLD : FW_NORMAL,
+		isItalic,
+		style == cwt::Font::Style::FontStyleUnderline,
+		style == cwt::Font::Style::FontStyleStrikeout,
+		DEFAULT_CHARSET, OUT_TT_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+		DEFAULT_PITCH | FF_SWISS, font.viewFontName().c_str());
+	if (!pImpl->hdc || !pImpl->hFont)
+	{
+		if (pImpl->hFont)
+		{
+			DeleteObject(pImpl->hFont);
+		}
+		if (pImpl->hdc)
+		{
+			DeleteDC(pImpl->hdc);
+		}
+		throw std::runtime_error("Cannot create font");
+	}
+	pImpl->hOldFont = SelectObject(pImpl->hdc, pImpl->hFont);
+
+	TEXTMETRICW metrics;
+	GetTextMetricsW(pImpl->hdc, &metrics);
+	pImpl->ascent = metrics.tmAscent;
+	lineHeight = metrics.tmHeight;
+}
+
+text::FontFace::~FontFace()
+{
+	SelectObject(pImpl->hdc, pImpl->hOldFont);
+	DeleteObject(pImpl->hFont);
+	DeleteDC(pImpl->hdc);
+}
+
+int text::FontFace::getAdvance(wchar_t ch)
+{
+	SIZE size;
+	if (!GetTextExtentPoint32W(pImpl->hdc, &ch, 1, &size))
+	{
+		return 0;
+	}
+	return size.cx;
+}
+
+void text::FontFace::rasterize(wchar_t ch, GlyphImage& image)
+{
+	image.left = 0;
+	image.top = 0;
+	image.width = 0;
+	image.height = 0;
+	image.coverage.clear();
+
+	const MAT2 identity = { { 0, 1 }, { 0, 0 }, { 0, 0 }, { 0, 1 } };
+	GLYPHMETRICS metrics;
+	const DWORD size = GetGlyphOutlineW(pImpl->hdc, ch, GGO_GRAY8_BITMAP, &metrics, 0, nullptr, &identity);
+	// Blank glyphs such as the space have no bitmap at all
+	if (size == GDI_ERROR || size == 0)
+	{
+		return;
+	}
+	pImpl->buffer.resize(size);
+	if (GetGlyphOutlineW(pImpl->hdc, ch, GGO_GRAY8_BITMAP, &metrics, size, pImpl->buffer.data(), &identity) == GDI_ERROR)
+	{
+		return;
+	}
+
+	image.left = metrics.gmptGlyphOrigin.x;
+	image.top = pImpl->ascent - metrics.gmptGlyphOrigin.y;
+	image.width = (int)metrics.gmBlackBoxX;
+	image.height = (int)metrics.gmBlackBoxY;
+	image.coverage.resize((size_t)image.width * image.height);
+	// Rows are DWORD aligned and hold 65 levels of gray
+	const size_t stride = ((size_t)image.width + 3) & ~(size_t)3;
+	for (int y = 0; y < image.height; y++)
+	{
+		const BYTE* src = pImpl->buffer.data() + y * stride;
+		std::uint8_t* dst = image.coverage.data() + (size_t)y * image.width;
+		for (int x = 0; x < image.width; x++)
+		{
+			dst[x] = (std::uint8_t)((src[x] * 255 + 32) / 64);
+		}
+	}
+}
+
+#endif // !ALGS4_RENDER_HEADLESS
@@ -0,0 +1,74 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+namespace
+{
+	constexpr size_t MIN_BLOCK_BYTES = 64 * 1024;
+}
+
+void geom::FrameArena::reset()
+{
+	current = 0;
+	used = 0;
+	currentLarge = 0;
+}
+
+size_t geom::FrameArena::viewCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : blocks)
+	{
+		capacity += block.size;
+	}
+	for (const Block& block : largeBlocks)
+	{
+		capacity += block.size;
+	}
+	return capacity;
+}
+
+void* geom::FrameArena::allocateBytes(size_t bytes, size_t alignment)
+{
+	// Blocks come from new[], which aligns them for any fundamental type
+	for (; current < blocks.size(); current++, used = 0)
+	{
+		const size_t start = (used + alignment - 1) & ~(alignment - 1);
+		if (start + bytes <= blocks[current].size)
+		{
+			used = start + bytes;
+			return blocks[current].bytes.get() + start;
+		}
+		if (bytes > blocks[current].size)
+		{
+			// Would not fit even in an empty block: keep filling this one
+			return allocateLarge(bytes);
+		}
+	}
+
+	// Out of blocks: double the last one, unless the request outgrows that too
+	const size_t size = std::max(MIN_BLOCK_BYTES, blocks.empty() ? 0 : 2 * blocks.back().size);
+	if (bytes > size)
+	{
+		return allocateLarge(bytes);
+	}
+	blocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+	used = bytes;
+	return blocks[current].bytes.get();
+}
+
+void* geom::FrameArena::allocateLarge(size_t bytes)
+{
+	// Reuse the first spare block large enough, so that a frame drawn again
+	// after reset() finds the blocks its large requests had
+	for (size_t i = currentLarge; i < largeBlocks.size(); i++)
+	{
+		if (largeBlocks[i].size >= bytes)
+		{
+			std::swap(largeBlocks[i], largeBlocks[currentLarge]);
+			return largeBlocks[currentLarge++].bytes.get();
+		}
+	}
+	largeBlocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes });
+	std::swap(largeBlocks.back(), largeBlocks[currentLarge]);
+	return largeBlocks[currentLarge++].bytes.get();
+}
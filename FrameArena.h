@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace geom
+{
+	/**
+	 * Monotonic allocator for what one frame of commands stores: coordinates
+	 * and text of every length.
+	 *
+	 * Allocating bumps a pointer through blocks that are kept from frame to
+	 * frame, and reset() rewinds to the first block in O(1), so a program
+	 * drawing similar frames stops allocating once the blocks are large
+	 * enough. Blocks grow geometrically, each twice the size of the last. A
+	 * request larger than the next block would be gets a block of its own,
+	 * kept apart so that it neither inflates the blocks after it nor ends the
+	 * one being filled: a 100k vertex polygon is one bump too. Memory handed
+	 * out stays put until reset().
+	 */
+	class FrameArena
+	{
+	public:
+		FrameArena() = default;
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Room for n uninitialized values of type T
+		template <class T>
+		T* allocate(size_t n)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+				"The arena never runs constructors or destructors!");
+			return static_cast<T*>(allocateBytes(n * sizeof(T), alignof(T)));
+		}
+
+		// Forgets everything allocated, keeping the blocks
+		void reset();
+
+		// Bytes held in blocks, used or not
+		size_t viewCapacity() const;
+	private:
+		struct Block
+		{
+			std::unique_ptr<unsigned char[]> bytes;
+			size_t size;
+		};
+
+		void* allocateBytes(size_t bytes, size_t alignment);
+		// A block of its own for a request of bytes
+		void* allocateLarge(size_t bytes);
+
+		std::vector<Block> blocks;
+		// Block being filled and bytes used in it
+		size_t current = 0;
+		size_t used = 0;
+
+		// Blocks of one large request each; those before currentLarge are in
+		// use since reset()
+		std::vector<Block> largeBlocks;
+		size_t currentLarge = 0;
+	};
+}
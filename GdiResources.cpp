@@ -0,0 +1,55 @@
+#include "RenderConfig.h"
+
+#ifndef ALGS4_RENDER_HEADLESS
+#include "GdiResources.h"
+
+void GdiResources::setCanvasSize(int width, int height)
+{
+	if (width != canvasWidth || height != canvasHeight)
+	{
+		for (PenObjects& objects : pens)
+		{
+			objects.pen.reset();
+		}
+		canvasWidth = width;
+		canvasHeight = height;
+	}
+}
+
+Gdiplus::Pen* GdiResources::getPen(geom::PenRef pen)
+{
+	PenObjects& objects = getPenObjects(pen.handle);
+	if (!objects.pen)
+	{
+		objects.pen = std::make_unique<Gdiplus::Pen>(
+			Gdiplus::Color(pen->color.a, pen->color.r, pen->color.g, pen->color.b), viewPenWidth(*pen));
+	}
+	return objects.pen.get();
+}
+
+Gdiplus::Brush* GdiResources::getBrush(geom::PenRef pen)
+{
+	PenObjects& objects = getPenObjects(pen.handle);
+	if (!objects.brush)
+	{
+		objects.brush = std::make_unique<Gdiplus::SolidBrush>(
+			Gdiplus::Color(pen->color.a, pen->color.r, pen->color.g, pen->color.b));
+	}
+	return objects.brush.get();
+}
+
+void GdiResources::release()
+{
+	pens.clear();
+}
+
+GdiResources::PenObjects& GdiResources::getPenObjects(std::uint32_t handle)
+{
+	if (handle >= pens.size())
+	{
+		pens.resize(handle + 1);
+	}
+	return pens[handle];
+}
+
+#endif // !ALGS4_RENDER_HEADLESS
@@ -0,0 +1,45 @@
+#pragma once
+#include <windows.h>
+#include <objidl.h>
+#include <gdiplus.h>
+#include <memory>
+#include <vector>
+#include "DisplayList.h"
+
+/**
+ * GDI+ pens and brushes built for the pens of a display list.
+ * Each one is built the first time it is used and kept, indexed by the handle
+ * the display list interned it under, so replaying a frame only looks them
+ * up. Everything must be released before GDI+ is shut down.
+ */
+class GdiResources
+{
+public:
+	// Width in pixels of the strokes of pen on the canvas
+	Gdiplus::REAL viewPenWidth(const cwt::Pen& pen) const
+	{
+		return (Gdiplus::REAL)cwt::penWidth(pen, canvasWidth, canvasHeight);
+	}
+
+	// Pens are as wide as the canvas makes them, so a new size drops them
+	void setCanvasSize(int width, int height);
+
+	// Pen of the color and width of pen
+	Gdiplus::Pen* getPen(geom::PenRef pen);
+	// Brush filling with the color of pen
+	Gdiplus::Brush* getBrush(geom::PenRef pen);
+
+	void release();
+private:
+	struct PenObjects
+	{
+		std::unique_ptr<Gdiplus::Pen> pen;
+		std::unique_ptr<Gdiplus::SolidBrush> brush;
+	};
+
+	PenObjects& getPenObjects(std::uint32_t handle);
+
+	std::vector<PenObjects> pens;
+	int canvasWidth = 0;
+	int canvasHeight = 0;
+};
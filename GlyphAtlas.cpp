@@ -0,0 +1,154 @@
+#include "GlyphAtlas.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void text::GlyphAtlas::measure(const cwt::Font& font, const wchar_t* text, size_t len, int& width, int& height)
+{
+	FontEntry& entry = getEntry(font);
+	width = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		width += getGlyph(entry, text[i]).advance;
+	}
+	height = entry.face->viewLineHeight();
+}
+
+text::GlyphAtlas::FontEntry& text::GlyphAtlas::getEntry(const cwt::Font& font)
+{
+	if (!fonts.empty() && fonts[lastFont]->font == font)
+	{
+		return *fonts[lastFont];
+	}
+
+	// Programs use a handful of fonts, a linear scan is enough
+	for (size_t i = 0; i < fonts.size(); i++)
+	{
+		if (fonts[i]->font == font)
+		{
+			lastFont = i;
+			return *fonts[i];
+		}
+	}
+
+	auto entry = std::make_unique<FontEntry>();
+	entry->font = font;
+	entry->face = std::make_unique<FontFace>(font);
+	std::fill(std::begin(entry->ascii), std::end(entry->ascii), -1);
+	fonts.push_back(std::move(entry));
+	lastFont = fonts.size() - 1;
+	return *fonts.back();
+}
+
+const text::GlyphAtlas::FontEntry& text::GlyphAtlas::viewEntry(const cwt::Font& font) const
+{
+	if (fonts[lastFont]->font == font)
+	{
+		return *fonts[lastFont];
+	}
+	for (const auto& entry : fonts)
+	{
+		if (entry->font == font)
+		{
+			return *entry;
+		}
+	}
+	assert(!"The font was not prepared");
+	return *fonts[lastFont];
+}
+
+const text::Glyph& text::GlyphAtlas::viewGlyph(const FontEntry& entry, wchar_t ch)
+{
+	if ((unsigned)ch < 128)
+	{
+		return entry.glyphs[entry.ascii[ch]];
+	}
+	return entry.glyphs[entry.others.at(ch)];
+}
+
+void text::GlyphAtlas::prepare(const cwt::Font& font, const wchar_t* text)
+{
+	FontEntry& entry = getEntry(font);
+	for (; *text != L'\0'; text++)
+	{
+		getRasterized(entry, *text);
+	}
+}
+
+text::Glyph& text::GlyphAtlas::getGlyph(FontEntry& entry, wchar_t ch)
+{
+	std::uint32_t index;
+	if ((unsigned)ch < 128)
+	{
+		if (entry.ascii[ch] >= 0)
+		{
+			return entry.glyphs[entry.ascii[ch]];
+		}
+		index = (std::uint32_t)entry.glyphs.size();
+		entry.ascii[ch] = (std::int32_t)index;
+	}
+	else
+	{
+		auto it = entry.others.find(ch);
+		if (it != entry.others.end())
+		{
+			return entry.glyphs[it->second];
+		}
+		index = (std::uint32_t)entry.glyphs.size();
+		entry.others.emplace(ch, index);
+	}
+
+	Glyph glyph;
+	glyph.advance = entry.face->getAdvance(ch);
+	entry.glyphs.push_back(glyph);
+	return entry.glyphs[index];
+}
+
+text::Glyph& text::GlyphAtlas::getRasterized(FontEntry& entry, wchar_t ch)
+{
+	Glyph& glyph = getGlyph(entry, ch);
+	if (glyph.isRasterized)
+	{
+		return glyph;
+	}
+
+	entry.face->rasterize(ch, scratch);
+	glyph.isRasterized = true;
+	glyph.left = scratch.left;
+	glyph.top = scratch.top;
+	// Glyphs too wide for the atlas are clipped to it
+	glyph.width = std::min(scratch.width, ATLAS_WIDTH);
+	glyph.height = scratch.height;
+	if (glyph.width <= 0 || glyph.height <= 0)
+	{
+		return glyph;
+	}
+	allocate(glyph.width, glyph.height, glyph.atlasX, glyph.atlasY);
+	for (int y = 0; y < glyph.height; y++)
+	{
+		std::memcpy(pixels.data() + (size_t)(glyph.atlasY + y) * ATLAS_WIDTH + glyph.atlasX,
+			scratch.coverage.data() + (size_t)y * scratch.width, glyph.width);
+	}
+	return glyph;
+}
+
+void text::GlyphAtlas::allocate(int width, int height, int& x, int& y)
+{
+	if (shelfX + width > ATLAS_WIDTH)
+	{
+		shelfY += shelfHeight;
+		shelfX = 0;
+		shelfHeight = 0;
+	}
+	x = shelfX;
+	y = shelfY;
+	shelfX += width;
+	shelfHeight = std::max(shelfHeight, height);
+
+	if (shelfY + shelfHeight > atlasHeight)
+	{
+		// Doubling keeps the number of copies logarithmic
+		atlasHeight = std::max(shelfY + shelfHeight, 2 * atlasHeight);
+		pixels.resize((size_t)atlasHeight * ATLAS_WIDTH);
+	}
+}
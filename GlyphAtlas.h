@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "FontFace.h"
+#include "cwt.h"
+
+namespace text
+{
+	// How a glyph is placed on a line and where its bitmap is in the atlas
+	struct Glyph
+	{
+		int advance = 0;
+		bool isRasterized = false;
+		int left = 0;
+		int top = 0;
+		int width = 0;
+		int height = 0;
+		int atlasX = 0;
+		int atlasY = 0;
+	};
+
+	/**
+	 * Glyphs of every font used so far, rasterized once into one coverage
+	 * atlas and copied from there by every string drawn with them. Fonts are
+	 * keyed by cwt::Font. Measuring only needs the advances, which are cached
+	 * too, so it never rasterizes anything.
+	 *
+	 * An atlas uses the faces of the thread it is used on; each thread that
+	 * measures or draws text keeps its own.
+	 */
+	class GlyphAtlas
+	{
+	public:
+		static constexpr int ATLAS_WIDTH = 1024;
+
+		// Size of the box holding len characters of text: the sum of their
+		// advances by the line height of font
+		void measure(const cwt::Font& font, const wchar_t* text, size_t len, int& width, int& height);
+
+		// Draws the null terminated text with the top-left corner of its line at
+		// (x, y), calling blit(x, y, coverage, stride, width, height) once for
+		// every glyph with ink. coverage points into the atlas and is only valid
+		// during the call.
+		template <class Blit>
+		void draw(const cwt::Font& font, const wchar_t* text, int x, int y, Blit blit)
+		{
+			FontEntry& entry = getEntry(font);
+			for (; *text != L'\0'; text++)
+			{
+				const Glyph& glyph = getRasterized(entry, *text);
+				if (glyph.width > 0 && glyph.height > 0)
+				{
+					blit(x + glyph.left, y + glyph.top,
+						pixels.data() + (size_t)glyph.atlasY * ATLAS_WIDTH + glyph.atlasX,
+						(size_t)ATLAS_WIDTH, glyph.width, glyph.height);
+				}
+				x += glyph.advance;
+			}
+		}
+
+		// Rasterizes every glyph of the null terminated text into the atlas
+		void prepare(const cwt::Font& font, const wchar_t* text);
+
+		// Draws like draw() text that was prepared. It only reads the atlas,
+		// so several threads may draw at once as long as none changes it.
+		template <class Blit>
+		void drawPrepared(const cwt::Font& font, const wchar_t* text, int x, int y, Blit blit) const
+		{
+			const FontEntry& entry = viewEntry(font);
+			for (; *text != L'\0'; text++)
+			{
+				const Glyph& glyph = viewGlyph(entry, *text);
+				if (glyph.width > 0 && glyph.height > 0)
+				{
+					blit(x + glyph.left, y + glyph.top,
+						pixels.data() + (size_t)glyph.atlasY * ATLAS_WIDTH + glyph.atlasX,
+						(size_t)ATLAS_WIDTH, glyph.width, glyph.height);
+				}
+				x += glyph.advance;
+			}
+		}
+
+		int viewLineHeight(const cwt::Font& font) { return getEntry(font).face->viewLineHeight(); }
+	private:
+		struct FontEntry
+		{
+			cwt::Font font;
+			std::unique_ptr<FontFace> face;
+			std::vector<Glyph> glyphs;
+			// Index into glyphs of each ASCII character, or -1
+			std::int32_t ascii[128];
+			std::unordered_map<wchar_t, std::uint32_t> others;
+		};
+
+		FontEntry& getEntry(const cwt::Font& font);
+		// Lookups of a prepared font and glyph that leave the caches alone
+		const FontEntry& viewEntry(const cwt::Font& font) const;
+		static const Glyph& viewGlyph(const FontEntry& entry, wchar_t ch);
+		// Glyph of ch with its advance, rasterized or not
+		Glyph& getGlyph(FontEntry& entry, wchar_t ch);
+		Glyph& getRasterized(FontEntry& entry, wchar_t ch);
+		// Finds room for a width x height bitmap, growing the atlas if needed
+		void allocate(int width, int height, int& x, int& y);
+
+		std::vector<std::unique_ptr<FontEntry>> fonts;
+		size_t lastFont = 0;
+
+		// 8-bit coverage, ATLAS_WIDTH wide, filled shelf by shelf
+		std::vector<std::uint8_t> pixels;
+		int atlasHeight = 0;
+		int shelfX = 0;
+		int shelfY = 0;
+		int shelfHeight = 0;
+
+		GlyphImage scratch;
+	};
+}
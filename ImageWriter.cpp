@@ -0,0 +1,289 @@
+#include "ImageWriter.h"
+#include "Zlib.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	/***************************************************************************
+	*  Output file.
+	***************************************************************************/
+
+	class File
+	{
+	public:
+		explicit File(const std::string& path)
+			:
+			path(path),
+			stream(path, std::ios::binary | std::ios::trunc)
+		{
+			if (!stream)
+			{
+				throw std::runtime_error("cannot open " + path + " for writing");
+			}
+		}
+
+		void write(const void* data, size_t n)
+		{
+			stream.write(static_cast<const char*>(data), (std::streamsize)n);
+		}
+
+		void writeU8(std::uint8_t v) { write(&v, 1); }
+
+		void writeU16LE(std::uint16_t v)
+		{
+			const std::uint8_t b[2] = { (std::uint8_t)v, (std::uint8_t)(v >> 8) };
+			write(b, sizeof(b));
+		}
+
+		void writeU32LE(std::uint32_t v)
+		{
+			const std::uint8_t b[4] = { (std::uint8_t)v, (std::uint8_t)(v >> 8), (std::uint8_t)(v >> 16), (std::uint8_t)(v >> 24) };
+			write(b, sizeof(b));
+		}
+
+		void writeU32BE(std::uint32_t v)
+		{
+			const std::uint8_t b[4] = { (std::uint8_t)(v >> 24), (std::uint8_t)(v >> 16), (std::uint8_t)(v >> 8), (std::uint8_t)v };
+			write(b, sizeof(b));
+		}
+
+		void close()
+		{
+			stream.close();
+			if (!stream)
+			{
+				throw std::runtime_error("error while writing " + path);
+			}
+		}
+
+	private:
+		std::string path;
+		std::ofstream stream;
+	};
+
+	// Copies the color channels of n pixels into out as R, G, B
+	void packRgb(const raster::Pixel* pixels, int n, std::uint8_t* out)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			out[3 * i] = pixels[i].r;
+			out[3 * i + 1] = pixels[i].g;
+			out[3 * i + 2] = pixels[i].b;
+		}
+	}
+
+	/***************************************************************************
+	*  PPM and BMP.
+	***************************************************************************/
+
+	void writePpm(File& file, int width, int height, const image::RowSource& row)
+	{
+		const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		file.write(header.data(), header.size());
+
+		std::vector<std::uint8_t> rgb((size_t)width * 3);
+		for (int y = 0; y < height; y++)
+		{
+			packRgb(row(y), width, rgb.data());
+			file.write(rgb.data(), rgb.size());
+		}
+	}
+
+	void writeBmp(File& file, int width, int height, const image::RowSource& row)
+	{
+		constexpr std::uint32_t FILE_HEADER_SIZE = 14;
+		constexpr std::uint32_t INFO_HEADER_SIZE = 40;
+		// Rows are padded to a multiple of four bytes
+		const size_t stride = ((size_t)width * 3 + 3) & ~(size_t)3;
+		const size_t imageSize = stride * height;
+		if (FILE_HEADER_SIZE + INFO_HEADER_SIZE + imageSize > UINT32_MAX)
+		{
+			throw std::runtime_error("image is too large for BMP");
+		}
+
+		file.writeU8('B');
+		file.writeU8('M');
+		file.writeU32LE((std::uint32_t)(FILE_HEADER_SIZE + INFO_HEADER_SIZE + imageSize));
+		file.writeU32LE(0);
+		file.writeU32LE(FILE_HEADER_SIZE + INFO_HEADER_SIZE);
+
+		file.writeU32LE(INFO_HEADER_SIZE);
+		file.writeU32LE((std::uint32_t)width);
+		file.writeU32LE((std::uint32_t)height);	// positive height: bottom row first
+		file.writeU16LE(1);						// planes
+		file.writeU16LE(24);					// bits per pixel
+		file.writeU32LE(0);						// no compression
+		file.writeU32LE((std::uint32_t)imageSize);
+		file.writeU32LE(2835);					// 72 DPI
+		file.writeU32LE(2835);
+		file.writeU32LE(0);
+		file.writeU32LE(0);
+
+		std::vector<std::uint8_t> bgr(stride, 0);
+		for (int y = height - 1; y >= 0; y--)
+		{
+			const raster::Pixel* pixels = row(y);
+			for (int x = 0; x < width; x++)
+			{
+				bgr[3 * x] = pixels[x].b;
+				bgr[3 * x + 1] = pixels[x].g;
+				bgr[3 * x + 2] = pixels[x].r;
+			}
+			file.write(bgr.data(), bgr.size());
+		}
+	}
+
+	/***************************************************************************
+	*  Checksums.
+	***************************************************************************/
+
+	std::array<std::uint32_t, 256> makeCrcTable()
+	{
+		std::array<std::uint32_t, 256> table{};
+		for (std::uint32_t n = 0; n < 256; n++)
+		{
+			std::uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	std::uint32_t updateCrc(std::uint32_t crc, const std::uint8_t* data, size_t n)
+	{
+		static const std::array<std::uint32_t, 256> table = makeCrcTable();
+		crc = ~crc;
+		for (size_t i = 0; i < n; i++)
+		{
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	/***************************************************************************
+	*  PNG.
+	***************************************************************************/
+
+	// Compressed data is written out in IDAT chunks of about this size
+	constexpr size_t IDAT_BYTES = 64 * 1024;
+
+	void writePngChunk(File& file, const char type[4], const std::uint8_t* data, size_t n)
+	{
+		file.writeU32BE((std::uint32_t)n);
+		file.write(type, 4);
+		file.write(data, n);
+		std::uint32_t crc = updateCrc(0, reinterpret_cast<const std::uint8_t*>(type), 4);
+		crc = updateCrc(crc, data, n);
+		file.writeU32BE(crc);
+	}
+
+	void writePng(File& file, int width, int height, const image::RowSource& row)
+	{
+		static const std::uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		file.write(SIGNATURE, sizeof(SIGNATURE));
+
+		std::uint8_t header[13];
+		const std::uint32_t w = (std::uint32_t)width;
+		const std::uint32_t h = (std::uint32_t)height;
+		const std::uint8_t size[8] = {
+			(std::uint8_t)(w >> 24), (std::uint8_t)(w >> 16), (std::uint8_t)(w >> 8), (std::uint8_t)w,
+			(std::uint8_t)(h >> 24), (std::uint8_t)(h >> 16), (std::uint8_t)(h >> 8), (std::uint8_t)h };
+		std::memcpy(header, size, sizeof(size));
+		header[8] = 8;		// bits per channel
+		header[9] = 2;		// RGB
+		header[10] = 0;		// deflate
+		header[11] = 0;		// adaptive filtering
+		header[12] = 0;		// not interlaced
+		writePngChunk(file, "IHDR", header, sizeof(header));
+
+		image::ZlibWriter zlib;
+		std::vector<std::uint8_t> rgb((size_t)width * 3);
+		std::vector<std::uint8_t> filtered(1 + (size_t)width * 3);
+		// Sub filter: each byte minus the same channel of the pixel to its left,
+		// which turns runs of one color into runs of zeros
+		filtered[0] = 1;
+		for (int y = 0; y < height; y++)
+		{
+			packRgb(row(y), width, rgb.data());
+			const size_t n = rgb.size();
+			for (size_t i = 0; i < (std::min)(n, (size_t)3); i++)
+			{
+				filtered[1 + i] = rgb[i];
+			}
+			for (size_t i = 3; i < n; i++)
+			{
+				filtered[1 + i] = (std::uint8_t)(rgb[i] - rgb[i - 3]);
+			}
+			zlib.write(filtered.data(), filtered.size());
+
+			std::vector<std::uint8_t>& compressed = zlib.output();
+			if (compressed.size() >= IDAT_BYTES)
+			{
+				writePngChunk(file, "IDAT", compressed.data(), compressed.size());
+				compressed.clear();
+			}
+		}
+		zlib.finish();
+		std::vector<std::uint8_t>& compressed = zlib.output();
+		writePngChunk(file, "IDAT", compressed.data(), compressed.size());
+		writePngChunk(file, "IEND", nullptr, 0);
+	}
+}
+
+bool image::findFormat(const std::string& path, Format& format)
+{
+	const size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return false;
+	}
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char c) { return (char)std::tolower(c); });
+
+	if (extension == "ppm")
+	{
+		format = Format::PPM;
+	}
+	else if (extension == "bmp")
+	{
+		format = Format::BMP;
+	}
+	else if (extension == "png")
+	{
+		format = Format::PNG;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+void image::write(const std::string& path, Format format, int width, int height, const RowSource& row)
+{
+	File file(path);
+	switch (format)
+	{
+	case Format::PPM:
+		writePpm(file, width, height, row);
+		break;
+	case Format::BMP:
+		writeBmp(file, width, height, row);
+		break;
+	case Format::PNG:
+		writePng(file, width, height, row);
+		break;
+	}
+	file.close();
+}
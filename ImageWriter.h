@@ -0,0 +1,28 @@
+#pragma once
+#include <functional>
+#include <string>
+#include "Raster.h"
+
+// Encoders that save a canvas to disk. Rows are pulled from the caller one at
+// a time and streamed to the file, so no copy of the whole image is made.
+namespace image
+{
+	enum class Format
+	{
+		PPM,	// binary portable pixmap, uncompressed
+		BMP,	// 24-bit Windows bitmap, uncompressed
+		PNG		// 8-bit RGB, deflate favouring speed over size
+	};
+
+	// Returns pixels of row y; the pointer only needs to stay valid until the
+	// next call. Rows may be asked for in any order, each one exactly once.
+	using RowSource = std::function<const raster::Pixel*(int y)>;
+
+	// Picks the format from the extension of path, ignoring case. Returns false
+	// if the extension is not one of .ppm, .bmp or .png.
+	bool findFormat(const std::string& path, Format& format);
+
+	// Writes a width x height image; throws std::runtime_error if the file
+	// cannot be written
+	void write(const std::string& path, Format format, int width, int height, const RowSource& row);
+}
@@ -0,0 +1,337 @@
+#include "Raster.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Classic 5x7 font for the printable ASCII range 0x20..0x7E. Each glyph is
+	// five columns, least significant bit at the top.
+	const std::uint8_t FONT_5X7[95][5] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+		{ 0x00, 0x00, 0x5F, 0x00, 0x00 },	// !
+		{ 0x00, 0x07, 0x00, 0x07, 0x00 },	// "
+		{ 0x14, 0x7F, 0x14, 0x7F, 0x14 },	// #
+		{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 },	// $
+		{ 0x23, 0x13, 0x08, 0x64, 0x62 },	// %
+		{ 0x36, 0x49, 0x55, 0x22, 0x50 },	// &
+		{ 0x00, 0x05, 0x03, 0x00, 0x00 },	// '
+		{ 0x00, 0x1C, 0x22, 0x41, 0x00 },	// (
+		{ 0x00, 0x41, 0x22, 0x1C, 0x00 },	// )
+		{ 0x08, 0x2A, 0x1C, 0x2A, 0x08 },	// *
+		{ 0x08, 0x08, 0x3E, 0x08, 0x08 },	// +
+		{ 0x00, 0x50, 0x30, 0x00, 0x00 },	// ,
+		{ 0x08, 0x08, 0x08, 0x08, 0x08 },	// -
+		{ 0x00, 0x60, 0x60, 0x00, 0x00 },	// .
+		{ 0x20, 0x10, 0x08, 0x04, 0x02 },	// /
+		{ 0x3E, 0x51, 0x49, 0x45, 0x3E },	// 0
+		{ 0x00, 0x42, 0x7F, 0x40, 0x00 },	// 1
+		{ 0x42, 0x61, 0x51, 0x49, 0x46 },	// 2
+		{ 0x21, 0x41, 0x45, 0x4B, 0x31 },	// 3
+		{ 0x18, 0x14, 0x12, 0x7F, 0x10 },	// 4
+		{ 0x27, 0x45, 0x45, 0x45, 0x39 },	// 5
+		{ 0x3C, 0x4A, 0x49, 0x49, 0x30 },	// 6
+		{ 0x01, 0x71, 0x09, 0x05, 0x03 },	// 7
+		{ 0x36, 0x49, 0x49, 0x49, 0x36 },	// 8
+		{ 0x06, 0x49, 0x49, 0x29, 0x1E },	// 9
+		{ 0x00, 0x36, 0x36, 0x00, 0x00 },	// :
+		{ 0x00, 0x56, 0x36, 0x00, 0x00 },	// ;
+		{ 0x08, 0x14, 0x22, 0x41, 0x00 },	// <
+		{ 0x14, 0x14, 0x14, 0x14, 0x14 },	// =
+		{ 0x00, 0x41, 0x22, 0x14, 0x08 },	// >
+		{ 0x02, 0x01, 0x51, 0x09, 0x06 },	// ?
+		{ 0x32, 0x49, 0x79, 0x41, 0x3E },	// @
+		{ 0x7E, 0x11, 0x11, 0x11, 0x7E },	// A
+		{ 0x7F, 0x49, 0x49, 0x49, 0x36 },	// B
+		{ 0x3E, 0x41, 0x41, 0x41, 0x22 },	// C
+		{ 0x7F, 0x41, 0x41, 0x22, 0x1C },	// D
+		{ 0x7F, 0x49, 0x49, 0x49, 0x41 },	// E
+		{ 0x7F, 0x09, 0x09, 0x09, 0x01 },	// F
+		{ 0x3E, 0x41, 0x49, 0x49, 0x7A },	// G
+		{ 0x7F, 0x08, 0x08, 0x08, 0x7F },	// H
+		{ 0x00, 0x41, 0x7F, 0x41, 0x00 },	// I
+		{ 0x20, 0x40, 0x41, 0x3F, 0x01 },	// J
+		{ 0x7F, 0x08, 0x14, 0x22, 0x41 },	// K
+		{ 0x7F, 0x40, 0x40, 0x40, 0x40 },	// L
+		{ 0x7F, 0x02, 0x0C, 0x02, 0x7F },	// M
+		{ 0x7F, 0x04, 0x08, 0x10, 0x7F },	// N
+		{ 0x3E, 0x41, 0x41, 0x41, 0x3E },	// O
+		{ 0x7F, 0x09, 0x09, 0x09, 0x06 },	// P
+		{ 0x3E, 0x41, 0x51, 0x21, 0x5E },	// Q
+		{ 0x7F, 0x09, 0x19, 0x29, 0x46 },	// R
+		{ 0x46, 0x49, 0x49, 0x49, 0x31 },	// S
+		{ 0x01, 0x01, 0x7F, 0x01, 0x01 },	// T
+		{ 0x3F, 0x40, 0x40, 0x40, 0x3F },	// U
+		{ 0x1F, 0x20, 0x40, 0x20, 0x1F },	// V
+		{ 0x3F, 0x40, 0x38, 0x40, 0x3F },	// W
+		{ 0x63, 0x14, 0x08, 0x14, 0x63 },	// X
+		{ 0x07, 0x08, 0x70, 0x08, 0x07 },	// Y
+		{ 0x61, 0x51, 0x49, 0x45, 0x43 },	// Z
+		{ 0x00, 0x7F, 0x41, 0x41, 0x00 },	// [
+		{ 0x02, 0x04, 0x08, 0x10, 0x20 },	// backslash
+		{ 0x00, 0x41, 0x41, 0x7F, 0x00 },	// ]
+		{ 0x04, 0x02, 0x01, 0x02, 0x04 },	// ^
+		{ 0x40, 0x40, 0x40, 0x40, 0x40 },	// _
+		{ 0x00, 0x01, 0x02, 0x04, 0x00 },	// `
+		{ 0x20, 0x54, 0x54, 0x54, 0x78 },	// a
+		{ 0x7F, 0x48, 0x44, 0x44, 0x38 },	// b
+		{ 0x38, 0x44, 0x44, 0x44, 0x20 },	// c
+		{ 0x38, 0x44, 0x44, 0x48, 0x7F },	// d
+		{ 0x38, 0x54, 0x54, 0x54, 0x18 },	// e
+		{ 0x08, 0x7E, 0x09, 0x01, 0x02 },	// f
+		{ 0x0C, 0x52, 0x52, 0x52, 0x3E },	// g
+		{ 0x7F, 0x08, 0x04, 0x04, 0x78 },	// h
+		{ 0x00, 0x44, 0x7D, 0x40, 0x00 },	// i
+		{ 0x20, 0x40, 0x44, 0x3D, 0x00 },	// j
+		{ 0x7F, 0x10, 0x28, 0x44, 0x00 },	// k
+		{ 0x00, 0x41, 0x7F, 0x40, 0x00 },	// l
+		{ 0x7C, 0x04, 0x18, 0x04, 0x78 },	// m
+		{ 0x7C, 0x08, 0x04, 0x04, 0x78 },	// n
+		{ 0x38, 0x44, 0x44, 0x44, 0x38 },	// o
+		{ 0x7C, 0x14, 0x14, 0x14, 0x08 },	// p
+		{ 0x08, 0x14, 0x14, 0x18, 0x7C },	// q
+		{ 0x7C, 0x08, 0x04, 0x04, 0x08 },	// r
+		{ 0x48, 0x54, 0x54, 0x54, 0x20 },	// s
+		{ 0x04, 0x3F, 0x44, 0x40, 0x20 },	// t
+		{ 0x3C, 0x40, 0x40, 0x20, 0x7C },	// u
+		{ 0x1C, 0x20, 0x40, 0x20, 0x1C },	// v
+		{ 0x3C, 0x40, 0x30, 0x40, 0x3C },	// w
+		{ 0x44, 0x28, 0x10, 0x28, 0x44 },	// x
+		{ 0x0C, 0x50, 0x50, 0x50, 0x3C },	// y
+		{ 0x44, 0x64, 0x54, 0x4C, 0x44 },	// z
+		{ 0x00, 0x08, 0x36, 0x41, 0x00 },	// {
+		{ 0x00, 0x00, 0x7F, 0x00, 0x00 },	// |
+		{ 0x00, 0x41, 0x36, 0x08, 0x00 },	// }
+		{ 0x08, 0x04, 0x08, 0x10, 0x08 },	// ~
+	};
+
+	// color premultiplied by its alpha
+	raster::Pixel toPixel(cwt::ColorRgba color)
+	{
+		auto premultiply = [a = color.a](std::uint8_t c) { return (std::uint8_t)((c * a + 127) / 255); };
+		return raster::Pixel{ premultiply(color.r), premultiply(color.g), premultiply(color.b), color.a };
+	}
+
+	std::uint8_t* viewBytes(raster::Pixel* p)
+	{
+		return reinterpret_cast<std::uint8_t*>(p);
+	}
+
+	// Index of the first pixel whose center lies at or after the edge v,
+	// clamped so that far away coordinates cannot overflow an int
+	int pixelEdge(double v, int limit)
+	{
+		double p = std::ceil(v - 0.5);
+		if (p < -1.0) return -1;
+		if (p > limit + 1.0) return limit + 1;
+		return (int)p;
+	}
+
+	// Covers the pixels of row y whose centers lie in [left, right)
+	void fillSpan(raster::Surface& fb, int y, double left, double right, cwt::ColorRgba color)
+	{
+		int w = fb.viewWidth();
+		fb.blendSpan(y, pixelEdge(left, w), pixelEdge(right, w), color);
+	}
+
+	// Rows whose centers lie in [top, bottom), clipped to the clip box
+	void rowRange(const raster::Surface& fb, double top, double bottom, int& first, int& last)
+	{
+		int h = fb.viewHeight();
+		first = std::max(fb.viewClipTop(), pixelEdge(top, h));
+		last = std::min(fb.viewClipBottom(), pixelEdge(bottom, h));
+	}
+
+	// Covers the ring between two concentric ellipses centered at (cx, cy), one
+	// row at a time through cover(fb, row, left, right, color). With inner radii
+	// <= 0 the whole outer ellipse is covered.
+	template <class SpanCover>
+	void fillRing(raster::Surface& fb, cwt::ColorRgba color, double cx, double cy,
+		double ao, double bo, double ai, double bi, SpanCover cover)
+	{
+		if (ao <= 0.0 || bo <= 0.0)
+		{
+			return;
+		}
+		const bool hasHole = ai > 0.0 && bi > 0.0;
+		int first = 0;
+		int last = 0;
+		rowRange(fb, cy - bo, cy + bo, first, last);
+		for (int row = first; row < last; row++)
+		{
+			const double dy = row + 0.5 - cy;
+			const double ky = dy / bo;
+			if (ky * ky >= 1.0)
+			{
+				continue;
+			}
+			const double ox = ao * std::sqrt(1.0 - ky * ky);
+			double ix = 0.0;
+			if (hasHole && std::abs(dy) < bi)
+			{
+				const double kiy = dy / bi;
+				ix = ai * std::sqrt(1.0 - kiy * kiy);
+			}
+			if (ix > 0.0)
+			{
+				cover(fb, row, cx - ox, cx - ix, color);
+				cover(fb, row, cx + ix, cx + ox, color);
+			}
+			else
+			{
+				cover(fb, row, cx - ox, cx + ox, color);
+			}
+		}
+	}
+
+	double strokeWidth(double penWidth)
+	{
+		return std::max(penWidth, 1.0);
+	}
+}
+
+raster::Surface::Surface(Surface& canvas, int left, int top, int right, int bottom)
+	: pixels(canvas.pixels), width(canvas.width), height(canvas.height),
+	clipLeft(std::max(left, canvas.clipLeft)), clipTop(std::max(top, canvas.clipTop)),
+	clipRight(std::min(right, canvas.clipRight)), clipBottom(std::min(bottom, canvas.clipBottom))
+{
+}
+
+raster::Framebuffer::Framebuffer(int width, int height, cwt::ColorRgba clearColor)
+{
+	resize(width, height, clearColor);
+}
+
+raster::Framebuffer::Framebuffer(const Framebuffer& other)
+	: Surface(), storage(other.storage)
+{
+	width = other.width;
+	height = other.height;
+	attach();
+}
+
+raster::Framebuffer& raster::Framebuffer::operator=(const Framebuffer& other)
+{
+	storage = other.storage;
+	width = other.width;
+	height = other.height;
+	attach();
+	return *this;
+}
+
+void raster::Framebuffer::resize(int newWidth, int newHeight, cwt::ColorRgba clearColor)
+{
+	width = std::max(newWidth, 0);
+	height = std::max(newHeight, 0);
+	storage.assign((size_t)width * height, toPixel(clearColor));
+	attach();
+}
+
+void raster::Framebuffer::clear(cwt::ColorRgba color)
+{
+	std::fill(storage.begin(), storage.end(), toPixel(color));
+}
+
+void raster::Framebuffer::attach()
+{
+	pixels = storage.data();
+	clipLeft = 0;
+	clipTop = 0;
+	clipRight = width;
+	clipBottom = height;
+}
+
+void raster::Surface::blendSpan(int y, int x0, int x1, cwt::ColorRgba color)
+{
+	if (y < clipTop || y >= clipBottom || color.a <= 0)
+	{
+		return;
+	}
+	x0 = std::max(x0, clipLeft);
+	x1 = std::min(x1, clipRight);
+	if (x0 >= x1)
+	{
+		return;
+	}
+	Pixel* row = getRow(y);
+	if (color.a >= 255)
+	{
+		std::fill(row + x0, row + x1, toPixel(color));
+		return;
+	}
+	simd::blendSpan(viewBytes(row + x0), (size_t)(x1 - x0), color.pack());
+}
+
+void raster::Surface::blendMask(int y, int x0, const std::uint8_t* coverage, int n, cwt::ColorRgba color)
+{
+	if (y < clipTop || y >= clipBottom || color.a <= 0)
+	{
+		return;
+	}
+	const int first = std::max(x0, clipLeft);
+	const int last = std::min(x0 + n, clipRight);
+	if (first >= last)
+	{
+		return;
+	}
+	simd::blendMask(viewBytes(getRow(y) + first), coverage + (first - x0), (size_t)(last - first), color.pack());
+}
+
+int raster::glyphScale(size_t fontSize)
+{
+	return std::max(1, (int)((fontSize + GLYPH_CELL_HEIGHT / 2) / GLYPH_CELL_HEIGHT));
+}
+
+const std::uint8_t* raster::glyphColumns(wchar_t ch)
+{
+	if (ch < 0x20 || ch > 0x7E)
+	{
+		ch = L'?';
+	}
+	return FONT_5X7[ch - 0x20];
+}
+
+void raster::fillEllipse(Surface& fb, cwt::ColorRgba color,
+	double x, double y, double width, double height)
+{
+	const double a = width / 2;
+	const double b = height / 2;
+	fillRing(fb, color, x + a, y + b, a, b, 0.0, 0.0, fillSpan);
+}
+
+void raster::drawRectangle(Surface& fb, cwt::ColorRgba color, double penWidth,
+	double x, double y, double width, double height)
+{
+	const double pw = strokeWidth(penWidth);
+	const double half = pw / 2;
+	fillRectangle(fb, color, x - half, y - half, width + pw, pw);
+	fillRectangle(fb, color, x - half, y + height - half, width + pw, pw);
+	if (height > pw)
+	{
+		fillRectangle(fb, color, x - half, y + half, pw, height - pw);
+		fillRectangle(fb, color, x + width - half, y + half, pw, height - pw);
+	}
+}
+
+void raster::fillRectangle(Surface& fb, cwt::ColorRgba color,
+	double x, double y, double width, double height)
+{
+	if (width < 0.0)
+	{
+		x += width;
+		width = -width;
+	}
+	if (height < 0.0)
+	{
+		y += height;
+		height = -height;
+	}
+	int first = 0;
+	int last = 0;
+	rowRange(fb, y, y + height, first, last);
+	for (int row = first; row < last; row++)
+	{
+		fillSpan(fb, row, x, x + width, color);
+	}
+}
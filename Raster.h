@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "cwt.h"
+
+// Portable CPU rasterizer used by the headless render backend.
+// All coordinates are in pixels, with (0, 0) at the top-left corner of the
+// canvas and y growing downwards, exactly like the GDI+ backend.
+namespace raster
+{
+	// One pixel stored as R, G, B, A bytes in memory order, with the color
+	// premultiplied by alpha.
+	struct Pixel
+	{
+		std::uint8_t r;
+		std::uint8_t g;
+		std::uint8_t b;
+		std::uint8_t a;
+	};
+
+	static_assert(sizeof(Pixel) == 4, "pixels are blended as packed bytes");
+
+	// Pixels the rasterizer draws into: a whole canvas, or a view of a part of
+	// one. Coordinates are always those of the canvas; whatever falls outside
+	// the clip box is dropped, so threads may draw through views with disjoint
+	// boxes at the same time.
+	class Surface
+	{
+	public:
+		// A view of the pixels of canvas, clipped to [left, right) x [top, bottom)
+		// and to the clip box of canvas
+		Surface(Surface& canvas, int left, int top, int right, int bottom);
+
+		int viewWidth() const { return width; }
+		int viewHeight() const { return height; }
+		int viewClipLeft() const { return clipLeft; }
+		int viewClipTop() const { return clipTop; }
+		int viewClipRight() const { return clipRight; }
+		int viewClipBottom() const { return clipBottom; }
+		const Pixel* viewRow(int y) const { return pixels + (size_t)y * width; }
+		Pixel* getRow(int y) { return pixels + (size_t)y * width; }
+
+		// Composites color source over every pixel of row y in [x0, x1),
+		// clipped to the clip box
+		void blendSpan(int y, int x0, int x1, cwt::ColorRgba color);
+
+		// Composites color source over the n pixels of row y from x0 on, its
+		// alpha weighted by the coverage (0 to 255) of each, clipped to the
+		// clip box
+		void blendMask(int y, int x0, const std::uint8_t* coverage, int n, cwt::ColorRgba color);
+	protected:
+		Surface() = default;
+
+		Pixel* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int clipLeft = 0;
+		int clipTop = 0;
+		int clipRight = 0;
+		int clipBottom = 0;
+	};
+
+	// A canvas owning its pixels, clipped to its own size
+	class Framebuffer : public Surface
+	{
+	public:
+		Framebuffer(int width, int height, cwt::ColorRgba clearColor);
+		Framebuffer(const Framebuffer& other);
+		Framebuffer& operator=(const Framebuffer& other);
+
+		const Pixel* viewPixels() const { return storage.data(); }
+
+		// Resizes the canvas, erasing it with clearColor
+		void resize(int newWidth, int newHeight, cwt::ColorRgba clearColor);
+
+		// Sets every pixel to color
+		void clear(cwt::ColorRgba color);
+	private:
+		// Points the surface at storage
+		void attach();
+
+		std::vector<Pixel> storage;
+	};
+
+	// Width and height of one glyph cell of the built-in font at scale 1
+	constexpr int GLYPH_CELL_WIDTH = 6;
+	constexpr int GLYPH_CELL_HEIGHT = 8;
+
+	// Returns the integer scale the built-in font uses for a font of fontSize pixels
+	int glyphScale(size_t fontSize);
+
+	// Five column bitmaps of ch in the built-in font, least significant bit at
+	// the top; characters the font lacks are drawn as '?'
+	const std::uint8_t* glyphColumns(wchar_t ch);
+
+	// Fills the ellipse inscribed in the given bounding box
+	void fillEllipse(Surface& fb, cwt::ColorRgba color,
+		double x, double y, double width, double height);
+
+	// Strokes the outline of a rectangle
+	void drawRectangle(Surface& fb, cwt::ColorRgba color, double penWidth,
+		double x, double y, double width, double height);
+
+	// Fills a rectangle
+	void fillRectangle(Surface& fb, cwt::ColorRgba color,
+		double x, double y, double width, double height);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "Raster.h"
+#include "Scanline.h"
+#include "Stroker.h"
+#include <cmath>
+
+namespace raster
+{
+	// Width in pixels of the strokes of pen on the canvas of fb
+	inline double penWidth(const cwt::Pen& pen, const Surface& fb)
+	{
+		return cwt::penWidth(pen, fb.viewWidth(), fb.viewHeight());
+	}
+
+	// Replays display list commands into the software rasterizer
+	class RasterDevice
+	{
+	public:
+		// With isGlyphAtlasShared, text must have been prepared in glyphs,
+		// which is then only read
+		RasterDevice(Surface& fb, text::GlyphAtlas& glyphs, ScanlineFiller& polygons, Stroker& strokes,
+			bool isGlyphAtlasShared = false)
+			: fb(fb), glyphs(glyphs), polygons(polygons), strokes(strokes), isGlyphAtlasShared(isGlyphAtlasShared) {}
+
+		void line(geom::PenRef pen, float x1, float y1, float x2, float y2)
+		{
+			const float xy[4] = { x1, y1, x2, y2 };
+			stroke(pen, xy, 2, false);
+		}
+
+		void ellipse(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				fillEllipse(fb, pen->color, x, y, width, height);
+			}
+			else
+			{
+				arc(pen, x, y, width, height, 0.0f, 360.0f);
+			}
+		}
+
+		void arc(geom::PenRef pen, float x, float y, float width, float height, float start, float sweep)
+		{
+			strokes.arc(x, y, width, height, start, sweep, penWidth(*pen, fb),
+				fb.viewClipLeft(), fb.viewClipTop(), fb.viewClipRight(), fb.viewClipBottom(), blendInto(pen->color));
+		}
+
+		void rectangle(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				fillRectangle(fb, pen->color, x, y, width, height);
+			}
+			else
+			{
+				drawRectangle(fb, pen->color, penWidth(*pen, fb), x, y, width, height);
+			}
+		}
+
+		void polygon(geom::PenRef pen, const float* xy, size_t n, bool isFill)
+		{
+			if (isFill)
+			{
+				polygons.fill(fb.viewWidth(), fb.viewHeight(), xy, n, blendInto(pen->color));
+			}
+			else
+			{
+				stroke(pen, xy, n, true);
+			}
+		}
+
+		void polyline(geom::PenRef pen, const float* xy, size_t n)
+		{
+			stroke(pen, xy, n, false);
+		}
+
+		void text(geom::PenRef pen, geom::FontRef font, const wchar_t* text, float x, float y)
+		{
+			const cwt::ColorRgba color = pen->color;
+			auto blit = [this, color](int gx, int gy, const std::uint8_t* coverage, size_t stride, int width, int height)
+			{
+				for (int row = 0; row < height; row++)
+				{
+					fb.blendMask(gy + row, gx, coverage + row * stride, width, color);
+				}
+			};
+			if (isGlyphAtlasShared)
+			{
+				glyphs.drawPrepared(*font, text, (int)std::lround(x), (int)std::lround(y), blit);
+			}
+			else
+			{
+				glyphs.draw(*font, text, (int)std::lround(x), (int)std::lround(y), blit);
+			}
+		}
+
+		void lines(geom::PenRef pen, const float* segments, size_t n)
+		{
+			// Separate strokes, each blended on its own
+			for (size_t i = 0; i < n; i++)
+			{
+				stroke(pen, segments + 4 * i, 2, false);
+			}
+		}
+
+		void filledEllipses(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* b = boxes + 4 * i;
+				fillEllipse(fb, pen->color, b[0], b[1], b[2], b[3]);
+			}
+		}
+
+		void filledRectangles(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* b = boxes + 4 * i;
+				fillRectangle(fb, pen->color, b[0], b[1], b[2], b[3]);
+			}
+		}
+
+	private:
+		// Sink blending coverage spans of color into fb
+		SpanSink blendInto(cwt::ColorRgba color)
+		{
+			return [this, color](int y, int x, const std::uint8_t* coverage, int count)
+			{
+				fb.blendMask(y, x, coverage, count, color);
+			};
+		}
+
+		void stroke(geom::PenRef pen, const float* xy, size_t n, bool isClosed)
+		{
+			strokes.polyline(xy, n, isClosed, penWidth(*pen, fb),
+				fb.viewClipLeft(), fb.viewClipTop(), fb.viewClipRight(), fb.viewClipBottom(), blendInto(pen->color));
+		}
+
+		Surface& fb;
+		text::GlyphAtlas& glyphs;
+		ScanlineFiller& polygons;
+		Stroker& strokes;
+		bool isGlyphAtlasShared;
+	};
+}
@@ -0,0 +1,562 @@
+#include "Recorder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+	void append16(std::vector<std::uint8_t>& out, int v)
+	{
+		out.push_back((std::uint8_t)v);
+		out.push_back((std::uint8_t)(v >> 8));
+	}
+
+	std::uint32_t packColor(const raster::Pixel& p)
+	{
+		return (std::uint32_t)p.r << 16 | (std::uint32_t)p.g << 8 | p.b;
+	}
+
+	/***************************************************************************
+	*  GIF palettes.
+	*  A frame with at most 256 colors gets exactly those colors. Anything
+	*  richer, like anti-aliased edges over a gradient, falls back to a fixed
+	*  6x7x6 color cube.
+	***************************************************************************/
+
+	class Palette
+	{
+	public:
+		// Builds the palette of the pixels in the given rectangle
+		Palette(const std::vector<raster::Pixel>& pixels, int stride, int left, int top, int width, int height)
+		{
+			for (int y = top; y < top + height && !isCube; y++)
+			{
+				const raster::Pixel* row = pixels.data() + (size_t)y * stride;
+				for (int x = left; x < left + width; x++)
+				{
+					const std::uint32_t color = packColor(row[x]);
+					if (index.find(color) != index.end())
+					{
+						continue;
+					}
+					if (colors.size() == 256)
+					{
+						isCube = true;
+						break;
+					}
+					index.emplace(color, (std::uint8_t)colors.size());
+					colors.push_back(color);
+				}
+			}
+
+			if (isCube)
+			{
+				colors.clear();
+				for (int r = 0; r < 6; r++)
+				{
+					for (int g = 0; g < 7; g++)
+					{
+						for (int b = 0; b < 6; b++)
+						{
+							colors.push_back((std::uint32_t)(r * 255 / 5) << 16 | (std::uint32_t)(g * 255 / 6) << 8 | (std::uint32_t)(b * 255 / 5));
+						}
+					}
+				}
+			}
+		}
+
+		// Bits per index, at least 2 as LZW requires
+		int viewBits() const
+		{
+			int bits = 2;
+			while ((size_t)1 << bits < colors.size())
+			{
+				bits++;
+			}
+			return bits;
+		}
+
+		std::uint8_t indexOf(const raster::Pixel& p)
+		{
+			if (isCube)
+			{
+				const int r = (p.r * 5 + 127) / 255;
+				const int g = (p.g * 6 + 127) / 255;
+				const int b = (p.b * 5 + 127) / 255;
+				return (std::uint8_t)((r * 7 + g) * 6 + b);
+			}
+			const std::uint32_t color = packColor(p);
+			if (color != lastColor || !hasLast)
+			{
+				lastColor = color;
+				lastIndex = index.find(color)->second;
+				hasLast = true;
+			}
+			return lastIndex;
+		}
+
+		// Appends the color table, padded to 2^viewBits() entries
+		void appendTable(std::vector<std::uint8_t>& out) const
+		{
+			const size_t entries = (size_t)1 << viewBits();
+			for (size_t i = 0; i < entries; i++)
+			{
+				const std::uint32_t color = i < colors.size() ? colors[i] : 0;
+				out.push_back((std::uint8_t)(color >> 16));
+				out.push_back((std::uint8_t)(color >> 8));
+				out.push_back((std::uint8_t)color);
+			}
+		}
+
+	private:
+		std::vector<std::uint32_t> colors;
+		std::unordered_map<std::uint32_t, std::uint8_t> index;
+		bool isCube = false;
+		std::uint32_t lastColor = 0;
+		std::uint8_t lastIndex = 0;
+		bool hasLast = false;
+	};
+
+	/***************************************************************************
+	*  GIF LZW.
+	***************************************************************************/
+
+	class LzwWriter
+	{
+	public:
+		LzwWriter(std::vector<std::uint8_t>& out, int minCodeSize)
+			:
+			out(out),
+			minCodeSize(minCodeSize),
+			clearCode(1 << minCodeSize),
+			keys(TABLE_SIZE),
+			codes(TABLE_SIZE)
+		{
+			out.push_back((std::uint8_t)minCodeSize);
+			reset();
+			putCode(clearCode);
+		}
+
+		void write(const std::uint8_t* indices, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const int c = indices[i];
+				if (prefix < 0)
+				{
+					prefix = c;
+					continue;
+				}
+
+				// Open addressing on (prefix, c)
+				const std::int32_t key = prefix << 8 | c;
+				size_t slot = ((size_t)key * 2654435761u) % TABLE_SIZE;
+				while (keys[slot] != EMPTY && keys[slot] != key)
+				{
+					slot = slot + 1 == TABLE_SIZE ? 0 : slot + 1;
+				}
+				if (keys[slot] == key)
+				{
+					prefix = codes[slot];
+					continue;
+				}
+
+				putCode(prefix);
+				keys[slot] = key;
+				codes[slot] = (std::uint16_t)++maxCode;
+				if (maxCode >= 1 << codeSize)
+				{
+					codeSize++;
+				}
+				if (maxCode >= 4095)
+				{
+					// Table full: start over
+					putCode(clearCode);
+					reset();
+				}
+				prefix = c;
+			}
+		}
+
+		void finish()
+		{
+			if (prefix >= 0)
+			{
+				putCode(prefix);
+			}
+			putCode(clearCode);
+			codeSize = minCodeSize + 1;
+			putCode(clearCode + 1);
+			if (bitCount > 0)
+			{
+				pushByte((std::uint8_t)bitBuffer);
+			}
+			if (!block.empty())
+			{
+				flushBlock();
+			}
+			out.push_back(0);
+		}
+
+	private:
+		static constexpr size_t TABLE_SIZE = 5003;
+		static constexpr std::int32_t EMPTY = -1;
+
+		void reset()
+		{
+			std::fill(keys.begin(), keys.end(), EMPTY);
+			codeSize = minCodeSize + 1;
+			maxCode = clearCode + 1;
+		}
+
+		void putCode(int code)
+		{
+			bitBuffer |= (std::uint32_t)code << bitCount;
+			bitCount += codeSize;
+			while (bitCount >= 8)
+			{
+				pushByte((std::uint8_t)bitBuffer);
+				bitBuffer >>= 8;
+				bitCount -= 8;
+			}
+		}
+
+		// Data is stored in sub-blocks of at most 255 bytes
+		void pushByte(std::uint8_t b)
+		{
+			block.push_back(b);
+			if (block.size() == 255)
+			{
+				flushBlock();
+			}
+		}
+
+		void flushBlock()
+		{
+			out.push_back((std::uint8_t)block.size());
+			out.insert(out.end(), block.begin(), block.end());
+			block.clear();
+		}
+
+		std::vector<std::uint8_t>& out;
+		const int minCodeSize;
+		const int clearCode;
+		int codeSize = 0;
+		int maxCode = 0;
+		int prefix = -1;
+		std::vector<std::int32_t> keys;
+		std::vector<std::uint16_t> codes;
+		std::uint32_t bitBuffer = 0;
+		int bitCount = 0;
+		std::vector<std::uint8_t> block;
+	};
+}
+
+bool image::findVideoFormat(const std::string& path, VideoFormat& format)
+{
+	const size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return false;
+	}
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char c) { return (char)std::tolower(c); });
+
+	if (extension == "gif")
+	{
+		format = VideoFormat::GIF;
+	}
+	else if (extension == "y4m")
+	{
+		format = VideoFormat::Y4M;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+image::Recorder::Recorder(const std::string& path, VideoFormat format, int fps)
+	:
+	format(format),
+	fps(fps),
+	file(path, std::ios::binary | std::ios::trunc)
+{
+	if (!file)
+	{
+		throw std::runtime_error("cannot open " + path + " for writing");
+	}
+	worker = std::thread(&Recorder::run, this);
+}
+
+image::Recorder::~Recorder()
+{
+	finish();
+}
+
+void image::Recorder::addFrame(int frameWidth, int frameHeight, const RowSource& row)
+{
+	std::unique_ptr<Frame> frame;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (width == 0)
+		{
+			width = frameWidth;
+			height = frameHeight;
+		}
+		if (!spare.empty())
+		{
+			frame = std::move(spare.back());
+			spare.pop_back();
+		}
+	}
+	if (!frame)
+	{
+		frame = std::make_unique<Frame>();
+	}
+
+	// Copy outside the lock; the worker never touches width and height
+	// before the first frame is queued
+	const raster::Pixel white{ 255, 255, 255, 255 };
+	frame->pixels.assign((size_t)width * height, white);
+	const int copyWidth = (std::min)(width, frameWidth);
+	for (int y = 0; y < (std::min)(height, frameHeight); y++)
+	{
+		std::memcpy(frame->pixels.data() + (size_t)y * width, row(y), copyWidth * sizeof(raster::Pixel));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(std::move(frame));
+	}
+	wake.notify_one();
+}
+
+std::string image::Recorder::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isFinishing = true;
+	}
+	wake.notify_one();
+	if (worker.joinable())
+	{
+		worker.join();
+
+		if (format == VideoFormat::GIF && error.empty() && frameCount > 0)
+		{
+			flushGifFrame();
+			file.put(0x3B);
+		}
+		file.close();
+		if (!file && error.empty())
+		{
+			error = "error while writing the recording";
+		}
+	}
+	return error;
+}
+
+void image::Recorder::run()
+{
+	for (;;)
+	{
+		std::unique_ptr<Frame> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return !pending.empty() || isFinishing; });
+			if (pending.empty())
+			{
+				return;
+			}
+			frame = std::move(pending.front());
+			pending.pop_front();
+		}
+
+		if (error.empty())
+		{
+			encode(*frame);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(std::move(frame));
+	}
+}
+
+void image::Recorder::encode(Frame& frame)
+{
+	switch (format)
+	{
+	case VideoFormat::GIF:
+		encodeGif(frame);
+		break;
+	case VideoFormat::Y4M:
+		encodeY4m(frame);
+		break;
+	}
+	frameCount++;
+	if (!file)
+	{
+		error = "error while writing the recording";
+	}
+}
+
+void image::Recorder::encodeGif(Frame& frame)
+{
+	int left = 0;
+	int top = 0;
+	int right = width;
+	int bottom = height;
+	if (frameCount == 0)
+	{
+		// Header, screen without a global color table, loop forever
+		std::vector<std::uint8_t> header = { 'G', 'I', 'F', '8', '9', 'a' };
+		append16(header, width);
+		append16(header, height);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+		const std::uint8_t loop[] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+		header.insert(header.end(), loop, loop + sizeof(loop));
+		file.write((const char*)header.data(), (std::streamsize)header.size());
+	}
+	else
+	{
+		// Only the bounding box of what changed since the previous frame
+		left = width;
+		top = height;
+		right = 0;
+		bottom = 0;
+		for (int y = 0; y < height; y++)
+		{
+			const size_t offset = (size_t)y * width;
+			if (std::memcmp(frame.pixels.data() + offset, previous.data() + offset, width * sizeof(raster::Pixel)) == 0)
+			{
+				continue;
+			}
+			int x0 = 0;
+			int x1 = width - 1;
+			while (packColor(frame.pixels[offset + x0]) == packColor(previous[offset + x0]) && x0 < x1)
+			{
+				x0++;
+			}
+			while (packColor(frame.pixels[offset + x1]) == packColor(previous[offset + x1]) && x1 > x0)
+			{
+				x1--;
+			}
+			left = (std::min)(left, x0);
+			right = (std::max)(right, x1 + 1);
+			top = (std::min)(top, y);
+			bottom = y + 1;
+		}
+		if (left >= right)
+		{
+			// Nothing changed: the frame still on screen just lasts longer
+			previous.swap(frame.pixels);
+			return;
+		}
+		flushGifFrame();
+	}
+
+	const int w = right - left;
+	const int h = bottom - top;
+	Palette palette(frame.pixels, width, left, top, w, h);
+	const int bits = palette.viewBits();
+
+	gifFrame.clear();
+	gifFrame.push_back(0x2C);
+	append16(gifFrame, left);
+	append16(gifFrame, top);
+	append16(gifFrame, w);
+	append16(gifFrame, h);
+	gifFrame.push_back((std::uint8_t)(0x80 | (bits - 1)));	// local color table
+	palette.appendTable(gifFrame);
+
+	LzwWriter lzw(gifFrame, bits);
+	std::vector<std::uint8_t> indices(w);
+	for (int y = top; y < bottom; y++)
+	{
+		const raster::Pixel* row = frame.pixels.data() + (size_t)y * width;
+		for (int x = 0; x < w; x++)
+		{
+			indices[x] = palette.indexOf(row[left + x]);
+		}
+		lzw.write(indices.data(), indices.size());
+	}
+	lzw.finish();
+	gifFrameStart = frameCount;
+
+	previous.swap(frame.pixels);
+}
+
+void image::Recorder::flushGifFrame()
+{
+	// Delays are in hundredths of a second; rounding the start and end of each
+	// frame rather than its length keeps the total from drifting
+	const std::uint64_t start = (gifFrameStart * 100 + fps / 2) / fps;
+	const std::uint64_t end = (frameCount * 100 + fps / 2) / fps;
+	const int delay = (int)(std::min)(end - start, (std::uint64_t)0xFFFF);
+
+	// Graphic control extension: leave the frame in place for the next one
+	const std::uint8_t control[] = { 0x21, 0xF9, 0x04, 1 << 2, (std::uint8_t)delay, (std::uint8_t)(delay >> 8), 0x00, 0x00 };
+	file.write((const char*)control, sizeof(control));
+	file.write((const char*)gifFrame.data(), (std::streamsize)gifFrame.size());
+}
+
+void image::Recorder::encodeY4m(Frame& frame)
+{
+	const int chromaWidth = (width + 1) / 2;
+	const int chromaHeight = (height + 1) / 2;
+	if (frameCount == 0)
+	{
+		const std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+			+ " F" + std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n";
+		file.write(header.data(), (std::streamsize)header.size());
+	}
+
+	// Full range BT.601 in 16-bit fixed point
+	const size_t lumaSize = (size_t)width * height;
+	const size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+	scratch.resize(lumaSize + 2 * chromaSize);
+	std::uint8_t* yPlane = scratch.data();
+	std::uint8_t* uPlane = yPlane + lumaSize;
+	std::uint8_t* vPlane = uPlane + chromaSize;
+	for (size_t i = 0; i < lumaSize; i++)
+	{
+		const raster::Pixel& p = frame.pixels[i];
+		yPlane[i] = (std::uint8_t)((19595 * p.r + 38470 * p.g + 7471 * p.b + 32768) >> 16);
+	}
+	for (int cy = 0; cy < chromaHeight; cy++)
+	{
+		for (int cx = 0; cx < chromaWidth; cx++)
+		{
+			// Average the 2x2 block, clamped at the right and bottom edges
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			for (int dy = 0; dy < 2; dy++)
+			{
+				const int y = (std::min)(2 * cy + dy, height - 1);
+				for (int dx = 0; dx < 2; dx++)
+				{
+					const int x = (std::min)(2 * cx + dx, width - 1);
+					const raster::Pixel& p = frame.pixels[(size_t)y * width + x];
+					r += p.r;
+					g += p.g;
+					b += p.b;
+				}
+			}
+			const int u = (-11059 * r - 21709 * g + 32768 * b + (128 << 18) + (1 << 17)) >> 18;
+			const int v = (32768 * r - 27439 * g - 5329 * b + (128 << 18) + (1 << 17)) >> 18;
+			uPlane[(size_t)cy * chromaWidth + cx] = (std::uint8_t)std::clamp(u, 0, 255);
+			vPlane[(size_t)cy * chromaWidth + cx] = (std::uint8_t)std::clamp(v, 0, 255);
+		}
+	}
+
+	file.write("FRAME\n", 6);
+	file.write((const char*)scratch.data(), (std::streamsize)scratch.size());
+}
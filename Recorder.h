@@ -0,0 +1,84 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ImageWriter.h"
+#include "Raster.h"
+
+namespace image
+{
+	enum class VideoFormat
+	{
+		GIF,	// animated GIF, only the changed part of each frame is stored
+		Y4M		// uncompressed YUV4MPEG2 4:2:0, for piping to a video encoder
+	};
+
+	// Picks the format from the extension of path, ignoring case. Returns false
+	// if the extension is neither .gif nor .y4m.
+	bool findVideoFormat(const std::string& path, VideoFormat& format);
+
+	/**
+	 * Encodes a sequence of frames to a file on a worker thread of its own.
+	 * addFrame() only copies the frame, so whoever draws the frames is never
+	 * held up by the encoder. The size of the first frame is the size of the
+	 * video; later frames are cropped or padded to it.
+	 */
+	class Recorder
+	{
+	public:
+		// Throws std::runtime_error if the file cannot be created
+		Recorder(const std::string& path, VideoFormat format, int fps);
+		Recorder(const Recorder&) = delete;
+		void operator=(const Recorder&) = delete;
+		~Recorder();
+
+		void addFrame(int width, int height, const RowSource& row);
+
+		// Encodes the frames still queued and closes the file. Returns why
+		// writing failed, or an empty string.
+		std::string finish();
+
+	private:
+		struct Frame
+		{
+			std::vector<raster::Pixel> pixels;
+		};
+
+		void run();
+		// The encoders keep the pixels of frame as the previous frame
+		void encode(Frame& frame);
+		void encodeGif(Frame& frame);
+		void encodeY4m(Frame& frame);
+		// Writes the GIF frame held back until its duration was known
+		void flushGifFrame();
+
+		const VideoFormat format;
+		const int fps;
+		std::ofstream file;
+		int width = 0;
+		int height = 0;
+
+		// Shared with the worker
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<std::unique_ptr<Frame>> pending;
+		std::vector<std::unique_ptr<Frame>> spare;
+		bool isFinishing = false;
+		std::thread worker;
+
+		// Worker state
+		std::string error;
+		std::uint64_t frameCount = 0;
+		std::vector<raster::Pixel> previous;
+		// Encoded GIF frame waiting for its delay, and the frame number it started at
+		std::vector<std::uint8_t> gifFrame;
+		std::uint64_t gifFrameStart = 0;
+		std::vector<std::uint8_t> scratch;
+	};
+}
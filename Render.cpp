@@ -1,11 +1,29 @@
 #include "Render.h"
+#include "Capture.h"
+#include "RenderConfig.h"
+#include <exception>
+#ifdef ALGS4_RENDER_HEADLESS
+#include "Render_Headless.h"
+#else
 #include "Render_Impl.h"
+#endif
 
 Render::Render(const cwt::Pen& pen, int width, int height, const wchar_t* caption)
-    : pRender_impl(new Render_Impl(pen, width, height, caption)) {}
+    : pRender_impl(new Render_Impl(pen, width, height, caption)), canvasWidth(width), canvasHeight(height) {}
 
 Render::~Render()
 {
+    if (captureWriter)
+    {
+        // Nobody is left to hear about a failure
+        try
+        {
+            captureWriter->finish();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
     delete pRender_impl;
     pRender_impl = nullptr;
 }
@@ -37,59 +55,233 @@ bool Render::isWindowOpen()
 
 void Render::drawLine(double x1, double y1, double x2, double y2)
 {
+    if (captureWriter)
+    {
+        captureWriter->addLine(viewPen(), x1, y1, x2, y2);
+    }
     pRender_impl->drawLine(x1, y1, x2, y2);
 }
 
 void Render::drawElipse(double x, double y, double width, double height)
 {
+    if (captureWriter)
+    {
+        constexpr bool isFill = false;
+        captureWriter->addEllipse(viewPen(), x, y, width, height, isFill);
+    }
     pRender_impl->drawElipse(x, y, width, height);
 }
 
 void Render::fillElipse(double x, double y, double width, double height)
 {
+    if (captureWriter)
+    {
+        constexpr bool isFill = true;
+        captureWriter->addEllipse(viewPen(), x, y, width, height, isFill);
+    }
     pRender_impl->fillElipse(x, y, width, height);
 }
 
 void Render::drawArc(double x, double y, double width, double height, double start, double sweep)
 {
+    if (captureWriter)
+    {
+        captureWriter->addArc(viewPen(), x, y, width, height, start, sweep);
+    }
     pRender_impl->drawArc(x, y, width, height, start, sweep);
 }
 
 void Render::drawRectangle(double x, double y, double width, double height)
 {
+    if (captureWriter)
+    {
+        constexpr bool isFill = false;
+        captureWriter->addRectangle(viewPen(), x, y, width, height, isFill);
+    }
     pRender_impl->drawRectangle(x, y, width, height);
 }
 
 void Render::fillRectangle(double x, double y, double width, double height)
 {
+    if (captureWriter)
+    {
+        constexpr bool isFill = true;
+        captureWriter->addRectangle(viewPen(), x, y, width, height, isFill);
+    }
     pRender_impl->fillRectangle(x, y, width, height);
 }
 
-void Render::drawPolygon(const std::vector<double>& x, const std::vector<double>& y)
+void Render::drawPolygon(std::span<const double> points)
 {
-    pRender_impl->drawPolygon(x, y);
+    if (captureWriter)
+    {
+        constexpr bool isFill = false;
+        captureWriter->addPolygon(viewPen(), points.data(), points.size() / 2, isFill);
+    }
+    pRender_impl->drawPolygon(points);
 }
 
-void Render::fillPolygon(const std::vector<double>& x, const std::vector<double>& y)
+void Render::fillPolygon(std::span<const double> points)
 {
-    pRender_impl->fillPolygon(x, y);
+    if (captureWriter)
+    {
+        constexpr bool isFill = true;
+        captureWriter->addPolygon(viewPen(), points.data(), points.size() / 2, isFill);
+    }
+    pRender_impl->fillPolygon(points);
 }
 
-void Render::drawString(const wchar_t* text, double x, double y)
+void Render::drawString(std::wstring_view text, double x, double y)
 {
+    if (captureWriter)
+    {
+        captureWriter->addText(viewPen(), viewFont(), text.data(), text.size(), x, y);
+    }
     pRender_impl->drawString(text, x, y);
 }
 
+void Render::drawLines(std::span<const double> segments)
+{
+    if (captureWriter)
+    {
+        captureWriter->addLines(viewPen(), segments.data(), segments.size() / 4);
+    }
+    pRender_impl->drawLines(segments);
+}
+
+void Render::fillElipses(std::span<const double> boxes)
+{
+    if (captureWriter)
+    {
+        captureWriter->addFilledEllipses(viewPen(), boxes.data(), boxes.size() / 4);
+    }
+    pRender_impl->fillElipses(boxes);
+}
+
+void Render::fillRectangles(std::span<const double> boxes)
+{
+    if (captureWriter)
+    {
+        captureWriter->addFilledRectangles(viewPen(), boxes.data(), boxes.size() / 4);
+    }
+    pRender_impl->fillRectangles(boxes);
+}
+
 void Render::show()
 {
     pRender_impl->show();
 }
 
+void Render::clear(const cwt::ColorRgba& color)
+{
+    if (captureWriter)
+    {
+        captureWriter->clear(color);
+    }
+    pRender_impl->clear(color);
+}
+
+void Render::setDoubleBuffering(bool enabled)
+{
+    isDoubleBuffered = enabled;
+    if (captureWriter)
+    {
+        captureWriter->setDoubleBuffering(enabled);
+    }
+    pRender_impl->setDoubleBuffering(enabled);
+}
+
+void Render::present()
+{
+    if (captureWriter)
+    {
+        captureWriter->present();
+    }
+    pRender_impl->present();
+}
+
+void Render::finish()
+{
+    pRender_impl->finish();
+}
+
+void Render::save(const char* path)
+{
+    pRender_impl->save(path);
+}
+
+void Render::saveVector(const char* path, bool isCoalesced)
+{
+    pRender_impl->saveVector(path, isCoalesced);
+}
+
+void Render::startRecording(const char* path, int fps)
+{
+    pRender_impl->startRecording(path, fps);
+}
+
+void Render::stopRecording()
+{
+    pRender_impl->stopRecording();
+}
+
+void Render::startCapture(const char* path)
+{
+    stopCapture();
+    captureWriter = std::make_unique<capture::Writer>(path, canvasWidth, canvasHeight, isDoubleBuffered);
+}
+
+void Render::stopCapture()
+{
+    if (captureWriter)
+    {
+        // The capture is over even if it could not be finished
+        std::unique_ptr<capture::Writer> writer = std::move(captureWriter);
+        writer->finish();
+    }
+}
+
 void Render::setCanvasSize(int canvasWidth, int canvasHeight)
 {
+    this->canvasWidth = canvasWidth;
+    this->canvasHeight = canvasHeight;
+    if (captureWriter)
+    {
+        captureWriter->setCanvasSize(canvasWidth, canvasHeight);
+    }
     pRender_impl->setCanvasSize(canvasWidth, canvasHeight);
 }
 
+void Render::enableStats(bool enabled)
+{
+    pRender_impl->enableStats(enabled);
+}
+
+perf::RenderStats Render::stats()
+{
+    return pRender_impl->stats();
+}
+
+void Render::setStatsOverlay(bool visible)
+{
+    pRender_impl->setStatsOverlay(visible);
+}
+
+void Render::startStatsLog(const char* path, int everyFrames)
+{
+    pRender_impl->startStatsLog(path, everyFrames);
+}
+
+void Render::stopStatsLog()
+{
+    pRender_impl->stopStatsLog();
+}
+
+void Render::countCulled(size_t n)
+{
+    pRender_impl->countCulled(n);
+}
+
 void Render::GetTextExtent(const wchar_t* text, int len, int& w, int& h)
 {
     pRender_impl->GetTextExtent(text, len, w, h);
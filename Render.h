@@ -1,14 +1,24 @@
 #pragma once
+#include "RenderStats.h"
+#include <memory>
+#include <span>
+#include <string_view>
 #include <vector>
 
 class Render_Impl;
 
 namespace cwt
 {
+	struct ColorRgba;
 	struct Pen;
 	class Font;
 }
 
+namespace capture
+{
+	class Writer;
+}
+
 class Render final
 {
 public:
@@ -28,12 +38,67 @@ public:
 	void drawArc(double x, double y, double width, double height, double start, double sweep);
 	void drawRectangle(double x, double y, double width, double height);
 	void fillRectangle(double x, double y, double width, double height);
-	void drawPolygon(const std::vector<double>& x, const std::vector<double>& y);
-	void fillPolygon(const std::vector<double>& x, const std::vector<double>& y);
-	void drawString(const wchar_t* text, double x, double y);
+	// Two values per vertex, (x, y)
+	void drawPolygon(std::span<const double> points);
+	void fillPolygon(std::span<const double> points);
+	void drawString(std::wstring_view text, double x, double y);
+	// Batches: four values per primitive, (x1, y1, x2, y2) for lines and
+	// (x, y, width, height) for the others
+	void drawLines(std::span<const double> segments);
+	void fillElipses(std::span<const double> boxes);
+	void fillRectangles(std::span<const double> boxes);
 	void show();
+	// Erases the canvas to color
+	void clear(const cwt::ColorRgba& color);
+	// With double buffering on, drawing goes to an offscreen canvas that only
+	// reaches the screen on present()
+	void setDoubleBuffering(bool enabled);
+	void present();
+	// Blocks until everything drawn so far is rasterized
+	void finish();
+	// Saves the canvas on screen once everything drawn so far is on it; the
+	// format follows the extension of path. Throws std::runtime_error if the
+	// file cannot be written.
+	void save(const char* path);
+	// Writes everything drawn since the last clear to path as vector
+	// graphics, without rasterizing it; the format follows the extension of
+	// path. With isCoalesced, filled shapes no larger than a pixel become
+	// that pixel. Throws std::runtime_error if the file cannot be written.
+	void saveVector(const char* path, bool isCoalesced);
+	// Records every presented frame to path until stopRecording(); the format
+	// follows the extension of path. Both throw std::runtime_error if the
+	// file cannot be written.
+	void startRecording(const char* path, int fps);
+	void stopRecording();
+	// Writes every command drawn from now on, and the canvas it is drawn on,
+	// to a capture file at path until stopCapture(); see Capture.h. Both
+	// throw std::runtime_error if the file cannot be written.
+	void startCapture(const char* path);
+	void stopCapture();
 	void setCanvasSize(int canvasWidth, int canvasHeight);
 	void GetTextExtent(const wchar_t* text, int len, int& w, int& h);
+	// Instrumentation, off until enabled; see perf::RenderStats for what a
+	// frame is and what is measured
+	void enableStats(bool enabled);
+	perf::RenderStats stats();
+	// Shows the stats of the last frame in a corner of the window. The
+	// headless backend draws them on presented frames, so they end up in
+	// saved images and recordings.
+	void setStatsOverlay(bool visible);
+	// Writes the stats of every everyFrames-th frame to path, as CSV or JSON
+	// following its extension, until stopStatsLog(). Any other extension is
+	// an std::invalid_argument; both throw std::runtime_error if the file
+	// cannot be written.
+	void startStatsLog(const char* path, int everyFrames);
+	void stopStatsLog();
+	// n primitives were not drawn because they are off the canvas
+	void countCulled(size_t n);
 private:
 	Render_Impl* pRender_impl;
+	// Null unless capturing
+	std::unique_ptr<capture::Writer> captureWriter;
+	// What a capture starts with
+	int canvasWidth;
+	int canvasHeight;
+	bool isDoubleBuffered = false;
 };
@@ -0,0 +1,12 @@
+#pragma once
+
+// Render backend selection.
+//
+// The GDI+ backend (Render_Impl.h) opens a window and is only available on
+// Windows. The headless backend (Render_Headless.h) rasterizes everything into
+// an in-memory RGBA framebuffer and needs neither a window nor a message pump.
+// Define ALGS4_RENDER_HEADLESS to force it on Windows too; every other
+// platform always gets the headless backend.
+#if !defined(_WIN32) && !defined(ALGS4_RENDER_HEADLESS)
+#define ALGS4_RENDER_HEADLESS
+#endif
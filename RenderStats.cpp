@@ -0,0 +1,205 @@
+#include "RenderStats.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cwchar>
+#include <stdexcept>
+
+namespace
+{
+	bool hasSuffix(const std::string& path, const char* suffix)
+	{
+		const size_t length = std::char_traits<char>::length(suffix);
+		if (path.size() < length)
+		{
+			return false;
+		}
+		return std::equal(path.end() - length, path.end(), suffix,
+			[](char a, char b) { return std::tolower((unsigned char)a) == b; });
+	}
+}
+
+const char* perf::viewName(Primitive kind)
+{
+	switch (kind)
+	{
+	case Primitive::Line: return "line";
+	case Primitive::Ellipse: return "ellipse";
+	case Primitive::FilledEllipse: return "filled_ellipse";
+	case Primitive::Arc: return "arc";
+	case Primitive::Rectangle: return "rectangle";
+	case Primitive::FilledRectangle: return "filled_rectangle";
+	case Primitive::Polygon: return "polygon";
+	case Primitive::FilledPolygon: return "filled_polygon";
+	case Primitive::Text: return "text";
+	}
+	return "";
+}
+
+std::uint64_t perf::RenderStats::countPrimitives() const
+{
+	std::uint64_t total = 0;
+	for (std::uint64_t count : primitives)
+	{
+		total += count;
+	}
+	return total;
+}
+
+std::vector<std::wstring> perf::formatOverlay(const RenderStats& stats)
+{
+	wchar_t line[128];
+	std::vector<std::wstring> lines;
+	std::swprintf(line, std::size(line), L"frame %llu  raster %.2f ms (max %.2f)",
+		(unsigned long long)stats.frames, stats.rasterizeMs, stats.maxRasterizeMs);
+	lines.push_back(line);
+	std::swprintf(line, std::size(line), L"primitives %llu  culled %llu",
+		(unsigned long long)stats.countPrimitives(), (unsigned long long)stats.culled);
+	lines.push_back(line);
+	std::swprintf(line, std::size(line), L"list %.1f KB  queue %.1f KB",
+		stats.displayListBytes / 1024.0, stats.queueBytes / 1024.0);
+	lines.push_back(line);
+	std::swprintf(line, std::size(line), L"merged frames %llu", (unsigned long long)stats.mergedFrames);
+	lines.push_back(line);
+	return lines;
+}
+
+perf::StatsCollector::~StatsCollector()
+{
+	closeLog();
+}
+
+void perf::StatsCollector::enable(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (enabled && !isEnabled())
+	{
+		current = RenderStats{};
+		culledBefore = culled.load(std::memory_order_relaxed);
+	}
+	this->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+perf::RenderStats perf::StatsCollector::snapshot() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	RenderStats stats = current;
+	stats.culled = culled.load(std::memory_order_relaxed) - culledBefore;
+	return stats;
+}
+
+void perf::StatsCollector::startLog(const std::string& path, int everyFrames)
+{
+	const bool isCsv = hasSuffix(path, ".csv");
+	if (!isCsv && !hasSuffix(path, ".json"))
+	{
+		throw std::invalid_argument("unsupported stats file type: " + path);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!closeLog())
+	{
+		throw std::runtime_error("error while writing " + logPath);
+	}
+	log.open(path, std::ios::trunc);
+	if (!log)
+	{
+		throw std::runtime_error("cannot open " + path + " for writing");
+	}
+	logPath = path;
+	isJson = !isCsv;
+	this->everyFrames = (std::max)(everyFrames, 1);
+	entries = 0;
+
+	if (isJson)
+	{
+		log << "[";
+		return;
+	}
+	log << "frame,rasterize_ms,max_rasterize_ms";
+	for (size_t i = 0; i < PRIMITIVE_KINDS; i++)
+	{
+		log << ',' << viewName((Primitive)i);
+	}
+	log << ",culled,display_list_bytes,queue_bytes,merged_frames\n";
+}
+
+void perf::StatsCollector::stopLog()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::string path = logPath;
+	if (!closeLog())
+	{
+		throw std::runtime_error("error while writing " + path);
+	}
+}
+
+bool perf::StatsCollector::closeLog()
+{
+	if (!log.is_open())
+	{
+		return true;
+	}
+	if (isJson)
+	{
+		log << (entries > 0 ? "\n]\n" : "]\n");
+	}
+	log.close();
+	const bool isWritten = !log.fail();
+	log.clear();
+	logPath.clear();
+	return isWritten;
+}
+
+void perf::StatsCollector::endFrame(double rasterizeMs, const PrimitiveCounts& primitives,
+	size_t displayListBytes, size_t queueBytes, bool isMerged)
+{
+	const std::uint64_t culledNow = culled.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	current.frames++;
+	current.rasterizeMs = rasterizeMs;
+	current.maxRasterizeMs = (std::max)(current.maxRasterizeMs, rasterizeMs);
+	current.primitives = primitives;
+	current.culled = culledNow - culledBefore;
+	current.displayListBytes = displayListBytes;
+	current.queueBytes = queueBytes;
+	current.mergedFrames += isMerged ? 1 : 0;
+
+	if (log.is_open() && current.frames % everyFrames == 0)
+	{
+		writeEntry();
+	}
+}
+
+void perf::StatsCollector::writeEntry()
+{
+	char number[32];
+	std::snprintf(number, sizeof(number), "%.3f,%.3f", current.rasterizeMs, current.maxRasterizeMs);
+	if (!isJson)
+	{
+		log << current.frames << ',' << number;
+		for (std::uint64_t count : current.primitives)
+		{
+			log << ',' << count;
+		}
+		log << ',' << current.culled << ',' << current.displayListBytes << ',' << current.queueBytes
+			<< ',' << current.mergedFrames << '\n';
+	}
+	else
+	{
+		std::snprintf(number, sizeof(number), "%.3f", current.rasterizeMs);
+		log << (entries > 0 ? ",\n" : "\n") << "{\"frame\":" << current.frames << ",\"rasterize_ms\":" << number;
+		std::snprintf(number, sizeof(number), "%.3f", current.maxRasterizeMs);
+		log << ",\"max_rasterize_ms\":" << number << ",\"primitives\":{";
+		for (size_t i = 0; i < PRIMITIVE_KINDS; i++)
+		{
+			log << (i > 0 ? "," : "") << '"' << viewName((Primitive)i) << "\":" << current.primitives[i];
+		}
+		log << "},\"culled\":" << current.culled << ",\"display_list_bytes\":" << current.displayListBytes
+			<< ",\"queue_bytes\":" << current.queueBytes << ",\"merged_frames\":" << current.mergedFrames << '}';
+	}
+	// Readable while the program runs
+	log.flush();
+	entries++;
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "DisplayList.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace perf
+{
+	// Kinds of primitive counted, one per drawing member of a device
+	enum class Primitive : std::uint8_t
+	{
+		Line,
+		Ellipse,
+		FilledEllipse,
+		Arc,
+		Rectangle,
+		FilledRectangle,
+		Polygon,
+		FilledPolygon,
+		Text
+	};
+
+	constexpr size_t PRIMITIVE_KINDS = 9;
+
+	using PrimitiveCounts = std::array<std::uint64_t, PRIMITIVE_KINDS>;
+
+	// Name of a kind in logs, as snake case
+	const char* viewName(Primitive kind);
+
+	/**
+	 * What the render did for the last frame. A frame is one rasterization
+	 * pass: one per present() with double buffering, and otherwise one each
+	 * time the render thread catches up with the drawing.
+	 */
+	struct RenderStats
+	{
+		// Frames rasterized since stats were enabled
+		std::uint64_t frames = 0;
+		// Time spent rasterizing the last frame and the slowest one so far
+		double rasterizeMs = 0.0;
+		double maxRasterizeMs = 0.0;
+		// Primitives rasterized in the last frame, by Primitive; a batch
+		// counts each of its primitives and a dot counts as a filled rectangle
+		PrimitiveCounts primitives{};
+		// Primitives StdDraw skipped as off the canvas since stats were enabled
+		std::uint64_t culled = 0;
+		// Memory held by the display list, used or not
+		size_t displayListBytes = 0;
+		// Commands queued but not yet rasterized when the frame ended
+		size_t queueBytes = 0;
+		// Frames replaced before the window showed them, since stats were
+		// enabled. The headless backend has no window and never merges any.
+		std::uint64_t mergedFrames = 0;
+
+		std::uint64_t countPrimitives() const;
+	};
+
+	// Display list device that counts what is replayed into it
+	class PrimitiveCounter
+	{
+	public:
+		void line(geom::PenRef, float, float, float, float) { add(Primitive::Line); }
+		void ellipse(geom::PenRef, float, float, float, float, bool isFill)
+		{
+			add(isFill ? Primitive::FilledEllipse : Primitive::Ellipse);
+		}
+		void arc(geom::PenRef, float, float, float, float, float, float) { add(Primitive::Arc); }
+		void rectangle(geom::PenRef, float, float, float, float, bool isFill)
+		{
+			add(isFill ? Primitive::FilledRectangle : Primitive::Rectangle);
+		}
+		void polygon(geom::PenRef, const float*, size_t, bool isFill)
+		{
+			add(isFill ? Primitive::FilledPolygon : Primitive::Polygon);
+		}
+		// A polyline counts the lines merged into it
+		void polyline(geom::PenRef, const float*, size_t n) { add(Primitive::Line, n > 0 ? n - 1 : 0); }
+		void text(geom::PenRef, geom::FontRef, const wchar_t*, float, float) { add(Primitive::Text); }
+		void lines(geom::PenRef, const float*, size_t n) { add(Primitive::Line, n); }
+		void filledEllipses(geom::PenRef, const float*, size_t n) { add(Primitive::FilledEllipse, n); }
+		void filledRectangles(geom::PenRef, const float*, size_t n) { add(Primitive::FilledRectangle, n); }
+
+		const PrimitiveCounts& viewCounts() const { return counts; }
+	private:
+		void add(Primitive kind, size_t n = 1) { counts[(size_t)kind] += n; }
+
+		PrimitiveCounts counts{};
+	};
+
+	// Look of the stats overlay: lines of text on a dark box in the top-left
+	// corner of the canvas
+	constexpr size_t OVERLAY_FONT_SIZE = 12;
+	constexpr int OVERLAY_MARGIN = 4;
+	constexpr cwt::ColorRgba OVERLAY_BACKGROUND{ 0, 0, 0, 160 };
+	constexpr cwt::ColorRgba OVERLAY_TEXT{ 255, 255, 255, 255 };
+
+	// Lines of text the stats overlay shows
+	std::vector<std::wstring> formatOverlay(const RenderStats& stats);
+
+	/**
+	 * Stats shared between the drawing thread, which reads them, and the
+	 * render thread, which reports every frame. Nothing is measured until
+	 * enable() is called.
+	 *
+	 * A log gets one entry every few frames, as CSV rows or as the elements
+	 * of a JSON array, picked from the extension of its path.
+	 */
+	class StatsCollector
+	{
+	public:
+		StatsCollector() = default;
+		StatsCollector(const StatsCollector&) = delete;
+		StatsCollector& operator=(const StatsCollector&) = delete;
+		~StatsCollector();
+
+		// Enabling starts the counts over
+		void enable(bool enabled);
+		bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+		void setOverlay(bool visible) { overlay.store(visible, std::memory_order_relaxed); }
+		bool hasOverlay() const { return overlay.load(std::memory_order_relaxed); }
+
+		// Drawing thread: n primitives were skipped as off the canvas
+		void countCulled(size_t n)
+		{
+			culled.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		// Stats of the last frame
+		RenderStats snapshot() const;
+
+		// Throw std::invalid_argument if path is neither .csv nor .json and
+		// std::runtime_error if the file cannot be written
+		void startLog(const std::string& path, int everyFrames);
+		void stopLog();
+
+		// Render thread: reports a frame
+		void endFrame(double rasterizeMs, const PrimitiveCounts& primitives,
+			size_t displayListBytes, size_t queueBytes, bool isMerged);
+	private:
+		// Appends current to the log; the mutex is held
+		void writeEntry();
+		// Ends the log and closes it, returning false if writing failed
+		bool closeLog();
+
+		std::atomic<bool> enabled{ false };
+		std::atomic<bool> overlay{ false };
+		std::atomic<std::uint64_t> culled{ 0 };
+
+		mutable std::mutex mutex;
+		RenderStats current;
+		// culled when stats were enabled
+		std::uint64_t culledBefore = 0;
+
+		std::ofstream log;
+		std::string logPath;
+		bool isJson = false;
+		int everyFrames = 1;
+		std::uint64_t entries = 0;
+	};
+}
@@ -0,0 +1,369 @@
+#include "RenderConfig.h"
+
+#ifdef ALGS4_RENDER_HEADLESS
+#include "Render_Headless.h"
+#include "ImageWriter.h"
+#include "VectorWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+Render_Impl::~Render_Impl()
+{
+	queue.quit();
+	renderThread.join();
+}
+
+const raster::Framebuffer& Render_Impl::getFramebuffer()
+{
+	queue.waitFor(queue.fence());
+	return doubleBuffered ? screen : framebuffer;
+}
+
+bool Render_Impl::isWindowOpen()
+{
+	return false;
+}
+
+void Render_Impl::drawLine(double x1, double y1, double x2, double y2)
+{
+	queue.addLine(pen, x1, y1, x2, y2);
+}
+
+void Render_Impl::drawElipse(double x, double y, double width, double height)
+{
+	constexpr bool isFill = false;
+	queue.addEllipse(pen, x, y, width, height, isFill);
+}
+
+void Render_Impl::fillElipse(double x, double y, double width, double height)
+{
+	constexpr bool isFill = true;
+	queue.addEllipse(pen, x, y, width, height, isFill);
+}
+
+void Render_Impl::drawArc(double x, double y, double width, double height, double start, double sweep)
+{
+	queue.addArc(pen, x, y, width, height, start, sweep);
+}
+
+void Render_Impl::drawRectangle(double x, double y, double width, double height)
+{
+	constexpr bool isFill = false;
+	queue.addRectangle(pen, x, y, width, height, isFill);
+}
+
+void Render_Impl::fillRectangle(double x, double y, double width, double height)
+{
+	constexpr bool isFill = true;
+	queue.addRectangle(pen, x, y, width, height, isFill);
+}
+
+void Render_Impl::drawPolygon(std::span<const double> points)
+{
+	constexpr bool isFill = false;
+	queue.addPolygon(pen, points.data(), points.size() / 2, isFill);
+}
+
+void Render_Impl::fillPolygon(std::span<const double> points)
+{
+	constexpr bool isFill = true;
+	queue.addPolygon(pen, points.data(), points.size() / 2, isFill);
+}
+
+void Render_Impl::drawString(std::wstring_view text, double x, double y)
+{
+	queue.addText(pen, font, text.data(), text.size(), x, y);
+}
+
+void Render_Impl::drawLines(std::span<const double> segments)
+{
+	queue.addLines(pen, segments.data(), segments.size() / 4);
+}
+
+void Render_Impl::fillElipses(std::span<const double> boxes)
+{
+	queue.addFilledEllipses(pen, boxes.data(), boxes.size() / 4);
+}
+
+void Render_Impl::fillRectangles(std::span<const double> boxes)
+{
+	queue.addFilledRectangles(pen, boxes.data(), boxes.size() / 4);
+}
+
+void Render_Impl::show()
+{
+	// Nothing to present: the render thread rasterizes commands as they arrive
+}
+
+void Render_Impl::clear(const cwt::ColorRgba& color)
+{
+	queue.clear(color);
+}
+
+void Render_Impl::setDoubleBuffering(bool enabled)
+{
+	queue.setDoubleBuffering(enabled);
+}
+
+void Render_Impl::present()
+{
+	queue.present();
+}
+
+void Render_Impl::finish()
+{
+	queue.waitFor(queue.fence());
+}
+
+void Render_Impl::save(const char* path)
+{
+	queue.save(path);
+	waitForRequest();
+}
+
+void Render_Impl::saveVector(const char* path, bool isCoalesced)
+{
+	queue.saveVector(path, isCoalesced);
+	waitForRequest();
+}
+
+void Render_Impl::startRecording(const char* path, int fps)
+{
+	queue.startRecording(path, fps);
+	waitForRequest();
+}
+
+void Render_Impl::stopRecording()
+{
+	queue.stopRecording();
+	waitForRequest();
+}
+
+void Render_Impl::waitForRequest()
+{
+	queue.waitFor(queue.fence());
+	if (!requestError.empty())
+	{
+		std::string error;
+		error.swap(requestError);
+		throw std::runtime_error(error);
+	}
+}
+
+void Render_Impl::setCanvasSize(int canvasWidth, int canvasHeight)
+{
+	queue.setCanvasSize(canvasWidth, canvasHeight);
+}
+
+void Render_Impl::GetTextExtent(const wchar_t* text, int len, int& w, int& h)
+{
+	metrics.measure(font, text, (size_t)len, w, h);
+}
+
+void Render_Impl::run()
+{
+	displayList.setCanvasSize(framebuffer.viewWidth(), framebuffer.viewHeight());
+	for (;;)
+	{
+		const geom::Control control = queue.drain(displayList);
+		switch (control.kind)
+		{
+		case geom::Control::Kind::None:
+			// A double buffered frame is rasterized once, when it is presented
+			if (!doubleBuffered)
+			{
+				flush(true);
+			}
+			queue.waitForCommands();
+			break;
+		case geom::Control::Kind::Canvas:
+			// Everything is redrawn on the resized canvas
+			framebuffer.resize(control.width, control.height, clearColor);
+			displayList.setCanvasSize(control.width, control.height);
+			drawnCount = 0;
+			break;
+		case geom::Control::Kind::Clear:
+			// What was drawn before is gone for good
+			clearColor = control.color;
+			displayList.clear();
+			drawnCount = 0;
+			framebuffer.clear(clearColor);
+			break;
+		case geom::Control::Kind::Present:
+			flush();
+			if (doubleBuffered)
+			{
+				screen = framebuffer;
+				if (collector.hasOverlay())
+				{
+					drawOverlay(screen);
+				}
+			}
+			if (recorder)
+			{
+				const raster::Framebuffer& fb = doubleBuffered ? screen : framebuffer;
+				recorder->addFrame(fb.viewWidth(), fb.viewHeight(), [&fb](int y) { return fb.viewRow(y); });
+			}
+			break;
+		case geom::Control::Kind::Buffering:
+			// The screen starts out showing the canvas as it is
+			flush();
+			screen = framebuffer;
+			doubleBuffered = control.enabled;
+			break;
+		case geom::Control::Kind::Save:
+			if (!doubleBuffered)
+			{
+				flush();
+			}
+			saveScreen(control.path);
+			break;
+		case geom::Control::Kind::Export:
+			saveDisplayList(control);
+			break;
+		case geom::Control::Kind::Record:
+			record(control);
+			break;
+		case geom::Control::Kind::Fence:
+			if (!doubleBuffered)
+			{
+				flush();
+			}
+			queue.complete(control.epoch);
+			break;
+		case geom::Control::Kind::Quit:
+			flush();
+			recorder.reset();
+			queue.detach();
+			return;
+		}
+	}
+}
+
+void Render_Impl::saveScreen(const char* path)
+{
+	image::Format format;
+	if (!image::findFormat(path, format))
+	{
+		requestError = std::string("unsupported image file type: ") + path;
+		return;
+	}
+
+	const raster::Framebuffer& fb = doubleBuffered ? screen : framebuffer;
+	try
+	{
+		image::write(path, format, fb.viewWidth(), fb.viewHeight(), [&fb](int y) { return fb.viewRow(y); });
+	}
+	catch (const std::exception& e)
+	{
+		requestError = e.what();
+	}
+}
+
+void Render_Impl::saveDisplayList(const geom::Control& control)
+{
+	image::VectorFormat format;
+	if (!image::findVectorFormat(control.path, format))
+	{
+		requestError = std::string("unsupported vector file type: ") + control.path;
+		return;
+	}
+	try
+	{
+		image::writeVector(control.path, format, framebuffer.viewWidth(), framebuffer.viewHeight(), clearColor,
+			displayList, glyphs, control.enabled);
+	}
+	catch (const std::exception& e)
+	{
+		requestError = e.what();
+	}
+}
+
+void Render_Impl::record(const geom::Control& control)
+{
+	if (recorder)
+	{
+		requestError = recorder->finish();
+		recorder.reset();
+	}
+	if (!control.enabled || !requestError.empty())
+	{
+		return;
+	}
+
+	image::VideoFormat format;
+	if (!image::findVideoFormat(control.path, format))
+	{
+		requestError = std::string("unsupported video file type: ") + control.path;
+		return;
+	}
+	try
+	{
+		recorder = std::make_unique<image::Recorder>(control.path, format, control.fps);
+	}
+	catch (const std::exception& e)
+	{
+		requestError = e.what();
+	}
+}
+
+void Render_Impl::flush(bool isIdle)
+{
+	if (!isIdle)
+	{
+		displayList.endPath();
+	}
+	if (!displayList.hasNew(drawnCount))
+	{
+		return;
+	}
+	if (!collector.isEnabled())
+	{
+		tiles.render(framebuffer, displayList, drawnCount, glyphs);
+		return;
+	}
+
+	perf::PrimitiveCounter counter;
+	displayList.replay(counter, drawnCount, displayList.settledSize());
+	const auto start = std::chrono::steady_clock::now();
+	tiles.render(framebuffer, displayList, drawnCount, glyphs);
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	// There is no window, so no frame is ever replaced before it is shown
+	constexpr bool isMerged = false;
+	collector.endFrame(elapsed.count(), counter.viewCounts(), displayList.viewBytes(), queue.viewPendingBytes(), isMerged);
+}
+
+void Render_Impl::drawOverlay(raster::Surface& fb)
+{
+	const cwt::Font overlayFont(L"SansSerif", cwt::Font::Style::FontStyleRegular, perf::OVERLAY_FONT_SIZE);
+	const std::vector<std::wstring> lines = perf::formatOverlay(collector.snapshot());
+
+	int boxWidth = 0;
+	int lineHeight = 0;
+	for (const std::wstring& line : lines)
+	{
+		int w, h;
+		glyphs.measure(overlayFont, line.c_str(), line.size(), w, h);
+		boxWidth = std::max(boxWidth, w);
+		lineHeight = std::max(lineHeight, h);
+	}
+	const int boxHeight = lineHeight * (int)lines.size();
+	raster::fillRectangle(fb, perf::OVERLAY_BACKGROUND, 0, 0, boxWidth + 2 * perf::OVERLAY_MARGIN, boxHeight + 2 * perf::OVERLAY_MARGIN);
+
+	const cwt::ColorRgba color = perf::OVERLAY_TEXT;
+	auto blit = [&fb, color](int gx, int gy, const std::uint8_t* coverage, size_t stride, int width, int height)
+	{
+		for (int row = 0; row < height; row++)
+		{
+			fb.blendMask(gy + row, gx, coverage + row * stride, width, color);
+		}
+	};
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		glyphs.draw(overlayFont, lines[i].c_str(), perf::OVERLAY_MARGIN, perf::OVERLAY_MARGIN + (int)i * lineHeight, blit);
+	}
+}
+
+#endif // ALGS4_RENDER_HEADLESS
@@ -0,0 +1,128 @@
+#pragma once
+#include "RenderConfig.h"
+#include "CommandQueue.h"
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "Recorder.h"
+#include "RenderStats.h"
+#include "Raster.h"
+#include "TileRenderer.h"
+#include "cwt.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Headless implementation of the render: primitives are queued to a render
+// thread that records them into the display list and rasterizes them into an
+// in-memory RGBA framebuffer. There is no window and no message pump, so show()
+// returns as soon as it is called.
+class Render_Impl final
+{
+public:
+	Render_Impl(const cwt::Pen& pen, int width, int height, const wchar_t* caption)
+		:
+		pen(pen),
+		windowCaption(caption),
+		framebuffer(width, height, clearColor),
+		screen(width, height, clearColor),
+		renderThread(&Render_Impl::run, this)
+	{}
+	~Render_Impl();
+
+	const cwt::Pen& viewPen() const { return pen; }
+	cwt::Pen& getPen() { return pen; }
+	const cwt::Font& viewFont() const { return font; }
+	cwt::Font& getFont() { return font; }
+	// Waits until everything drawn so far is rasterized and returns the
+	// canvas, which stays valid until the next drawing call. With double
+	// buffering on, that is the frame last presented.
+	const raster::Framebuffer& getFramebuffer();
+
+	bool isWindowOpen();
+	void drawLine(double x1, double y1, double x2, double y2);
+	void drawElipse(double x, double y, double width, double height);
+	void fillElipse(double x, double y, double width, double height);
+	void drawArc(double x, double y, double width, double height, double start, double sweep);
+	void drawRectangle(double x, double y, double width, double height);
+	void fillRectangle(double x, double y, double width, double height);
+	void drawPolygon(std::span<const double> points);
+	void fillPolygon(std::span<const double> points);
+	void drawString(std::wstring_view text, double x, double y);
+	void drawLines(std::span<const double> segments);
+	void fillElipses(std::span<const double> boxes);
+	void fillRectangles(std::span<const double> boxes);
+	void show();
+	void clear(const cwt::ColorRgba& color);
+	void setDoubleBuffering(bool enabled);
+	void present();
+	void finish();
+	void save(const char* path);
+	void saveVector(const char* path, bool isCoalesced);
+	void startRecording(const char* path, int fps);
+	void stopRecording();
+	void setCanvasSize(int canvasWidth, int canvasHeight);
+	void GetTextExtent(const wchar_t* text, int len, int& w, int& h);
+	void enableStats(bool enabled) { collector.enable(enabled); }
+	perf::RenderStats stats() { return collector.snapshot(); }
+	void setStatsOverlay(bool visible) { collector.setOverlay(visible); }
+	void startStatsLog(const char* path, int everyFrames) { collector.startLog(path, everyFrames); }
+	void stopStatsLog() { collector.stopLog(); }
+	void countCulled(size_t n) { collector.countCulled(n); }
+private:
+	// Render thread: drains the queue and rasterizes until told to quit
+	void run();
+	// Rasterizes the commands added since the last flush. An idle flush, when
+	// the queue runs dry, leaves the open path for a later one, so that how
+	// often the thread idles does not change what is drawn
+	void flush(bool isIdle = false);
+	// Waits until the render thread has handled every request queued so far
+	// and throws std::runtime_error if one of them failed
+	void waitForRequest();
+	// Writes the canvas on screen to path, noting failures in requestError
+	void saveScreen(const char* path);
+	// Writes the display list to control.path as vector graphics, noting
+	// failures in requestError
+	void saveDisplayList(const geom::Control& control);
+	// Starts or stops the recorder as control asks, noting failures in requestError
+	void record(const geom::Control& control);
+	// Draws the stats overlay over fb
+	void drawOverlay(raster::Surface& fb);
+
+	// Owned by the drawing thread
+	// current pen
+	cwt::Pen pen;
+	// Font
+	cwt::Font font;
+	// Advances of the fonts measured by GetTextExtent()
+	text::GlyphAtlas metrics;
+
+	const wchar_t* windowCaption;
+
+	geom::CommandQueue queue;
+	// Why the last save or recording request failed, set by the render thread
+	// before it completes the fence the drawing thread waits on
+	std::string requestError;
+	// Filled by the render thread, read by the drawing thread
+	perf::StatsCollector collector;
+
+	// Owned by the render thread
+	std::unique_ptr<image::Recorder> recorder;
+	geom::DisplayList displayList;
+	// Glyphs of the text drawn so far
+	text::GlyphAtlas glyphs;
+	// Rasterizes the display list on every core
+	raster::TileRenderer tiles;
+	// Number of displayList commands already rasterized into framebuffer
+	size_t drawnCount = 0;
+	cwt::ColorRgba clearColor = cwt::getRgba(cwt::Color::DEFAULT_CLEAR_COLOR);
+	// Canvas being drawn
+	raster::Framebuffer framebuffer;
+	// Frame last presented, only used with double buffering
+	raster::Framebuffer screen;
+	bool doubleBuffered = false;
+
+	std::thread renderThread;
+};
@@ -1,4 +1,350 @@
+#include "RenderConfig.h"
+
+#ifndef ALGS4_RENDER_HEADLESS
 #include "Render_Impl.h"
+#include "ImageWriter.h"
+#include "VectorWriter.h"
+#include "Simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cwchar>
+#include <stdexcept>
+
+namespace
+{
+	static_assert(sizeof(Gdiplus::PointF) == 2 * sizeof(float), 
+		"Display list vertices are handed to GDI+ as PointF arrays");
+	static_assert(sizeof(Gdiplus::RectF) == 4 * sizeof(float), 
+		"Display list boxes are handed to GDI+ as RectF arrays");
+
+	// Hands the rows of a bitmap, converted to straight RGBA, to use(width,
+	// height, row). Returns false if the bitmap could not be locked.
+	template <class Use>
+	bool readBack(Gdiplus::Bitmap* pBitmap, Use use)
+	{
+		const INT bitmapWidth = (INT)pBitmap->GetWidth();
+		const INT bitmapHeight = (INT)pBitmap->GetHeight();
+		// Locking in the format the bitmap already has maps its memory directly
+		Gdiplus::Rect rect(0, 0, bitmapWidth, bitmapHeight);
+		Gdiplus::BitmapData data;
+		if (pBitmap->LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppPARGB, &data) != Gdiplus::Ok)
+		{
+			return false;
+		}
+
+		std::vector<raster::Pixel> pixels(bitmapWidth);
+		auto row = [&](int y)
+		{
+			const BYTE* bgra = static_cast<const BYTE*>(data.Scan0) + (ptrdiff_t)y * data.Stride;
+			for (INT x = 0; x < bitmapWidth; x++)
+			{
+				const BYTE* p = bgra + 4 * x;
+				const int a = p[3];
+				if (a == 255 || a == 0)
+				{
+					pixels[x] = raster::Pixel{ p[2], p[1], p[0], (std::uint8_t)a };
+				}
+				else
+				{
+					// Undo the premultiplication
+					pixels[x] = raster::Pixel{
+						(std::uint8_t)((p[2] * 255 + a / 2) / a),
+						(std::uint8_t)((p[1] * 255 + a / 2) / a),
+						(std::uint8_t)((p[0] * 255 + a / 2) / a),
+						(std::uint8_t)a };
+				}
+			}
+			return (const raster::Pixel*)pixels.data();
+		};
+		use((int)bitmapWidth, (int)bitmapHeight, image::RowSource(row));
+
+		pBitmap->UnlockBits(&data);
+		return true;
+	}
+
+	// Replays display list commands into a GDI+ surface and keeps track of the
+	// area they cover
+	class GdiDevice
+	{
+	public:
+		GdiDevice(Gdiplus::Bitmap* pBitmap, Gdiplus::Graphics* pGraphics, GdiResources& resources,
+			text::GlyphAtlas& glyphs, raster::ScanlineFiller& polygons, raster::Stroker& strokes)
+			: pBitmap(pBitmap), pGraphics(pGraphics), resources(resources), glyphs(glyphs), polygons(polygons),
+			strokes(strokes) {}
+
+		bool isDirty() const { return hasDirty; }
+		const Gdiplus::RectF& viewDirty() const { return dirty; }
+
+		void line(geom::PenRef pen, float x1, float y1, float x2, float y2)
+		{
+			const float xy[4] = { x1, y1, x2, y2 };
+			stroke(pen, xy, 2, false);
+		}
+
+		void ellipse(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				pGraphics->FillEllipse(resources.getBrush(pen), x, y, width, height);
+			}
+			else
+			{
+				arc(pen, x, y, width, height, 0.0f, 360.0f);
+				return;
+			}
+			grow(*pen, x, y, width, height);
+		}
+
+		void arc(geom::PenRef pen, float x, float y, float width, float height, float start, float sweep)
+		{
+			const float left = (std::min)(x, x + width);
+			const float top = (std::min)(y, y + height);
+			grow(*pen, left, top, std::abs(width), std::abs(height));
+			const double penWidth = resources.viewPenWidth(*pen);
+			blendSpans(*pen, left, top, left + std::abs(width), top + std::abs(height),
+				[&](const Gdiplus::Rect& area, const raster::SpanSink& sink)
+				{
+					strokes.arc(x, y, width, height, start, sweep, penWidth,
+						area.X, area.Y, area.GetRight(), area.GetBottom(), sink);
+				});
+		}
+
+		void rectangle(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				pGraphics->FillRectangle(resources.getBrush(pen), x, y, width, height);
+			}
+			else
+			{
+				pGraphics->DrawRectangle(resources.getPen(pen), x, y, width, height);
+			}
+			grow(*pen, x, y, width, height);
+		}
+
+		void polygon(geom::PenRef pen, const float* xy, size_t n, bool isFill)
+		{
+			if (n == 0)
+			{
+				return;
+			}
+			if (!isFill)
+			{
+				stroke(pen, xy, n, true);
+				return;
+			}
+			float left, top, right, bottom;
+			findBounds(xy, n, left, top, right, bottom);
+			grow(*pen, left, top, right - left, bottom - top);
+
+			// Filled by our own anti-aliasing filler rather than GDI+
+			blendSpans(*pen, left, top, right, bottom,
+				[&](const Gdiplus::Rect&, const raster::SpanSink& sink)
+				{
+					polygons.fill((int)pBitmap->GetWidth(), (int)pBitmap->GetHeight(), xy, n, sink);
+				});
+		}
+
+		void polyline(geom::PenRef pen, const float* xy, size_t n)
+		{
+			if (n > 0)
+			{
+				stroke(pen, xy, n, false);
+			}
+		}
+
+		void text(geom::PenRef pen, geom::FontRef font, const wchar_t* text, float x, float y)
+		{
+			const int left = (int)std::lround(x);
+			const int top = (int)std::lround(y);
+			int width = 0;
+			int height = 0;
+			glyphs.measure(*font, text, std::wcslen(text), width, height);
+
+			// Glyphs may overhang their advances, by up to about half a line
+			const int slack = height / 2 + 1;
+			Gdiplus::Rect area(left - slack, top - slack, width + 2 * slack, height + 2 * slack);
+			Gdiplus::BitmapData data;
+			if (!lock(area, data))
+			{
+				return;
+			}
+			const std::uint32_t color = packBgra(pen->color);
+			glyphs.draw(*font, text, left, top,
+				[&](int gx, int gy, const std::uint8_t* coverage, size_t stride, int glyphWidth, int glyphHeight)
+				{
+					const int x0 = (std::max)(gx, area.X);
+					const int x1 = (std::min)(gx + glyphWidth, area.GetRight());
+					const int y0 = (std::max)(gy, area.Y);
+					const int y1 = (std::min)(gy + glyphHeight, area.GetBottom());
+					if (x0 >= x1)
+					{
+						return;
+					}
+					for (int py = y0; py < y1; py++)
+					{
+						const std::uint8_t* src = coverage + (size_t)(py - gy) * stride;
+						BYTE* row = static_cast<BYTE*>(data.Scan0) + (ptrdiff_t)(py - area.Y) * data.Stride;
+						simd::blendMask(row + 4 * (x0 - area.X), src + (x0 - gx), (size_t)(x1 - x0), color);
+					}
+				});
+			pBitmap->UnlockBits(&data);
+			grow(*pen, (Gdiplus::REAL)area.X, (Gdiplus::REAL)area.Y, (Gdiplus::REAL)area.Width, (Gdiplus::REAL)area.Height);
+		}
+
+		void lines(geom::PenRef pen, const float* segments, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				stroke(pen, segments + 4 * i, 2, false);
+			}
+		}
+
+		void filledEllipses(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			Gdiplus::Brush* pBrush = resources.getBrush(pen);
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* b = boxes + 4 * i;
+				pGraphics->FillEllipse(pBrush, b[0], b[1], b[2], b[3]);
+				grow(*pen, b[0], b[1], b[2], b[3]);
+			}
+		}
+
+		void filledRectangles(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			if (n == 0)
+			{
+				return;
+			}
+			// Boxes are laid out exactly like RectF, so GDI+ takes them as they are
+			const Gdiplus::RectF* rects = reinterpret_cast<const Gdiplus::RectF*>(boxes);
+			pGraphics->FillRectangles(resources.getBrush(pen), rects, (INT)n);
+			for (size_t i = 0; i < n; i++)
+			{
+				grow(*pen, rects[i].X, rects[i].Y, rects[i].Width, rects[i].Height);
+			}
+		}
+
+	private:
+		// Box of the n vertices of xy
+		static void findBounds(const float* xy, size_t n, float& left, float& top, float& right, float& bottom)
+		{
+			left = xy[0];
+			top = xy[1];
+			right = xy[0];
+			bottom = xy[1];
+			for (size_t i = 1; i < n; i++)
+			{
+				left = (std::min)(left, xy[2 * i]);
+				top = (std::min)(top, xy[2 * i + 1]);
+				right = (std::max)(right, xy[2 * i]);
+				bottom = (std::max)(bottom, xy[2 * i + 1]);
+			}
+		}
+
+		// Strokes the path through the n vertices of xy with our own stroker,
+		// which GDI+ pens cannot match: round joins, and every pixel blended once
+		void stroke(geom::PenRef pen, const float* xy, size_t n, bool isClosed)
+		{
+			float left, top, right, bottom;
+			findBounds(xy, n, left, top, right, bottom);
+			grow(*pen, left, top, right - left, bottom - top);
+			const double penWidth = resources.viewPenWidth(*pen);
+			blendSpans(*pen, left, top, right, bottom,
+				[&](const Gdiplus::Rect& area, const raster::SpanSink& sink)
+				{
+					strokes.polyline(xy, n, isClosed, penWidth, area.X, area.Y, area.GetRight(), area.GetBottom(), sink);
+				});
+		}
+
+		// Locks the area of the bitmap the box (left, top)-(right, bottom)
+		// grown by the pen covers, and blends into it, in the color of pen,
+		// the coverage spans fill(area, sink) hands to sink. The box is
+		// clamped first, so that far off vertices cannot overflow an INT.
+		template <class Fill>
+		void blendSpans(const cwt::Pen& pen, float left, float top, float right, float bottom, Fill fill)
+		{
+			const float pad = (std::max)(resources.viewPenWidth(pen), 1.0f) / 2 + 1;
+			const float bitmapWidth = (float)pBitmap->GetWidth();
+			const float bitmapHeight = (float)pBitmap->GetHeight();
+			const INT x0 = (INT)std::floor(std::clamp(left - pad, -1.0f, bitmapWidth));
+			const INT y0 = (INT)std::floor(std::clamp(top - pad, -1.0f, bitmapHeight));
+			const INT x1 = (INT)std::ceil(std::clamp(right + pad, -1.0f, bitmapWidth));
+			const INT y1 = (INT)std::ceil(std::clamp(bottom + pad, -1.0f, bitmapHeight));
+			Gdiplus::Rect area(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+			Gdiplus::BitmapData data;
+			if (!lock(area, data))
+			{
+				return;
+			}
+			const std::uint32_t color = packBgra(pen.color);
+			fill(area, [&](int y, int x, const std::uint8_t* coverage, int count)
+				{
+					if (y < area.Y || y >= area.GetBottom())
+					{
+						return;
+					}
+					BYTE* row = static_cast<BYTE*>(data.Scan0) + (ptrdiff_t)(y - area.Y) * data.Stride;
+					const int from = (std::max)(x, area.X);
+					const int to = (std::min)(x + count, area.GetRight());
+					if (from < to)
+					{
+						simd::blendMask(row + 4 * (from - area.X), coverage + (from - x), (size_t)(to - from), color);
+					}
+				});
+			pBitmap->UnlockBits(&data);
+		}
+
+		// Clips area to the bitmap and locks it for blending into. Whatever
+		// GDI+ still has pending for the bitmap lands first.
+		bool lock(Gdiplus::Rect& area, Gdiplus::BitmapData& data)
+		{
+			Gdiplus::Rect::Intersect(area, area,
+				Gdiplus::Rect(0, 0, (INT)pBitmap->GetWidth(), (INT)pBitmap->GetHeight()));
+			if (area.IsEmptyArea())
+			{
+				return false;
+			}
+			pGraphics->Flush(Gdiplus::FlushIntentionSync);
+			return pBitmap->LockBits(&area, Gdiplus::ImageLockModeRead | Gdiplus::ImageLockModeWrite,
+				PixelFormat32bppPARGB, &data) == Gdiplus::Ok;
+		}
+
+		// color packed for simd::blendMask() over premultiplied BGRA pixels
+		static std::uint32_t packBgra(cwt::ColorRgba color)
+		{
+			return cwt::ColorRgba{ color.b, color.g, color.r, color.a }.pack();
+		}
+
+		// Adds the box (x, y, width, height), grown by half the pen plus one
+		// pixel of slack, to the dirty area
+		void grow(const cwt::Pen& pen, float x, float y, float width, float height)
+		{
+			Gdiplus::REAL slack = resources.viewPenWidth(pen) / 2 + 1;
+			Gdiplus::RectF box(x - slack, y - slack, width + 2 * slack, height + 2 * slack);
+			if (hasDirty)
+			{
+				Gdiplus::RectF::Union(dirty, dirty, box);
+			}
+			else
+			{
+				dirty = box;
+				hasDirty = true;
+			}
+		}
+
+		Gdiplus::Bitmap* pBitmap;
+		Gdiplus::Graphics* pGraphics;
+		GdiResources& resources;
+		text::GlyphAtlas& glyphs;
+		raster::ScanlineFiller& polygons;
+		raster::Stroker& strokes;
+		Gdiplus::RectF dirty;
+		bool hasDirty = false;
+	};
+}
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message,
 	WPARAM wParam, LPARAM lParam)
@@ -6,7 +352,26 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message,
 
 	switch (message)
 	{
+	case WM_ERASEBKGND:
+		// paint() covers the whole dirty area, erasing first would only flicker
+		return 1;
+	case WM_PAINT:
+	{
+		PAINTSTRUCT ps;
+		HDC hdc = BeginPaint(hWnd, &ps);
+		Render_Impl* pRender = reinterpret_cast<Render_Impl*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+		if (pRender)
+		{
+			pRender->paint(hdc, ps.rcPaint);
+		}
+		EndPaint(hWnd, &ps);
+		return 0;
+	}
+	case WM_TIMER:
+		// Only here to wake the message loop up, see Render_Impl::show
+		return 0;
 	case WM_DESTROY:
+		KillTimer(hWnd, FLUSH_TIMER_ID);
 		PostQuitMessage(0);
 		return 0;
 	default:
@@ -19,6 +384,11 @@ Render_Impl::~Render_Impl()
 {
 	delete pGraphics;
 	pGraphics = nullptr;
+	delete pBackBuffer;
+	pBackBuffer = nullptr;
+	delete pFrontBuffer;
+	pFrontBuffer = nullptr;
+	resources.release();
 
 	// EndPaint(hWnd, &ps);
 	Gdiplus::GdiplusShutdown(gdiplusToken);
@@ -31,53 +401,68 @@ bool Render_Impl::isWindowOpen()
 
 void Render_Impl::drawLine(double x1, double y1, double x2, double y2)
 {
-	objects2D.emplace_back(std::make_unique<geom::Line>(pen, x1, y1, x2, y2));
+	queue.addLine(pen, x1, y1, x2, y2);
 }
 
 void Render_Impl::drawElipse(double x, double y, double width, double height)
 {
-	constexpr double isFill = false;
-	objects2D.emplace_back(std::make_unique<geom::Circle>(pen, x, y, width, height, isFill));
+	constexpr bool isFill = false;
+	queue.addEllipse(pen, x, y, width, height, isFill);
 }
 
 void Render_Impl::fillElipse(double x, double y, double width, double height)
 {
-	constexpr double isFill = true;
-	objects2D.emplace_back(std::make_unique<geom::Circle>(pen, x, y, width, height, isFill));
+	constexpr bool isFill = true;
+	queue.addEllipse(pen, x, y, width, height, isFill);
 }
 
 void Render_Impl::drawArc(double x, double y, double width, double height, double start, double sweep)
 {
-	objects2D.emplace_back(std::make_unique<geom::Arc>(pen, x, y, width, height, start, sweep));
+	queue.addArc(pen, x, y, width, height, start, sweep);
 }
 
 void Render_Impl::drawRectangle(double x, double y, double width, double height)
 {
-	constexpr double isFill = false;
-	objects2D.emplace_back(std::make_unique<geom::Rectangle>(pen, x, y, width, height, isFill));
+	constexpr bool isFill = false;
+	queue.addRectangle(pen, x, y, width, height, isFill);
 }
 
 void Render_Impl::fillRectangle(double x, double y, double width, double height)
 {
-	constexpr double isFill = true;
-	objects2D.emplace_back(std::make_unique<geom::Rectangle>(pen, x, y, width, height, isFill));
+	constexpr bool isFill = true;
+	queue.addRectangle(pen, x, y, width, height, isFill);
+}
+
+void Render_Impl::drawPolygon(std::span<const double> points)
+{
+	constexpr bool isFill = false;
+	queue.addPolygon(pen, points.data(), points.size() / 2, isFill);
 }
 
-void Render_Impl::drawPolygon(const std::vector<double>& x, const std::vector<double>& y)
+void Render_Impl::fillPolygon(std::span<const double> points)
 {
-	constexpr double isFill = false;
-	objects2D.emplace_back(std::make_unique<geom::Polygon>(pen, x, y, isFill));
+	constexpr bool isFill = true;
+	queue.addPolygon(pen, points.data(), points.size() / 2, isFill);
 }
 
-void Render_Impl::fillPolygon(const std::vector<double>& x, const std::vector<double>& y)
+void Render_Impl::drawString(std::wstring_view text, double x, double y)
 {
-	constexpr double isFill = true;
-	objects2D.emplace_back(std::make_unique<geom::Polygon>(pen, x, y, isFill));
+	queue.addText(pen, font, text.data(), text.size(), x, y);
 }
 
-void Render_Impl::drawString(const wchar_t* text, double x, double y)
+void Render_Impl::drawLines(std::span<const double> segments)
 {
-	objects2D.emplace_back(std::make_unique<geom::Text>(pen, font, text, x, y));
+	queue.addLines(pen, segments.data(), segments.size() / 4);
+}
+
+void Render_Impl::fillElipses(std::span<const double> boxes)
+{
+	queue.addFilledEllipses(pen, boxes.data(), boxes.size() / 4);
+}
+
+void Render_Impl::fillRectangles(std::span<const double> boxes)
+{
+	queue.addFilledRectangles(pen, boxes.data(), boxes.size() / 4);
 }
 
 void Render_Impl::show()
@@ -87,42 +472,404 @@ void Render_Impl::show()
 		init();
 	}
 
+	// Every message only costs the objects added since the previous one; the
+	// rest of the canvas is kept in the back buffer and repainted from there.
+	// A double buffered frame is only rasterized when it is presented.
 	while (isWindowOpen())
 	{
 		this->preDraw();
-		
-		for (const std::unique_ptr<geom::Object2D>& obj : objects2D)
+		this->drain();
+		if (!doubleBuffered)
 		{
-			obj->Draw(pGraphics);
+			this->flush(true);
 		}
-
 		this->posDraw();
 	}
+
+	// Nothing will be rendered anymore, do not keep anyone waiting for it
+	recorder.reset();
+	queue.detach();
+}
+
+void Render_Impl::clear(const cwt::ColorRgba& color)
+{
+	queue.clear(color);
+}
+
+void Render_Impl::setDoubleBuffering(bool enabled)
+{
+	queue.setDoubleBuffering(enabled);
+}
+
+void Render_Impl::present()
+{
+	queue.present();
+}
+
+void Render_Impl::finish()
+{
+	queue.waitFor(queue.fence());
+}
+
+void Render_Impl::save(const char* path)
+{
+	queue.save(path);
+	waitForRequest();
+}
+
+void Render_Impl::saveVector(const char* path, bool isCoalesced)
+{
+	queue.saveVector(path, isCoalesced);
+	waitForRequest();
+}
+
+void Render_Impl::startRecording(const char* path, int fps)
+{
+	queue.startRecording(path, fps);
+	waitForRequest();
+}
+
+void Render_Impl::stopRecording()
+{
+	queue.stopRecording();
+	waitForRequest();
+}
+
+void Render_Impl::waitForRequest()
+{
+	queue.waitFor(queue.fence());
+	if (!requestError.empty())
+	{
+		std::string error;
+		error.swap(requestError);
+		throw std::runtime_error(error);
+	}
 }
 
 void Render_Impl::setCanvasSize(int canvasWidth, int canvasHeight)
 {
-	width = canvasWidth;
-	height = canvasHeight;
+	queue.setCanvasSize(canvasWidth, canvasHeight);
 }
 
 void Render_Impl::GetTextExtent(const wchar_t* text, int len, int& w, int& h)
 {
-	HDC hdc = GetDC(hWnd);
-	SIZE size;
-	GetTextExtentPoint32W(hdc, text, len, &size);
-	w = size.cx;
-	h = size.cy;
+	metrics.measure(font, text, (size_t)len, w, h);
 }
 
 void Render_Impl::preDraw()
 {
-	if (!pGraphics)
+	if (pBackBuffer 
+		&& pBackBuffer->GetWidth() == (UINT)width 
+		&& pBackBuffer->GetHeight() == (UINT)height)
+	{
+		return;
+	}
+
+	// (Re)create the back buffer and redraw everything into it
+	delete pGraphics;
+	delete pBackBuffer;
+	pBackBuffer = new Gdiplus::Bitmap(width, height, PixelFormat32bppPARGB);
+	pGraphics = new Gdiplus::Graphics(pBackBuffer);
+	pGraphics->Clear(Gdiplus::Color(clearColor.a, clearColor.r, clearColor.g, clearColor.b));
+	displayList.setCanvasSize(width, height);
+	resources.setCanvasSize(width, height);
+	drawnCount = 0;
+	InvalidateRect(hWnd, nullptr, FALSE);
+}
+
+void Render_Impl::drain()
+{
+	for (;;)
+	{
+		const geom::Control control = queue.drain(displayList);
+		switch (control.kind)
+		{
+		case geom::Control::Kind::None:
+		case geom::Control::Kind::Quit:
+			return;
+		case geom::Control::Kind::Canvas:
+			width = control.width;
+			height = control.height;
+			SetWindowPos(hWnd, nullptr, 0, 0, width + 17, height + 40, SWP_NOMOVE | SWP_NOZORDER);
+			// Everything is redrawn on the resized back buffer
+			preDraw();
+			break;
+		case geom::Control::Kind::Clear:
+			// What was drawn before is gone for good
+			clearColor = control.color;
+			displayList.clear();
+			drawnCount = 0;
+			pGraphics->Clear(Gdiplus::Color(clearColor.a, clearColor.r, clearColor.g, clearColor.b));
+			if (!doubleBuffered)
+			{
+				InvalidateRect(hWnd, nullptr, FALSE);
+			}
+			break;
+		case geom::Control::Kind::Present:
+			flush();
+			if (doubleBuffered)
+			{
+				swapBuffers();
+			}
+			if (recorder)
+			{
+				readBack(doubleBuffered ? pFrontBuffer : pBackBuffer, 
+					[this](int bufferWidth, int bufferHeight, const image::RowSource& row)
+					{
+						recorder->addFrame(bufferWidth, bufferHeight, row);
+					});
+			}
+			break;
+		case geom::Control::Kind::Buffering:
+			// The screen starts out showing the canvas as it is
+			flush();
+			doubleBuffered = control.enabled;
+			if (doubleBuffered)
+			{
+				swapBuffers();
+			}
+			InvalidateRect(hWnd, nullptr, FALSE);
+			break;
+		case geom::Control::Kind::Save:
+			if (!doubleBuffered)
+			{
+				flush();
+			}
+			saveScreen(control.path);
+			break;
+		case geom::Control::Kind::Export:
+			saveDisplayList(control);
+			break;
+		case geom::Control::Kind::Record:
+			record(control);
+			break;
+		case geom::Control::Kind::Fence:
+			if (!doubleBuffered)
+			{
+				flush();
+			}
+			queue.complete(control.epoch);
+			break;
+		}
+	}
+}
+
+void Render_Impl::flush(bool isIdle)
+{
+	if (!isIdle)
+	{
+		displayList.endPath();
+	}
+	if (!displayList.hasNew(drawnCount))
+	{
+		return;
+	}
+
+	perf::PrimitiveCounter counter;
+	const bool isMeasured = collector.isEnabled();
+	if (isMeasured)
+	{
+		displayList.replay(counter, drawnCount, displayList.settledSize());
+	}
+	const auto start = std::chrono::steady_clock::now();
+
+	GdiDevice device(pBackBuffer, pGraphics, resources, glyphs, polygons, strokes);
+	displayList.replayNew(device, drawnCount);
+
+	if (isMeasured)
+	{
+		// A frame is merged into this one if no repaint showed it
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		collector.endFrame(elapsed.count(), counter.viewCounts(), displayList.viewBytes(), queue.viewPendingBytes(), isFrameUnpainted);
+		if (collector.hasOverlay())
+		{
+			InvalidateRect(hWnd, &overlayArea, FALSE);
+		}
+	}
+	if (device.isDirty() || doubleBuffered)
+	{
+		isFrameUnpainted = true;
+	}
+	if (!device.isDirty() || doubleBuffered)
+	{
+		return;
+	}
+
+	const Gdiplus::RectF& dirty = device.viewDirty();
+	RECT area;
+	area.left = (LONG)std::floor(dirty.X);
+	area.top = (LONG)std::floor(dirty.Y);
+	area.right = (LONG)std::ceil(dirty.GetRight());
+	area.bottom = (LONG)std::ceil(dirty.GetBottom());
+	InvalidateRect(hWnd, &area, FALSE);
+}
+
+void Render_Impl::swapBuffers()
+{
+	const UINT bufferWidth = pBackBuffer->GetWidth();
+	const UINT bufferHeight = pBackBuffer->GetHeight();
+	if (!pFrontBuffer 
+		|| pFrontBuffer->GetWidth() != bufferWidth 
+		|| pFrontBuffer->GetHeight() != bufferHeight)
+	{
+		delete pFrontBuffer;
+		pFrontBuffer = new Gdiplus::Bitmap(bufferWidth, bufferHeight, PixelFormat32bppPARGB);
+	}
+
+	Gdiplus::Graphics front(pFrontBuffer);
+	front.SetCompositingMode(Gdiplus::CompositingModeSourceCopy);
+	front.DrawImage(pBackBuffer, 0, 0, (INT)bufferWidth, (INT)bufferHeight);
+	InvalidateRect(hWnd, nullptr, FALSE);
+}
+
+void Render_Impl::saveScreen(const char* path)
+{
+	image::Format format;
+	if (!image::findFormat(path, format))
 	{
-		pGraphics = new Gdiplus::Graphics(hWnd);
+		requestError = std::string("unsupported image file type: ") + path;
+		return;
+	}
+
+	Gdiplus::Bitmap* pBuffer = doubleBuffered ? pFrontBuffer : pBackBuffer;
+	const bool isRead = readBack(pBuffer, [&](int bufferWidth, int bufferHeight, const image::RowSource& row)
+		{
+			try
+			{
+				image::write(path, format, bufferWidth, bufferHeight, row);
+			}
+			catch (const std::exception& e)
+			{
+				requestError = e.what();
+			}
+		});
+	if (!isRead)
+	{
+		requestError = "cannot read the canvas back";
+	}
+}
+
+void Render_Impl::saveDisplayList(const geom::Control& control)
+{
+	image::VectorFormat format;
+	if (!image::findVectorFormat(control.path, format))
+	{
+		requestError = std::string("unsupported vector file type: ") + control.path;
+		return;
+	}
+	try
+	{
+		image::writeVector(control.path, format, width, height, clearColor,
+			displayList, glyphs, control.enabled);
+	}
+	catch (const std::exception& e)
+	{
+		requestError = e.what();
 	}
 }
 
+void Render_Impl::record(const geom::Control& control)
+{
+	if (recorder)
+	{
+		requestError = recorder->finish();
+		recorder.reset();
+	}
+	if (!control.enabled || !requestError.empty())
+	{
+		return;
+	}
+
+	image::VideoFormat format;
+	if (!image::findVideoFormat(control.path, format))
+	{
+		requestError = std::string("unsupported video file type: ") + control.path;
+		return;
+	}
+	try
+	{
+		recorder = std::make_unique<image::Recorder>(control.path, format, control.fps);
+	}
+	catch (const std::exception& e)
+	{
+		requestError = e.what();
+	}
+}
+
+void Render_Impl::paint(HDC hdc, const RECT& area)
+{
+	Gdiplus::Graphics screen(hdc);
+	Gdiplus::Rect dirty(area.left, area.top, area.right - area.left, area.bottom - area.top);
+	Gdiplus::SolidBrush background(Gdiplus::Color(255, 255, 255));
+	Gdiplus::Bitmap* pBuffer = doubleBuffered ? pFrontBuffer : pBackBuffer;
+	if (!pBuffer)
+	{
+		screen.FillRectangle(&background, dirty);
+		return;
+	}
+
+	// Window area outside the canvas
+	Gdiplus::Rect canvas(0, 0, (INT)pBuffer->GetWidth(), (INT)pBuffer->GetHeight());
+	screen.SetClip(canvas, Gdiplus::CombineModeExclude);
+	screen.FillRectangle(&background, dirty);
+	screen.ResetClip();
+
+	Gdiplus::Rect visible;
+	if (Gdiplus::Rect::Intersect(visible, dirty, canvas))
+	{
+		screen.SetCompositingMode(Gdiplus::CompositingModeSourceCopy);
+		screen.DrawImage(
+			pBuffer, 
+			visible, 
+			visible.X, 
+			visible.Y, 
+			visible.Width, 
+			visible.Height, 
+			Gdiplus::UnitPixel);
+	}
+
+	if (collector.hasOverlay())
+	{
+		paintOverlay(screen);
+	}
+	isFrameUnpainted = false;
+}
+
+void Render_Impl::paintOverlay(Gdiplus::Graphics& screen)
+{
+	const std::vector<std::wstring> lines = perf::formatOverlay(collector.snapshot());
+	Gdiplus::Font overlayFont(Gdiplus::FontFamily::GenericSansSerif(), (Gdiplus::REAL)perf::OVERLAY_FONT_SIZE,
+		Gdiplus::FontStyleRegular, Gdiplus::UnitPixel);
+
+	Gdiplus::REAL boxWidth = 0;
+	Gdiplus::REAL lineHeight = 0;
+	for (const std::wstring& line : lines)
+	{
+		Gdiplus::RectF box;
+		screen.MeasureString(line.c_str(), (INT)line.size(), &overlayFont, Gdiplus::PointF(0, 0), &box);
+		boxWidth = (std::max)(boxWidth, box.Width);
+		lineHeight = (std::max)(lineHeight, box.Height);
+	}
+	const Gdiplus::REAL margin = (Gdiplus::REAL)perf::OVERLAY_MARGIN;
+	const Gdiplus::RectF area(0, 0, boxWidth + 2 * margin, lineHeight * (Gdiplus::REAL)lines.size() + 2 * margin);
+
+	const cwt::ColorRgba background = perf::OVERLAY_BACKGROUND;
+	const cwt::ColorRgba text = perf::OVERLAY_TEXT;
+	Gdiplus::SolidBrush backgroundBrush(Gdiplus::Color(background.a, background.r, background.g, background.b));
+	Gdiplus::SolidBrush textBrush(Gdiplus::Color(text.a, text.r, text.g, text.b));
+	screen.SetCompositingMode(Gdiplus::CompositingModeSourceOver);
+	screen.FillRectangle(&backgroundBrush, area);
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		screen.DrawString(lines[i].c_str(), (INT)lines[i].size(), &overlayFont,
+			Gdiplus::PointF(margin, margin + lineHeight * (Gdiplus::REAL)i), &textBrush);
+	}
+
+	// Later frames repaint at least as much, so a longer line is not cut
+	overlayArea.right = (std::max)(overlayArea.right, (LONG)std::ceil(area.GetRight()));
+	overlayArea.bottom = (std::max)(overlayArea.bottom, (LONG)std::ceil(area.GetBottom()));
+}
+
 void Render_Impl::posDraw()
 {
 	TranslateMessage(&msg);
@@ -160,9 +907,14 @@ void Render_Impl::init()
 		wndClass.hInstance,		// program instance handle
 		nullptr);					// creation parameters
 
+	SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+	SetTimer(hWnd, FLUSH_TIMER_ID, FLUSH_INTERVAL_MS, nullptr);
+
 	INT nCmdShow = SW_SHOWNORMAL;
 	ShowWindow(hWnd, nCmdShow);
 	UpdateWindow(hWnd);
 
 	hasInit = true;
 }
+
+#endif // !ALGS4_RENDER_HEADLESS
@@ -3,237 +3,25 @@
 #include <objidl.h>
 #include <gdiplus.h>
 #pragma comment (lib,"Gdiplus.lib")
-#include <vector>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CommandQueue.h"
+#include "DisplayList.h"
+#include "GdiResources.h"
+#include "GlyphAtlas.h"
+#include "Recorder.h"
+#include "RenderStats.h"
+#include "Scanline.h"
+#include "Stroker.h"
 #include "cwt.h"
 
-constexpr Gdiplus::REAL STDDRAW_PEN_RADIUS_TO_GDI_PEN_RADIUS = 500.0f;
-
-namespace geom
-{
-	class Object2D
-	{
-	public:
-		virtual void Draw(Gdiplus::Graphics* pGraphics) const = 0;
-		virtual ~Object2D() = default;
-	protected:
-		Object2D(cwt::Pen _pen) : 
-			pen(_pen), 
-			gdiPenRadius((Gdiplus::REAL)pen.radius* STDDRAW_PEN_RADIUS_TO_GDI_PEN_RADIUS) 
-		{}
-		cwt::Pen pen;
-		Gdiplus::REAL gdiPenRadius;
-	};
-
-	class Line : public Object2D
-	{
-		double x1;
-		double y1;
-		double x2;
-		double y2;
-	public:
-		Line(cwt::Pen pen, double x1, double y1, double x2, double y2)
-			: Object2D(pen), x1(x1), y1(y1), x2(x2), y2(y2) {}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			Gdiplus::Pen gdiPen(Gdiplus::Color(pen.color.r, pen.color.g, pen.color.b), gdiPenRadius);
-			pGraphics->DrawLine(
-				&gdiPen, 
-				(Gdiplus::REAL)x1, 
-				(Gdiplus::REAL)y1, 
-				(Gdiplus::REAL)x2, 
-				(Gdiplus::REAL)y2);
-		}
-	};
-
-	class Circle : public Object2D
-	{
-		double x;
-		double y;
-		double width;
-		double height;
-		bool isFill;
-	public:
-		Circle(cwt::Pen pen, double x, double y, double width, double height, bool isFill)
-			: Object2D(pen), x(x), y(y), width(width), height(height), isFill(isFill) {}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			if (isFill)
-			{
-				Gdiplus::SolidBrush gdiBrush(Gdiplus::Color(pen.color.a, pen.color.r, pen.color.g, pen.color.b));
-				pGraphics->FillEllipse(
-					&gdiBrush, 
-					(Gdiplus::REAL)x, 
-					(Gdiplus::REAL)y, 
-					(Gdiplus::REAL)width, 
-					(Gdiplus::REAL)height);
-			}
-			else
-			{
-				Gdiplus::Pen gdiPen(Gdiplus::Color(pen.color.r, pen.color.g, pen.color.b), gdiPenRadius);
-				pGraphics->DrawEllipse(
-					&gdiPen, 
-					(Gdiplus::REAL)x, 
-					(Gdiplus::REAL)y, 
-					(Gdiplus::REAL)width, 
-					(Gdiplus::REAL)height);
-			}
-		}
-	};
-
-	class Arc : public Object2D
-	{
-		double x;
-		double y;
-		double width;
-		double height;
-		double start;
-		double sweep;
-	public:
-		Arc(cwt::Pen pen, double x, double y, double width, double height, double start, double sweep)
-			: Object2D(pen), x(x), y(y), width(width), height(height), start(start), sweep(sweep) {}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			Gdiplus::Pen gdiPen(Gdiplus::Color(pen.color.r, pen.color.g, pen.color.b), gdiPenRadius);
-			gdiPen.SetStartCap(Gdiplus::LineCap::LineCapRound);
-			gdiPen.SetEndCap(Gdiplus::LineCap::LineCapRound);
-			pGraphics->DrawArc(
-				&gdiPen, 
-				(Gdiplus::REAL)x, 
-				(Gdiplus::REAL)y, 
-				(Gdiplus::REAL)width, 
-				(Gdiplus::REAL)height, 
-				(Gdiplus::REAL)-start, 
-				(Gdiplus::REAL)-sweep);
-		}
-	};
-
-	class Rectangle : public Object2D
-	{
-		double x;
-		double y;
-		double width;
-		double height;
-		bool isFill;
-	public:
-		Rectangle(cwt::Pen pen, double x, double y, double width, double height, bool isFill)
-			: Object2D(pen), x(x), y(y), width(width), height(height), isFill(isFill) {}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			if (isFill)
-			{
-				Gdiplus::SolidBrush gdiBrush(Gdiplus::Color(pen.color.a, pen.color.r, pen.color.g, pen.color.b));
-				pGraphics->FillRectangle(
-					&gdiBrush, 
-					(Gdiplus::REAL)x, 
-					(Gdiplus::REAL)y, 
-					(Gdiplus::REAL)width, 
-					(Gdiplus::REAL)height);
-			}
-			else
-			{
-				Gdiplus::Pen gdiPen(Gdiplus::Color(pen.color.r, pen.color.g, pen.color.b), gdiPenRadius);
-				pGraphics->DrawRectangle(
-					&gdiPen, 
-					(Gdiplus::REAL)x, 
-					(Gdiplus::REAL)y, 
-					(Gdiplus::REAL)width, 
-					(Gdiplus::REAL)height);
-			}
-		}
-	};
-
-	class Polygon : public Object2D
-	{
-		bool isFill;
-		std::vector<Gdiplus::Point> points;
-	public:
-		Polygon(cwt::Pen pen, const std::vector<double>& x, const std::vector<double>& y, bool isFill)
-			: Object2D(pen), isFill(isFill) 
-		{
-			if (x.size() != y.size())
-			{
-				assert(!"Both x and y vectors must be of the same size to create a polygon!");
-			}
-			for (size_t i = 0; i < x.size(); i++)
-			{
-				points.emplace_back(Gdiplus::Point((INT)x[i], (INT)y[i]));
-			}
-		}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			if (isFill)
-			{
-				Gdiplus::SolidBrush gdiBrush(Gdiplus::Color(pen.color.a, pen.color.r, pen.color.g, pen.color.b));
-				pGraphics->FillPolygon(&gdiBrush, points.data(), (INT)points.size());
-			}
-			else
-			{
-				Gdiplus::Pen gdiPen(Gdiplus::Color(pen.color.r, pen.color.g, pen.color.b), gdiPenRadius);
-				pGraphics->DrawPolygon(&gdiPen, points.data(), (INT)points.size());
-			}
-		}
-	};
-
-	class Text : public Object2D
-	{
-		cwt::Font font;
-		std::wstring text;
-		double x;
-		double y;
-
-		Gdiplus::FontStyle viewStye(cwt::Font::Style style) const
-		{
-			switch (style)
-			{
-			default:
-			case cwt::Font::Style::FontStyleRegular:
-				return Gdiplus::FontStyleRegular;
-				break;
-			case cwt::Font::Style::FontStyleBold:
-				return Gdiplus::FontStyleBold;
-				break;
-			case cwt::Font::Style::FontStyleItalic:
-				return Gdiplus::FontStyleItalic;
-				break;
-			case cwt::Font::Style::FontStyleBoldItalic:
-				return Gdiplus::FontStyleBoldItalic;
-				break;
-			case cwt::Font::Style::FontStyleUnderline:
-				return Gdiplus::FontStyleUnderline;
-				break;
-			case cwt::Font::Style::FontStyleStrikeout:
-				return Gdiplus::FontStyleStrikeout;
-				break;
-			}
-		}
-
-	public:
-		Text(cwt::Pen pen, cwt::Font font, const std::wstring& text, double x, double y)
-			: Object2D(pen), font(font), text(text), x(x), y(y) {}
-
-		void Draw(Gdiplus::Graphics* pGraphics) const override
-		{
-			Gdiplus::Font gdiFont(
-				font.viewFontName().c_str(), 
-				(Gdiplus::REAL)font.viewFontSize(),
-				viewStye(font.viewFontSyle()), 
-				Gdiplus::UnitPixel);
-			Gdiplus::SolidBrush gdiBrush(Gdiplus::Color(pen.color.a, pen.color.r, pen.color.g, pen.color.b));
-			pGraphics->DrawString(
-				text.c_str(),
-				-1, 
-				&gdiFont, 
-				Gdiplus::PointF((Gdiplus::REAL)x, (Gdiplus::REAL)y), 
-				&gdiBrush);
-		}
-	};
-}
+// Wakes the message loop up so new objects reach the screen even when the
+// window receives no input
+constexpr UINT FLUSH_TIMER_ID = 1;
+constexpr UINT FLUSH_INTERVAL_MS = 16;
 
 class Render_Impl final
 {
@@ -244,7 +32,9 @@ public:
 		msg(),
 		wndClass(),
 		gdiplusToken(),
+		pBackBuffer(nullptr),
 		pGraphics(nullptr),
+		pFrontBuffer(nullptr),
 		pen(pen), 
 		width(width), 
 		height(height), 
@@ -264,35 +54,111 @@ public:
 	void drawArc(double x, double y, double width, double height, double start, double sweep);
 	void drawRectangle(double x, double y, double width, double height);
 	void fillRectangle(double x, double y, double width, double height);
-	void drawPolygon(const std::vector<double>& x, const std::vector<double>& y);
-	void fillPolygon(const std::vector<double>& x, const std::vector<double>& y);
-	void drawString(const wchar_t* text, double x, double y);
+	void drawPolygon(std::span<const double> points);
+	void fillPolygon(std::span<const double> points);
+	void drawString(std::wstring_view text, double x, double y);
+	void drawLines(std::span<const double> segments);
+	void fillElipses(std::span<const double> boxes);
+	void fillRectangles(std::span<const double> boxes);
 	void show();
+	void clear(const cwt::ColorRgba& color);
+	void setDoubleBuffering(bool enabled);
+	void present();
+	void finish();
+	void save(const char* path);
+	void saveVector(const char* path, bool isCoalesced);
+	void startRecording(const char* path, int fps);
+	void stopRecording();
 	void setCanvasSize(int canvasWidth, int canvasHeight);
 	void GetTextExtent(const wchar_t* text, int len, int& w, int& h);
+	void enableStats(bool enabled) { collector.enable(enabled); }
+	perf::RenderStats stats() { return collector.snapshot(); }
+	void setStatsOverlay(bool visible) { collector.setOverlay(visible); }
+	void startStatsLog(const char* path, int everyFrames) { collector.startLog(path, everyFrames); }
+	void stopStatsLog() { collector.stopLog(); }
+	void countCulled(size_t n) { collector.countCulled(n); }
 private:
+	friend LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
+
 	void preDraw();
 	void posDraw();
 	void init();
+	// Moves queued commands into the display list, handling resizes and
+	// fences on the way
+	void drain();
+	// Rasterizes the commands added since the last flush into the back buffer
+	// and invalidates the part of the window they cover. An idle flush, once
+	// the queue is drained, leaves the open path for a later one, so that how
+	// often the window loop runs does not change what is drawn
+	void flush(bool isIdle = false);
+	// Copies the back buffer to the front buffer and repaints the window
+	void swapBuffers();
+	// Waits until the render thread has handled every request queued so far
+	// and throws std::runtime_error if one of them failed
+	void waitForRequest();
+	// Writes the canvas on screen to path, noting failures in requestError
+	void saveScreen(const char* path);
+	// Writes the display list to control.path as vector graphics, noting
+	// failures in requestError
+	void saveDisplayList(const geom::Control& control);
+	// Starts or stops the recorder as control asks, noting failures in requestError
+	void record(const geom::Control& control);
+	// Copies the area of the buffer on screen that needs repainting to the window
+	void paint(HDC hdc, const RECT& area);
+	// Draws the stats overlay over the window and grows overlayArea to cover it
+	void paintOverlay(Gdiplus::Graphics& screen);
 	
 	HWND							hWnd;
 	MSG								msg;
 	WNDCLASS						wndClass;
 	Gdiplus::GdiplusStartupInput	gdiplusStartupInput;
 	ULONG_PTR						gdiplusToken;
+	// Retained canvas; pGraphics draws into it
+	Gdiplus::Bitmap*				pBackBuffer;
 	Gdiplus::Graphics*				pGraphics;
+	// Frame last presented, on screen while double buffering
+	Gdiplus::Bitmap*				pFrontBuffer;
 
+	// Owned by the drawing thread
 	// current pen
 	cwt::Pen pen;
 	// Font
 	cwt::Font font;
+	// Advances of the fonts measured by GetTextExtent()
+	text::GlyphAtlas metrics;
+
+	geom::CommandQueue queue;
+	// Why the last save or recording request failed, set by the render thread
+	// before it completes the fence the drawing thread waits on
+	std::string requestError;
+	// Filled by the render thread, read by the drawing thread
+	perf::StatsCollector collector;
+
+	// Owned by the render thread
+	std::unique_ptr<image::Recorder> recorder;
 	// Canvas size
 	int width;
 	int height;
 
 	const wchar_t* windowCaption;
 
-	std::vector<std::unique_ptr<geom::Object2D>> objects2D;
+	geom::DisplayList displayList;
+	// GDI+ objects for the pens of displayList, kept across frames
+	GdiResources resources;
+	// Glyphs of the text drawn so far
+	text::GlyphAtlas glyphs;
+	// Threads the bands of polygons with many edges are filled on
+	raster::ThreadPool fillThreads;
+	raster::ScanlineFiller polygons{ &fillThreads };
+	raster::Stroker strokes;
+	// Number of displayList commands already rasterized into the back buffer
+	size_t drawnCount = 0;
+	cwt::ColorRgba clearColor = cwt::getRgba(cwt::Color::DEFAULT_CLEAR_COLOR);
+	bool doubleBuffered = false;
+	// Set when a frame is rasterized, cleared once the window painted it
+	bool isFrameUnpainted = false;
+	// Part of the window the stats overlay is drawn on
+	RECT overlayArea{ 0, 0, 320, 80 };
 
 	bool hasInit = false;
 };
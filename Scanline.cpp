@@ -0,0 +1,298 @@
+#include "Scanline.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Vertices are snapped to 1/256 of a pixel
+	constexpr int FIXED_SHIFT = 8;
+	constexpr std::int64_t FIXED_ONE = 1 << FIXED_SHIFT;
+
+	// Below these sizes a polygon is not worth splitting across threads
+	constexpr size_t MIN_PARALLEL_EDGES = 4096;
+	constexpr int MIN_BAND_ROWS = 32;
+	// Bands per pool thread, so that threads done early steal from the others
+	constexpr unsigned BANDS_PER_THREAD = 4;
+
+	// Coordinates are clamped to this before clipping, which keeps the
+	// crossings it computes finite, and moves an edge on the canvas by less
+	// than 2^-18 of a pixel
+	constexpr double MAX_COORD = 1e12;
+
+	std::int64_t toFixed(double v)
+	{
+		return (std::int64_t)std::llround(v * FIXED_ONE);
+	}
+
+	// Keeps the part of the polygon in src where inside(x, y) holds, closing it
+	// along the boundary with cross(a, b), which returns where the edge a-b
+	// meets it. Inside the kept half-plane the winding is left unchanged.
+	template <class Inside, class Cross>
+	void clipPolygon(const std::vector<double>& src, std::vector<double>& dst, Inside inside, Cross cross)
+	{
+		dst.clear();
+		const size_t n = src.size() / 2;
+		for (size_t i = 0; i < n; i++)
+		{
+			const double* a = src.data() + 2 * ((i + n - 1) % n);
+			const double* b = src.data() + 2 * i;
+			const bool aIn = inside(a[0], a[1]);
+			const bool bIn = inside(b[0], b[1]);
+			if (aIn != bIn)
+			{
+				double x;
+				double y;
+				cross(a, b, x, y);
+				dst.push_back(x);
+				dst.push_back(y);
+			}
+			if (bIn)
+			{
+				dst.push_back(b[0]);
+				dst.push_back(b[1]);
+			}
+		}
+	}
+}
+
+void raster::ScanlineFiller::fill(int canvasWidth, int canvasHeight, const float* xy, size_t n, const SpanSink& sink)
+{
+	assert(canvasWidth < (1 << 22) && canvasHeight < (1 << 22) && "Canvas too large for the fixed point filler!");
+	if (n < 3 || canvasWidth <= 0 || canvasHeight <= 0)
+	{
+		return;
+	}
+	width = canvasWidth;
+	height = canvasHeight;
+	buildEdges(xy, n);
+	if (edges.empty())
+	{
+		return;
+	}
+
+	const unsigned threads = pool ? pool->viewThreadCount() : 1;
+	const int bands = (int)(std::min)((unsigned)(height / MIN_BAND_ROWS), BANDS_PER_THREAD * threads);
+	if (edges.size() < MIN_PARALLEL_EDGES || threads < 2 || bands < 2)
+	{
+		fillBand(0, height, scratch, sink);
+		return;
+	}
+
+	// Bands cover different rows, so they never write the same pixel
+	bandScratch.resize(threads);
+	const int rows = (height + bands - 1) / bands;
+	pool->run((size_t)bands, [this, rows, &sink](size_t band, unsigned thread)
+		{
+			const int first = (int)band * rows;
+			const int last = (std::min)(height, first + rows);
+			if (first < last)
+			{
+				fillBand(first, last, bandScratch[thread], sink);
+			}
+		});
+}
+
+void raster::ScanlineFiller::buildEdges(const float* xy, size_t n)
+{
+	// A vertex with a NaN has no place to go and is left out
+	clipped.clear();
+	for (size_t i = 0; i < n; i++)
+	{
+		const double x = xy[2 * i];
+		const double y = xy[2 * i + 1];
+		if (!std::isnan(x) && !std::isnan(y))
+		{
+			clipped.push_back(std::clamp(x, -MAX_COORD, MAX_COORD));
+			clipped.push_back(std::clamp(y, -MAX_COORD, MAX_COORD));
+		}
+	}
+	const double w = width;
+	const double h = height;
+	// Area left of the canvas still winds the pixels on it, and clipping
+	// replaces it with a vertical edge at x = 0 that does the same
+	clipPolygon(clipped, clipScratch,
+		[](double x, double) { return x >= 0.0; },
+		[](const double* a, const double* b, double& x, double& y) { x = 0.0; y = a[1] + (b[1] - a[1]) * (0.0 - a[0]) / (b[0] - a[0]); });
+	clipPolygon(clipScratch, clipped,
+		[w](double x, double) { return x <= w; },
+		[w](const double* a, const double* b, double& x, double& y) { x = w; y = a[1] + (b[1] - a[1]) * (w - a[0]) / (b[0] - a[0]); });
+	clipPolygon(clipped, clipScratch,
+		[](double, double y) { return y >= 0.0; },
+		[](const double* a, const double* b, double& x, double& y) { y = 0.0; x = a[0] + (b[0] - a[0]) * (0.0 - a[1]) / (b[1] - a[1]); });
+	clipPolygon(clipScratch, clipped,
+		[h](double, double y) { return y <= h; },
+		[h](const double* a, const double* b, double& x, double& y) { y = h; x = a[0] + (b[0] - a[0]) * (h - a[1]) / (b[1] - a[1]); });
+
+	edges.clear();
+	const size_t m = clipped.size() / 2;
+	for (size_t i = 0; i < m; i++)
+	{
+		const double* a = clipped.data() + 2 * i;
+		const double* b = clipped.data() + 2 * ((i + 1) % m);
+		if (!std::isfinite(a[0] + a[1] + b[0] + b[1]))
+		{
+			// Never reaches the fixed point, whose rows index the edge table
+			continue;
+		}
+		Edge edge{ toFixed(a[0]), toFixed(a[1]), toFixed(b[0]), toFixed(b[1]), 1.0f, 0 };
+		if (edge.y0 == edge.y1)
+		{
+			// Horizontal edges cover nothing
+			continue;
+		}
+		if (edge.y0 > edge.y1)
+		{
+			std::swap(edge.x0, edge.x1);
+			std::swap(edge.y0, edge.y1);
+			edge.dir = -1.0f;
+		}
+		edge.bottom = (int)((edge.y1 + FIXED_ONE - 1) >> FIXED_SHIFT);
+		edges.push_back(edge);
+	}
+
+	// Bucket the edges by their first row, a counting sort in O(edges + rows)
+	rowStart.assign((size_t)height + 1, 0);
+	for (const Edge& edge : edges)
+	{
+		rowStart[(size_t)(edge.y0 >> FIXED_SHIFT) + 1]++;
+	}
+	for (int y = 0; y < height; y++)
+	{
+		rowStart[(size_t)y + 1] += rowStart[y];
+	}
+	order.resize(edges.size());
+	cursor.assign(rowStart.begin(), rowStart.end() - 1);
+	for (std::uint32_t i = 0; i < edges.size(); i++)
+	{
+		order[cursor[(size_t)(edges[i].y0 >> FIXED_SHIFT)]++] = i;
+	}
+}
+
+void raster::ScanlineFiller::fillBand(int first, int last, Scratch& band, const SpanSink& sink) const
+{
+	band.accumulator.assign((size_t)width + 2, 0.0f);
+	band.coverage.resize((size_t)width);
+	std::vector<std::uint32_t>& active = band.active;
+	active.clear();
+
+	// Edges that start above the band but reach into it
+	for (std::uint32_t k = 0; k < rowStart[first]; k++)
+	{
+		if (edges[order[k]].bottom > first)
+		{
+			active.push_back(order[k]);
+		}
+	}
+
+	for (int y = first; y < last; y++)
+	{
+		active.insert(active.end(), order.begin() + rowStart[y], order.begin() + rowStart[(size_t)y + 1]);
+		if (active.empty())
+		{
+			continue;
+		}
+
+		int minX = width + 1;
+		int maxX = -1;
+		size_t kept = 0;
+		for (std::uint32_t i : active)
+		{
+			const Edge& edge = edges[i];
+			accumulate(edge, y, band.accumulator, minX, maxX);
+			if (edge.bottom > y + 1)
+			{
+				active[kept++] = i;
+			}
+		}
+		active.resize(kept);
+		if (maxX < minX)
+		{
+			continue;
+		}
+
+		// The running sum of the accumulator is the signed coverage; folding
+		// it into [0, 1] every two windings gives the even-odd rule
+		float sum = 0.0f;
+		const int end = (std::min)(maxX + 1, width);
+		for (int x = minX; x < end; x++)
+		{
+			sum += band.accumulator[x];
+			band.accumulator[x] = 0.0f;
+			float a = std::fmod(std::abs(sum), 2.0f);
+			if (a > 1.0f)
+			{
+				a = 2.0f - a;
+			}
+			band.coverage[x - minX] = (std::uint8_t)(a * 255.0f + 0.5f);
+		}
+		for (int x = end; x <= maxX; x++)
+		{
+			band.accumulator[x] = 0.0f;
+		}
+		if (minX < end)
+		{
+			sink(y, minX, band.coverage.data(), end - minX);
+		}
+	}
+}
+
+void raster::ScanlineFiller::accumulate(const Edge& edge, int y, std::vector<float>& accumulator, int& minX, int& maxX)
+{
+	const std::int64_t top = (std::int64_t)y << FIXED_SHIFT;
+	const std::int64_t ya = (std::max)(edge.y0, top);
+	const std::int64_t yb = (std::min)(edge.y1, top + FIXED_ONE);
+	if (ya >= yb)
+	{
+		return;
+	}
+	// Exact in 64 bits: both factors are below 2^31 on a clipped canvas
+	const std::int64_t dy = edge.y1 - edge.y0;
+	const std::int64_t dx = edge.x1 - edge.x0;
+	const float xa = (float)(edge.x0 + (ya - edge.y0) * dx / dy) / FIXED_ONE;
+	const float xb = (float)(edge.x0 + (yb - edge.y0) * dx / dy) / FIXED_ONE;
+	const float d = (float)(yb - ya) / FIXED_ONE * edge.dir;
+
+	const float x0 = (std::min)(xa, xb);
+	const float x1 = (std::max)(xa, xb);
+	const float x0floor = std::floor(x0);
+	const int x0i = (int)x0floor;
+	const float x1ceil = std::ceil(x1);
+	const int x1i = (int)x1ceil;
+	float* acc = accumulator.data();
+	minX = (std::min)(minX, x0i);
+	if (x1i <= x0i + 1)
+	{
+		// Within one pixel: split the area at the mean x
+		const float xmf = 0.5f * (xa + xb) - x0floor;
+		acc[x0i] += d - d * xmf;
+		acc[x0i + 1] += d * xmf;
+		maxX = (std::max)(maxX, x0i + 1);
+		return;
+	}
+
+	// Across several pixels: the trapezoids under the edge, pixel by pixel
+	const float s = 1.0f / (x1 - x0);
+	const float x0f = x0 - x0floor;
+	const float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+	const float x1f = x1 - x1ceil + 1.0f;
+	const float am = 0.5f * s * x1f * x1f;
+	acc[x0i] += d * a0;
+	if (x1i == x0i + 2)
+	{
+		acc[x0i + 1] += d * (1.0f - a0 - am);
+	}
+	else
+	{
+		const float a1 = s * (1.5f - x0f);
+		acc[x0i + 1] += d * (a1 - a0);
+		for (int xi = x0i + 2; xi < x1i - 1; xi++)
+		{
+			acc[xi] += d * s;
+		}
+		const float a2 = a1 + (x1i - x0i - 3) * s;
+		acc[x1i - 1] += d * (1.0f - a2 - am);
+	}
+	acc[x1i] += d * am;
+	maxX = (std::max)(maxX, x1i);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ThreadPool.h"
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace raster
+{
+	// Receives the coverage (0 to 255) of count pixels of row y from x on.
+	// Rows of one polygon may arrive in any order and from several threads.
+	using SpanSink = std::function<void(int y, int x, const std::uint8_t* coverage, int count)>;
+
+	/**
+	 * Anti-aliased filler for polygons of any size, with the even-odd rule.
+	 *
+	 * The polygon is clipped to the canvas and its vertices are snapped to
+	 * 1/256 of a pixel in 64-bit fixed point, so nothing is ever truncated to
+	 * whole pixels and edges far off the canvas cannot overflow. Rows are
+	 * swept top to bottom with an active edge table; every edge adds the exact
+	 * area it covers in each pixel to a row accumulator, whose running sum is
+	 * the coverage. A fill costs O(edges + pixels), and polygons with many
+	 * edges are split into horizontal bands filled on the threads of a pool.
+	 *
+	 * A filler keeps its buffers between polygons and is used by one thread,
+	 * never from an iteration its pool runs.
+	 */
+	class ScanlineFiller
+	{
+	public:
+		ScanlineFiller() = default;
+		// Fills polygons with many edges on the threads of pool
+		explicit ScanlineFiller(ThreadPool* pool) : pool(pool) {}
+
+		// Fills the polygon whose n vertices are stored as interleaved (x, y)
+		// pairs in xy, on a width x height canvas. Vertices with a NaN are left
+		// out and infinite ones are taken as very far away.
+		void fill(int width, int height, const float* xy, size_t n, const SpanSink& sink);
+
+	private:
+		struct Edge
+		{
+			// End points in fixed point, y0 < y1
+			std::int64_t x0;
+			std::int64_t y0;
+			std::int64_t x1;
+			std::int64_t y1;
+			float dir;		// +1 going down, -1 going up
+			int bottom;		// first row below the edge
+		};
+
+		// Buffers of one band
+		struct Scratch
+		{
+			std::vector<float> accumulator;
+			std::vector<std::uint8_t> coverage;
+			std::vector<std::uint32_t> active;
+		};
+
+		// Clips the polygon to the canvas and fills edges and the edge table
+		void buildEdges(const float* xy, size_t n);
+		// Sweeps rows [first, last)
+		void fillBand(int first, int last, Scratch& scratch, const SpanSink& sink) const;
+		// Adds what edge covers of row y to the accumulator
+		static void accumulate(const Edge& edge, int y, std::vector<float>& accumulator, int& minX, int& maxX);
+
+		ThreadPool* pool = nullptr;
+		int width = 0;
+		int height = 0;
+		std::vector<double> clipped;
+		std::vector<double> clipScratch;
+		std::vector<Edge> edges;
+		// Edge table: edges starting in row y are order[rowStart[y]..rowStart[y + 1])
+		std::vector<std::uint32_t> rowStart;
+		std::vector<std::uint32_t> order;
+		std::vector<std::uint32_t> cursor;
+		Scratch scratch;
+		// One per pool thread
+		std::vector<Scratch> bandScratch;
+	};
+}
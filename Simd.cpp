@@ -0,0 +1,530 @@
+#include "Simd.h"
+#include <cfloat>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ALGS4_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit instructions the function is compiled for, MSVC
+// emits any intrinsic that is used
+#if defined(ALGS4_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ALGS4_TARGET_SSE2 __attribute__((target("sse2")))
+#define ALGS4_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ALGS4_TARGET_SSE2
+#define ALGS4_TARGET_AVX2
+#endif
+
+namespace
+{
+	struct Kernels
+	{
+		simd::Level level;
+		size_t (*findNonFinite)(const double*, size_t);
+		size_t (*findNegative)(const double*, size_t);
+		void (*affine)(const double*, size_t, double, double, double*, size_t);
+		void (*blendSpan)(std::uint8_t*, size_t, std::uint32_t);
+		void (*blendMask)(std::uint8_t*, const std::uint8_t*, size_t, std::uint32_t);
+	};
+
+	/***************************************************************************
+	*  Scalar kernels, also used for the tails of the vector loops.
+	***************************************************************************/
+
+	bool isFinite(double v)
+	{
+		// NaN fails every comparison, infinities are out of range
+		return v >= -DBL_MAX && v <= DBL_MAX;
+	}
+
+	size_t findNonFiniteScalar(const double* values, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (!isFinite(values[i]))
+			{
+				return i;
+			}
+		}
+		return n;
+	}
+
+	size_t findNegativeScalar(const double* values, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			if (values[i] < 0.0)
+			{
+				return i;
+			}
+		}
+		return n;
+	}
+
+	void affineScalar(const double* values, size_t n, double scale, double offset, double* out, size_t stride)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			out[i * stride] = values[i] * scale + offset;
+		}
+	}
+
+	// Compositing works on 16-bit lanes: a channel times an alpha plus a
+	// channel times its complement is at most 255 * 255, rounded once by
+	// div255(). The color is weighted by its alpha in that product, which
+	// keeps it more precise than a premultiplied 8-bit color would be.
+
+	// t / 255 rounded to nearest, exact for t in [0, 255 * 255]
+	std::uint32_t div255(std::uint32_t t)
+	{
+		t += 128;
+		return (t + (t >> 8)) >> 8;
+	}
+
+	// Composites channels c, weighted by alpha w, over pixel p
+	void blendPixel(std::uint8_t* p, const std::uint32_t c[4], std::uint32_t w)
+	{
+		const std::uint32_t nw = 255 - w;
+		p[0] = (std::uint8_t)div255(c[0] * w + p[0] * nw);
+		p[1] = (std::uint8_t)div255(c[1] * w + p[1] * nw);
+		p[2] = (std::uint8_t)div255(c[2] * w + p[2] * nw);
+		p[3] = (std::uint8_t)div255(c[3] * w + p[3] * nw);
+	}
+
+	void blendSpanScalar(std::uint8_t* pixels, size_t n, std::uint32_t color)
+	{
+		const std::uint32_t c[4] = { color >> 24, color >> 16 & 0xFF, color >> 8 & 0xFF, 255 };
+		const std::uint32_t a = color & 0xFF;
+		for (size_t i = 0; i < n; i++)
+		{
+			blendPixel(pixels + 4 * i, c, a);
+		}
+	}
+
+	void blendMaskScalar(std::uint8_t* pixels, const std::uint8_t* coverage, size_t n, std::uint32_t color)
+	{
+		const std::uint32_t c[4] = { color >> 24, color >> 16 & 0xFF, color >> 8 & 0xFF, 255 };
+		const std::uint32_t a = color & 0xFF;
+		for (size_t i = 0; i < n; i++)
+		{
+			if (coverage[i] != 0)
+			{
+				blendPixel(pixels + 4 * i, c, div255(a * coverage[i]));
+			}
+		}
+	}
+
+#ifdef ALGS4_SIMD_X86
+	/***************************************************************************
+	*  SSE2 kernels, two doubles or four pixels at a time.
+	***************************************************************************/
+
+	ALGS4_TARGET_SSE2 size_t findNonFiniteSSE2(const double* values, size_t n)
+	{
+		const __m128d lo = _mm_set1_pd(-DBL_MAX);
+		const __m128d hi = _mm_set1_pd(DBL_MAX);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d v = _mm_loadu_pd(values + i);
+			__m128d ok = _mm_and_pd(_mm_cmpge_pd(v, lo), _mm_cmple_pd(v, hi));
+			if (_mm_movemask_pd(ok) != 0x3)
+			{
+				return i + findNonFiniteScalar(values + i, 2);
+			}
+		}
+		return i + findNonFiniteScalar(values + i, n - i);
+	}
+
+	ALGS4_TARGET_SSE2 size_t findNegativeSSE2(const double* values, size_t n)
+	{
+		const __m128d zero = _mm_setzero_pd();
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d v = _mm_loadu_pd(values + i);
+			if (_mm_movemask_pd(_mm_cmplt_pd(v, zero)) != 0)
+			{
+				return i + findNegativeScalar(values + i, 2);
+			}
+		}
+		return i + findNegativeScalar(values + i, n - i);
+	}
+
+	ALGS4_TARGET_SSE2 void affineSSE2(const double* values, size_t n, double scale, double offset, double* out, size_t stride)
+	{
+		const __m128d s = _mm_set1_pd(scale);
+		const __m128d o = _mm_set1_pd(offset);
+		size_t i = 0;
+		for (; i + 2 <= n; i += 2)
+		{
+			__m128d v = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(values + i), s), o);
+			if (stride == 1)
+			{
+				_mm_storeu_pd(out + i, v);
+			}
+			else
+			{
+				_mm_store_sd(out + i * stride, v);
+				_mm_storeh_pd(out + (i + 1) * stride, v);
+			}
+		}
+		affineScalar(values + i, n - i, scale, offset, out + i * stride, stride);
+	}
+
+	// div255() on eight 16-bit lanes
+	ALGS4_TARGET_SSE2 __m128i div255SSE2(__m128i t)
+	{
+		t = _mm_add_epi16(t, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+
+	// Color channels, with 255 for alpha, on the lanes of two pixels
+	ALGS4_TARGET_SSE2 __m128i colorSSE2(std::uint32_t color)
+	{
+		const short r = (short)(color >> 24);
+		const short g = (short)(color >> 16 & 0xFF);
+		const short b = (short)(color >> 8 & 0xFF);
+		return _mm_setr_epi16(r, g, b, 255, r, g, b, 255);
+	}
+
+	// Each pixel is widened to four 16-bit lanes
+	ALGS4_TARGET_SSE2 void blendSpanSSE2(std::uint8_t* pixels, size_t n, std::uint32_t color)
+	{
+		const __m128i a = _mm_set1_epi16((short)(color & 0xFF));
+		const __m128i weighted = _mm_mullo_epi16(colorSSE2(color), a);
+		const __m128i na = _mm_sub_epi16(_mm_set1_epi16(255), a);
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i* p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+			const __m128i d = _mm_loadu_si128(p);
+			const __m128i lo = div255SSE2(_mm_add_epi16(weighted, _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), na)));
+			const __m128i hi = div255SSE2(_mm_add_epi16(weighted, _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), na)));
+			_mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+		}
+		blendSpanScalar(pixels + 4 * i, n - i, color);
+	}
+
+	ALGS4_TARGET_SSE2 void blendMaskSSE2(std::uint8_t* pixels, const std::uint8_t* coverage, size_t n, std::uint32_t color)
+	{
+		const __m128i c = colorSSE2(color);
+		const __m128i a = _mm_set1_epi16((short)(color & 0xFF));
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i solid = _mm_packus_epi16(c, c);
+		const bool isOpaque = (color & 0xFF) == 255;
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			std::uint32_t covered;
+			std::memcpy(&covered, coverage + i, sizeof(covered));
+			if (covered == 0)
+			{
+				continue;
+			}
+			// Fully covered by an opaque color, the pixels become that color,
+			// as the blend would make them
+			if (isOpaque && covered == 0xFFFFFFFF)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4 * i), solid);
+				continue;
+			}
+			// Alpha of each pixel, spread over its four lanes
+			const __m128i w = div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)covered), zero), a));
+			const __m128i pairs = _mm_unpacklo_epi16(w, w);
+			const __m128i wlo = _mm_unpacklo_epi32(pairs, pairs);
+			const __m128i whi = _mm_unpackhi_epi32(pairs, pairs);
+
+			__m128i* p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+			const __m128i d = _mm_loadu_si128(p);
+			const __m128i lo = div255SSE2(_mm_add_epi16(_mm_mullo_epi16(c, wlo),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(full, wlo))));
+			const __m128i hi = div255SSE2(_mm_add_epi16(_mm_mullo_epi16(c, whi),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(full, whi))));
+			_mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+		}
+		blendMaskScalar(pixels + 4 * i, coverage + i, n - i, color);
+	}
+
+	/***************************************************************************
+	*  AVX2 kernels, four doubles or eight pixels at a time.
+	*
+	*  The tails are left to kernels in legacy SSE encoding. Running those with
+	*  the upper halves of the YMM registers dirty costs a state transition
+	*  each time, hundreds of cycles on some CPUs, so _mm256_zeroupper() goes
+	*  first.
+	***************************************************************************/
+
+	ALGS4_TARGET_AVX2 size_t findNonFiniteAVX2(const double* values, size_t n)
+	{
+		const __m256d lo = _mm256_set1_pd(-DBL_MAX);
+		const __m256d hi = _mm256_set1_pd(DBL_MAX);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d v = _mm256_loadu_pd(values + i);
+			__m256d ok = _mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GE_OQ), _mm256_cmp_pd(v, hi, _CMP_LE_OQ));
+			if (_mm256_movemask_pd(ok) != 0xF)
+			{
+				_mm256_zeroupper();
+				return i + findNonFiniteScalar(values + i, 4);
+			}
+		}
+		_mm256_zeroupper();
+		return i + findNonFiniteScalar(values + i, n - i);
+	}
+
+	ALGS4_TARGET_AVX2 size_t findNegativeAVX2(const double* values, size_t n)
+	{
+		const __m256d zero = _mm256_setzero_pd();
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d v = _mm256_loadu_pd(values + i);
+			if (_mm256_movemask_pd(_mm256_cmp_pd(v, zero, _CMP_LT_OQ)) != 0)
+			{
+				_mm256_zeroupper();
+				return i + findNegativeScalar(values + i, 4);
+			}
+		}
+		_mm256_zeroupper();
+		return i + findNegativeScalar(values + i, n - i);
+	}
+
+	ALGS4_TARGET_AVX2 void affineAVX2(const double* values, size_t n, double scale, double offset, double* out, size_t stride)
+	{
+		// Multiply then add rather than FMA, so every level rounds the same way
+		const __m256d s = _mm256_set1_pd(scale);
+		const __m256d o = _mm256_set1_pd(offset);
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d v = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(values + i), s), o);
+			if (stride == 1)
+			{
+				_mm256_storeu_pd(out + i, v);
+			}
+			else
+			{
+				alignas(32) double lanes[4];
+				_mm256_store_pd(lanes, v);
+				out[i * stride] = lanes[0];
+				out[(i + 1) * stride] = lanes[1];
+				out[(i + 2) * stride] = lanes[2];
+				out[(i + 3) * stride] = lanes[3];
+			}
+		}
+		_mm256_zeroupper();
+		affineScalar(values + i, n - i, scale, offset, out + i * stride, stride);
+	}
+
+	ALGS4_TARGET_AVX2 __m256i div255AVX2(__m256i t)
+	{
+		t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+	}
+
+	// Unpacking works within 128-bit halves, so the low lanes hold pixels 0, 1, 4 and 5 and the high ones 2, 3, 6 and 7.
+	ALGS4_TARGET_AVX2 void blendSpanAVX2(std::uint8_t* pixels, size_t n, std::uint32_t color)
+	{
+		const __m256i a = _mm256_set1_epi16((short)(color & 0xFF));
+		const __m256i weighted = _mm256_mullo_epi16(_mm256_broadcastsi128_si256(colorSSE2(color)), a);
+		const __m256i na = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			__m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+			const __m256i d = _mm256_loadu_si256(p);
+			const __m256i lo = div255AVX2(_mm256_add_epi16(weighted, _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), na)));
+			const __m256i hi = div255AVX2(_mm256_add_epi16(weighted, _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), na)));
+			_mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+		}
+		_mm256_zeroupper();
+		blendSpanSSE2(pixels + 4 * i, n - i, color);
+	}
+
+	ALGS4_TARGET_AVX2 void blendMaskAVX2(std::uint8_t* pixels, const std::uint8_t* coverage, size_t n, std::uint32_t color)
+	{
+		const __m256i c = _mm256_broadcastsi128_si256(colorSSE2(color));
+		const __m128i a = _mm_set1_epi16((short)(color & 0xFF));
+		const __m256i full = _mm256_set1_epi16(255);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i solid = _mm256_packus_epi16(c, c);
+		const bool isOpaque = (color & 0xFF) == 255;
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+		{
+			std::uint64_t covered;
+			std::memcpy(&covered, coverage + i, sizeof(covered));
+			if (covered == 0)
+			{
+				continue;
+			}
+			if (isOpaque && covered == ~std::uint64_t{ 0 })
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + 4 * i), solid);
+				continue;
+			}
+			const __m128i w = div255SSE2(_mm_mullo_epi16(
+				_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)), _mm_setzero_si128()), a));
+			const __m128i pairs03 = _mm_unpacklo_epi16(w, w);
+			const __m128i pairs47 = _mm_unpackhi_epi16(w, w);
+			const __m256i wlo = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_unpacklo_epi32(pairs03, pairs03)), _mm_unpacklo_epi32(pairs47, pairs47), 1);
+			const __m256i whi = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_unpackhi_epi32(pairs03, pairs03)), _mm_unpackhi_epi32(pairs47, pairs47), 1);
+
+			__m256i* p = reinterpret_cast<__m256i*>(pixels + 4 * i);
+			const __m256i d = _mm256_loadu_si256(p);
+			const __m256i lo = div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(c, wlo),
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(full, wlo))));
+			const __m256i hi = div255AVX2(_mm256_add_epi16(_mm256_mullo_epi16(c, whi),
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(full, whi))));
+			_mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+		}
+		_mm256_zeroupper();
+		blendMaskSSE2(pixels + 4 * i, coverage + i, n - i, color);
+	}
+
+	/***************************************************************************
+	*  CPU detection.
+	***************************************************************************/
+
+	void cpuid(int leaf, int subleaf, int info[4])
+	{
+#ifdef _MSC_VER
+		__cpuidex(info, leaf, subleaf);
+#else
+		unsigned a = 0;
+		unsigned b = 0;
+		unsigned c = 0;
+		unsigned d = 0;
+		__asm__ __volatile__("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(subleaf));
+		info[0] = (int)a;
+		info[1] = (int)b;
+		info[2] = (int)c;
+		info[3] = (int)d;
+#endif
+	}
+
+	bool osSavesAvxState()
+	{
+#ifdef _MSC_VER
+		return (_xgetbv(0) & 0x6) == 0x6;
+#else
+		unsigned lo = 0;
+		unsigned hi = 0;
+		__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return (lo & 0x6) == 0x6;
+#endif
+	}
+
+	simd::Level detectLevel()
+	{
+		int info[4];
+		cpuid(0, 0, info);
+		const int maxLeaf = info[0];
+		if (maxLeaf < 1)
+		{
+			return simd::Level::Scalar;
+		}
+
+		cpuid(1, 0, info);
+		const bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+		const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+		const bool hasAVX = (info[2] & (1 << 28)) != 0;
+		if (maxLeaf >= 7 && hasOSXSAVE && hasAVX && osSavesAvxState())
+		{
+			cpuid(7, 0, info);
+			if (info[1] & (1 << 5))
+			{
+				return simd::Level::AVX2;
+			}
+		}
+		return hasSSE2 ? simd::Level::SSE2 : simd::Level::Scalar;
+	}
+#endif // ALGS4_SIMD_X86
+
+	// Most capable level this machine runs
+	simd::Level findSupportedLevel()
+	{
+#if defined(ALGS4_SIMD_X86) && defined(__AVX2__)
+		// Built for AVX2 (-march=x86-64-v3, /arch:AVX2): no CPU to detect
+		return simd::Level::AVX2;
+#elif defined(ALGS4_SIMD_X86)
+		return detectLevel();
+#else
+		return simd::Level::Scalar;
+#endif
+	}
+
+	Kernels selectKernels(simd::Level level)
+	{
+#ifdef ALGS4_SIMD_X86
+		switch (level)
+		{
+		case simd::Level::AVX2:
+			return Kernels{ simd::Level::AVX2, findNonFiniteAVX2, findNegativeAVX2, affineAVX2, blendSpanAVX2, blendMaskAVX2 };
+		case simd::Level::SSE2:
+			return Kernels{ simd::Level::SSE2, findNonFiniteSSE2, findNegativeSSE2, affineSSE2, blendSpanSSE2, blendMaskSSE2 };
+		default:
+			break;
+		}
+#endif
+		return Kernels{ simd::Level::Scalar, findNonFiniteScalar, findNegativeScalar, affineScalar, blendSpanScalar, blendMaskScalar };
+	}
+
+	Kernels& kernels()
+	{
+		static Kernels selected = selectKernels(findSupportedLevel());
+		return selected;
+	}
+}
+
+simd::Level simd::viewLevel()
+{
+	return kernels().level;
+}
+
+bool simd::setLevel(Level level)
+{
+	if (level > findSupportedLevel())
+	{
+		return false;
+	}
+	kernels() = selectKernels(level);
+	return true;
+}
+
+size_t simd::findNonFinite(const double* values, size_t n)
+{
+	return kernels().findNonFinite(values, n);
+}
+
+size_t simd::findNegative(const double* values, size_t n)
+{
+	return kernels().findNegative(values, n);
+}
+
+void simd::affine(const double* values, size_t n, double scale, double offset, double* out, size_t stride)
+{
+	kernels().affine(values, n, scale, offset, out, stride);
+}
+
+void simd::blendSpan(std::uint8_t* pixels, size_t n, std::uint32_t color)
+{
+	kernels().blendSpan(pixels, n, color);
+}
+
+void simd::blendMask(std::uint8_t* pixels, const std::uint8_t* coverage, size_t n, std::uint32_t color)
+{
+	kernels().blendMask(pixels, coverage, n, color);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Array kernels for validating and transforming coordinates and compositing
+// pixels. Each kernel has a scalar, an SSE2 and an AVX2 version; the fastest
+// one the CPU supports is picked the first time a kernel is called. All
+// versions return exactly the same results.
+namespace simd
+{
+	enum class Level
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	// Instruction set the kernels dispatch to on this machine
+	Level viewLevel();
+
+	// Makes the kernels dispatch to level, so that tests can compare the
+	// versions. Returns false, changing nothing, if the CPU lacks level. No
+	// kernel may be running meanwhile.
+	bool setLevel(Level level);
+
+	// Returns the index of the first value that is NaN or infinite, or n if
+	// every value is finite
+	size_t findNonFinite(const double* values, size_t n);
+
+	// Returns the index of the first value below zero, or n if there is none
+	size_t findNegative(const double* values, size_t n);
+
+	// out[i * stride] = values[i] * scale + offset, for i in [0, n)
+	void affine(const double* values, size_t n, double scale, double offset, double* out, size_t stride);
+
+	// Composites color, packed as 0xRRGGBBAA and not premultiplied, source
+	// over n premultiplied pixels of four bytes, alpha last. The first three
+	// bytes of the color go to the first three of each pixel, so BGRA pixels
+	// take the color packed as 0xBBGGRRAA.
+	void blendSpan(std::uint8_t* pixels, size_t n, std::uint32_t color);
+
+	// blendSpan() with the alpha of the color weighted by coverage[i], from
+	// 0 to 255, for pixel i
+	void blendMask(std::uint8_t* pixels, const std::uint8_t* coverage, size_t n, std::uint32_t color);
+}
@@ -0,0 +1,535 @@
+#include "Stroker.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+	constexpr double INF = std::numeric_limits<double>::infinity();
+
+	// Arcs are flattened into chords within this many pixels of the ellipse,
+	// and into no more chords than this however large the ellipse
+	constexpr double ARC_TOLERANCE = 0.1;
+	constexpr double MAX_ARC_CHORDS = 8192;
+
+	// Components of a direction smaller than this count as zero
+	constexpr double MIN_DIRECTION = 1e-12;
+
+	// Rounding of values known to fit an int, without the library calls
+	int floorToInt(double v)
+	{
+		const int i = (int)v;
+		return i - (i > v);
+	}
+
+	int ceilToInt(double v)
+	{
+		const int i = (int)v;
+		return i + (i < v);
+	}
+
+	// Coverage of a pixel whose center lies c inside the outline of a stroke
+	// grown by half a pixel. Clamped as an integer, which compilers do
+	// without branches; the pixels at the edges go either way.
+	std::uint8_t toCoverage(double c)
+	{
+		const int value = (int)std::min(c * 255.0 + 0.5, 255.0);
+		return (std::uint8_t)std::max(value, 0);
+	}
+
+	// Pixels [first, last] of the columns [left, right) whose centers lie in
+	// [lo, hi]; false if there are none. Both ends are clamped in double
+	// before the cast, as the span may lie far off the canvas.
+	bool findSpan(double lo, double hi, int left, int right, int& first, int& last)
+	{
+		if (!(hi >= left && lo <= right))
+		{
+			return false;
+		}
+		first = (int)std::clamp(std::ceil(lo - 0.5), (double)left, (double)right);
+		last = (int)std::clamp(std::floor(hi - 0.5), left - 1.0, right - 1.0);
+		return first <= last;
+	}
+
+	// Narrows [lo, hi] to the x for which low <= (x - x0) * k <= high, given
+	// the reciprocal of k, or zero if k is too small to have one
+	void narrow(double x0, double invK, double low, double high, double& lo, double& hi)
+	{
+		if (invK == 0.0)
+		{
+			if (low > 0.0 || high < 0.0)
+			{
+				lo = INF;
+				hi = -INF;
+			}
+			return;
+		}
+		double u = x0 + low * invK;
+		double v = x0 + high * invK;
+		if (invK < 0.0)
+		{
+			std::swap(u, v);
+		}
+		lo = std::max(lo, u);
+		hi = std::min(hi, v);
+	}
+}
+
+bool raster::Stroker::Segment::reach(double y, double r, double& lo, double& hi) const
+{
+	lo = INF;
+	hi = -INF;
+	// The round ends; only the rows near them need a square root
+	auto end = [&](double cx, double cy)
+	{
+		const double h = y - cy;
+		if (std::abs(h) <= r)
+		{
+			const double w = std::sqrt(r * r - h * h);
+			lo = std::min(lo, cx - w);
+			hi = std::max(hi, cx + w);
+		}
+	};
+	end(x0, y0);
+	end(x1, y1);
+
+	// The band along the segment: points projecting onto it, at most r from
+	// its line. Together with the ends they make a convex shape, so the row
+	// meets it in one interval.
+	if (length > 0.0)
+	{
+		const double h = y - y0;
+		double a = -INF;
+		double b = INF;
+		narrow(x0, invUy, h * ux - r, h * ux + r, a, b);
+		narrow(x0, invUx, -h * uy, length - h * uy, a, b);
+		if (a <= b)
+		{
+			lo = std::min(lo, a);
+			hi = std::max(hi, b);
+		}
+	}
+	return lo <= hi;
+}
+
+double raster::Stroker::Segment::distance(double x, double y) const
+{
+	const double ex = x - x0;
+	const double ey = y - y0;
+	// Past an end the nearest point is that end, otherwise it lies on the line
+	const double t = ex * ux + ey * uy;
+	if (t <= 0.0)
+	{
+		return std::sqrt(ex * ex + ey * ey);
+	}
+	if (t >= length)
+	{
+		return std::sqrt((x - x1) * (x - x1) + (y - y1) * (y - y1));
+	}
+	return std::abs(ex * uy - ey * ux);
+}
+
+void raster::Stroker::polyline(const float* xy, size_t n, bool isClosed, double penWidth,
+	int left, int top, int right, int bottom, const SpanSink& sink)
+{
+	if (n == 0 || left >= right || top >= bottom)
+	{
+		return;
+	}
+	halfWidth = std::max(penWidth, 1.0) / 2;
+	clipLeft = left;
+	clipTop = top;
+	clipRight = right;
+	clipBottom = bottom;
+
+	// A lone vertex is a dot, and a closed path runs back to its first vertex
+	segments.clear();
+	const size_t count = isClosed || n == 1 ? n : n - 1;
+	for (size_t i = 0; i < count; i++)
+	{
+		const size_t j = (i + 1) % n;
+		addSegment(xy[2 * i], xy[2 * i + 1], xy[2 * j], xy[2 * j + 1]);
+	}
+	if (segments.empty())
+	{
+		return;
+	}
+
+	// The row buffer is all zeros between strokes
+	const int width = clipRight - clipLeft;
+	if (coverage.size() < (size_t)width)
+	{
+		coverage.resize((size_t)width, 0);
+	}
+	minX = width;
+	maxX = -1;
+	if (segments.size() == 1)
+	{
+		strokeSegment(segments[0], sink);
+		return;
+	}
+
+	order.resize(segments.size());
+	int last = clipTop;
+	for (std::uint32_t i = 0; i < segments.size(); i++)
+	{
+		order[i] = i;
+		last = std::max(last, segments[i].bottom);
+	}
+	std::sort(order.begin(), order.end(),
+		[this](std::uint32_t a, std::uint32_t b) { return segments[a].top < segments[b].top; });
+
+	active.clear();
+	size_t next = 0;
+	for (int y = segments[order[0]].top; y < last; y++)
+	{
+		for (; next < order.size() && segments[order[next]].top <= y; next++)
+		{
+			active.push_back(order[next]);
+		}
+		if (active.empty())
+		{
+			// Skip the rows between two parts of the path
+			if (next == order.size())
+			{
+				break;
+			}
+			y = segments[order[next]].top - 1;
+			continue;
+		}
+		size_t kept = 0;
+		for (std::uint32_t i : active)
+		{
+			cover(segments[i], y);
+			if (segments[i].bottom > y + 1)
+			{
+				active[kept++] = i;
+			}
+		}
+		active.resize(kept);
+		flush(y, sink);
+	}
+}
+
+void raster::Stroker::arc(double x, double y, double width, double height, double start, double sweep,
+	double penWidth, int left, int top, int right, int bottom, const SpanSink& sink)
+{
+	const double a = std::abs(width) / 2;
+	const double b = std::abs(height) / 2;
+	const double cx = x + width / 2;
+	const double cy = y + height / 2;
+	if (sweep < 0.0)
+	{
+		start += sweep;
+		sweep = -sweep;
+	}
+	const bool isClosed = sweep >= 360.0;
+	if (isClosed)
+	{
+		// A circle is stroked directly from its distance. An ellipse is
+		// flattened like any arc, as no closed form distance to it stays
+		// within ARC_TOLERANCE for thick pens on its flat sides.
+		if (a > 0.0 && a == b)
+		{
+			ring(cx, cy, a, penWidth, left, top, right, bottom, sink);
+			return;
+		}
+		sweep = 360.0;
+	}
+
+	// A chord spanning the angle step strays at most ARC_TOLERANCE from the
+	// ellipse, as it would from a circle of its larger radius
+	const double r = std::max(a, b);
+	const double step = r > ARC_TOLERANCE ? 2 * std::acos(1.0 - ARC_TOLERANCE / r) : 2 * PI;
+	const double chords = std::clamp(std::ceil(sweep * PI / 180.0 / step), 1.0, MAX_ARC_CHORDS);
+	if (!(chords >= 1.0))
+	{
+		return;
+	}
+	const size_t n = (size_t)chords;
+
+	path.clear();
+	const size_t vertices = isClosed ? n : n + 1;
+	for (size_t i = 0; i < vertices; i++)
+	{
+		const double t = (start + sweep * (double)i / (double)n) * PI / 180.0;
+		path.push_back((float)(cx + a * std::cos(t)));
+		path.push_back((float)(cy - b * std::sin(t)));
+	}
+	polyline(path.data(), vertices, isClosed, penWidth, left, top, right, bottom, sink);
+}
+
+void raster::Stroker::ring(double cx, double cy, double radius, double penWidth,
+	int left, int top, int right, int bottom, const SpanSink& sink)
+{
+	if (left >= right || top >= bottom)
+	{
+		return;
+	}
+	halfWidth = std::max(penWidth, 1.0) / 2;
+	clipLeft = left;
+	clipTop = top;
+	clipRight = right;
+	clipBottom = bottom;
+	const int width = clipRight - clipLeft;
+	if (coverage.size() < (size_t)width)
+	{
+		coverage.resize((size_t)width, 0);
+	}
+	minX = width;
+	maxX = -1;
+
+	// The stroke lies between the circles with the radius grown and shrunk
+	// by its reach
+	const double reach = halfWidth + 0.5;
+	const double ro = radius + reach;
+	const double ri = radius - reach;
+
+	// Rows whose centers lie within reach, clamped in double first as the
+	// circle may lie far off the canvas
+	const double firstRow = std::clamp(std::ceil(cy - ro - 0.5), (double)clipTop, (double)clipBottom);
+	const double lastRow = std::clamp(std::floor(cy + ro - 0.5) + 1.0, (double)clipTop, (double)clipBottom);
+	if (!(firstRow < lastRow))
+	{
+		return;
+	}
+	const int first = (int)firstRow;
+	const int last = (int)lastRow;
+	std::uint8_t* row = coverage.data() - clipLeft;
+	for (int y = first; y < last; y++)
+	{
+		const double py = y + 0.5 - cy;
+		if (py * py >= ro * ro)
+		{
+			continue;
+		}
+		const double xo = std::sqrt(ro * ro - py * py);
+		double xi = -1.0;
+		if (ri > 0.0 && std::abs(py) < ri)
+		{
+			xi = std::sqrt(ri * ri - py * py);
+		}
+		// Pixels whose centers lie in [lo, hi]
+		auto coverSpan = [&](double lo, double hi)
+		{
+			int from;
+			int to;
+			if (!findSpan(lo, hi, clipLeft, clipRight, from, to))
+			{
+				return;
+			}
+			for (int x = from; x <= to; x++)
+			{
+				const double px = x + 0.5 - cx;
+				row[x] = std::max(row[x], toCoverage(reach - std::abs(std::sqrt(px * px + py * py) - radius)));
+			}
+			minX = std::min(minX, from - clipLeft);
+			maxX = std::max(maxX, to - clipLeft);
+		};
+		if (xi > 0.0)
+		{
+			coverSpan(cx - xo, cx - xi);
+			coverSpan(cx + xi, cx + xo);
+		}
+		else
+		{
+			coverSpan(cx - xo, cx + xo);
+		}
+		flush(y, sink);
+	}
+}
+
+void raster::Stroker::addSegment(double x0, double y0, double x1, double y1)
+{
+	const double reach = halfWidth + 0.5;
+	// Written so that segments with NaN coordinates reach nothing
+	if (!(std::max(x0, x1) + reach > clipLeft && std::min(x0, x1) - reach < clipRight))
+	{
+		return;
+	}
+	// Rows whose centers lie within reach of the segment vertically
+	const double top = std::max(std::ceil(std::min(y0, y1) - reach - 0.5), (double)clipTop);
+	const double bottom = std::min(std::floor(std::max(y0, y1) + reach - 0.5) + 1.0, (double)clipBottom);
+	if (!(top < bottom))
+	{
+		return;
+	}
+	const double length = std::hypot(x1 - x0, y1 - y0);
+	const double ux = length > 0.0 ? (x1 - x0) / length : 0.0;
+	const double uy = length > 0.0 ? (y1 - y0) / length : 0.0;
+	auto reciprocal = [](double u) { return std::abs(u) > MIN_DIRECTION ? 1.0 / u : 0.0; };
+	const double invUy = reciprocal(uy);
+
+	// Most rows of a long segment pass between its ends, out of reach of
+	// both; there every pixel is nearest the line itself
+	double bandTop = std::clamp(std::floor(std::min(y0, y1) + reach - 0.5) + 1.0, top, bottom);
+	double bandBottom = std::clamp(std::ceil(std::max(y0, y1) - reach - 0.5), bandTop, bottom);
+	if (invUy == 0.0)
+	{
+		bandBottom = bandTop;
+	}
+	segments.push_back(Segment{ x0, y0, x1, y1, ux, uy, reciprocal(ux), invUy, length,
+		(int)top, (int)bottom, (int)bandTop, (int)bandBottom });
+}
+
+void raster::Stroker::cover(const Segment& segment, int y)
+{
+	const double cy = y + 0.5;
+	const double outer = halfWidth + 0.5;
+	if (y >= segment.bandTop && y < segment.bandBottom)
+	{
+		int first;
+		int last;
+		if (findBand(segment, y, first, last))
+		{
+			coverBand(segment, y, first, last, coverage.data() - clipLeft, true);
+			minX = std::min(minX, first - clipLeft);
+			maxX = std::max(maxX, last - clipLeft);
+		}
+		return;
+	}
+	double lo;
+	double hi;
+	if (!segment.reach(cy, outer, lo, hi))
+	{
+		return;
+	}
+	// The segment may reach far off the canvas
+	int first;
+	int last;
+	if (!findSpan(lo, hi, clipLeft, clipRight, first, last))
+	{
+		return;
+	}
+
+	// Pixels within halfWidth - 0.5 are covered fully, without a distance
+	int solidFirst = last + 1;
+	int solidLast = last;
+	const double inner = halfWidth - 0.5;
+	if (inner > 0.0 && segment.reach(cy, inner, lo, hi))
+	{
+		solidFirst = (int)std::clamp(std::ceil(lo - 0.5), (double)first, last + 1.0);
+		solidLast = (int)std::clamp(std::floor(hi - 0.5), solidFirst - 1.0, (double)last);
+	}
+
+	std::uint8_t* row = coverage.data() - clipLeft;
+	auto coverPixel = [&](int x)
+	{
+		row[x] = std::max(row[x], toCoverage(outer - segment.distance(x + 0.5, cy)));
+	};
+	for (int x = first; x < solidFirst; x++)
+	{
+		coverPixel(x);
+	}
+	if (solidFirst <= solidLast)
+	{
+		std::fill(row + solidFirst, row + solidLast + 1, (std::uint8_t)255);
+	}
+	for (int x = std::max(solidFirst, solidLast + 1); x <= last; x++)
+	{
+		coverPixel(x);
+	}
+	minX = std::min(minX, first - clipLeft);
+	maxX = std::max(maxX, last - clipLeft);
+}
+
+void raster::Stroker::strokeSegment(const Segment& segment, const SpanSink& sink)
+{
+	for (int y = segment.top; y < segment.bandTop; y++)
+	{
+		cover(segment, y);
+		flush(y, sink);
+	}
+	// Nothing else covers the rows between the ends, so they go to sink as
+	// they come, from the start of the row buffer
+	int used = 0;
+	for (int y = segment.bandTop; y < segment.bandBottom; y++)
+	{
+		int first;
+		int last;
+		if (findBand(segment, y, first, last))
+		{
+			coverBand(segment, y, first, last, coverage.data() - first, false);
+			sink(y, first, coverage.data(), last - first + 1);
+			used = std::max(used, last - first + 1);
+		}
+	}
+	std::fill(coverage.begin(), coverage.begin() + used, (std::uint8_t)0);
+	for (int y = segment.bandBottom; y < segment.bottom; y++)
+	{
+		cover(segment, y);
+		flush(y, sink);
+	}
+}
+
+bool raster::Stroker::findBand(const Segment& segment, int y, int& first, int& last) const
+{
+	const double outer = halfWidth + 0.5;
+	const double h = y + 0.5 - segment.y0;
+	double lo = segment.x0 + (h * segment.ux - outer) * segment.invUy;
+	double hi = segment.x0 + (h * segment.ux + outer) * segment.invUy;
+	if (lo > hi)
+	{
+		std::swap(lo, hi);
+	}
+	first = ceilToInt(std::clamp(lo - 0.5, (double)clipLeft, (double)clipRight));
+	last = floorToInt(std::clamp(hi - 0.5, clipLeft - 1.0, clipRight - 1.0));
+	return first <= last;
+}
+
+void raster::Stroker::coverBand(const Segment& segment, int y, int first, int last,
+	std::uint8_t* row, bool isMerged) const
+{
+	// The distance to the line, worked out as Segment::distance() does so
+	// that the pixels come out the same either way. Pixels well inside clamp
+	// to 255 on their own, which is cheaper than finding them for the narrow
+	// spans of a band. Held in locals, as the row could alias the segment.
+	const double outer = halfWidth + 0.5;
+	const double x0 = segment.x0;
+	const double uy = segment.uy;
+	const double hux = (y + 0.5 - segment.y0) * segment.ux;
+	if (isMerged)
+	{
+		for (int x = first; x <= last; x++)
+		{
+			row[x] = std::max(row[x], toCoverage(outer - std::abs((x + 0.5 - x0) * uy - hux)));
+		}
+	}
+	else
+	{
+		for (int x = first; x <= last; x++)
+		{
+			row[x] = toCoverage(outer - std::abs((x + 0.5 - x0) * uy - hux));
+		}
+	}
+}
+
+void raster::Stroker::flush(int y, const SpanSink& sink)
+{
+	if (minX > maxX)
+	{
+		return;
+	}
+	// Runs of covered pixels, leaving out the gaps between parts of the path
+	int x = minX;
+	while (x <= maxX)
+	{
+		while (x <= maxX && coverage[x] == 0)
+		{
+			x++;
+		}
+		const int start = x;
+		while (x <= maxX && coverage[x] != 0)
+		{
+			x++;
+		}
+		if (start < x)
+		{
+			sink(y, clipLeft + start, coverage.data() + start, x - start);
+		}
+	}
+	std::fill(coverage.begin() + minX, coverage.begin() + maxX + 1, (std::uint8_t)0);
+	minX = clipRight - clipLeft;
+	maxX = -1;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "Scanline.h"
+
+namespace raster
+{
+	/**
+	 * Anti-aliased stroker for polylines and elliptical arcs, with a round pen.
+	 *
+	 * The stroke is every point within half the pen width of the path, so
+	 * ends and corners come out round. A pixel is covered fully when its
+	 * center lies half a pixel inside that outline, not at all half a pixel
+	 * outside, and in proportion in between. Coverage comes from the nearest
+	 * segment, so a pixel where segments meet or cross is handed out once and
+	 * translucent pens do not darken the joints.
+	 *
+	 * Rows are swept top to bottom over the segments within reach of them. A
+	 * segment covers one interval of a row, found in closed form, and only the
+	 * pixels at its ends need their distance to the segment, so a stroke costs
+	 * O(segments + pixels). Segments out of reach of the clip box are skipped
+	 * and nothing else depends on the box, so the tiles of a canvas stroke a
+	 * path exactly as the whole canvas would.
+	 *
+	 * Closed circles are not flattened: their pixels are covered from the
+	 * exact distance to the circle itself. Other arcs and ellipses are
+	 * flattened into chords within a tenth of a pixel of the curve.
+	 *
+	 * A stroker keeps its buffers between strokes and is used by one thread.
+	 */
+	class Stroker
+	{
+	public:
+		// Strokes the polyline through the n vertices stored as interleaved
+		// (x, y) pairs in xy, back to the first one if isClosed, with a pen
+		// penWidth pixels wide, at least one. Only the pixels in the clip box
+		// [left, right) x [top, bottom) are handed to sink.
+		void polyline(const float* xy, size_t n, bool isClosed, double penWidth,
+			int left, int top, int right, int bottom, const SpanSink& sink);
+
+		// Strokes the arc of the ellipse inscribed in the box (x, y, width,
+		// height) going sweep degrees counterclockwise from start degrees, 0
+		// being 3 o'clock. A sweep of a whole turn strokes the closed ellipse.
+		void arc(double x, double y, double width, double height, double start, double sweep,
+			double penWidth, int left, int top, int right, int bottom, const SpanSink& sink);
+
+	private:
+		struct Segment
+		{
+			double x0;
+			double y0;
+			double x1;
+			double y1;
+			// Unit direction, zero for a dot, and the reciprocals of its
+			// components, zero where they are about zero
+			double ux;
+			double uy;
+			double invUx;
+			double invUy;
+			double length;
+			// Rows [top, bottom) of the clip box within reach, and rows
+			// [bandTop, bandBottom) among them passing between the ends, out
+			// of their reach
+			int top;
+			int bottom;
+			int bandTop;
+			int bandBottom;
+
+			// Interval [lo, hi] of the row at height y whose points lie within
+			// r of the segment; false if there are none
+			bool reach(double y, double r, double& lo, double& hi) const;
+			double distance(double x, double y) const;
+		};
+
+		// Strokes the closed circle centered at (cx, cy) straight from its
+		// distance
+		void ring(double cx, double cy, double radius, double penWidth,
+			int left, int top, int right, int bottom, const SpanSink& sink);
+		// Adds the segment from (x0, y0) to (x1, y1) if it reaches the clip box
+		void addSegment(double x0, double y0, double x1, double y1);
+		// Raises the coverage of row y to what segment covers of it
+		void cover(const Segment& segment, int y);
+		// Strokes a path of one segment
+		void strokeSegment(const Segment& segment, const SpanSink& sink);
+		// Pixels [first, last] of a row between the ends of segment within its
+		// reach; false if there are none in the clip box
+		bool findBand(const Segment& segment, int y, int& first, int& last) const;
+		// Writes the coverage of pixels [first, last] of such a row to row[x],
+		// or raises row[x] to it if isMerged
+		void coverBand(const Segment& segment, int y, int first, int last, std::uint8_t* row, bool isMerged) const;
+		// Hands the coverage of row y to sink and clears it
+		void flush(int y, const SpanSink& sink);
+
+		// Stroke in progress
+		double halfWidth = 0.0;
+		int clipLeft = 0;
+		int clipTop = 0;
+		int clipRight = 0;
+		int clipBottom = 0;
+		// Pixels of the row touched so far, relative to clipLeft
+		int minX = 0;
+		int maxX = 0;
+
+		std::vector<Segment> segments;
+		// Segments by first row, and those reaching the current one
+		std::vector<std::uint32_t> order;
+		std::vector<std::uint32_t> active;
+		// Coverage of the current row, from clipLeft on
+		std::vector<std::uint8_t> coverage;
+		// Vertices of a flattened arc
+		std::vector<float> path;
+	};
+}
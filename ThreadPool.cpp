@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+raster::ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (unsigned i = 0; i < threads; i++)
+	{
+		queues.push_back(std::make_unique<Queue>());
+	}
+	for (unsigned i = 1; i < threads; i++)
+	{
+		workers.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+raster::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void raster::ThreadPool::run(size_t count, const PoolTask& task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (workers.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			task(i, 0);
+		}
+		return;
+	}
+
+	// Neighbouring iterations start out on the same thread; stealing from
+	// the front takes the ones its owner would get to last
+	const size_t threads = queues.size();
+	for (size_t t = 0; t < threads; t++)
+	{
+		std::lock_guard<std::mutex> lock(queues[t]->mutex);
+		for (size_t i = count * t / threads; i < count * (t + 1) / threads; i++)
+		{
+			queues[t]->indices.push_front(i);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		generation++;
+		busy = (unsigned)workers.size();
+	}
+	wake.notify_all();
+
+	drain(0);
+
+	// A worker still stealing could otherwise take iterations of the next loop
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return busy == 0; });
+	this->task = nullptr;
+}
+
+void raster::ThreadPool::work(unsigned thread)
+{
+	std::uint64_t seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quitting || generation != seen; });
+			if (quitting)
+			{
+				return;
+			}
+			seen = generation;
+		}
+		drain(thread);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0)
+		{
+			idle.notify_one();
+		}
+	}
+}
+
+void raster::ThreadPool::drain(unsigned thread)
+{
+	size_t index = 0;
+	while (take(thread, index))
+	{
+		(*task)(index, thread);
+	}
+}
+
+bool raster::ThreadPool::take(unsigned thread, size_t& index)
+{
+	{
+		Queue& own = *queues[thread];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.indices.empty())
+		{
+			index = own.indices.back();
+			own.indices.pop_back();
+			return true;
+		}
+	}
+	const size_t threads = queues.size();
+	for (size_t k = 1; k < threads; k++)
+	{
+		Queue& victim = *queues[(thread + k) % threads];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.indices.empty())
+		{
+			index = victim.indices.front();
+			victim.indices.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace raster
+{
+	// One iteration of a parallel loop: index of the iteration and number of
+	// the thread running it
+	using PoolTask = std::function<void(size_t index, unsigned thread)>;
+
+	/**
+	 * Fixed set of threads running the iterations of parallel loops.
+	 *
+	 * Every thread owns a deque of iterations. It takes work from the back of
+	 * its own deque and, once that is empty, steals from the front of the
+	 * others, so uneven iterations even out without a central queue. The
+	 * thread calling run() works as thread 0.
+	 */
+	class ThreadPool
+	{
+	public:
+		// threads counts the caller of run(); 0 means one per hardware thread
+		explicit ThreadPool(unsigned threads = 0);
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned viewThreadCount() const { return (unsigned)queues.size(); }
+
+		// Calls task(index, thread) for every index in [0, count) and returns
+		// once all calls are done. thread is below viewThreadCount() and lets
+		// tasks keep scratch buffers per thread. Only one thread may call run().
+		void run(size_t count, const PoolTask& task);
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<size_t> indices;
+		};
+
+		// Worker thread: runs the iterations of every loop until the pool dies
+		void work(unsigned thread);
+		// Runs iterations until every deque is empty
+		void drain(unsigned thread);
+		// Next iteration for thread, its own or stolen; false if none is left
+		bool take(unsigned thread, size_t& index);
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		// Loop being run, set before generation is bumped
+		const PoolTask* task = nullptr;
+		std::uint64_t generation = 0;
+		// Workers still running the current loop
+		unsigned busy = 0;
+		bool quitting = false;
+	};
+}
@@ -0,0 +1,401 @@
+#include "TileRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+
+namespace
+{
+	// Primitives binned before the tiles are drawn, bounding the memory used
+	constexpr size_t CHUNK_PRIMITIVES = 1 << 16;
+	// Smaller chunks are drawn on one thread, waking the pool would cost more
+	constexpr size_t MIN_PARALLEL_PRIMITIVES = 64;
+	// Filled polygons meeting more tiles are filled alone on the whole canvas
+	constexpr size_t MAX_POLYGON_TILES = 4;
+
+	// Strokes reach half a pixel past half their width
+	double strokePad(const cwt::Pen& pen, const raster::Surface& fb)
+	{
+		return std::max(raster::penWidth(pen, fb), 1.0) / 2 + 1.0;
+	}
+}
+
+class raster::TileRenderer::Binner
+{
+public:
+	explicit Binner(TileRenderer& tiles) : tiles(tiles) {}
+
+	void line(geom::PenRef pen, float x1, float y1, float x2, float y2)
+	{
+		const float c[4] = { x1, y1, x2, y2 };
+		tiles.add(Shape::Line, *pen, c, 4);
+		tiles.finishBin(tiles.binSegment(x1, y1, x2, y2, strokePad(*pen, *tiles.target)));
+	}
+
+	void ellipse(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+	{
+		const float c[4] = { x, y, width, height };
+		tiles.add(isFill ? Shape::FilledEllipse : Shape::Ellipse, *pen, c, 4);
+		binBox(x, y, width, height, isFill ? 1.0 : strokePad(*pen, *tiles.target));
+	}
+
+	void arc(geom::PenRef pen, float x, float y, float width, float height, float start, float sweep)
+	{
+		const float c[6] = { x, y, width, height, start, sweep };
+		tiles.add(Shape::Arc, *pen, c, 6);
+		binBox(x, y, width, height, strokePad(*pen, *tiles.target));
+	}
+
+	void rectangle(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+	{
+		const float c[4] = { x, y, width, height };
+		tiles.add(isFill ? Shape::FilledRectangle : Shape::Rectangle, *pen, c, 4);
+		binBox(x, y, width, height, isFill ? 1.0 : strokePad(*pen, *tiles.target));
+	}
+
+	void polygon(geom::PenRef pen, const float* xy, size_t n, bool isFill)
+	{
+		if (n == 0)
+		{
+			return;
+		}
+		if (!isFill)
+		{
+			stroke(Shape::Polygon, pen, xy, n, true);
+			return;
+		}
+
+		double left = xy[0];
+		double top = xy[1];
+		double right = left;
+		double bottom = top;
+		for (size_t i = 1; i < n; i++)
+		{
+			left = std::min(left, (double)xy[2 * i]);
+			right = std::max(right, (double)xy[2 * i]);
+			top = std::min(top, (double)xy[2 * i + 1]);
+			bottom = std::max(bottom, (double)xy[2 * i + 1]);
+		}
+		int x0, y0, x1, y1;
+		if (!tiles.findTiles(left - 1.0, top - 1.0, right + 1.0, bottom + 1.0, x0, y0, x1, y1))
+		{
+			return;
+		}
+		if ((size_t)(x1 - x0 + 1) * (y1 - y0 + 1) > MAX_POLYGON_TILES)
+		{
+			tiles.drawChunk();
+			RasterDevice device(*tiles.target, *tiles.glyphs, tiles.canvasFiller, tiles.strokers[0]);
+			device.polygon(pen, xy, n, isFill);
+			return;
+		}
+		tiles.add(Shape::FilledPolygon, *pen, xy, 2 * n, (std::uint32_t)n);
+		tiles.bin(left - 1.0, top - 1.0, right + 1.0, bottom + 1.0);
+	}
+
+	void polyline(geom::PenRef pen, const float* xy, size_t n)
+	{
+		if (n > 0)
+		{
+			stroke(Shape::Polyline, pen, xy, n, false);
+		}
+	}
+
+	void text(geom::PenRef pen, geom::FontRef font, const wchar_t* text, float x, float y)
+	{
+		// Tiles only read the atlas, every glyph goes in now
+		tiles.glyphs->prepare(*font, text);
+		int width = 0;
+		int height = 0;
+		tiles.glyphs->measure(*font, text, std::wcslen(text), width, height);
+
+		const float c[2] = { x, y };
+		tiles.add(Shape::Text, *pen, c, 2, (std::uint32_t)tiles.texts.size());
+		tiles.texts.push_back(TextRun{ &*font, text });
+		// Glyphs may overhang their line by about as much as it is high
+		const double left = std::lround(x);
+		const double top = std::lround(y);
+		if (!tiles.bin(left - height, top - height, left + width + height, top + 2.0 * height))
+		{
+			tiles.texts.pop_back();
+		}
+	}
+
+	void lines(geom::PenRef pen, const float* segments, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* s = segments + 4 * i;
+			line(pen, s[0], s[1], s[2], s[3]);
+		}
+	}
+
+	void filledEllipses(geom::PenRef pen, const float* boxes, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* b = boxes + 4 * i;
+			ellipse(pen, b[0], b[1], b[2], b[3], true);
+		}
+	}
+
+	void filledRectangles(geom::PenRef pen, const float* boxes, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* b = boxes + 4 * i;
+			rectangle(pen, b[0], b[1], b[2], b[3], true);
+		}
+	}
+
+private:
+	// Bins a stroke through n vertices by its segments, so that a long path
+	// only goes to the tiles along it
+	void stroke(Shape shape, geom::PenRef pen, const float* xy, size_t n, bool isClosed)
+	{
+		tiles.add(shape, *pen, xy, 2 * n, (std::uint32_t)n);
+		const double pad = strokePad(*pen, *tiles.target);
+		const size_t count = isClosed || n == 1 ? n : n - 1;
+		bool isBinned = false;
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t j = (i + 1) % n;
+			isBinned |= tiles.binSegment(xy[2 * i], xy[2 * i + 1], xy[2 * j], xy[2 * j + 1], pad);
+		}
+		tiles.finishBin(isBinned);
+	}
+
+	// Bins the last primitive by its box, which may have a negative size
+	void binBox(double x, double y, double width, double height, double pad)
+	{
+		const double left = std::min(x, x + width);
+		const double top = std::min(y, y + height);
+		tiles.bin(left - pad, top - pad, left + std::abs(width) + pad, top + std::abs(height) + pad);
+	}
+
+	TileRenderer& tiles;
+};
+
+raster::TileRenderer::TileRenderer(unsigned threads)
+	: pool(threads), fillers(pool.viewThreadCount()), canvasFiller(&pool), strokers(pool.viewThreadCount())
+{
+}
+
+void raster::TileRenderer::render(Surface& fb, geom::DisplayList& list, size_t& drawn, text::GlyphAtlas& glyphs)
+{
+	if (pool.viewThreadCount() == 1)
+	{
+		RasterDevice device(fb, glyphs, fillers[0], strokers[0]);
+		list.replayNew(device, drawn);
+		return;
+	}
+
+	target = &fb;
+	this->glyphs = &glyphs;
+	columns = (fb.viewWidth() + TILE_SIZE - 1) / TILE_SIZE;
+	rows = (fb.viewHeight() + TILE_SIZE - 1) / TILE_SIZE;
+	bins.resize((size_t)columns * rows);
+
+	Binner binner(*this);
+	list.replayNew(binner, drawn);
+	drawChunk();
+	target = nullptr;
+	this->glyphs = nullptr;
+}
+
+void raster::TileRenderer::add(Shape shape, const cwt::Pen& pen, const float* c, size_t n, std::uint32_t count)
+{
+	primitives.push_back(Primitive{ &pen, (std::uint32_t)coords.size(), count, shape });
+	coords.insert(coords.end(), c, c + n);
+}
+
+bool raster::TileRenderer::findTiles(double left, double top, double right, double bottom,
+	int& x0, int& y0, int& x1, int& y1) const
+{
+	// Written so that NaN boxes meet no tile either
+	if (!(right >= 0.0 && bottom >= 0.0 && left < target->viewWidth() && top < target->viewHeight()))
+	{
+		return false;
+	}
+	x0 = (int)std::max(left / TILE_SIZE, 0.0);
+	y0 = (int)std::max(top / TILE_SIZE, 0.0);
+	x1 = (int)std::min(right / TILE_SIZE, columns - 1.0);
+	y1 = (int)std::min(bottom / TILE_SIZE, rows - 1.0);
+	return true;
+}
+
+bool raster::TileRenderer::bin(double left, double top, double right, double bottom)
+{
+	int x0, y0, x1, y1;
+	const bool isBinned = findTiles(left, top, right, bottom, x0, y0, x1, y1);
+	if (isBinned)
+	{
+		for (int ty = y0; ty <= y1; ty++)
+		{
+			addToTiles(ty, x0, x1);
+		}
+	}
+	finishBin(isBinned);
+	return isBinned;
+}
+
+bool raster::TileRenderer::binSegment(double x1, double y1, double x2, double y2, double pad)
+{
+	const double top = std::min(y1, y2) - pad;
+	const double bottom = std::max(y1, y2) + pad;
+	if (!(bottom - top >= TILE_SIZE))
+	{
+		int tx0, ty0, tx1, ty1;
+		if (!findTiles(std::min(x1, x2) - pad, top, std::max(x1, x2) + pad, bottom, tx0, ty0, tx1, ty1))
+		{
+			return false;
+		}
+		for (int ty = ty0; ty <= ty1; ty++)
+		{
+			addToTiles(ty, tx0, tx1);
+		}
+		return true;
+	}
+
+	// A segment crossing rows of tiles only goes to the tiles along it
+	const int first = (int)std::clamp(top / TILE_SIZE, 0.0, (double)rows);
+	const int last = (int)std::clamp(bottom / TILE_SIZE, -1.0, rows - 1.0);
+	const double dx = x2 - x1;
+	const double dy = y2 - y1;
+	bool isBinned = false;
+	for (int ty = first; ty <= last; ty++)
+	{
+		// Part of the segment within pad of the row; a thick level one is all in it
+		double t0 = 0.0;
+		double t1 = 1.0;
+		if (dy != 0.0)
+		{
+			t0 = ((double)ty * TILE_SIZE - pad - y1) / dy;
+			t1 = ((double)(ty + 1) * TILE_SIZE + pad - y1) / dy;
+			if (t0 > t1)
+			{
+				std::swap(t0, t1);
+			}
+			t0 = std::max(t0, 0.0);
+			t1 = std::min(t1, 1.0);
+		}
+		const double xa = x1 + t0 * dx;
+		const double xb = x1 + t1 * dx;
+		const double left = std::min(xa, xb) - pad;
+		const double right = std::max(xa, xb) + pad;
+		if (!(t0 <= t1 && right >= 0.0 && left < target->viewWidth()))
+		{
+			continue;
+		}
+		addToTiles(ty, (int)std::max(left / TILE_SIZE, 0.0), (int)std::min(right / TILE_SIZE, columns - 1.0));
+		isBinned = true;
+	}
+	return isBinned;
+}
+
+void raster::TileRenderer::finishBin(bool isBinned)
+{
+	if (!isBinned)
+	{
+		drop();
+	}
+	else if (primitives.size() >= CHUNK_PRIMITIVES)
+	{
+		drawChunk();
+	}
+}
+
+void raster::TileRenderer::addToTiles(int row, int first, int last)
+{
+	const std::uint32_t index = (std::uint32_t)(primitives.size() - 1);
+	for (int column = first; column <= last; column++)
+	{
+		const std::uint32_t tile = (std::uint32_t)(row * columns + column);
+		if (bins[tile].empty())
+		{
+			busyTiles.push_back(tile);
+		}
+		else if (bins[tile].back() == index)
+		{
+			// Segments of one stroke meeting the same tile
+			continue;
+		}
+		bins[tile].push_back(index);
+	}
+}
+
+void raster::TileRenderer::drop()
+{
+	coords.resize(primitives.back().first);
+	primitives.pop_back();
+}
+
+void raster::TileRenderer::drawChunk()
+{
+	if (primitives.size() < MIN_PARALLEL_PRIMITIVES)
+	{
+		RasterDevice device(*target, *glyphs, fillers[0], strokers[0], true);
+		for (const Primitive& primitive : primitives)
+		{
+			draw(device, primitive);
+		}
+	}
+	else
+	{
+		pool.run(busyTiles.size(), [this](size_t i, unsigned thread)
+			{
+				const int tile = (int)busyTiles[i];
+				const int x = tile % columns * TILE_SIZE;
+				const int y = tile / columns * TILE_SIZE;
+				Surface view(*target, x, y, x + TILE_SIZE, y + TILE_SIZE);
+				RasterDevice device(view, *glyphs, fillers[thread], strokers[thread], true);
+				for (std::uint32_t index : bins[tile])
+				{
+					draw(device, primitives[index]);
+				}
+			});
+	}
+
+	for (std::uint32_t tile : busyTiles)
+	{
+		bins[tile].clear();
+	}
+	busyTiles.clear();
+	primitives.clear();
+	coords.clear();
+	texts.clear();
+}
+
+void raster::TileRenderer::draw(RasterDevice& device, const Primitive& primitive) const
+{
+	const geom::PenRef pen{ 0, *primitive.pen };
+	const float* c = coords.data() + primitive.first;
+	switch (primitive.shape)
+	{
+	case Shape::Line:
+		device.line(pen, c[0], c[1], c[2], c[3]);
+		break;
+	case Shape::Ellipse:
+	case Shape::FilledEllipse:
+		device.ellipse(pen, c[0], c[1], c[2], c[3], primitive.shape == Shape::FilledEllipse);
+		break;
+	case Shape::Arc:
+		device.arc(pen, c[0], c[1], c[2], c[3], c[4], c[5]);
+		break;
+	case Shape::Rectangle:
+	case Shape::FilledRectangle:
+		device.rectangle(pen, c[0], c[1], c[2], c[3], primitive.shape == Shape::FilledRectangle);
+		break;
+	case Shape::Polygon:
+	case Shape::FilledPolygon:
+		device.polygon(pen, c, primitive.count, primitive.shape == Shape::FilledPolygon);
+		break;
+	case Shape::Polyline:
+		device.polyline(pen, c, primitive.count);
+		break;
+	case Shape::Text:
+	{
+		const TextRun& run = texts[primitive.count];
+		device.text(pen, geom::FontRef{ 0, *run.font }, run.text, c[0], c[1]);
+		break;
+	}
+	}
+}
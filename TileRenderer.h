@@ -0,0 +1,115 @@
+#pragma once
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "Raster.h"
+#include "RasterDevice.h"
+#include "Scanline.h"
+#include "Stroker.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+namespace raster
+{
+	/**
+	 * Rasterizes display lists on every core.
+	 *
+	 * The canvas is cut into square tiles. The primitives of new commands are
+	 * binned to the tiles they may touch, then the tiles are drawn on a
+	 * work-stealing pool, each one drawing its primitives in list order
+	 * through a view clipped to it. A pixel only depends on the primitives
+	 * covering it and their order, so the canvas ends up exactly as if one
+	 * thread had drawn everything.
+	 *
+	 * Primitives are binned in chunks of bounded size. A filled polygon
+	 * spanning many tiles would be filled again for each of them, so it ends
+	 * the chunk and is filled alone on the whole canvas.
+	 */
+	class TileRenderer
+	{
+	public:
+		static constexpr int TILE_SIZE = 128;
+
+		// threads as for ThreadPool; with one, everything is drawn directly
+		explicit TileRenderer(unsigned threads = 0);
+
+		// Rasterizes into fb what list holds past drawn, like
+		// DisplayList::replayNew(), and advances drawn
+		void render(Surface& fb, geom::DisplayList& list, size_t& drawn, text::GlyphAtlas& glyphs);
+	private:
+		enum class Shape : std::uint8_t
+		{
+			Line,
+			Ellipse,
+			FilledEllipse,
+			Arc,
+			Rectangle,
+			FilledRectangle,
+			Polygon,
+			FilledPolygon,
+			Polyline,
+			Text
+		};
+
+		struct Primitive
+		{
+			const cwt::Pen* pen;
+			// Index of the first coordinate in coords
+			std::uint32_t first;
+			// Vertices of a polygon or polyline, index into texts of a text
+			std::uint32_t count;
+			Shape shape;
+		};
+
+		struct TextRun
+		{
+			const cwt::Font* font;
+			const wchar_t* text;
+		};
+
+		// Device replaying the display list into the bins
+		class Binner;
+
+		// Adds a primitive with its coordinates
+		void add(Shape shape, const cwt::Pen& pen, const float* c, size_t n, std::uint32_t count = 0);
+		// Range of tiles meeting the box; false if there are none
+		bool findTiles(double left, double top, double right, double bottom, int& x0, int& y0, int& x1, int& y1) const;
+		// Bins the last primitive added to the tiles meeting the box, dropping
+		// it if there are none
+		bool bin(double left, double top, double right, double bottom);
+		// Bins the last primitive added to the tiles within pad of a segment of
+		// it; false if there are none. finishBin() must follow.
+		bool binSegment(double x1, double y1, double x2, double y2, double pad);
+		// Drops the last primitive added if it was not binned, and draws the
+		// chunk once it is full
+		void finishBin(bool isBinned);
+		// Bins the last primitive added to tiles [first, last] of a row, once
+		// however many of its parts meet them
+		void addToTiles(int row, int first, int last);
+		// Forgets the last primitive added
+		void drop();
+		// Draws and forgets the primitives binned so far
+		void drawChunk();
+		void draw(RasterDevice& device, const Primitive& primitive) const;
+
+		ThreadPool pool;
+		// One per pool thread
+		std::vector<ScanlineFiller> fillers;
+		// Fills the polygons drawn alone on the whole canvas, in bands on pool
+		ScanlineFiller canvasFiller;
+		std::vector<Stroker> strokers;
+
+		// Target of the render() call in progress
+		Surface* target = nullptr;
+		text::GlyphAtlas* glyphs = nullptr;
+		int columns = 0;
+		int rows = 0;
+
+		std::vector<Primitive> primitives;
+		std::vector<float> coords;
+		std::vector<TextRun> texts;
+		// Primitives of every tile, row by row, and the tiles with any
+		std::vector<std::vector<std::uint32_t>> bins;
+		std::vector<std::uint32_t> busyTiles;
+	};
+}
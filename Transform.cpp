@@ -0,0 +1,18 @@
+#include "Transform.h"
+
+void geom::Transform::setScale(double xmin, double xmax, double ymin, double ymax, int width, int height)
+{
+	// x * width / (xmax - xmin) - xmin * width / (xmax - xmin), and y flipped
+	scale.sx = width / (xmax - xmin);
+	scale.dx = -xmin * scale.sx;
+	scale.sy = -height / (ymax - ymin);
+	scale.dy = -ymax * scale.sy;
+	if (scale.sx == 1.0 && scale.dx == 0.0 && scale.sy == 1.0 && scale.dy == 0.0)
+	{
+		kind = Kind::Identity;
+	}
+	else
+	{
+		kind = Kind::Scale;
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "Simd.h"
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+// Transforms from user coordinates to pixels. Every kind of transform is a
+// policy type with the same inline members, so a kernel written as a template
+// over the policy compiles to plain multiply-adds for the kind at hand, and a
+// Transform picks the policy that fits its scale once per call.
+namespace geom
+{
+	// (x, y) -> (sx * x + dx, sy * y + dy)
+	struct Scale
+	{
+		double sx = 1.0;
+		double dx = 0.0;
+		double sy = 1.0;
+		double dy = 0.0;
+	};
+
+	// User coordinates are pixels already
+	struct IdentityTransform
+	{
+		// Each axis maps on its own as value * scale + offset
+		static constexpr bool IS_SEPARABLE = true;
+
+		void apply(double x, double y, double& px, double& py) const { px = x; py = y; }
+		double lengthX(double w) const { return w; }
+		double lengthY(double h) const { return h; }
+		double scaleX() const { return 1.0; }
+		double offsetX() const { return 0.0; }
+		double scaleY() const { return 1.0; }
+		double offsetY() const { return 0.0; }
+	};
+
+	// A scale and an offset per axis, which is what StdDraw::setScale() makes
+	struct ScaleTransform
+	{
+		static constexpr bool IS_SEPARABLE = true;
+
+		void apply(double x, double y, double& px, double& py) const
+		{
+			px = x * scale.sx + scale.dx;
+			py = y * scale.sy + scale.dy;
+		}
+		double lengthX(double w) const { return w * std::abs(scale.sx); }
+		double lengthY(double h) const { return h * std::abs(scale.sy); }
+		double scaleX() const { return scale.sx; }
+		double offsetX() const { return scale.dx; }
+		double scaleY() const { return scale.sy; }
+		double offsetY() const { return scale.dy; }
+
+		Scale scale;
+	};
+
+	// Polar coordinates and log scales in front of a linear transform. Points
+	// given as (radius, angle in degrees) are turned into (x, y) first, then a
+	// log scale replaces a coordinate by its base 10 logarithm. Lengths are
+	// those of the linear transform.
+	template <class Linear>
+	struct CurvedTransform
+	{
+		static constexpr bool IS_SEPARABLE = false;
+
+		void apply(double x, double y, double& px, double& py) const
+		{
+			if (isPolar)
+			{
+				const double angle = y * (3.14159265358979323846 / 180.0);
+				y = x * std::sin(angle);
+				x = x * std::cos(angle);
+			}
+			if (isLogX)
+			{
+				x = std::log10(x);
+			}
+			if (isLogY)
+			{
+				y = std::log10(y);
+			}
+			linear.apply(x, y, px, py);
+		}
+		double lengthX(double w) const { return linear.lengthX(w); }
+		double lengthY(double h) const { return linear.lengthY(h); }
+
+		Linear linear;
+		bool isLogX;
+		bool isLogY;
+		bool isPolar;
+	};
+
+	// Transforms the points (x[i], y[i]), i in [0, n), into
+	// (outX[i * stride], outY[i * stride]), moved by shift pixels along both
+	// axes. The output may overwrite the input when stride is 1.
+	template <class Policy>
+	void transformPoints(const Policy& transform, const double* x, const double* y, size_t n,
+		double* outX, double* outY, size_t stride, double shift = 0.0)
+	{
+		if constexpr (Policy::IS_SEPARABLE)
+		{
+			simd::affine(x, n, transform.scaleX(), transform.offsetX() + shift, outX, stride);
+			simd::affine(y, n, transform.scaleY(), transform.offsetY() + shift, outY, stride);
+		}
+		else
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				double px;
+				double py;
+				transform.apply(x[i], y[i], px, py);
+				outX[i * stride] = px + shift;
+				outY[i * stride] = py + shift;
+			}
+		}
+	}
+
+	/**
+	 * The transform in use: a scale per axis computed once when it changes,
+	 * and optional polar coordinates and log scales.
+	 *
+	 * visit(kernel) calls kernel with the cheapest policy that does the same
+	 * as the scale, so a kernel instantiated for each policy only pays for
+	 * what the transform needs.
+	 */
+	class Transform
+	{
+	public:
+		// Maps [xmin, xmax] x [ymin, ymax] onto a width x height canvas, with
+		// y going up
+		void setScale(double xmin, double xmax, double ymin, double ymax, int width, int height);
+
+		void setLogX(bool enabled) { isLogX = enabled; }
+		void setLogY(bool enabled) { isLogY = enabled; }
+		void setPolar(bool enabled) { isPolar = enabled; }
+
+		// True with polar coordinates or a log scale, where points may have no
+		// image and transformed coordinates must be checked
+		bool isCurved() const { return isLogX || isLogY || isPolar; }
+
+		template <class Kernel>
+		decltype(auto) visit(Kernel&& kernel) const
+		{
+			if (isCurved())
+			{
+				return visitLinear([&](const auto& linear)
+					{
+						using Linear = std::decay_t<decltype(linear)>;
+						return kernel(CurvedTransform<Linear>{ linear, isLogX, isLogY, isPolar });
+					});
+			}
+			return visitLinear(kernel);
+		}
+
+		void apply(double x, double y, double& px, double& py) const
+		{
+			visit([&](const auto& transform) { transform.apply(x, y, px, py); });
+		}
+		double lengthX(double w) const
+		{
+			return visit([w](const auto& transform) { return transform.lengthX(w); });
+		}
+		double lengthY(double h) const
+		{
+			return visit([h](const auto& transform) { return transform.lengthY(h); });
+		}
+	private:
+		enum class Kind
+		{
+			Identity,
+			Scale
+		};
+
+		template <class Kernel>
+		auto visitLinear(Kernel&& kernel) const -> decltype(kernel(IdentityTransform{}))
+		{
+			if (kind == Kind::Identity)
+			{
+				return kernel(IdentityTransform{});
+			}
+			return kernel(ScaleTransform{ scale });
+		}
+
+		Scale scale;
+		Kind kind = Kind::Identity;
+		bool isLogX = false;
+		bool isLogY = false;
+		bool isPolar = false;
+	};
+}
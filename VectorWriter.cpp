@@ -0,0 +1,1369 @@
+#include "VectorWriter.h"
+#include "Zlib.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Output is handed on to the file in pieces of about this size
+	constexpr size_t FLUSH_BYTES = 64 * 1024;
+
+	// Shapes merged into one path before another one is started, which keeps
+	// viewers from choking on a single huge path
+	constexpr size_t MAX_SUBPATHS = 4096;
+
+	// Coordinates are written in hundredths of a pixel, finer than any viewer
+	// shows, and clamped to a range they cannot overflow in
+	constexpr int COORDINATE_DECIMALS = 2;
+	constexpr double MAX_COORDINATE = 1e9;
+
+	/***************************************************************************
+	*  Output.
+	***************************************************************************/
+
+	class File
+	{
+	public:
+		explicit File(const std::string& path)
+			:
+			path(path),
+			stream(path, std::ios::binary | std::ios::trunc)
+		{
+			if (!stream)
+			{
+				throw std::runtime_error("cannot open " + path + " for writing");
+			}
+		}
+
+		void write(const void* data, size_t n)
+		{
+			stream.write(static_cast<const char*>(data), (std::streamsize)n);
+			offset += n;
+		}
+
+		void write(std::string_view text)
+		{
+			write(text.data(), text.size());
+		}
+
+		// Bytes written so far
+		size_t viewOffset() const { return offset; }
+
+		void close()
+		{
+			stream.close();
+			if (!stream)
+			{
+				throw std::runtime_error("error while writing " + path);
+			}
+		}
+
+	private:
+		std::string path;
+		std::ofstream stream;
+		size_t offset = 0;
+	};
+
+	// Text being written, numbers included
+	class Buffer
+	{
+	public:
+		void put(char c) { text.push_back(c); }
+		void put(std::string_view s) { text.append(s); }
+
+		void integer(long long v)
+		{
+			char digits[24];
+			const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), v);
+			text.append(digits, result.ptr);
+		}
+
+		// v rounded to the given number of decimals, without trailing zeros
+		void number(double v, int decimals = COORDINATE_DECIMALS)
+		{
+			fixed(toFixed(v, decimals), decimals);
+		}
+
+		// scaled / 10^decimals, without trailing zeros
+		void fixed(long long scaled, int decimals = COORDINATE_DECIMALS)
+		{
+			long long scale = 1;
+			for (int i = 0; i < decimals; i++)
+			{
+				scale *= 10;
+			}
+			if (scaled < 0)
+			{
+				put('-');
+				scaled = -scaled;
+			}
+			integer(scaled / scale);
+			long long fraction = scaled % scale;
+			if (fraction == 0)
+			{
+				return;
+			}
+			put('.');
+			while (fraction != 0)
+			{
+				scale /= 10;
+				put((char)('0' + fraction / scale));
+				fraction %= scale;
+			}
+		}
+
+		// x and y separated by a space
+		void point(double x, double y)
+		{
+			number(x);
+			put(' ');
+			number(y);
+		}
+
+		// v in units of 10^-decimals, the way number() rounds it
+		static long long toFixed(double v, int decimals = COORDINATE_DECIMALS)
+		{
+			if (!(std::abs(v) <= MAX_COORDINATE))
+			{
+				v = std::isnan(v) ? 0.0 : std::copysign(MAX_COORDINATE, v);
+			}
+			double scale = 1.0;
+			for (int i = 0; i < decimals; i++)
+			{
+				scale *= 10.0;
+			}
+			return std::llround(v * scale);
+		}
+
+		size_t size() const { return text.size(); }
+		std::string_view view() const { return text; }
+		void clear() { text.clear(); }
+
+	private:
+		std::string text;
+	};
+
+	// Appends ch to utf8, as UTF-8; a UTF-16 surrogate pair takes two calls,
+	// the first of which keeps the high half in pending
+	void appendUtf8(std::string& utf8, wchar_t ch, std::uint32_t& pending)
+	{
+		std::uint32_t c = (std::uint32_t)ch;
+		if (c >= 0xD800 && c < 0xDC00)
+		{
+			pending = c;
+			return;
+		}
+		if (c >= 0xDC00 && c < 0xE000)
+		{
+			if (pending == 0)
+			{
+				return;
+			}
+			c = 0x10000 + ((pending - 0xD800) << 10) + (c - 0xDC00);
+		}
+		pending = 0;
+		if (c < 0x80)
+		{
+			utf8.push_back((char)c);
+		}
+		else if (c < 0x800)
+		{
+			utf8.push_back((char)(0xC0 | c >> 6));
+			utf8.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x10000)
+		{
+			utf8.push_back((char)(0xE0 | c >> 12));
+			utf8.push_back((char)(0x80 | (c >> 6 & 0x3F)));
+			utf8.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x110000)
+		{
+			utf8.push_back((char)(0xF0 | c >> 18));
+			utf8.push_back((char)(0x80 | (c >> 12 & 0x3F)));
+			utf8.push_back((char)(0x80 | (c >> 6 & 0x3F)));
+			utf8.push_back((char)(0x80 | (c & 0x3F)));
+		}
+	}
+
+	std::string toUtf8(const wchar_t* text, size_t n)
+	{
+		std::string utf8;
+		std::uint32_t pending = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			appendUtf8(utf8, text[i], pending);
+		}
+		return utf8;
+	}
+
+	/***************************************************************************
+	*  Paths and styles, whatever the format.
+	***************************************************************************/
+
+	enum class Paint
+	{
+		Stroke,
+		// Stroke with square corners, for rectangle outlines
+		MiterStroke,
+		Fill,
+		// Fill with the even-odd rule, for polygons
+		EvenOddFill
+	};
+
+	bool isStroke(Paint paint)
+	{
+		return paint == Paint::Stroke || paint == Paint::MiterStroke;
+	}
+
+	// What a path is painted with: a color and, for strokes, a width
+	struct Style
+	{
+		cwt::ColorRgba color;
+		double width;	// zero for fills
+	};
+
+	constexpr int NO_STYLE = -1;
+
+	/**
+	 * Replays a display list as paths, which the formats below write out.
+	 *
+	 * Pens come in as interned handles and are turned into styles once each;
+	 * pens sharing a color share a fill style, and a stroke style if their
+	 * widths are the same too. A format sees each style once, when it is first
+	 * used, and refers to it by index from then on.
+	 *
+	 * Every shape is one or more subpaths. Opaque shapes of the same paint and
+	 * style, one after the other, go into the same path, so a graph of a
+	 * million edges drawn with one pen makes a handful of paths.
+	 */
+	class VectorDevice
+	{
+	public:
+		VectorDevice(int width, int height, text::GlyphAtlas& metrics, bool isCoalesced)
+			: width(width), height(height), metrics(metrics), isCoalesced(isCoalesced) {}
+		virtual ~VectorDevice() = default;
+
+		void line(geom::PenRef pen, float x1, float y1, float x2, float y2)
+		{
+			beginShape(pen, Paint::Stroke);
+			moveTo(x1, y1);
+			lineTo(x2, y2);
+			endShape();
+		}
+
+		void ellipse(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				fillBox(pen, x, y, width, height, true);
+				return;
+			}
+			beginShape(pen, Paint::Stroke);
+			arcPath(x, y, width, height, 0.0, 360.0);
+			endShape();
+		}
+
+		void arc(geom::PenRef pen, float x, float y, float width, float height, float start, float sweep)
+		{
+			beginShape(pen, Paint::Stroke);
+			arcPath(x, y, width, height, start, sweep);
+			endShape();
+		}
+
+		void rectangle(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			if (isFill)
+			{
+				fillBox(pen, x, y, width, height, false);
+				return;
+			}
+			beginShape(pen, Paint::MiterStroke);
+			rectanglePath(x, y, width, height);
+			endShape();
+		}
+
+		void polygon(geom::PenRef pen, const float* xy, size_t n, bool isFill)
+		{
+			beginShape(pen, isFill ? Paint::EvenOddFill : Paint::Stroke);
+			polylinePath(xy, n, true);
+			endShape();
+		}
+
+		void polyline(geom::PenRef pen, const float* xy, size_t n)
+		{
+			beginShape(pen, Paint::Stroke);
+			polylinePath(xy, n, false);
+			endShape();
+		}
+
+		void text(geom::PenRef pen, geom::FontRef font, const wchar_t* text, float x, float y)
+		{
+			// The canvas puts the top-left corner of the box measured here at
+			// (x, y); the formats center their own glyphs in the same box
+			const size_t length = std::wcslen(text);
+			int boxWidth = 0;
+			int boxHeight = 0;
+			metrics.measure(*font, text, length, boxWidth, boxHeight);
+			const int style = findStyle(pen, Paint::Fill);
+			closePath();
+			pixelStyle = NO_STYLE;
+			writeText(style, font, text, length, x + boxWidth / 2.0, y + boxHeight / 2.0);
+			flushIfFull();
+		}
+
+		void lines(geom::PenRef pen, const float* segments, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* s = segments + 4 * i;
+				line(pen, s[0], s[1], s[2], s[3]);
+			}
+		}
+
+		void filledEllipses(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* b = boxes + 4 * i;
+				fillBox(pen, b[0], b[1], b[2], b[3], true);
+			}
+		}
+
+		void filledRectangles(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				const float* b = boxes + 4 * i;
+				fillBox(pen, b[0], b[1], b[2], b[3], false);
+			}
+		}
+
+		// Paints the last path and ends the file
+		void finish()
+		{
+			closePath();
+			finishFile();
+		}
+
+	protected:
+		// A style used for the first time; no path is open
+		virtual void addStyle(int style) = 0;
+		virtual void beginPath(Paint paint, int style) = 0;
+		virtual void endPath(Paint paint) = 0;
+		virtual void moveTo(double x, double y) = 0;
+		virtual void lineTo(double x, double y) = 0;
+		// Elliptical arc from the current point, at angle t0 of the ellipse
+		// centered on (cx, cy) with radii a and b, to angle t1, counterclockwise
+		// in radians. t1 - t0 is at most half a turn.
+		virtual void arcTo(double cx, double cy, double a, double b, double t0, double t1) = 0;
+		// Rectangle with a positive width and height, as one subpath going the
+		// way arcs go, so that it adds up with them in a merged fill
+		virtual void rectangleTo(double x, double y, double width, double height) = 0;
+		virtual void closeSubpath() = 0;
+		// Text centered on (cx, cy); no path is open
+		virtual void writeText(int style, geom::FontRef font, const wchar_t* text, size_t length, double cx, double cy) = 0;
+		// Hands the buffered text on
+		virtual void flush() = 0;
+		virtual void finishFile() = 0;
+
+		const Style& viewStyle(int style) const { return styles[(size_t)style]; }
+
+		const int width;
+		const int height;
+		Buffer out;
+
+	private:
+		// Starts a shape, continuing the open path when it can
+		void beginShape(geom::PenRef pen, Paint paint, bool isPixel = false)
+		{
+			const int style = findStyle(pen, paint);
+			// Pixels of a run never overlap, so they may share a path whatever
+			// their alpha
+			const bool isShared = (isPixel || pen->color.a == 255) && paint != Paint::EvenOddFill;
+			if (isPathOpen && (!isShared || !isPathShared || style != pathStyle || paint != pathPaint
+				|| subpaths >= MAX_SUBPATHS))
+			{
+				closePath();
+			}
+			if (!isPixel)
+			{
+				pixelStyle = NO_STYLE;
+			}
+			if (!isPathOpen)
+			{
+				beginPath(paint, style);
+				isPathOpen = true;
+				isPathShared = isShared;
+				pathPaint = paint;
+				pathStyle = style;
+				subpaths = 0;
+			}
+			subpaths++;
+		}
+
+		void endShape()
+		{
+			if (!isPathShared)
+			{
+				closePath();
+			}
+			flushIfFull();
+		}
+
+		// Paints the open path, if any
+		void closePath()
+		{
+			if (isPathOpen)
+			{
+				endPath(pathPaint);
+				isPathOpen = false;
+			}
+		}
+
+		void flushIfFull()
+		{
+			if (out.size() >= FLUSH_BYTES)
+			{
+				flush();
+				out.clear();
+			}
+		}
+
+		// Index of the style pen paints with, added on first use
+		int findStyle(geom::PenRef pen, Paint paint)
+		{
+			const bool isStroked = isStroke(paint);
+			std::vector<int>& ofPen = isStroked ? strokeOfPen : fillOfPen;
+			if (pen.handle >= ofPen.size())
+			{
+				ofPen.resize((size_t)pen.handle + 1, NO_STYLE);
+			}
+			int& style = ofPen[pen.handle];
+			if (style != NO_STYLE)
+			{
+				return style;
+			}
+
+			const double strokeWidth = isStroked ? std::max(cwt::penWidth(*pen, width, height), 1.0) : 0.0;
+			const std::pair<std::uint32_t, double> key{ pen->color.pack(), strokeWidth };
+			const auto found = styleIndex.find(key);
+			if (found != styleIndex.end())
+			{
+				style = found->second;
+				return style;
+			}
+			style = (int)styles.size();
+			styles.push_back(Style{ pen->color, strokeWidth });
+			styleIndex.emplace(key, style);
+			closePath();
+			addStyle(style);
+			return style;
+		}
+
+		// Filled ellipse or rectangle in the box, or the pixel it falls in
+		void fillBox(geom::PenRef pen, double x, double y, double w, double h, bool isEllipse)
+		{
+			if (isCoalesced && std::abs(w) <= 1.0 && std::abs(h) <= 1.0)
+			{
+				const double px = std::floor(x + w / 2);
+				const double py = std::floor(y + h / 2);
+				if (!(px >= 0.0 && px < width && py >= 0.0 && py < height))
+				{
+					return;
+				}
+				const int style = findStyle(pen, Paint::Fill);
+				if (style != pixelStyle)
+				{
+					pixels.clear();
+					pixelStyle = style;
+				}
+				if (!pixels.insert((std::uint64_t)py * (std::uint64_t)width + (std::uint64_t)px).second)
+				{
+					return;
+				}
+				constexpr bool isPixel = true;
+				beginShape(pen, Paint::Fill, isPixel);
+				rectangleTo(px, py, 1.0, 1.0);
+				endShape();
+				return;
+			}
+
+			beginShape(pen, Paint::Fill);
+			if (isEllipse)
+			{
+				arcPath(x, y, w, h, 0.0, 360.0);
+			}
+			else
+			{
+				rectanglePath(x, y, w, h);
+			}
+			endShape();
+		}
+
+		void rectanglePath(double x, double y, double w, double h)
+		{
+			if (w < 0.0)
+			{
+				x += w;
+				w = -w;
+			}
+			if (h < 0.0)
+			{
+				y += h;
+				h = -h;
+			}
+			rectangleTo(x, y, w, h);
+		}
+
+		// The arc of the ellipse inscribed in the box, as the canvas strokes it:
+		// sweep degrees counterclockwise from start, 0 being 3 o'clock
+		void arcPath(double x, double y, double w, double h, double start, double sweep)
+		{
+			const double a = std::abs(w) / 2;
+			const double b = std::abs(h) / 2;
+			const double cx = x + w / 2;
+			const double cy = y + h / 2;
+			if (sweep < 0.0)
+			{
+				start += sweep;
+				sweep = -sweep;
+			}
+			const bool isClosed = sweep >= 360.0;
+			if (isClosed)
+			{
+				sweep = 360.0;
+			}
+			const int pieces = std::max(1, (int)std::ceil(sweep / 180.0));
+			double t = start * PI / 180.0;
+			const double step = sweep * PI / 180.0 / pieces;
+			moveTo(cx + a * std::cos(t), cy - b * std::sin(t));
+			for (int i = 0; i < pieces; i++, t += step)
+			{
+				arcTo(cx, cy, a, b, t, t + step);
+			}
+			if (isClosed)
+			{
+				closeSubpath();
+			}
+		}
+
+		void polylinePath(const float* xy, size_t n, bool isClosed)
+		{
+			if (n == 0)
+			{
+				return;
+			}
+			moveTo(xy[0], xy[1]);
+			for (size_t i = 1; i < n; i++)
+			{
+				lineTo(xy[2 * i], xy[2 * i + 1]);
+			}
+			if (n == 1)
+			{
+				// A dot, which round caps still draw
+				lineTo(xy[0], xy[1]);
+			}
+			if (isClosed)
+			{
+				closeSubpath();
+			}
+		}
+
+		text::GlyphAtlas& metrics;
+		const bool isCoalesced;
+
+		std::vector<Style> styles;
+		std::map<std::pair<std::uint32_t, double>, int> styleIndex;
+		// Style of each pen handle, or NO_STYLE until it is used
+		std::vector<int> strokeOfPen;
+		std::vector<int> fillOfPen;
+
+		bool isPathOpen = false;
+		bool isPathShared = false;
+		Paint pathPaint = Paint::Stroke;
+		int pathStyle = NO_STYLE;
+		size_t subpaths = 0;
+
+		// Pixels written by the run of coalesced shapes in pixelStyle going on
+		std::unordered_set<std::uint64_t> pixels;
+		int pixelStyle = NO_STYLE;
+	};
+
+	// "#rrggbb"
+	void putHexColor(Buffer& out, cwt::ColorRgba color)
+	{
+		static const char DIGITS[] = "0123456789abcdef";
+		out.put('#');
+		for (std::uint8_t channel : { color.r, color.g, color.b })
+		{
+			out.put(DIGITS[channel >> 4]);
+			out.put(DIGITS[channel & 0xF]);
+		}
+	}
+
+	/***************************************************************************
+	*  SVG.
+	*  Styles are CSS classes, written in a <style> element of their own just
+	*  before they are first used; paths of one style are grouped in a <g> of
+	*  that class, so that the paths themselves only hold their data.
+	***************************************************************************/
+
+	class SvgDevice final : public VectorDevice
+	{
+	public:
+		SvgDevice(File& file, int width, int height, cwt::ColorRgba background, text::GlyphAtlas& metrics, bool isCoalesced)
+			:
+			VectorDevice(width, height, metrics, isCoalesced),
+			file(file)
+		{
+			out.put("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+			out.put("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" width=\"");
+			out.integer(width);
+			out.put("\" height=\"");
+			out.integer(height);
+			out.put("\" viewBox=\"0 0 ");
+			out.integer(width);
+			out.put(' ');
+			out.integer(height);
+			// The pen is round, apart from the corners of rectangles
+			out.put("\" stroke-linecap=\"round\" stroke-linejoin=\"round\">\n");
+			out.put("<rect width=\"100%\" height=\"100%\" fill=\"");
+			putHexColor(out, background);
+			out.put("\"/>\n");
+		}
+
+	protected:
+		void addStyle(int style) override
+		{
+			const Style& s = viewStyle(style);
+			out.put("<style>.");
+			putClass(style);
+			if (s.width > 0.0)
+			{
+				out.put("{fill:none;stroke:");
+				putHexColor(out, s.color);
+				out.put(";stroke-width:");
+				out.number(s.width);
+				putOpacity("stroke", s.color);
+			}
+			else
+			{
+				out.put("{fill:");
+				putHexColor(out, s.color);
+				putOpacity("fill", s.color);
+			}
+			out.put("}</style>\n");
+		}
+
+		void beginPath(Paint paint, int style) override
+		{
+			useGroup(style);
+			out.put("<path");
+			if (paint == Paint::MiterStroke)
+			{
+				out.put(" stroke-linejoin=\"miter\"");
+			}
+			else if (paint == Paint::EvenOddFill)
+			{
+				out.put(" fill-rule=\"evenodd\"");
+			}
+			out.put(" d=\"");
+		}
+
+		void endPath(Paint) override
+		{
+			out.put("\"/>\n");
+		}
+
+		void moveTo(double x, double y) override
+		{
+			out.put('M');
+			out.point(x, y);
+			penX = Buffer::toFixed(x);
+			penY = Buffer::toFixed(y);
+			hasPen = true;
+		}
+
+		void lineTo(double x, double y) override
+		{
+			if (!hasPen)
+			{
+				out.put('L');
+				out.point(x, y);
+				return;
+			}
+			// Relative to the last point, which is shorter for short segments;
+			// the offsets are exact, so the error does not build up
+			const long long nextX = Buffer::toFixed(x);
+			const long long nextY = Buffer::toFixed(y);
+			out.put('l');
+			out.fixed(nextX - penX);
+			if (nextY >= penY)
+			{
+				out.put(' ');
+			}
+			out.fixed(nextY - penY);
+			penX = nextX;
+			penY = nextY;
+		}
+
+		void arcTo(double cx, double cy, double a, double b, double, double t1) override
+		{
+			hasPen = false;
+			// Counterclockwise on the screen is SVG's negative direction
+			out.put('A');
+			out.point(a, b);
+			out.put(" 0 0 0 ");
+			out.point(cx + a * std::cos(t1), cy - b * std::sin(t1));
+		}
+
+		void rectangleTo(double x, double y, double width, double height) override
+		{
+			hasPen = false;
+			// Down, right, then back up
+			out.put('M');
+			out.point(x, y);
+			out.put('v');
+			out.number(height);
+			out.put('h');
+			out.number(width);
+			out.put('v');
+			out.number(-height);
+			out.put('z');
+		}
+
+		void closeSubpath() override
+		{
+			hasPen = false;
+			out.put('z');
+		}
+
+		void writeText(int style, geom::FontRef font, const wchar_t* text, size_t length, double cx, double cy) override
+		{
+			useGroup(style);
+			if (font.handle >= fontClasses.size())
+			{
+				fontClasses.resize((size_t)font.handle + 1, false);
+			}
+			if (!fontClasses[font.handle])
+			{
+				addFont(font);
+				fontClasses[font.handle] = true;
+			}
+			out.put("<text class=\"t");
+			out.integer(font.handle);
+			out.put("\" x=\"");
+			out.number(cx);
+			out.put("\" y=\"");
+			out.number(cy);
+			out.put("\">");
+			putEscaped(toUtf8(text, length));
+			out.put("</text>\n");
+		}
+
+		void flush() override
+		{
+			file.write(out.view());
+		}
+
+		void finishFile() override
+		{
+			if (group != NO_STYLE)
+			{
+				out.put("</g>\n");
+			}
+			out.put("</svg>\n");
+			flush();
+		}
+
+	private:
+		void putClass(int style)
+		{
+			out.put(viewStyle(style).width > 0.0 ? 's' : 'f');
+			out.integer(style);
+		}
+
+		// ";stroke-opacity:0.5" and the like for translucent colors
+		void putOpacity(std::string_view property, cwt::ColorRgba color)
+		{
+			if (color.a == 255)
+			{
+				return;
+			}
+			out.put(';');
+			out.put(property);
+			out.put("-opacity:");
+			constexpr int ALPHA_DECIMALS = 3;
+			out.number(color.a / 255.0, ALPHA_DECIMALS);
+		}
+
+		// Puts what comes next in a group of the class of style
+		void useGroup(int style)
+		{
+			if (style == group)
+			{
+				return;
+			}
+			if (group != NO_STYLE)
+			{
+				out.put("</g>\n");
+			}
+			out.put("<g class=\"");
+			putClass(style);
+			out.put("\">\n");
+			group = style;
+		}
+
+		// Class t<handle> with the font as CSS, the logical Java names mapped to
+		// the generic families
+		void addFont(geom::FontRef font)
+		{
+			const std::string name = toUtf8(font->viewFontName().c_str(), font->viewFontName().size());
+			out.put("<style>.t");
+			out.integer(font.handle);
+			out.put("{font-family:");
+			if (name == "SansSerif" || name == "Dialog" || name == "DialogInput")
+			{
+				out.put("sans-serif");
+			}
+			else if (name == "Serif")
+			{
+				out.put("serif");
+			}
+			else if (name == "Monospaced")
+			{
+				out.put("monospace");
+			}
+			else
+			{
+				out.put('\'');
+				for (char c : name)
+				{
+					if (c != '\'' && c != '<' && c != '&')
+					{
+						out.put(c);
+					}
+				}
+				out.put("',sans-serif");
+			}
+			out.put(";font-size:");
+			out.integer((long long)font->viewFontSize());
+			out.put("px");
+			switch (font->viewFontSyle())
+			{
+			case cwt::Font::Style::FontStyleBold:
+				out.put(";font-weight:bold");
+				break;
+			case cwt::Font::Style::FontStyleItalic:
+				out.put(";font-style:italic");
+				break;
+			case cwt::Font::Style::FontStyleBoldItalic:
+				out.put(";font-weight:bold;font-style:italic");
+				break;
+			case cwt::Font::Style::FontStyleUnderline:
+				out.put(";text-decoration:underline");
+				break;
+			case cwt::Font::Style::FontStyleStrikeout:
+				out.put(";text-decoration:line-through");
+				break;
+			case cwt::Font::Style::FontStyleRegular:
+				break;
+			}
+			out.put(";text-anchor:middle;dominant-baseline:central}</style>\n");
+		}
+
+		void putEscaped(std::string_view text)
+		{
+			for (char c : text)
+			{
+				switch (c)
+				{
+				case '<':
+					out.put("&lt;");
+					break;
+				case '>':
+					out.put("&gt;");
+					break;
+				case '&':
+					out.put("&amp;");
+					break;
+				default:
+					out.put(c);
+					break;
+				}
+			}
+		}
+
+		File& file;
+		// Style of the open <g>
+		int group = NO_STYLE;
+		// Font handles with a class
+		std::vector<bool> fontClasses;
+		// Current point of the path, in the units of Buffer::toFixed, if it
+		// was set by moveTo or lineTo
+		long long penX = 0;
+		long long penY = 0;
+		bool hasPen = false;
+	};
+
+	/***************************************************************************
+	*  PDF.
+	*  One page the size of the canvas, flipped so that y grows downwards as on
+	*  the canvas. The content stream is deflated on the fly and its length
+	*  written after it, as an object of its own, so the file is written front
+	*  to back in one pass. Colors, widths and alphas are only set when they
+	*  change; alphas are graphics states shared through the page resources.
+	*
+	*  Text uses the standard Helvetica and Courier fonts, which every viewer
+	*  has, so nothing is embedded.
+	***************************************************************************/
+
+	// Advances of the printable ASCII characters in Helvetica, per 1000 units
+	// of font size, from its Adobe font metrics
+	constexpr std::uint16_t HELVETICA_WIDTHS[95] = {
+		278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,
+		556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,
+		1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,
+		667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556,
+		333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500, 222, 833, 556, 556,
+		556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584 };
+	constexpr std::uint16_t COURIER_WIDTH = 600;
+
+	// Height of the middle of lowercase letters over the baseline, per unit of
+	// font size; text is centered on it
+	constexpr double TEXT_MIDDLE = 0.35;
+
+	// Objects written before the content stream, which refers to them by number
+	constexpr int CATALOG_OBJECT = 1;
+	constexpr int PAGES_OBJECT = 2;
+	constexpr int PAGE_OBJECT = 3;
+	constexpr int CONTENT_OBJECT = 4;
+	constexpr int RESOURCES_OBJECT = 5;
+	constexpr int LENGTH_OBJECT = 6;
+	constexpr int FIRST_FONT_OBJECT = 7;
+
+	class PdfDevice final : public VectorDevice
+	{
+	public:
+		PdfDevice(File& file, int width, int height, cwt::ColorRgba background, text::GlyphAtlas& metrics, bool isCoalesced)
+			:
+			VectorDevice(width, height, metrics, isCoalesced),
+			file(file)
+		{
+			// The comment of high bytes marks the file as binary
+			file.write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+			Buffer header;
+			beginObject(header, CATALOG_OBJECT);
+			header.put("<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+			writeObject(header);
+			beginObject(header, PAGES_OBJECT);
+			header.put("<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+			writeObject(header);
+			beginObject(header, PAGE_OBJECT);
+			header.put("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ");
+			header.integer(width);
+			header.put(' ');
+			header.integer(height);
+			header.put("] /Resources 5 0 R /Contents 4 0 R >>\nendobj\n");
+			writeObject(header);
+			beginObject(header, CONTENT_OBJECT);
+			header.put("<< /Length 6 0 R /Filter /FlateDecode >>\nstream\n");
+			writeObject(header);
+			contentStart = file.viewOffset();
+
+			out.put("1 0 0 -1 0 ");
+			out.integer(height);
+			out.put(" cm 1 J 1 j\n");
+			putColor(background, "rg");
+			out.put(" 0 0 ");
+			out.integer(width);
+			out.put(' ');
+			out.integer(height);
+			out.put(" re f\n");
+		}
+
+	protected:
+		void addStyle(int) override {}
+
+		void beginPath(Paint paint, int style) override
+		{
+			const Style& s = viewStyle(style);
+			if (isStroke(paint))
+			{
+				if (!hasStroke || !(s.color.r == stroke.r && s.color.g == stroke.g && s.color.b == stroke.b))
+				{
+					putColor(s.color, "RG");
+					out.put('\n');
+					stroke = s.color;
+					hasStroke = true;
+				}
+				if (s.width != lineWidth)
+				{
+					out.number(s.width);
+					out.put(" w\n");
+					lineWidth = s.width;
+				}
+				const bool isMiter = paint == Paint::MiterStroke;
+				if (isMiter != isMiterJoin)
+				{
+					out.put(isMiter ? "0 j\n" : "1 j\n");
+					isMiterJoin = isMiter;
+				}
+			}
+			else
+			{
+				useFill(s.color);
+			}
+			useAlpha(s.color.a);
+		}
+
+		void endPath(Paint paint) override
+		{
+			switch (paint)
+			{
+			case Paint::Stroke:
+			case Paint::MiterStroke:
+				out.put(" S\n");
+				break;
+			case Paint::Fill:
+				out.put(" f\n");
+				break;
+			case Paint::EvenOddFill:
+				out.put(" f*\n");
+				break;
+			}
+		}
+
+		void moveTo(double x, double y) override
+		{
+			out.point(x, y);
+			out.put(" m ");
+		}
+
+		void lineTo(double x, double y) override
+		{
+			out.point(x, y);
+			out.put(" l ");
+		}
+
+		void arcTo(double cx, double cy, double a, double b, double t0, double t1) override
+		{
+			// Cubic Beziers of at most a quarter turn each, with control points
+			// along the tangents at the ends
+			const int pieces = t1 - t0 > PI / 2 ? 2 : 1;
+			const double step = (t1 - t0) / pieces;
+			const double k = 4.0 / 3.0 * std::tan(step / 4);
+			double t = t0;
+			for (int i = 0; i < pieces; i++, t += step)
+			{
+				const double u = t + step;
+				out.point(cx + a * (std::cos(t) - k * std::sin(t)), cy - b * (std::sin(t) + k * std::cos(t)));
+				out.put(' ');
+				out.point(cx + a * (std::cos(u) + k * std::sin(u)), cy - b * (std::sin(u) - k * std::cos(u)));
+				out.put(' ');
+				out.point(cx + a * std::cos(u), cy - b * std::sin(u));
+				out.put(" c ");
+			}
+		}
+
+		void rectangleTo(double x, double y, double width, double height) override
+		{
+			// From the top-right corner with a negative width, which turns the
+			// way arcs do on the flipped page
+			out.point(x + width, y);
+			out.put(' ');
+			out.point(-width, height);
+			out.put(" re ");
+		}
+
+		void closeSubpath() override
+		{
+			out.put("h ");
+		}
+
+		void writeText(int style, geom::FontRef font, const wchar_t* text, size_t length, double cx, double cy) override
+		{
+			const Style& s = viewStyle(style);
+			useFill(s.color);
+			useAlpha(s.color.a);
+
+			const bool isMonospaced = font->viewFontName() == L"Monospaced";
+			const double size = (double)font->viewFontSize();
+			std::string bytes;
+			double advance = 0.0;
+			for (size_t i = 0; i < length; i++)
+			{
+				// WinAnsiEncoding matches Latin-1 on these
+				const wchar_t c = text[i];
+				const bool isKnown = (c >= 32 && c < 127) || (c >= 160 && c < 256);
+				const std::uint8_t byte = isKnown ? (std::uint8_t)c : (std::uint8_t)'?';
+				bytes.push_back((char)byte);
+				advance += isMonospaced ? COURIER_WIDTH : byte < 127 ? HELVETICA_WIDTHS[byte - 32] : 556;
+			}
+			advance *= size / 1000.0;
+
+			out.put("BT /F");
+			out.integer(findFont(font));
+			out.put(' ');
+			out.integer((long long)size);
+			out.put(" Tf 1 0 0 -1 ");
+			out.point(cx - advance / 2, cy + TEXT_MIDDLE * size);
+			out.put(" Tm (");
+			for (char c : bytes)
+			{
+				if (c == '(' || c == ')' || c == '\\')
+				{
+					out.put('\\');
+				}
+				out.put(c);
+			}
+			out.put(") Tj ET\n");
+		}
+
+		void flush() override
+		{
+			const std::string_view text = out.view();
+			zlib.write(reinterpret_cast<const std::uint8_t*>(text.data()), text.size());
+			std::vector<std::uint8_t>& compressed = zlib.output();
+			if (compressed.size() >= FLUSH_BYTES)
+			{
+				file.write(compressed.data(), compressed.size());
+				compressed.clear();
+			}
+		}
+
+		void finishFile() override
+		{
+			flush();
+			out.clear();
+			zlib.finish();
+			std::vector<std::uint8_t>& compressed = zlib.output();
+			file.write(compressed.data(), compressed.size());
+			const size_t contentLength = file.viewOffset() - contentStart;
+			file.write("\nendstream\nendobj\n");
+
+			Buffer trailer;
+			beginObject(trailer, RESOURCES_OBJECT);
+			trailer.put("<< /Font <<");
+			for (size_t i = 0; i < fonts.size(); i++)
+			{
+				trailer.put(" /F");
+				trailer.integer((long long)i);
+				trailer.put(' ');
+				trailer.integer(FIRST_FONT_OBJECT + (long long)i);
+				trailer.put(" 0 R");
+			}
+			trailer.put(" >> /ExtGState <<");
+			for (std::uint8_t alpha : alphas)
+			{
+				trailer.put(" /A");
+				trailer.integer(alpha);
+				trailer.put(" << /CA ");
+				trailer.number(alpha / 255.0, 3);
+				trailer.put(" /ca ");
+				trailer.number(alpha / 255.0, 3);
+				trailer.put(" >>");
+			}
+			trailer.put(" >> >>\nendobj\n");
+			writeObject(trailer);
+
+			beginObject(trailer, LENGTH_OBJECT);
+			trailer.integer((long long)contentLength);
+			trailer.put("\nendobj\n");
+			writeObject(trailer);
+
+			for (size_t i = 0; i < fonts.size(); i++)
+			{
+				beginObject(trailer, FIRST_FONT_OBJECT + (int)i);
+				trailer.put("<< /Type /Font /Subtype /Type1 /BaseFont /");
+				trailer.put(fonts[i]);
+				trailer.put(" /Encoding /WinAnsiEncoding >>\nendobj\n");
+				writeObject(trailer);
+			}
+
+			const size_t xref = file.viewOffset();
+			trailer.put("xref\n0 ");
+			trailer.integer((long long)offsets.size() + 1);
+			trailer.put("\n0000000000 65535 f \n");
+			for (size_t offset : offsets)
+			{
+				char entry[21];
+				std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offset);
+				trailer.put(std::string_view(entry, 20));
+			}
+			trailer.put("trailer\n<< /Size ");
+			trailer.integer((long long)offsets.size() + 1);
+			trailer.put(" /Root 1 0 R >>\nstartxref\n");
+			trailer.integer((long long)xref);
+			trailer.put("\n%%EOF\n");
+			writeObject(trailer);
+		}
+
+	private:
+		// Notes where object number starts, which must be the next one
+		void beginObject(Buffer& buffer, int number)
+		{
+			offsets.push_back(file.viewOffset() + buffer.size());
+			buffer.integer(number);
+			buffer.put(" 0 obj\n");
+		}
+
+		void writeObject(Buffer& buffer)
+		{
+			file.write(buffer.view());
+			buffer.clear();
+		}
+
+		// "r g b" and the operator, the channels as fractions of 255
+		void putColor(cwt::ColorRgba color, std::string_view op)
+		{
+			constexpr int CHANNEL_DECIMALS = 3;
+			out.number(color.r / 255.0, CHANNEL_DECIMALS);
+			out.put(' ');
+			out.number(color.g / 255.0, CHANNEL_DECIMALS);
+			out.put(' ');
+			out.number(color.b / 255.0, CHANNEL_DECIMALS);
+			out.put(' ');
+			out.put(op);
+		}
+
+		void useFill(cwt::ColorRgba color)
+		{
+			if (hasFill && color.r == fill.r && color.g == fill.g && color.b == fill.b)
+			{
+				return;
+			}
+			putColor(color, "rg");
+			out.put('\n');
+			fill = color;
+			hasFill = true;
+		}
+
+		void useAlpha(std::uint8_t alpha)
+		{
+			if (alpha == currentAlpha)
+			{
+				return;
+			}
+			if (std::find(alphas.begin(), alphas.end(), alpha) == alphas.end())
+			{
+				alphas.push_back(alpha);
+			}
+			out.put("/A");
+			out.integer(alpha);
+			out.put(" gs\n");
+			currentAlpha = alpha;
+		}
+
+		// Index of the standard font standing for font among the page resources
+		int findFont(geom::FontRef font)
+		{
+			const bool isMonospaced = font->viewFontName() == L"Monospaced";
+			const char* name = nullptr;
+			switch (font->viewFontSyle())
+			{
+			case cwt::Font::Style::FontStyleBold:
+				name = isMonospaced ? "Courier-Bold" : "Helvetica-Bold";
+				break;
+			case cwt::Font::Style::FontStyleItalic:
+				name = isMonospaced ? "Courier-Oblique" : "Helvetica-Oblique";
+				break;
+			case cwt::Font::Style::FontStyleBoldItalic:
+				name = isMonospaced ? "Courier-BoldOblique" : "Helvetica-BoldOblique";
+				break;
+			default:
+				name = isMonospaced ? "Courier" : "Helvetica";
+				break;
+			}
+			const auto found = std::find(fonts.begin(), fonts.end(), name);
+			if (found != fonts.end())
+			{
+				return (int)(found - fonts.begin());
+			}
+			fonts.push_back(name);
+			return (int)fonts.size() - 1;
+		}
+
+		File& file;
+		image::ZlibWriter zlib;
+		size_t contentStart = 0;
+		// Offset of every object, by number from 1
+		std::vector<size_t> offsets;
+		std::vector<std::string> fonts;
+		std::vector<std::uint8_t> alphas;
+
+		// Graphics state of the content stream
+		cwt::ColorRgba stroke;
+		bool hasStroke = false;
+		cwt::ColorRgba fill;
+		bool hasFill = false;
+		double lineWidth = 1.0;
+		bool isMiterJoin = false;
+		std::uint8_t currentAlpha = 255;
+	};
+}
+
+bool image::findVectorFormat(const std::string& path, VectorFormat& format)
+{
+	const size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return false;
+	}
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char c) { return (char)std::tolower(c); });
+
+	if (extension == "svg")
+	{
+		format = VectorFormat::SVG;
+	}
+	else if (extension == "pdf")
+	{
+		format = VectorFormat::PDF;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+void image::writeVector(const std::string& path, VectorFormat format, int width, int height,
+	cwt::ColorRgba background, const geom::DisplayList& list, text::GlyphAtlas& metrics, bool isCoalesced)
+{
+	File file(path);
+	switch (format)
+	{
+	case VectorFormat::SVG:
+	{
+		SvgDevice device(file, width, height, background, metrics, isCoalesced);
+		list.replay(device);
+		device.finish();
+		break;
+	}
+	case VectorFormat::PDF:
+	{
+		PdfDevice device(file, width, height, background, metrics, isCoalesced);
+		list.replay(device);
+		device.finish();
+		break;
+	}
+	}
+	file.close();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "cwt.h"
+
+// Encoders that save a display list as vector graphics, without rasterizing
+// it. The list is replayed once and streamed to the file as it goes.
+namespace image
+{
+	enum class VectorFormat
+	{
+		SVG,	// SVG 1.1, one shared CSS class per distinct pen and font
+		PDF		// one page, the drawing in a deflated content stream
+	};
+
+	// Picks the format from the extension of path, ignoring case. Returns false
+	// if the extension is neither .svg nor .pdf.
+	bool findVectorFormat(const std::string& path, VectorFormat& format);
+
+	/**
+	 * Writes the commands of list as drawn on a width x height canvas cleared to
+	 * background; metrics measures text as the canvas does, so that it lands in
+	 * the same place. Throws std::runtime_error if the file cannot be written.
+	 *
+	 * Consecutive opaque primitives drawn with the same style share one path,
+	 * as overlaps between them cannot show; translucent ones get a path each,
+	 * so that they darken each other as on the canvas.
+	 *
+	 * The list already merges opaque dots. With isCoalesced, every filled shape
+	 * no larger than a pixel, translucent ones included, becomes the pixel its
+	 * center lies in, written once per run of the same style however many
+	 * land on it, and dropped off the canvas. A scatter plot then costs at most
+	 * one square per pixel, at the price of translucent dots no longer
+	 * darkening each other.
+	 */
+	void writeVector(const std::string& path, VectorFormat format, int width, int height,
+		cwt::ColorRgba background, const geom::DisplayList& list, text::GlyphAtlas& metrics, bool isCoalesced);
+}
@@ -0,0 +1,249 @@
+#include "Zlib.h"
+#include <algorithm>
+
+namespace
+{
+	std::uint32_t updateAdler(std::uint32_t adler, const std::uint8_t* data, size_t n)
+	{
+		constexpr std::uint32_t BASE = 65521;
+		// Largest run that cannot overflow 32 bits before the modulo
+		constexpr size_t NMAX = 5552;
+		std::uint32_t a = adler & 0xFFFF;
+		std::uint32_t b = adler >> 16;
+		while (n > 0)
+		{
+			const size_t run = (std::min)(n, NMAX);
+			for (size_t i = 0; i < run; i++)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= BASE;
+			b %= BASE;
+			data += run;
+			n -= run;
+		}
+		return b << 16 | a;
+	}
+
+	std::uint32_t reverseBits(std::uint32_t code, std::uint32_t length)
+	{
+		std::uint32_t reversed = 0;
+		for (std::uint32_t i = 0; i < length; i++)
+		{
+			reversed = reversed << 1 | (code >> i & 1);
+		}
+		return reversed;
+	}
+
+	constexpr std::uint16_t LENGTH_BASE[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	constexpr std::uint8_t LENGTH_EXTRA[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	constexpr std::uint16_t DISTANCE_BASE[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	constexpr std::uint8_t DISTANCE_EXTRA[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	constexpr size_t MIN_MATCH = 3;
+	constexpr size_t MAX_MATCH = 258;
+	constexpr size_t WINDOW_SIZE = 32768;
+	constexpr int HASH_BITS = 15;
+}
+
+// Codes of every literal and match length, extra bits folded in, and a
+// lookup from match distances to their codes
+struct image::ZlibWriter::FixedCodes
+{
+	FixedCodes()
+	{
+		for (std::uint32_t symbol = 0; symbol < 288; symbol++)
+		{
+			literal[symbol] = fixedLiteralCode(symbol);
+		}
+		for (std::uint32_t code = 0; code < 29; code++)
+		{
+			const Code symbol = literal[257 + code];
+			const std::uint32_t last = code == 28 ? 258 : LENGTH_BASE[code + 1] - 1u;
+			for (std::uint32_t len = LENGTH_BASE[code]; len <= last; len++)
+			{
+				const std::uint32_t extra = len - LENGTH_BASE[code];
+				length[len] = Code{ symbol.bits | extra << symbol.length, symbol.length + LENGTH_EXTRA[code] };
+			}
+		}
+		for (std::uint32_t code = 0; code < 30; code++)
+		{
+			distanceSymbol[code] = Code{ reverseBits(code, 5), 5 };
+			const std::uint32_t first = DISTANCE_BASE[code] - 1u;
+			const std::uint32_t last = first + (1u << DISTANCE_EXTRA[code]) - 1;
+			for (std::uint32_t d = first; d <= last; d++)
+			{
+				distanceCode[d < 256 ? d : 256 + (d >> 7)] = (std::uint8_t)code;
+			}
+		}
+	}
+
+	static Code fixedLiteralCode(std::uint32_t symbol)
+	{
+		if (symbol < 144)
+		{
+			return Code{ reverseBits(0x30 + symbol, 8), 8 };
+		}
+		if (symbol < 256)
+		{
+			return Code{ reverseBits(0x190 + symbol - 144, 9), 9 };
+		}
+		if (symbol < 280)
+		{
+			return Code{ reverseBits(symbol - 256, 7), 7 };
+		}
+		return Code{ reverseBits(0xC0 + symbol - 280, 8), 8 };
+	}
+
+	Code viewDistance(std::uint32_t dist) const
+	{
+		// Distances past 256 share a code in blocks of 128, as in zlib
+		const std::uint32_t d = dist - 1;
+		const std::uint32_t code = distanceCode[d < 256 ? d : 256 + (d >> 7)];
+		const Code symbol = distanceSymbol[code];
+		return Code{ symbol.bits | (dist - DISTANCE_BASE[code]) << symbol.length, symbol.length + DISTANCE_EXTRA[code] };
+	}
+
+	Code literal[288];
+	Code length[MAX_MATCH + 1];
+	Code distanceSymbol[30];
+	std::uint8_t distanceCode[512];
+};
+
+image::ZlibWriter::ZlibWriter()
+	:
+	head((size_t)1 << HASH_BITS, 0)
+{
+	window.reserve(3 * WINDOW_SIZE);
+	// 32K window, fastest compression level
+	out.push_back(0x78);
+	out.push_back(0x01);
+	// The whole stream is one final block with fixed codes
+	putBits(1, 1);
+	putBits(1, 2);
+}
+
+void image::ZlibWriter::write(const std::uint8_t* data, size_t n)
+{
+	adler = updateAdler(adler, data, n);
+	while (n > 0)
+	{
+		if (window.size() == window.capacity())
+		{
+			slide();
+		}
+		const size_t run = (std::min)(n, window.capacity() - window.size());
+		window.insert(window.end(), data, data + run);
+		data += run;
+		n -= run;
+		compress(false);
+	}
+}
+
+void image::ZlibWriter::finish()
+{
+	compress(true);
+	putCode(codes().literal[256]);
+	if (bitCount > 0)
+	{
+		putBits(0, 8 - bitCount % 8);
+	}
+	flushBits();
+	for (int shift = 24; shift >= 0; shift -= 8)
+	{
+		out.push_back((std::uint8_t)(adler >> shift));
+	}
+}
+
+const image::ZlibWriter::FixedCodes& image::ZlibWriter::codes()
+{
+	static const FixedCodes fixed;
+	return fixed;
+}
+
+std::uint32_t image::ZlibWriter::hash(const std::uint8_t* p)
+{
+	const std::uint32_t v = (std::uint32_t)p[0] << 16 | (std::uint32_t)p[1] << 8 | p[2];
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void image::ZlibWriter::slide()
+{
+	const size_t shift = pos - WINDOW_SIZE;
+	window.erase(window.begin(), window.begin() + shift);
+	base += shift;
+	pos -= shift;
+}
+
+void image::ZlibWriter::compress(bool isLast)
+{
+	const FixedCodes& fixed = codes();
+	const size_t end = window.size();
+	const std::uint8_t* data = window.data();
+	while (pos < end && (isLast || end - pos >= MAX_MATCH))
+	{
+		if (end - pos >= MIN_MATCH)
+		{
+			const std::uint32_t h = hash(data + pos);
+			const size_t candidate = head[h];
+			head[h] = base + pos + 1;
+
+			// Bucket entries hold absolute positions plus one, zero is empty
+			const size_t at = base + pos;
+			if (candidate > base && at - (candidate - 1) <= WINDOW_SIZE)
+			{
+				const std::uint8_t* match = data + (candidate - 1 - base);
+				const std::uint8_t* scan = data + pos;
+				const size_t limit = (std::min)(MAX_MATCH, end - pos);
+				size_t len = 0;
+				while (len < limit && match[len] == scan[len])
+				{
+					len++;
+				}
+				if (len >= MIN_MATCH)
+				{
+					putCode(fixed.length[len]);
+					putCode(fixed.viewDistance((std::uint32_t)(at - (candidate - 1))));
+					pos += len;
+					continue;
+				}
+			}
+		}
+		putCode(fixed.literal[data[pos]]);
+		pos++;
+	}
+}
+
+void image::ZlibWriter::putCode(Code code)
+{
+	putBits(code.bits, code.length);
+}
+
+void image::ZlibWriter::putBits(std::uint32_t bits, std::uint32_t length)
+{
+	bitBuffer |= (std::uint64_t)bits << bitCount;
+	bitCount += length;
+	if (bitCount >= 32)
+	{
+		flushBits();
+	}
+}
+
+void image::ZlibWriter::flushBits()
+{
+	while (bitCount >= 8)
+	{
+		out.push_back((std::uint8_t)bitBuffer);
+		bitBuffer >>= 8;
+		bitCount -= 8;
+	}
+}
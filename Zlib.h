@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace image
+{
+	/**
+	 * zlib stream (RFC 1950) around a deflate stream (RFC 1951), as PNG image
+	 * data and PDF content streams hold it. Compressed bytes accumulate in
+	 * output() until the caller takes them.
+	 *
+	 * The stream is a single block with the fixed Huffman codes of RFC 1951
+	 * and greedy LZ77 matching against one candidate per hash bucket. That is
+	 * roughly zlib's fastest level: canvases are mostly long runs of few
+	 * colors, and drawing commands repeat the same few operators, which this
+	 * compresses well at a small fraction of the cost of a full search.
+	 */
+	class ZlibWriter
+	{
+	public:
+		ZlibWriter();
+
+		void write(const std::uint8_t* data, size_t n);
+
+		// Ends the stream; nothing may be written after
+		void finish();
+
+		std::vector<std::uint8_t>& output() { return out; }
+
+	private:
+		struct Code
+		{
+			std::uint32_t bits;	// LSB first, ready for the bit writer
+			std::uint32_t length;
+		};
+
+		struct FixedCodes;
+
+		static const FixedCodes& codes();
+		static std::uint32_t hash(const std::uint8_t* p);
+
+		// Drops data older than the window so there is room to append
+		void slide();
+		// Encodes the window up to its end, or up to where a match could still
+		// grow with the data yet to come
+		void compress(bool isLast);
+		void putCode(Code code);
+		void putBits(std::uint32_t bits, std::uint32_t length);
+		void flushBits();
+
+		std::vector<std::uint8_t> window;
+		// Absolute offset of window[0] in the stream
+		size_t base = 0;
+		// Next byte of the window to encode
+		size_t pos = 0;
+		std::vector<size_t> head;
+
+		std::uint64_t bitBuffer = 0;
+		std::uint32_t bitCount = 0;
+		std::uint32_t adler = 1;
+		std::vector<std::uint8_t> out;
+	};
+}
@@ -0,0 +1,383 @@
+// Microbenchmarks of the StdDraw drawing calls on the headless backend.
+//
+// Every case draws a fixed, seeded set of primitives on a cleared canvas with
+// double buffering on, then presents the frame and waits for the render
+// thread, so its time covers both the calls and the pixels they produce. The
+// time spent in the calls alone is reported too, as the latency of one call.
+//
+// Results are printed to stdout as JSON, always in the same order and layout,
+// so that the output of two commits can be compared with a diff or a script.
+// Progress goes to stderr.
+//
+//   StdDrawBench [--filter=name] [--sizes=256,512,1024] [--repetitions=5]
+#include "RenderConfig.h"
+#include "StdDraw.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#ifndef ALGS4_RENDER_HEADLESS
+#error "The benchmarks measure the headless backend, define ALGS4_RENDER_HEADLESS"
+#endif
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Seed of every input, so that runs draw the same primitives
+	constexpr unsigned SEED = 42;
+
+	// Canvas sizes and repetitions when none are given
+	const std::vector<int> DEFAULT_SIZES = { 256, 512, 1024 };
+	constexpr int DEFAULT_REPETITIONS = 5;
+
+	// Vertex counts of the filledPolygon cases, and the vertices drawn per
+	// repetition, split across as many polygons as it takes
+	const std::vector<size_t> POLYGON_VERTICES = { 8, 64, 1024, 16384 };
+	constexpr size_t POLYGON_TOTAL_VERTICES = 65536;
+
+	// Pen of the cases drawing thick lines, about 5 pixels wide at 512x512
+	constexpr double THICK_PEN_RADIUS = 0.01;
+
+	struct Case
+	{
+		std::string name;
+		// Calls made and primitives drawn per repetition
+		size_t calls;
+		size_t primitives;
+		std::function<void(StdDraw&)> draw;
+	};
+
+	struct Result
+	{
+		std::string name;
+		int canvas;
+		size_t calls;
+		size_t primitives;
+		// Medians over the repetitions, except minMs
+		double callNs = 0.0;
+		double medianMs = 0.0;
+		double minMs = 0.0;
+	};
+
+	struct Options
+	{
+		std::string filter;
+		std::vector<int> sizes = DEFAULT_SIZES;
+		int repetitions = DEFAULT_REPETITIONS;
+	};
+
+	std::vector<double> uniform(std::mt19937& random, size_t n, double lo, double hi)
+	{
+		std::uniform_real_distribution<double> distribution(lo, hi);
+		std::vector<double> values(n);
+		for (double& value : values)
+		{
+			value = distribution(random);
+		}
+		return values;
+	}
+
+	// n star shaped polygons of the given number of vertices, stored one
+	// after the other
+	void makePolygons(std::mt19937& random, size_t n, size_t vertices, std::vector<double>& x, std::vector<double>& y)
+	{
+		std::uniform_real_distribution<double> center(0.2, 0.8);
+		std::uniform_real_distribution<double> radius(0.05, 0.2);
+		x.clear();
+		y.clear();
+		for (size_t p = 0; p < n; p++)
+		{
+			const double cx = center(random);
+			const double cy = center(random);
+			for (size_t i = 0; i < vertices; i++)
+			{
+				const double angle = 2 * PI * i / vertices;
+				const double r = radius(random);
+				x.push_back(cx + r * std::cos(angle));
+				y.push_back(cy + r * std::sin(angle));
+			}
+		}
+	}
+
+	std::vector<Case> makeCases()
+	{
+		std::mt19937 random(SEED);
+		std::vector<Case> cases;
+
+		{
+			constexpr size_t n = 20000;
+			auto c = uniform(random, 4 * n, 0.0, 1.0);
+			cases.push_back({ "line", n, n, [c](StdDraw& d)
+				{
+					for (size_t i = 0; i < n; i++)
+					{
+						d.line(c[4 * i], c[4 * i + 1], c[4 * i + 2], c[4 * i + 3]);
+					}
+				} });
+		}
+		{
+			constexpr size_t n = 5000;
+			auto c = uniform(random, 2 * n, 0.0, 1.0);
+			auto r = uniform(random, n, 0.005, 0.05);
+			cases.push_back({ "circle", n, n, [c, r](StdDraw& d)
+				{
+					for (size_t i = 0; i < n; i++)
+					{
+						d.circle(c[2 * i], c[2 * i + 1], r[i]);
+					}
+				} });
+			cases.push_back({ "filledCircle", n, n, [c, r](StdDraw& d)
+				{
+					for (size_t i = 0; i < n; i++)
+					{
+						d.filledCircle(c[2 * i], c[2 * i + 1], r[i]);
+					}
+				} });
+		}
+		for (size_t vertices : POLYGON_VERTICES)
+		{
+			const size_t n = POLYGON_TOTAL_VERTICES / vertices;
+			std::vector<double> x, y;
+			makePolygons(random, n, vertices, x, y);
+			cases.push_back({ "filledPolygon/" + std::to_string(vertices), n, n, [x, y, n, vertices](StdDraw& d)
+				{
+					for (size_t p = 0; p < n; p++)
+					{
+						d.filledPolygon(std::span<const double>(x).subspan(p * vertices, vertices),
+							std::span<const double>(y).subspan(p * vertices, vertices));
+					}
+				} });
+		}
+		{
+			constexpr size_t n = 2000;
+			auto c = uniform(random, 2 * n, 0.0, 1.0);
+			std::vector<std::wstring> texts;
+			for (size_t i = 0; i < n; i++)
+			{
+				texts.push_back(L"StdDraw " + std::to_wstring(i));
+			}
+			cases.push_back({ "text", n, n, [c, texts](StdDraw& d)
+				{
+					for (size_t i = 0; i < n; i++)
+					{
+						d.text(c[2 * i], c[2 * i + 1], texts[i]);
+					}
+				} });
+		}
+		{
+			constexpr size_t n = 20000;
+			auto x0 = uniform(random, n, 0.0, 1.0);
+			auto y0 = uniform(random, n, 0.0, 1.0);
+			auto x1 = uniform(random, n, 0.0, 1.0);
+			auto y1 = uniform(random, n, 0.0, 1.0);
+			cases.push_back({ "lines", 1, n, [x0, y0, x1, y1](StdDraw& d)
+				{
+					d.lines(x0, y0, x1, y1);
+				} });
+		}
+		{
+			constexpr size_t n = 50000;
+			auto x = uniform(random, n, 0.0, 1.0);
+			auto y = uniform(random, n, 0.0, 1.0);
+			cases.push_back({ "points", 1, n, [x, y](StdDraw& d)
+				{
+					d.points(x, y);
+				} });
+		}
+		{
+			constexpr size_t n = 5000;
+			auto x = uniform(random, n, 0.0, 1.0);
+			auto y = uniform(random, n, 0.0, 1.0);
+			auto r = uniform(random, n, 0.005, 0.05);
+			cases.push_back({ "filledCircles", 1, n, [x, y, r](StdDraw& d)
+				{
+					d.filledCircles(x, y, r);
+				} });
+		}
+		{
+			// Edges of a random graph with a thick pen, as graph clients draw
+			constexpr size_t vertices = 2000;
+			constexpr size_t n = 20000;
+			auto x = uniform(random, vertices, 0.0, 1.0);
+			auto y = uniform(random, vertices, 0.0, 1.0);
+			std::uniform_int_distribution<size_t> vertex(0, vertices - 1);
+			std::vector<size_t> ends(2 * n);
+			for (size_t& end : ends)
+			{
+				end = vertex(random);
+			}
+			cases.push_back({ "graphEdges", n, n, [x, y, ends](StdDraw& d)
+				{
+					d.setPenRadius(THICK_PEN_RADIUS);
+					for (size_t i = 0; i < n; i++)
+					{
+						d.line(x[ends[2 * i]], y[ends[2 * i]], x[ends[2 * i + 1]], y[ends[2 * i + 1]]);
+					}
+					d.setPenRadius();
+				} });
+		}
+		{
+			// A random walk of connected lines, which merge into one polyline
+			constexpr size_t n = 20000;
+			auto steps = uniform(random, 2 * n, -0.02, 0.02);
+			std::vector<double> x(n + 1, 0.5);
+			std::vector<double> y(n + 1, 0.5);
+			for (size_t i = 0; i < n; i++)
+			{
+				x[i + 1] = std::clamp(x[i] + steps[2 * i], 0.0, 1.0);
+				y[i + 1] = std::clamp(y[i] + steps[2 * i + 1], 0.0, 1.0);
+			}
+			cases.push_back({ "path", n, n, [x, y](StdDraw& d)
+				{
+					d.setPenRadius(THICK_PEN_RADIUS);
+					for (size_t i = 0; i < n; i++)
+					{
+						d.line(x[i], y[i], x[i + 1], y[i + 1]);
+					}
+					d.setPenRadius();
+				} });
+		}
+		return cases;
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		const size_t middle = values.size() / 2;
+		return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+	}
+
+	Result run(StdDraw& d, const Case& c, int canvas, int repetitions)
+	{
+		using Clock = std::chrono::steady_clock;
+		using Ms = std::chrono::duration<double, std::milli>;
+
+		std::vector<double> callMs;
+		std::vector<double> totalMs;
+		// The first pass warms caches, glyph atlases and allocators up
+		for (int r = -1; r < repetitions; r++)
+		{
+			d.clear();
+			d.show();
+			d.finish();
+
+			const Clock::time_point start = Clock::now();
+			c.draw(d);
+			const Clock::time_point called = Clock::now();
+			d.show();
+			d.finish();
+			const Clock::time_point done = Clock::now();
+
+			if (r >= 0)
+			{
+				callMs.push_back(Ms(called - start).count());
+				totalMs.push_back(Ms(done - start).count());
+			}
+		}
+
+		Result result{ c.name, canvas, c.calls, c.primitives };
+		result.callNs = median(callMs) * 1e6 / c.calls;
+		result.medianMs = median(totalMs);
+		result.minMs = *std::min_element(totalMs.begin(), totalMs.end());
+		return result;
+	}
+
+	bool parse(int argc, char* argv[], Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			if (arg.rfind("--filter=", 0) == 0)
+			{
+				options.filter = arg.substr(9);
+			}
+			else if (arg.rfind("--sizes=", 0) == 0)
+			{
+				options.sizes.clear();
+				size_t begin = 8;
+				while (begin < arg.size())
+				{
+					const size_t end = std::min(arg.find(',', begin), arg.size());
+					const int size = std::atoi(arg.substr(begin, end - begin).c_str());
+					if (size <= 0)
+					{
+						return false;
+					}
+					options.sizes.push_back(size);
+					begin = end + 1;
+				}
+			}
+			else if (arg.rfind("--repetitions=", 0) == 0)
+			{
+				options.repetitions = std::atoi(arg.c_str() + 14);
+				if (options.repetitions <= 0)
+				{
+					return false;
+				}
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return !options.sizes.empty();
+	}
+
+	void print(const std::vector<Result>& results, const Options& options)
+	{
+		std::printf("{\n");
+		std::printf("  \"benchmark\": \"StdDraw\",\n");
+		std::printf("  \"version\": 1,\n");
+		std::printf("  \"backend\": \"headless\",\n");
+		std::printf("  \"repetitions\": %d,\n", options.repetitions);
+		std::printf("  \"results\": [");
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& r = results[i];
+			std::printf("%s\n    {\"name\": \"%s\", \"canvas\": %d, \"calls\": %zu, \"primitives\": %zu, "
+				"\"call_ns\": %.1f, \"median_ms\": %.3f, \"min_ms\": %.3f, \"primitives_per_s\": %.0f}",
+				i > 0 ? "," : "", r.name.c_str(), r.canvas, r.calls, r.primitives,
+				r.callNs, r.medianMs, r.minMs, r.primitives / (r.medianMs / 1000.0));
+		}
+		std::printf("\n  ]\n}\n");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!parse(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: %s [--filter=name] [--sizes=256,512,1024] [--repetitions=5]\n", argv[0]);
+		return 2;
+	}
+
+	StdDraw& d = StdDraw::getInstance();
+	d.enableDoubleBuffering();
+	const std::vector<Case> cases = makeCases();
+
+	std::vector<Result> results;
+	for (int size : options.sizes)
+	{
+		d.setCanvasSize(size, size);
+		for (const Case& c : cases)
+		{
+			if (c.name.find(options.filter) == std::string::npos)
+			{
+				continue;
+			}
+			std::fprintf(stderr, "%s at %dx%d\n", c.name.c_str(), size, size);
+			results.push_back(run(d, c, size, options.repetitions));
+		}
+	}
+	print(results, options);
+	return 0;
+}
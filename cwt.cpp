@@ -1,118 +1,53 @@
 #include "cwt.h"
 
-cwt::ColorRgba cwt::getRgba(Color color)
+namespace
 {
-	ColorRgba retColor;
+	// Open addressing table from the RGB of the named colors to their Color,
+	// built at compile time. Twice as many slots as the table needs keeps
+	// probes short.
+	constexpr int COLOR_SLOT_BITS = 6;
+	constexpr size_t COLOR_SLOTS = size_t{ 1 } << COLOR_SLOT_BITS;
+	static_assert(COLOR_SLOTS >= 2 * cwt::NAMED_COLORS.size());
 
-	switch (color)
+	constexpr size_t findSlot(std::uint32_t rgb)
 	{
-	case Color::BLACK:
-		retColor.r = 0;
-		retColor.g = 0;
-		retColor.b = 0;
-		break;
-	case Color::BLUE:
-		retColor.r = 0;
-		retColor.g = 0;
-		retColor.b = 255;
-		break;
-	case Color::CYAN:
-		retColor.r = 0;
-		retColor.g = 255;
-		retColor.b = 255;
-		break;
-	case Color::DARK_GRAY:
-		retColor.r = 102;
-		retColor.g = 102;
-		retColor.b = 102;
-		break;
-	case Color::GRAY:
-		retColor.r = 153;
-		retColor.g = 153;
-		retColor.b = 153;
-		break;
-	case Color::GREEN:
-		retColor.r = 0;
-		retColor.g = 255;
-		retColor.b = 0;
-		break;
-	case Color::LIGHT_GRAY:
-		retColor.r = 204;
-		retColor.g = 204;
-		retColor.b = 204;
-		break;
-	case Color::MAGENTA:
-		retColor.r = 255;
-		retColor.g = 0;
-		retColor.b = 255;
-		break;
-	case Color::ORANGE:
-		retColor.r = 255;
-		retColor.g = 102;
-		retColor.b = 0;
-		break;
-	case Color::PINK:
-		retColor.r = 255;
-		retColor.g = 192;
-		retColor.b = 203;
-		break;
-	case Color::RED:
-		retColor.r = 255;
-		retColor.g = 0;
-		retColor.b = 0;
-		break;
-	case Color::WHITE:
-		retColor.r = 255;
-		retColor.g = 255;
-		retColor.b = 255;
-		break;
-	case Color::YELLOW:
-		retColor.r = 255;
-		retColor.g = 255;
-		retColor.b = 0;
-		break;
-	case Color::BOOK_BLUE:
-		retColor.r = 9;
-		retColor.g = 90;
-		retColor.b = 196;
-		break;
-	case Color::BOOK_LIGHT_BLUE:
-		retColor.r = 103;
-		retColor.g = 198;
-		retColor.b = 243;
-		break;
-	case Color::BOOK_RED:
-		retColor.r = 150;
-		retColor.g = 35;
-		retColor.b = 31;
-		break;
-	case Color::PRINCETON_ORANGE:
-		retColor.r = 245;
-		retColor.g = 128;
-		retColor.b = 37;
-		break;
-	case Color::UNDEFINED:
-	default:
-		assert(!"This RGB combination is not associated with a cwt::Color enum!");
-		break;
+		return (std::uint32_t)(rgb * 0x9E3779B1u) >> (32 - COLOR_SLOT_BITS);
 	}
 
-	return retColor;
-}
-
-cwt::Color cwt::getColor(int red, int green, int blue)
-{
+	constexpr std::array<cwt::Color, COLOR_SLOTS> makeColorIndex()
 	{
-		for (Color c = Color::FIRST; c != Color::LAST; c = static_cast<Color>(static_cast<int>(c) + 1))
+		std::array<cwt::Color, COLOR_SLOTS> index{};
+		index.fill(cwt::Color::UNDEFINED);
+		// BLACK first, so that UNDEFINED, also black, never shadows it
+		for (size_t c = (size_t)cwt::Color::BLACK; c < cwt::NAMED_COLORS.size(); c++)
 		{
-			ColorRgba rgbaColor = getRgba(c);
-			if (rgbaColor.r == red && rgbaColor.g == green && rgbaColor.b == blue)
+			size_t slot = findSlot(cwt::NAMED_COLORS[c].pack() >> 8);
+			while (index[slot] != cwt::Color::UNDEFINED)
 			{
-				return c;
+				slot = (slot + 1) % COLOR_SLOTS;
 			}
+			index[slot] = (cwt::Color)c;
 		}
+		return index;
+	}
+
+	constexpr std::array<cwt::Color, COLOR_SLOTS> COLOR_INDEX = makeColorIndex();
+}
 
-		assert(!"RGB Color is not assigned to a cwt::Color enum!");
+cwt::Color cwt::getColor(int red, int green, int blue)
+{
+	if ((red | green | blue) & ~0xFF)
+	{
 		return Color::UNDEFINED;
 	}
+
+	const std::uint32_t rgb = (std::uint32_t)red << 16 | (std::uint32_t)green << 8 | (std::uint32_t)blue;
+	for (size_t slot = findSlot(rgb); COLOR_INDEX[slot] != Color::UNDEFINED; slot = (slot + 1) % COLOR_SLOTS)
+	{
+		if (getRgba(COLOR_INDEX[slot]).pack() >> 8 == rgb)
+		{
+			return COLOR_INDEX[slot];
+		}
+	}
+	return Color::UNDEFINED;
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 
 namespace cwt
 {
@@ -26,21 +28,67 @@ namespace cwt
 		BOOK_LIGHT_BLUE,
 		BOOK_RED,
 		PRINCETON_ORANGE,
+		LAST,
 		DEFAULT_PEN_COLOR = BLACK,
-		DEFAULT_CLEAR_COLOR = WHITE,
-		LAST
+		DEFAULT_CLEAR_COLOR = WHITE
 	};
 
+	// 32-bit color, one byte per channel; alpha 255 is opaque
 	struct ColorRgba
 	{
-		int r = 0;
-		int g = 0;
-		int b = 0;
-		int a = 255;	
-	};	
-
-	ColorRgba getRgba(Color color);
-	
+		std::uint8_t r = 0;
+		std::uint8_t g = 0;
+		std::uint8_t b = 0;
+		std::uint8_t a = 255;
+
+		// The channels as 0xRRGGBBAA
+		constexpr std::uint32_t pack() const
+		{
+			return (std::uint32_t)r << 24 | (std::uint32_t)g << 16 | (std::uint32_t)b << 8 | a;
+		}
+
+		static constexpr ColorRgba unpack(std::uint32_t rgba)
+		{
+			return ColorRgba{ (std::uint8_t)(rgba >> 24), (std::uint8_t)(rgba >> 16),
+				(std::uint8_t)(rgba >> 8), (std::uint8_t)rgba };
+		}
+	};
+
+	constexpr bool operator==(const ColorRgba& lhs, const ColorRgba& rhs)
+	{
+		return lhs.pack() == rhs.pack();
+	}
+
+	// Channels of the named colors, indexed by Color; UNDEFINED is black
+	constexpr std::array<ColorRgba, (size_t)Color::LAST> NAMED_COLORS{ {
+		{ 0, 0, 0 },		// UNDEFINED
+		{ 0, 0, 0 },		// BLACK
+		{ 0, 0, 255 },		// BLUE
+		{ 0, 255, 255 },	// CYAN
+		{ 102, 102, 102 },	// DARK_GRAY
+		{ 153, 153, 153 },	// GRAY
+		{ 0, 255, 0 },		// GREEN
+		{ 204, 204, 204 },	// LIGHT_GRAY
+		{ 255, 0, 255 },	// MAGENTA
+		{ 255, 102, 0 },	// ORANGE
+		{ 255, 192, 203 },	// PINK
+		{ 255, 0, 0 },		// RED
+		{ 255, 255, 255 },	// WHITE
+		{ 255, 255, 0 },	// YELLOW
+		{ 9, 90, 196 },		// BOOK_BLUE
+		{ 103, 198, 243 },	// BOOK_LIGHT_BLUE
+		{ 150, 35, 31 },	// BOOK_RED
+		{ 245, 128, 37 }	// PRINCETON_ORANGE
+	} };
+
+	constexpr ColorRgba getRgba(Color color)
+	{
+		const size_t index = (size_t)color;
+		return index < NAMED_COLORS.size() ? NAMED_COLORS[index] : ColorRgba{};
+	}
+
+	// The named color of an RGB triple, or Color::UNDEFINED if it has no name;
+	// a hash lookup, so any triple may be asked about
 	Color getColor(int red, int green, int blue);
 
 	struct Pen
@@ -49,6 +97,19 @@ namespace cwt
 		double radius;
 	};
 
+	inline bool operator==(const Pen& lhs, const Pen& rhs)
+	{
+		return lhs.color == rhs.color && lhs.radius == rhs.radius;
+	}
+
+	// Width in pixels of what pen draws on a width x height canvas. As in
+	// Java, where it is 512 times the radius on the default 512x512 canvas,
+	// it follows the size of the canvas, here its smaller side.
+	inline double penWidth(const Pen& pen, int width, int height)
+	{
+		return pen.radius * (std::min)(width, height);
+	}
+
 	class Font
 	{
 	public:
@@ -84,6 +145,11 @@ namespace cwt
 		{
 			return this->size;
 		}
+
+		bool operator==(const Font& other) const
+		{
+			return size == other.size && style == other.style && name == other.name;
+		}
 	private:
 		std::wstring name = L"SansSerif";
 		Style style = Style::FontStyleRegular;
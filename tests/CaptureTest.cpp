@@ -0,0 +1,318 @@
+#include "Test.h"
+#include "Capture.h"
+#include "Decode.h"
+#include "Render.h"
+#include "cwt.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int WIDTH = 120;
+	constexpr int HEIGHT = 90;
+
+	const cwt::ColorRgba WHITE{ 255, 255, 255, 255 };
+	const cwt::ColorRgba RED{ 255, 0, 0, 255 };
+	const cwt::ColorRgba TRANSLUCENT_BLUE{ 0, 0, 255, 100 };
+
+	void drawScene(Render& render)
+	{
+		render.clear(WHITE);
+		render.getPen() = cwt::Pen{ RED, 0.005 };
+		// A path drawn one line at a time
+		render.drawLine(10, 10, 60, 10);
+		render.drawLine(60, 10, 60, 60);
+		render.drawLine(60, 60, 10, 10);
+		render.fillElipse(70, 20, 30, 20);
+		render.getPen() = cwt::Pen{ TRANSLUCENT_BLUE, 0.01 };
+		render.fillPolygon(std::vector<double>{ 5, 80, 50, 40, 100, 85 });
+		render.drawArc(20, 20, 60, 50, 30, 200);
+		render.drawLines(std::vector<double>{ 0, 0, 120, 90, 0, 90, 120, 0 });
+		render.fillRectangles(std::vector<double>{ 100, 5, 10, 10, 105, 10, 10, 10 });
+		render.getPen() = cwt::Pen{ RED, 0.005 };
+		render.drawRectangle(2, 2, 116, 86);
+		render.drawString(L"Hi", 80, 70);
+	}
+
+	/**
+	 * Draws the records of a capture on a render, as algs4_replay does at the
+	 * size they were captured at.
+	 */
+	class Player
+	{
+	public:
+		explicit Player(Render& render) : render(render) {}
+
+		void play(const capture::Record& record)
+		{
+			using capture::Op;
+			switch (record.op)
+			{
+			case Op::Pen:
+			{
+				const capture::PenData& data = record.viewData<capture::PenData>();
+				pens.resize((std::max)(pens.size(), (size_t)record.pen + 1));
+				pens[record.pen] = cwt::Pen{ cwt::ColorRgba::unpack(data.color), data.radius };
+				return;
+			}
+			case Op::Font:
+			{
+				const capture::FontData& data = record.viewData<capture::FontData>();
+				fonts.resize((std::max)(fonts.size(), (size_t)record.pen + 1));
+				fonts[record.pen] = cwt::Font(capture::toWide(record.viewString<capture::FontData>(), record.count),
+					(cwt::Font::Style)data.style, data.size);
+				return;
+			}
+			case Op::Canvas:
+				render.setCanvasSize(record.viewData<capture::CanvasData>().width, record.viewData<capture::CanvasData>().height);
+				return;
+			case Op::Clear:
+				render.clear(cwt::ColorRgba::unpack(record.viewData<capture::ClearData>().color));
+				return;
+			case Op::Buffering:
+				render.setDoubleBuffering(record.viewData<capture::BufferingData>().enabled != 0);
+				return;
+			case Op::Present:
+				render.present();
+				return;
+			default:
+				break;
+			}
+
+			REQUIRE(record.pen < pens.size());
+			render.getPen() = pens[record.pen];
+			if (record.op == Op::Text)
+			{
+				const capture::TextData& data = record.viewData<capture::TextData>();
+				REQUIRE(data.font < fonts.size());
+				render.getFont() = fonts[data.font];
+				render.drawString(capture::toWide(record.viewString<capture::TextData>(), record.count), data.x, data.y);
+				return;
+			}
+
+			const size_t arity = capture::viewArity(record.op);
+			const float* c = record.viewCoords();
+			const std::vector<double> values(c, c + record.count * arity);
+			switch (record.op)
+			{
+			case Op::Polygon:
+				render.drawPolygon(values);
+				return;
+			case Op::FilledPolygon:
+				render.fillPolygon(values);
+				return;
+			case Op::Lines:
+				render.drawLines(values);
+				return;
+			case Op::FilledEllipses:
+				render.fillElipses(values);
+				return;
+			case Op::FilledRectangles:
+				render.fillRectangles(values);
+				return;
+			default:
+				break;
+			}
+			for (size_t i = 0; i < values.size(); i += arity)
+			{
+				const double* v = values.data() + i;
+				switch (record.op)
+				{
+				case Op::Line: render.drawLine(v[0], v[1], v[2], v[3]); break;
+				case Op::Ellipse: render.drawElipse(v[0], v[1], v[2], v[3]); break;
+				case Op::FilledEllipse: render.fillElipse(v[0], v[1], v[2], v[3]); break;
+				case Op::Arc: render.drawArc(v[0], v[1], v[2], v[3], v[4], v[5]); break;
+				case Op::Rectangle: render.drawRectangle(v[0], v[1], v[2], v[3]); break;
+				case Op::FilledRectangle: render.fillRectangle(v[0], v[1], v[2], v[3]); break;
+				default: break;
+				}
+			}
+		}
+
+	private:
+		Render& render;
+		std::vector<cwt::Pen> pens;
+		std::vector<cwt::Font> fonts;
+	};
+
+	std::vector<const capture::Record*> readAll(capture::Reader& reader)
+	{
+		std::vector<const capture::Record*> records;
+		for (const capture::Record* record = reader.next(); record; record = reader.next())
+		{
+			records.push_back(record);
+		}
+		return records;
+	}
+}
+
+TEST(Capture, ReplayDrawsTheSamePixels)
+{
+	const std::string capturePath = test::viewTempDir() + "/scene.a4c";
+	const std::string directPath = test::viewTempDir() + "/direct.ppm";
+	const std::string replayedPath = test::viewTempDir() + "/replayed.ppm";
+	{
+		Render render(cwt::Pen{ RED, 0.005 }, WIDTH, HEIGHT, L"test");
+		render.startCapture(capturePath.c_str());
+		drawScene(render);
+		render.stopCapture();
+		render.save(directPath.c_str());
+	}
+	{
+		capture::Reader reader(capturePath);
+		Render render(cwt::Pen{ WHITE, 0.0 }, WIDTH, HEIGHT, L"test");
+		Player player(render);
+		for (const capture::Record* record = reader.next(); record; record = reader.next())
+		{
+			player.play(*record);
+		}
+		render.save(replayedPath.c_str());
+	}
+
+	const test::RgbImage direct = test::readPpm(directPath);
+	const test::RgbImage replayed = test::readPpm(replayedPath);
+	CHECK_EQ(replayed.width, WIDTH);
+	CHECK_EQ(replayed.height, HEIGHT);
+	CHECK(replayed.rgb == direct.rgb);
+	std::remove(capturePath.c_str());
+	std::remove(directPath.c_str());
+	std::remove(replayedPath.c_str());
+}
+
+TEST(Capture, GroupsCallsAndDefinesPensOnce)
+{
+	const std::string path = test::viewTempDir() + "/records.a4c";
+	{
+		Render render(cwt::Pen{ RED, 0.005 }, WIDTH, HEIGHT, L"test");
+		render.startCapture(path.c_str());
+		drawScene(render);
+		render.stopCapture();
+	}
+
+	capture::Reader reader(path);
+	const std::vector<const capture::Record*> records = readAll(reader);
+	REQUIRE(!records.empty());
+	REQUIRE(records[0]->op == capture::Op::Canvas);
+	CHECK_EQ(records[0]->viewData<capture::CanvasData>().width, WIDTH);
+	CHECK_EQ(records[0]->viewData<capture::CanvasData>().height, HEIGHT);
+
+	std::vector<bool> defined;
+	size_t pens = 0;
+	size_t lineRecords = 0;
+	for (const capture::Record* record : records)
+	{
+		CHECK_EQ((size_t)record->bytes % 8, size_t{ 0 });
+		switch (record->op)
+		{
+		case capture::Op::Pen:
+			pens++;
+			defined.resize((std::max)(defined.size(), (size_t)record->pen + 1));
+			defined[record->pen] = true;
+			break;
+		case capture::Op::Line:
+			// The three lines share a record
+			lineRecords++;
+			CHECK_EQ(record->count, std::uint32_t{ 3 });
+			CHECK_EQ(record->viewCoords()[4], 60.0f);
+			break;
+		case capture::Op::FilledPolygon:
+			CHECK_EQ(record->count, std::uint32_t{ 3 });
+			break;
+		case capture::Op::FilledRectangles:
+			CHECK_EQ(record->count, std::uint32_t{ 2 });
+			break;
+		case capture::Op::Text:
+			CHECK(capture::toWide(record->viewString<capture::TextData>(), record->count) == L"Hi");
+			break;
+		default:
+			break;
+		}
+		if (capture::viewArity(record->op) > 0 || record->op == capture::Op::Text)
+		{
+			CHECK(record->pen < defined.size() && defined[record->pen]);
+		}
+	}
+	// Red is defined once, though it is picked twice
+	CHECK_EQ(pens, size_t{ 2 });
+	CHECK_EQ(lineRecords, size_t{ 1 });
+	std::remove(path.c_str());
+}
+
+TEST(Capture, ReaderStopsAtATruncatedRecord)
+{
+	const std::string path = test::viewTempDir() + "/whole.a4c";
+	const std::string cutPath = test::viewTempDir() + "/cut.a4c";
+	{
+		Render render(cwt::Pen{ RED, 0.005 }, WIDTH, HEIGHT, L"test");
+		render.startCapture(path.c_str());
+		drawScene(render);
+		render.stopCapture();
+	}
+	size_t whole = 0;
+	{
+		capture::Reader reader(path);
+		whole = readAll(reader).size();
+	}
+
+	// Cut inside the last record, as a program that crashed would leave it
+	const std::vector<std::uint8_t> bytes = test::readFile(path);
+	std::ofstream(cutPath, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size() - 4);
+	{
+		capture::Reader reader(cutPath);
+		CHECK_EQ(readAll(reader).size(), whole - 1);
+	}
+
+	// Anything but a capture is refused
+	std::ofstream(cutPath, std::ios::binary | std::ios::trunc) << "not a capture, only some text";
+	bool isRefused = false;
+	try
+	{
+		capture::Reader reader(cutPath);
+	}
+	catch (const std::runtime_error&)
+	{
+		isRefused = true;
+	}
+	CHECK(isRefused);
+	std::remove(path.c_str());
+	std::remove(cutPath.c_str());
+}
+
+TEST(Capture, ReaderRefusesAnEmptyCanvas)
+{
+	const std::string path = test::viewTempDir() + "/canvas.a4c";
+	{
+		Render render(cwt::Pen{ RED, 0.005 }, WIDTH, HEIGHT, L"test");
+		render.startCapture(path.c_str());
+		drawScene(render);
+		render.stopCapture();
+	}
+
+	// The capture starts with its canvas; replaying it would divide by a
+	// width of zero
+	std::vector<std::uint8_t> bytes = test::readFile(path);
+	const size_t width = sizeof(capture::FileHeader) + sizeof(capture::Record) + offsetof(capture::CanvasData, width);
+	for (const std::int32_t corrupt : { 0, -5 })
+	{
+		std::memcpy(bytes.data() + width, &corrupt, sizeof(corrupt));
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+		bool isRefused = false;
+		try
+		{
+			capture::Reader reader(path);
+			readAll(reader);
+		}
+		catch (const std::runtime_error&)
+		{
+			isRefused = true;
+		}
+		CHECK(isRefused);
+	}
+	std::remove(path.c_str());
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include "DisplayList.h"
+
+namespace test
+{
+	/**
+	 * Device for DisplayList::replay() that writes down every call it gets,
+	 * one per line, as its name, the pen color and the coordinates:
+	 *
+	 *   line #ff0000ff 1 2 3 4
+	 */
+	class CommandLog
+	{
+	public:
+		void line(geom::PenRef pen, float x1, float y1, float x2, float y2)
+		{
+			const float c[4] = { x1, y1, x2, y2 };
+			write("line", pen, c, 4);
+		}
+
+		void ellipse(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			const float c[4] = { x, y, width, height };
+			write(isFill ? "filledEllipse" : "ellipse", pen, c, 4);
+		}
+
+		void arc(geom::PenRef pen, float x, float y, float width, float height, float start, float sweep)
+		{
+			const float c[6] = { x, y, width, height, start, sweep };
+			write("arc", pen, c, 6);
+		}
+
+		void rectangle(geom::PenRef pen, float x, float y, float width, float height, bool isFill)
+		{
+			const float c[4] = { x, y, width, height };
+			write(isFill ? "filledRectangle" : "rectangle", pen, c, 4);
+		}
+
+		void polygon(geom::PenRef pen, const float* xy, size_t n, bool isFill)
+		{
+			write(isFill ? "filledPolygon" : "polygon", pen, xy, 2 * n);
+		}
+
+		void polyline(geom::PenRef pen, const float* xy, size_t n)
+		{
+			write("polyline", pen, xy, 2 * n);
+		}
+
+		void text(geom::PenRef pen, geom::FontRef font, const wchar_t* text, float x, float y)
+		{
+			const float c[2] = { x, y };
+			write("text", pen, c, 2);
+			log.pop_back();
+			log += " \"";
+			for (; *text; text++)
+			{
+				log += (char)*text;
+			}
+			log += "\" " + std::to_string(font->viewFontSize()) + "\n";
+		}
+
+		void lines(geom::PenRef pen, const float* segments, size_t n)
+		{
+			write("lines", pen, segments, 4 * n);
+		}
+
+		void filledEllipses(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			write("filledEllipses", pen, boxes, 4 * n);
+		}
+
+		void filledRectangles(geom::PenRef pen, const float* boxes, size_t n)
+		{
+			write("filledRectangles", pen, boxes, 4 * n);
+		}
+
+		std::string log;
+
+	private:
+		void write(const char* name, geom::PenRef pen, const float* values, size_t n)
+		{
+			char buffer[32];
+			std::snprintf(buffer, sizeof(buffer), " #%08x", (unsigned)pen->color.pack());
+			log += name;
+			log += buffer;
+			for (size_t i = 0; i < n; i++)
+			{
+				std::snprintf(buffer, sizeof(buffer), " %g", values[i]);
+				log += buffer;
+			}
+			log += "\n";
+		}
+	};
+}
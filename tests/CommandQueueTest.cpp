@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "CommandLog.h"
+#include "CommandQueue.h"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const cwt::Pen RED{ cwt::ColorRgba{ 255, 0, 0, 255 }, 0.002 };
+	const cwt::Pen BLUE{ cwt::ColorRgba{ 0, 0, 255, 255 }, 0.002 };
+
+	std::string replay(const geom::DisplayList& list)
+	{
+		test::CommandLog log;
+		list.replay(log);
+		return log.log;
+	}
+}
+
+TEST(CommandQueue, KeepsCommandsInOrderWithTheirPens)
+{
+	geom::CommandQueue queue;
+	queue.addLine(RED, 1, 2, 3, 4);
+	queue.addRectangle(BLUE, 5, 6, 7, 8, true);
+	const double xy[] = { 0, 0, 10, 0, 5, 5 };
+	queue.addPolygon(RED, xy, 3, false);
+	queue.addText(BLUE, cwt::Font(L"Serif", cwt::Font::Style::FontStyleRegular, 12), L"hi!", 2, 9, 10);
+	const double segments[] = { 1, 1, 2, 2, 3, 3, 4, 4 };
+	queue.addLines(RED, segments, 2);
+	queue.addArc(BLUE, 1, 2, 3, 4, 45, 90);
+
+	geom::DisplayList list;
+	CHECK(queue.drain(list).kind == geom::Control::Kind::None);
+	CHECK_EQ(replay(list),
+		"line #ff0000ff 1 2 3 4\n"
+		"filledRectangle #0000ffff 5 6 7 8\n"
+		"polygon #ff0000ff 0 0 10 0 5 5\n"
+		"text #0000ffff 9 10 \"hi\" 12\n"
+		"lines #ff0000ff 1 1 2 2 3 3 4 4\n"
+		"arc #0000ffff 1 2 3 4 45 90\n");
+	CHECK_EQ(queue.viewPendingBytes(), size_t{ 0 });
+}
+
+TEST(CommandQueue, RefusesAPolygonTooLargeForARecord)
+{
+	geom::CommandQueue queue;
+	// The size is checked before a coordinate is read
+	const double xy[] = { 0, 0, 10, 0, 5, 5 };
+	bool isRefused = false;
+	try
+	{
+		queue.addPolygon(RED, xy, size_t{ 1 } << 30, true);
+	}
+	catch (const std::invalid_argument&)
+	{
+		isRefused = true;
+	}
+	CHECK(isRefused);
+
+	// Nothing of it was queued
+	queue.addPolygon(RED, xy, 3, true);
+	geom::DisplayList list;
+	CHECK(queue.drain(list).kind == geom::Control::Kind::None);
+	CHECK_EQ(replay(list), "filledPolygon #ff0000ff 0 0 10 0 5 5\n");
+}
+
+TEST(CommandQueue, StopsAtEachControlRecord)
+{
+	geom::CommandQueue queue;
+	queue.addLine(RED, 0, 0, 1, 1);
+	queue.clear(cwt::ColorRgba{ 1, 2, 3, 4 });
+	queue.addLine(RED, 5, 5, 6, 6);
+	queue.present();
+	queue.setCanvasSize(300, 200);
+	queue.save("out.png");
+	queue.saveVector("out.svg", true);
+	queue.startRecording("out.gif", 25);
+	const std::uint64_t epoch = queue.fence();
+	queue.quit();
+
+	geom::DisplayList list;
+	geom::Control control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Clear);
+	CHECK(control.color == (cwt::ColorRgba{ 1, 2, 3, 4 }));
+	CHECK_EQ(list.size(), size_t{ 1 });
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Present);
+	CHECK_EQ(list.size(), size_t{ 2 });
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Canvas);
+	CHECK_EQ(control.width, 300);
+	CHECK_EQ(control.height, 200);
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Save);
+	CHECK_EQ(std::string(control.path), "out.png");
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Export);
+	CHECK(control.enabled);
+	CHECK_EQ(std::string(control.path), "out.svg");
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Record);
+	CHECK(control.enabled);
+	CHECK_EQ(control.fps, 25);
+	CHECK_EQ(std::string(control.path), "out.gif");
+
+	control = queue.drain(list);
+	CHECK(control.kind == geom::Control::Kind::Fence);
+	CHECK_EQ(control.epoch, epoch);
+
+	CHECK(queue.drain(list).kind == geom::Control::Kind::Quit);
+	CHECK(queue.drain(list).kind == geom::Control::Kind::None);
+	CHECK_EQ(list.size(), size_t{ 2 });
+}
+
+TEST(CommandQueue, CarriesRecordsLargerThanAChunk)
+{
+	geom::CommandQueue queue;
+	geom::DisplayList list;
+	// Drawn twice, so that the second one reuses the chunk of the first
+	for (int round = 0; round < 2; round++)
+	{
+		std::vector<double> xy(2 * 100000);
+		for (size_t i = 0; i < xy.size(); i++)
+		{
+			xy[i] = (double)(i % 1000) + round;
+		}
+		queue.addLine(RED, 0, 0, 1, 1);
+		queue.addPolygon(BLUE, xy.data(), xy.size() / 2, true);
+		queue.addLine(RED, 2, 2, 3, 3);
+
+		list.clear();
+		CHECK(queue.drain(list).kind == geom::Control::Kind::None);
+		std::string expected = "line #ff0000ff 0 0 1 1\nfilledPolygon #0000ffff";
+		for (double v : xy)
+		{
+			expected += ' ';
+			expected += std::to_string((int)v);
+		}
+		expected += "\nline #ff0000ff 2 2 3 3\n";
+		CHECK(replay(list) == expected);
+	}
+}
+
+TEST(CommandQueue, FenceWaitsForEverythingBeforeIt)
+{
+	constexpr int ROUNDS = 50;
+	constexpr int LINES = 2000;
+	geom::CommandQueue queue;
+	std::atomic<size_t> drainedAtFence{ 0 };
+	std::thread consumer([&queue, &drainedAtFence]()
+		{
+			geom::DisplayList list;
+			for (;;)
+			{
+				const geom::Control control = queue.drain(list);
+				switch (control.kind)
+				{
+				case geom::Control::Kind::None:
+					queue.waitForCommands();
+					break;
+				case geom::Control::Kind::Fence:
+					drainedAtFence.store(list.size(), std::memory_order_relaxed);
+					queue.complete(control.epoch);
+					break;
+				case geom::Control::Kind::Quit:
+					queue.detach();
+					return;
+				default:
+					break;
+				}
+			}
+		});
+
+	for (int round = 1; round <= ROUNDS; round++)
+	{
+		// Lines that do not touch, so that each one stays a command
+		for (int i = 0; i < LINES; i++)
+		{
+			queue.addLine(i % 2 == 0 ? RED : BLUE, i, round, i + 0.5, round);
+		}
+		queue.waitFor(queue.fence());
+		CHECK_EQ(drainedAtFence.load(std::memory_order_relaxed), (size_t)round * LINES);
+	}
+	queue.quit();
+	consumer.join();
+	CHECK_EQ(queue.viewPendingBytes(), size_t{ 0 });
+}
+
+TEST(CommandQueue, DetachReleasesWaitingProducers)
+{
+	geom::CommandQueue queue;
+	const std::uint64_t epoch = queue.fence();
+	std::thread consumer([&queue]() { queue.detach(); });
+	queue.waitFor(epoch);
+	consumer.join();
+	// Anything later is released at once
+	queue.waitFor(queue.fence());
+}
@@ -0,0 +1,676 @@
+#include "Decode.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+	// Reads the bits of a deflate stream, least significant first
+	class BitReader
+	{
+	public:
+		BitReader(const std::uint8_t* data, size_t n) : data(data), n(n) {}
+
+		std::uint32_t readBits(int count)
+		{
+			while (bitCount < count)
+			{
+				buffer |= (std::uint32_t)readByte() << bitCount;
+				bitCount += 8;
+			}
+			const std::uint32_t value = buffer & ((1u << count) - 1);
+			buffer >>= count;
+			bitCount -= count;
+			return value;
+		}
+
+		// Drops the bits left of the current byte
+		void alignToByte()
+		{
+			buffer = 0;
+			bitCount = 0;
+		}
+
+		std::uint8_t readByte()
+		{
+			if (pos >= n)
+			{
+				throw std::runtime_error("deflate stream cut short");
+			}
+			return data[pos++];
+		}
+
+		size_t viewPosition() const { return pos; }
+
+	private:
+		const std::uint8_t* data;
+		size_t n;
+		size_t pos = 0;
+		std::uint32_t buffer = 0;
+		int bitCount = 0;
+	};
+
+	// Canonical Huffman code: the number of codes of each length and the
+	// symbols in code order
+	struct Huffman
+	{
+		int counts[16] = {};
+		std::vector<int> symbols;
+	};
+
+	Huffman buildHuffman(const int* lengths, int n)
+	{
+		Huffman code;
+		code.symbols.resize(n);
+		for (int i = 0; i < n; i++)
+		{
+			code.counts[lengths[i]]++;
+		}
+		code.counts[0] = 0;
+		int offsets[16] = {};
+		for (int length = 1; length < 15; length++)
+		{
+			offsets[length + 1] = offsets[length] + code.counts[length];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			if (lengths[i] != 0)
+			{
+				code.symbols[offsets[lengths[i]]++] = i;
+			}
+		}
+		return code;
+	}
+
+	int decodeSymbol(BitReader& in, const Huffman& code)
+	{
+		int bits = 0;
+		int first = 0;
+		int index = 0;
+		for (int length = 1; length < 16; length++)
+		{
+			bits |= (int)in.readBits(1);
+			const int count = code.counts[length];
+			if (bits - first < count)
+			{
+				return code.symbols[index + bits - first];
+			}
+			index += count;
+			first = (first + count) << 1;
+			bits <<= 1;
+		}
+		throw std::runtime_error("invalid Huffman code");
+	}
+
+	const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	void inflateBlock(BitReader& in, const Huffman& lengths, const Huffman& distances, std::vector<std::uint8_t>& out)
+	{
+		for (;;)
+		{
+			const int symbol = decodeSymbol(in, lengths);
+			if (symbol < 256)
+			{
+				out.push_back((std::uint8_t)symbol);
+				continue;
+			}
+			if (symbol == 256)
+			{
+				return;
+			}
+			if (symbol > 285)
+			{
+				throw std::runtime_error("invalid length symbol");
+			}
+			const int length = LENGTH_BASE[symbol - 257] + (int)in.readBits(LENGTH_EXTRA[symbol - 257]);
+			const int code = decodeSymbol(in, distances);
+			if (code > 29)
+			{
+				throw std::runtime_error("invalid distance symbol");
+			}
+			const size_t distance = DISTANCE_BASE[code] + in.readBits(DISTANCE_EXTRA[code]);
+			if (distance > out.size())
+			{
+				throw std::runtime_error("distance before the start of the stream");
+			}
+			for (int i = 0; i < length; i++)
+			{
+				out.push_back(out[out.size() - distance]);
+			}
+		}
+	}
+
+	void inflateFixed(BitReader& in, std::vector<std::uint8_t>& out)
+	{
+		int lengths[288];
+		for (int i = 0; i < 288; i++)
+		{
+			lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+		}
+		int distances[30];
+		std::fill(distances, distances + 30, 5);
+		inflateBlock(in, buildHuffman(lengths, 288), buildHuffman(distances, 30), out);
+	}
+
+	void inflateDynamic(BitReader& in, std::vector<std::uint8_t>& out)
+	{
+		static const int ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		const int lengthCount = (int)in.readBits(5) + 257;
+		const int distanceCount = (int)in.readBits(5) + 1;
+		const int codeCount = (int)in.readBits(4) + 4;
+		int codeLengths[19] = {};
+		for (int i = 0; i < codeCount; i++)
+		{
+			codeLengths[ORDER[i]] = (int)in.readBits(3);
+		}
+		const Huffman lengthCode = buildHuffman(codeLengths, 19);
+
+		int lengths[320] = {};
+		int i = 0;
+		while (i < lengthCount + distanceCount)
+		{
+			const int symbol = decodeSymbol(in, lengthCode);
+			if (symbol < 16)
+			{
+				lengths[i++] = symbol;
+				continue;
+			}
+			int repeated = 0;
+			int times;
+			if (symbol == 16)
+			{
+				if (i == 0)
+				{
+					throw std::runtime_error("repeat with no previous length");
+				}
+				repeated = lengths[i - 1];
+				times = 3 + (int)in.readBits(2);
+			}
+			else if (symbol == 17)
+			{
+				times = 3 + (int)in.readBits(3);
+			}
+			else
+			{
+				times = 11 + (int)in.readBits(7);
+			}
+			if (i + times > lengthCount + distanceCount)
+			{
+				throw std::runtime_error("too many code lengths");
+			}
+			std::fill(lengths + i, lengths + i + times, repeated);
+			i += times;
+		}
+		inflateBlock(in, buildHuffman(lengths, lengthCount), buildHuffman(lengths + lengthCount, distanceCount), out);
+	}
+
+	std::uint32_t readU32BE(const std::uint8_t* p)
+	{
+		return (std::uint32_t)p[0] << 24 | (std::uint32_t)p[1] << 16 | (std::uint32_t)p[2] << 8 | p[3];
+	}
+
+	std::uint32_t crc32(const std::uint8_t* data, size_t n)
+	{
+		std::uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < n; i++)
+		{
+			crc ^= data[i];
+			for (int k = 0; k < 8; k++)
+			{
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+			}
+		}
+		return ~crc;
+	}
+
+	int paeth(int a, int b, int c)
+	{
+		const int p = a + b - c;
+		const int pa = std::abs(p - a);
+		const int pb = std::abs(p - b);
+		const int pc = std::abs(p - c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	// Walks the bytes of a GIF
+	class GifReader
+	{
+	public:
+		explicit GifReader(const std::vector<std::uint8_t>& bytes) : bytes(bytes) {}
+
+		std::uint8_t readByte()
+		{
+			if (pos >= bytes.size())
+			{
+				throw std::runtime_error("GIF cut short");
+			}
+			return bytes[pos++];
+		}
+
+		int read16()
+		{
+			const int low = readByte();
+			return low | readByte() << 8;
+		}
+
+		// The data of a run of sub-blocks, up to the empty one ending it
+		std::vector<std::uint8_t> readSubBlocks()
+		{
+			std::vector<std::uint8_t> data;
+			for (int n = readByte(); n > 0; n = readByte())
+			{
+				for (int i = 0; i < n; i++)
+				{
+					data.push_back(readByte());
+				}
+			}
+			return data;
+		}
+
+	private:
+		const std::vector<std::uint8_t>& bytes;
+		size_t pos = 0;
+	};
+
+	// Decodes the LZW codes of a GIF image into count color indices
+	std::vector<std::uint8_t> decodeGifLzw(const std::vector<std::uint8_t>& data, int minCodeSize, size_t count)
+	{
+		if (minCodeSize < 2 || minCodeSize > 8)
+		{
+			throw std::runtime_error("GIF with a bad LZW code size");
+		}
+		const int clearCode = 1 << minCodeSize;
+		const int endCode = clearCode + 1;
+		// Every entry is an entry before it plus one index
+		std::vector<int> prefixes(4096, -1);
+		std::vector<std::uint8_t> suffixes(4096, 0);
+		std::vector<std::uint8_t> firsts(4096, 0);
+		for (int i = 0; i < clearCode; i++)
+		{
+			suffixes[i] = (std::uint8_t)i;
+			firsts[i] = (std::uint8_t)i;
+		}
+
+		std::vector<std::uint8_t> indices;
+		std::vector<std::uint8_t> string;
+		auto emit = [&](int code)
+		{
+			string.clear();
+			for (int c = code; c >= 0; c = prefixes[c])
+			{
+				string.push_back(suffixes[c]);
+			}
+			indices.insert(indices.end(), string.rbegin(), string.rend());
+		};
+
+		int codeSize = minCodeSize + 1;
+		int next = endCode + 1;
+		int previous = -1;
+		size_t bit = 0;
+		for (;;)
+		{
+			if (bit + codeSize > data.size() * 8)
+			{
+				throw std::runtime_error("GIF image without an end code");
+			}
+			int code = 0;
+			for (int i = 0; i < codeSize; i++, bit++)
+			{
+				code |= (data[bit / 8] >> (bit % 8) & 1) << i;
+			}
+
+			if (code == clearCode)
+			{
+				codeSize = minCodeSize + 1;
+				next = endCode + 1;
+				previous = -1;
+				continue;
+			}
+			if (code == endCode)
+			{
+				break;
+			}
+			if (previous < 0)
+			{
+				if (code >= clearCode)
+				{
+					throw std::runtime_error("GIF image starting with an undefined code");
+				}
+				emit(code);
+				previous = code;
+				continue;
+			}
+			if (code > next || (code == next && next >= 4096))
+			{
+				throw std::runtime_error("GIF image with an undefined code");
+			}
+			if (next < 4096)
+			{
+				// The code being defined starts as the previous one did
+				prefixes[next] = previous;
+				suffixes[next] = firsts[code == next ? previous : code];
+				firsts[next] = firsts[previous];
+				next++;
+				if (next == 1 << codeSize && codeSize < 12)
+				{
+					codeSize++;
+				}
+			}
+			emit(code);
+			previous = code;
+		}
+		if (indices.size() != count)
+		{
+			throw std::runtime_error("GIF image with the wrong number of pixels");
+		}
+		return indices;
+	}
+}
+
+std::vector<std::uint8_t> test::readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("cannot open " + path);
+	}
+	return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<std::uint8_t> test::inflateZlib(const std::uint8_t* data, size_t n)
+{
+	if (n < 6 || (data[0] & 0x0F) != 8 || (data[0] * 256 + data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+	{
+		throw std::runtime_error("invalid zlib header");
+	}
+	BitReader in(data + 2, n - 2);
+	std::vector<std::uint8_t> out;
+	bool isLast = false;
+	while (!isLast)
+	{
+		isLast = in.readBits(1) != 0;
+		switch (in.readBits(2))
+		{
+		case 0:
+		{
+			in.alignToByte();
+			int header[4];
+			for (int& byte : header)
+			{
+				byte = in.readByte();
+			}
+			const int length = header[0] | header[1] << 8;
+			const int complement = header[2] | header[3] << 8;
+			if ((length ^ 0xFFFF) != complement)
+			{
+				throw std::runtime_error("invalid stored block length");
+			}
+			for (int i = 0; i < length; i++)
+			{
+				out.push_back(in.readByte());
+			}
+			break;
+		}
+		case 1:
+			inflateFixed(in, out);
+			break;
+		case 2:
+			inflateDynamic(in, out);
+			break;
+		default:
+			throw std::runtime_error("invalid block type");
+		}
+	}
+
+	const size_t end = 2 + in.viewPosition();
+	if (end + 4 != n)
+	{
+		throw std::runtime_error("zlib stream does not end after its checksum");
+	}
+	std::uint32_t a = 1;
+	std::uint32_t b = 0;
+	for (std::uint8_t byte : out)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	if (readU32BE(data + end) != (b << 16 | a))
+	{
+		throw std::runtime_error("Adler-32 mismatch");
+	}
+	return out;
+}
+
+test::RgbImage test::readPpm(const std::string& path)
+{
+	const std::vector<std::uint8_t> bytes = readFile(path);
+	size_t pos = 0;
+	// The header is four fields separated by whitespace
+	auto readField = [&]()
+		{
+			while (pos < bytes.size() && std::strchr(" \t\r\n", bytes[pos]))
+			{
+				pos++;
+			}
+			std::string field;
+			while (pos < bytes.size() && !std::strchr(" \t\r\n", bytes[pos]))
+			{
+				field += (char)bytes[pos++];
+			}
+			return field;
+		};
+	if (readField() != "P6")
+	{
+		throw std::runtime_error(path + " is not a binary PPM");
+	}
+	RgbImage image;
+	image.width = std::atoi(readField().c_str());
+	image.height = std::atoi(readField().c_str());
+	if (readField() != "255")
+	{
+		throw std::runtime_error(path + " is not an 8-bit PPM");
+	}
+	pos++;
+	const size_t size = (size_t)image.width * image.height * 3;
+	if (image.width <= 0 || image.height <= 0 || bytes.size() - pos != size)
+	{
+		throw std::runtime_error(path + " has the wrong size");
+	}
+	image.rgb.assign(bytes.begin() + pos, bytes.end());
+	return image;
+}
+
+test::RgbImage test::readPng(const std::string& path)
+{
+	static const std::uint8_t SIGNATURE[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	const std::vector<std::uint8_t> bytes = readFile(path);
+	if (bytes.size() < 8 || std::memcmp(bytes.data(), SIGNATURE, 8) != 0)
+	{
+		throw std::runtime_error(path + " is not a PNG");
+	}
+
+	RgbImage image;
+	std::vector<std::uint8_t> compressed;
+	bool hasEnd = false;
+	size_t pos = 8;
+	while (!hasEnd)
+	{
+		if (bytes.size() - pos < 12)
+		{
+			throw std::runtime_error(path + " is cut short");
+		}
+		const size_t length = readU32BE(&bytes[pos]);
+		if (bytes.size() - pos - 12 < length)
+		{
+			throw std::runtime_error(path + " is cut short");
+		}
+		const std::uint8_t* type = &bytes[pos + 4];
+		const std::uint8_t* data = type + 4;
+		if (readU32BE(data + length) != crc32(type, length + 4))
+		{
+			throw std::runtime_error(path + " has a chunk with a bad CRC");
+		}
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			image.width = (int)readU32BE(data);
+			image.height = (int)readU32BE(data + 4);
+			if (length != 13 || data[8] != 8 || data[9] != 2 || data[12] != 0)
+			{
+				throw std::runtime_error(path + " is not an 8-bit RGB PNG");
+			}
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), data, data + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			hasEnd = true;
+		}
+		pos += 12 + length;
+	}
+
+	const std::vector<std::uint8_t> raw = inflateZlib(compressed.data(), compressed.size());
+	const size_t stride = (size_t)image.width * 3;
+	if (raw.size() != (stride + 1) * image.height)
+	{
+		throw std::runtime_error(path + " has the wrong amount of image data");
+	}
+	image.rgb.resize(stride * image.height);
+	for (int y = 0; y < image.height; y++)
+	{
+		const std::uint8_t* in = &raw[(stride + 1) * y];
+		std::uint8_t* row = &image.rgb[stride * y];
+		const std::uint8_t* up = y > 0 ? row - stride : nullptr;
+		for (size_t i = 0; i < stride; i++)
+		{
+			const int a = i >= 3 ? row[i - 3] : 0;
+			const int b = up ? up[i] : 0;
+			const int c = up && i >= 3 ? up[i - 3] : 0;
+			int predicted = 0;
+			switch (in[0])
+			{
+			case 0: predicted = 0; break;
+			case 1: predicted = a; break;
+			case 2: predicted = b; break;
+			case 3: predicted = (a + b) / 2; break;
+			case 4: predicted = paeth(a, b, c); break;
+			default: throw std::runtime_error(path + " has an unknown filter");
+			}
+			row[i] = (std::uint8_t)(in[1 + i] + predicted);
+		}
+	}
+	return image;
+}
+
+std::vector<test::GifFrame> test::readGif(const std::string& path)
+{
+	const std::vector<std::uint8_t> bytes = readFile(path);
+	if (bytes.size() < 13 || (std::memcmp(bytes.data(), "GIF89a", 6) != 0 && std::memcmp(bytes.data(), "GIF87a", 6) != 0))
+	{
+		throw std::runtime_error(path + " is not a GIF");
+	}
+	GifReader reader(bytes);
+	for (int i = 0; i < 6; i++)
+	{
+		reader.readByte();
+	}
+
+	RgbImage screen;
+	screen.width = reader.read16();
+	screen.height = reader.read16();
+	screen.rgb.assign((size_t)screen.width * screen.height * 3, 0);
+	const int screenFlags = reader.readByte();
+	reader.readByte();
+	reader.readByte();
+	std::vector<std::uint8_t> globalTable;
+	if (screenFlags & 0x80)
+	{
+		for (int i = 0; i < 3 << ((screenFlags & 7) + 1); i++)
+		{
+			globalTable.push_back(reader.readByte());
+		}
+	}
+
+	std::vector<GifFrame> frames;
+	int delay = 0;
+	for (;;)
+	{
+		const int introducer = reader.readByte();
+		if (introducer == 0x3B)
+		{
+			return frames;
+		}
+		if (introducer == 0x21)
+		{
+			const int label = reader.readByte();
+			const std::vector<std::uint8_t> data = reader.readSubBlocks();
+			if (label == 0xF9)
+			{
+				if (data.size() != 4)
+				{
+					throw std::runtime_error(path + " has a bad graphic control extension");
+				}
+				delay = data[1] | data[2] << 8;
+			}
+			continue;
+		}
+		if (introducer != 0x2C)
+		{
+			throw std::runtime_error(path + " has an unknown block");
+		}
+
+		GifFrame frame;
+		frame.left = reader.read16();
+		frame.top = reader.read16();
+		frame.width = reader.read16();
+		frame.height = reader.read16();
+		frame.delay = delay;
+		delay = 0;
+		const int flags = reader.readByte();
+		if (flags & 0x40)
+		{
+			throw std::runtime_error(path + " is interlaced");
+		}
+		if (frame.left + frame.width > screen.width || frame.top + frame.height > screen.height)
+		{
+			throw std::runtime_error(path + " has a frame off the screen");
+		}
+		std::vector<std::uint8_t> table = globalTable;
+		if (flags & 0x80)
+		{
+			table.clear();
+			for (int i = 0; i < 3 << ((flags & 7) + 1); i++)
+			{
+				table.push_back(reader.readByte());
+			}
+		}
+		const int minCodeSize = reader.readByte();
+		const std::vector<std::uint8_t> indices = decodeGifLzw(reader.readSubBlocks(), minCodeSize,
+			(size_t)frame.width * frame.height);
+		for (int y = 0; y < frame.height; y++)
+		{
+			for (int x = 0; x < frame.width; x++)
+			{
+				const size_t index = indices[(size_t)y * frame.width + x];
+				if (3 * index >= table.size())
+				{
+					throw std::runtime_error(path + " has an index past its color table");
+				}
+				std::memcpy(&screen.rgb[((size_t)(frame.top + y) * screen.width + frame.left + x) * 3], &table[3 * index], 3);
+			}
+		}
+		frame.screen = screen;
+		frames.push_back(std::move(frame));
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decoders the tests read back what the library writes with, kept apart
+// from its encoders so that a mistake is not made twice. They favour
+// plainness over speed and throw std::runtime_error on malformed input.
+namespace test
+{
+	// An image as 8-bit RGB rows, top to bottom
+	struct RgbImage
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<std::uint8_t> rgb;
+	};
+
+	std::vector<std::uint8_t> readFile(const std::string& path);
+
+	// Decompresses a zlib stream with any deflate blocks, checking its Adler-32
+	std::vector<std::uint8_t> inflateZlib(const std::uint8_t* data, size_t n);
+
+	// Reads a binary PPM (P6) with a maxval of 255
+	RgbImage readPpm(const std::string& path);
+
+	// Reads an 8-bit RGB, non-interlaced PNG, checking the CRC of every chunk
+	RgbImage readPng(const std::string& path);
+
+	// A frame of an animated GIF: the rectangle it stores, how long it lasts
+	// in hundredths of a second, and the screen once it is drawn
+	struct GifFrame
+	{
+		int left = 0;
+		int top = 0;
+		int width = 0;
+		int height = 0;
+		int delay = 0;
+		RgbImage screen;
+	};
+
+	// Reads a non-interlaced GIF, drawing every frame over the screen the
+	// frame before it left, which starts out black
+	std::vector<GifFrame> readGif(const std::string& path);
+}
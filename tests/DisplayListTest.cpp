@@ -0,0 +1,196 @@
+#include "Test.h"
+#include "CommandLog.h"
+#include "DisplayList.h"
+#include "GlyphAtlas.h"
+#include "Raster.h"
+#include "TileRenderer.h"
+#include <string>
+
+namespace
+{
+	const cwt::Pen RED{ cwt::ColorRgba{ 255, 0, 0, 255 }, 0.002 };
+	const cwt::Pen BLUE{ cwt::ColorRgba{ 0, 0, 255, 255 }, 0.002 };
+	const cwt::Pen TRANSLUCENT{ cwt::ColorRgba{ 0, 255, 0, 128 }, 0.002 };
+
+	std::string replay(const geom::DisplayList& list)
+	{
+		test::CommandLog log;
+		list.replay(log);
+		return log.log;
+	}
+
+	std::string replayNew(geom::DisplayList& list, size_t& drawn)
+	{
+		test::CommandLog log;
+		list.replayNew(log, drawn);
+		return log.log;
+	}
+}
+
+TEST(DisplayList, MergesConnectedLinesIntoAPolyline)
+{
+	geom::DisplayList list;
+	list.addLine(RED, 0, 0, 1, 0);
+	list.addLine(RED, 1, 0, 1, 1);
+	list.addLine(RED, 1, 1, 2, 2);
+	// Another pen, or a gap, starts a new path
+	list.addLine(BLUE, 2, 2, 3, 3);
+	list.addLine(BLUE, 4, 4, 5, 5);
+	list.addLine(BLUE, 5, 5, 6, 6);
+	CHECK_EQ(replay(list),
+		"polyline #ff0000ff 0 0 1 0 1 1 2 2\n"
+		"line #0000ffff 2 2 3 3\n"
+		"polyline #0000ffff 4 4 5 5 6 6\n");
+	CHECK_EQ(list.size(), size_t{ 3 });
+}
+
+TEST(DisplayList, GrowsLongPolylines)
+{
+	geom::DisplayList list;
+	std::string expected = "polyline #ff0000ff 0 0";
+	for (int i = 0; i < 1000; i++)
+	{
+		list.addLine(RED, i, i % 2, i + 1, (i + 1) % 2);
+		expected += ' ' + std::to_string(i + 1) + ' ' + std::to_string((i + 1) % 2);
+	}
+	CHECK_EQ(list.size(), size_t{ 1 });
+	CHECK(replay(list) == expected + "\n");
+}
+
+TEST(DisplayList, HoldsBackTheOpenPathUntilItEnds)
+{
+	// The render thread replays whenever it catches up with the program
+	geom::DisplayList list;
+	size_t drawn = 0;
+	list.addLine(RED, 0, 0, 1, 0);
+	CHECK(!list.hasNew(drawn));
+	CHECK_EQ(replayNew(list, drawn), std::string());
+	list.addLine(RED, 1, 0, 1, 1);
+	CHECK_EQ(replayNew(list, drawn), std::string());
+	list.addLine(RED, 1, 1, 2, 2);
+	// Another path ends the one before
+	list.addLine(BLUE, 2, 2, 3, 3);
+	CHECK(list.hasNew(drawn));
+	CHECK_EQ(replayNew(list, drawn), "polyline #ff0000ff 0 0 1 0 1 1 2 2\n");
+	CHECK_EQ(list.settledSize(), size_t{ 1 });
+
+	list.endPath();
+	CHECK_EQ(list.settledSize(), size_t{ 2 });
+	CHECK_EQ(replayNew(list, drawn), "line #0000ffff 2 2 3 3\n");
+	CHECK(!list.hasNew(drawn));
+	// A line after the end starts a new path
+	list.addLine(BLUE, 3, 3, 4, 4);
+	list.endPath();
+	CHECK_EQ(replayNew(list, drawn), "line #0000ffff 3 3 4 4\n");
+	CHECK_EQ(list.size(), size_t{ 3 });
+}
+
+TEST(DisplayList, StrokesATranslucentPathOnceWhateverTheReplaysInBetween)
+{
+	const cwt::Pen pen{ cwt::ColorRgba{ 0, 128, 255, 100 }, 0.05 };
+	const cwt::ColorRgba white{ 255, 255, 255, 255 };
+	raster::TileRenderer tiles(1);
+	text::GlyphAtlas glyphs;
+
+	geom::DisplayList whole;
+	whole.addLine(pen, 20, 20, 80, 30);
+	whole.addLine(pen, 80, 30, 40, 80);
+	whole.endPath();
+	raster::Framebuffer single(100, 100, white);
+	size_t drawn = 0;
+	tiles.render(single, whole, drawn, glyphs);
+
+	// The render thread catches up between the two lines
+	geom::DisplayList list;
+	raster::Framebuffer replayed(100, 100, white);
+	drawn = 0;
+	list.addLine(pen, 20, 20, 80, 30);
+	tiles.render(replayed, list, drawn, glyphs);
+	list.addLine(pen, 80, 30, 40, 80);
+	tiles.render(replayed, list, drawn, glyphs);
+	list.endPath();
+	tiles.render(replayed, list, drawn, glyphs);
+	CHECK_EQ(replay(list), replay(whole));
+
+	int differing = 0;
+	int inked = 0;
+	for (int y = 0; y < 100; y++)
+	{
+		for (int x = 0; x < 100; x++)
+		{
+			const raster::Pixel& a = single.viewRow(y)[x];
+			const raster::Pixel& b = replayed.viewRow(y)[x];
+			differing += a.r != b.r || a.g != b.g || a.b != b.b || a.a != b.a;
+			inked += a.r != 255;
+		}
+	}
+	CHECK(inked > 0);
+	CHECK_EQ(differing, 0);
+}
+
+TEST(DisplayList, MergesOpaqueDotsIntoALayer)
+{
+	geom::DisplayList list;
+	list.setCanvasSize(4, 3);
+	const double boxes[] = {
+		0, 0, 1, 1,
+		2.2, 1.1, 0.5, 0.5,		// center in pixel (2, 1)
+		2.6, 1.6, 0.2, 0.2,		// the same pixel
+		-3, 0, 1, 1,			// off the canvas
+		0, 0, 3, 3 };			// too large to be a dot
+	list.addFilledRectangles(RED, boxes, 5);
+	list.addEllipse(BLUE, 3, 2, 1, 1, true);
+	CHECK_EQ(replay(list),
+		"filledRectangles #ff0000ff 0 0 3 3\n"
+		"filledRectangles #ff0000ff 0 0 1 1 2 1 1 1\n"
+		"filledRectangles #0000ffff 3 2 1 1\n");
+}
+
+TEST(DisplayList, KeepsTranslucentDotsAndOrder)
+{
+	geom::DisplayList list;
+	list.setCanvasSize(4, 4);
+	list.addRectangle(RED, 1, 1, 1, 1, true);
+	list.addRectangle(TRANSLUCENT, 1, 1, 1, 1, true);
+	list.addRectangle(TRANSLUCENT, 1, 1, 1, 1, true);
+	// A later dot on the same pixel must still land over the translucent ones
+	list.addRectangle(BLUE, 1, 1, 1, 1, true);
+	CHECK_EQ(replay(list),
+		"filledRectangles #ff0000ff 1 1 1 1\n"
+		"filledRectangle #00ff0080 1 1 1 1\n"
+		"filledRectangle #00ff0080 1 1 1 1\n"
+		"filledRectangles #0000ffff 1 1 1 1\n");
+}
+
+TEST(DisplayList, RedrawsDotsChangedAfterTheyWereHandedOut)
+{
+	geom::DisplayList list;
+	list.setCanvasSize(8, 8);
+	size_t drawn = 0;
+	list.addRectangle(RED, 1, 1, 1, 1, true);
+	list.addRectangle(RED, 2, 2, 1, 1, true);
+	CHECK_EQ(replayNew(list, drawn), "filledRectangles #ff0000ff 1 1 1 1 2 2 1 1\n");
+	CHECK(!list.hasNew(drawn));
+
+	// Same pen on a pixel already drawn: nothing to redraw
+	list.addRectangle(RED, 1, 1, 1, 1, true);
+	CHECK(!list.hasNew(drawn));
+	list.addRectangle(BLUE, 2, 2, 1, 1, true);
+	list.addRectangle(BLUE, 3, 3, 1, 1, true);
+	CHECK(list.hasNew(drawn));
+	CHECK_EQ(replayNew(list, drawn), "filledRectangles #0000ffff 2 2 1 1 3 3 1 1\n");
+	CHECK_EQ(replay(list), "filledRectangles #ff0000ff 1 1 1 1\nfilledRectangles #0000ffff 2 2 1 1 3 3 1 1\n");
+}
+
+TEST(DisplayList, ClearKeepsThePalettes)
+{
+	geom::DisplayList list;
+	list.addRectangle(RED, 0, 0, 5, 5, false);
+	list.addText(BLUE, cwt::Font(L"Serif", cwt::Font::Style::FontStyleBold, 14), L"abc", 1, 2);
+	CHECK_EQ(replay(list), "rectangle #ff0000ff 0 0 5 5\ntext #0000ffff 1 2 \"abc\" 14\n");
+	list.clear();
+	CHECK(list.empty());
+	CHECK_EQ(replay(list), "");
+	list.addEllipse(BLUE, 1, 2, 3, 4, false);
+	CHECK_EQ(replay(list), "ellipse #0000ffff 1 2 3 4\n");
+}
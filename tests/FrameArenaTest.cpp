@@ -0,0 +1,82 @@
+#include "Test.h"
+#include "FrameArena.h"
+#include <cstdint>
+
+namespace
+{
+	constexpr size_t MIN_BLOCK_BYTES = 64 * 1024;
+	constexpr size_t LARGE_BYTES = 10 * 1024 * 1024;
+
+	// Fills the first block and spills into the second
+	void fillTwoBlocks(geom::FrameArena& arena)
+	{
+		for (size_t i = 0; i < MIN_BLOCK_BYTES / 1024 + 1; i++)
+		{
+			arena.allocate<unsigned char>(1024);
+		}
+	}
+}
+
+TEST(FrameArena, AlignsEachAllocation)
+{
+	geom::FrameArena arena;
+	arena.allocate<char>(1);
+	CHECK_EQ(reinterpret_cast<std::uintptr_t>(arena.allocate<double>(1)) % alignof(double), std::uintptr_t{ 0 });
+	arena.allocate<char>(3);
+	CHECK_EQ(reinterpret_cast<std::uintptr_t>(arena.allocate<float>(1)) % alignof(float), std::uintptr_t{ 0 });
+}
+
+TEST(FrameArena, BlocksDouble)
+{
+	geom::FrameArena arena;
+	fillTwoBlocks(arena);
+	CHECK_EQ(arena.viewCapacity(), MIN_BLOCK_BYTES + 2 * MIN_BLOCK_BYTES);
+}
+
+TEST(FrameArena, LargeRequestsDoNotInflateLaterBlocks)
+{
+	geom::FrameArena arena;
+	unsigned char* first = arena.allocate<unsigned char>(100);
+	unsigned char* large = arena.allocate<unsigned char>(LARGE_BYTES);
+	// The block being filled goes on after the large request
+	CHECK(arena.allocate<unsigned char>(100) == first + 100);
+	CHECK_EQ(arena.viewCapacity(), MIN_BLOCK_BYTES + LARGE_BYTES);
+
+	// The next block doubles the first, not the large one
+	arena.reset();
+	fillTwoBlocks(arena);
+	CHECK_EQ(arena.viewCapacity(), MIN_BLOCK_BYTES + 2 * MIN_BLOCK_BYTES + LARGE_BYTES);
+
+	// A large request after reset() gets its block back
+	CHECK(arena.allocate<unsigned char>(LARGE_BYTES / 2) == large);
+	arena.allocate<unsigned char>(LARGE_BYTES / 2);
+	CHECK_EQ(arena.viewCapacity(), MIN_BLOCK_BYTES + 2 * MIN_BLOCK_BYTES + LARGE_BYTES + LARGE_BYTES / 2);
+}
+
+TEST(FrameArena, ResetReusesTheBlocks)
+{
+	geom::FrameArena arena;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		arena.reset();
+		fillTwoBlocks(arena);
+		arena.allocate<unsigned char>(LARGE_BYTES);
+		arena.allocate<unsigned char>(MIN_BLOCK_BYTES * 4);
+	}
+	CHECK_EQ(arena.viewCapacity(), 3 * MIN_BLOCK_BYTES + LARGE_BYTES + 4 * MIN_BLOCK_BYTES);
+}
+
+TEST(FrameArena, MemoryStaysPut)
+{
+	geom::FrameArena arena;
+	int* values[100];
+	for (int i = 0; i < 100; i++)
+	{
+		values[i] = arena.allocate<int>((size_t)1000 * (i % 7 + 1) * (i % 13 == 0 ? 100 : 1));
+		values[i][0] = i;
+	}
+	for (int i = 0; i < 100; i++)
+	{
+		CHECK_EQ(values[i][0], i);
+	}
+}
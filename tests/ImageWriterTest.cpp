@@ -0,0 +1,78 @@
+#include "Test.h"
+#include "Decode.h"
+#include "ImageWriter.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// An image with flat areas, gradients and noise
+	std::vector<raster::Pixel> makeImage(int width, int height)
+	{
+		std::mt19937 rng(7);
+		std::vector<raster::Pixel> pixels((size_t)width * height);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				raster::Pixel& p = pixels[(size_t)y * width + x];
+				if (x < width / 3)
+				{
+					p = raster::Pixel{ 255, 255, 255, 255 };
+				}
+				else if (x < 2 * width / 3)
+				{
+					p = raster::Pixel{ (std::uint8_t)x, (std::uint8_t)y, (std::uint8_t)(x + y), 255 };
+				}
+				else
+				{
+					p = raster::Pixel{ (std::uint8_t)rng(), (std::uint8_t)rng(), (std::uint8_t)rng(), 255 };
+				}
+			}
+		}
+		return pixels;
+	}
+
+	std::vector<std::uint8_t> toRgb(const std::vector<raster::Pixel>& pixels)
+	{
+		std::vector<std::uint8_t> rgb;
+		for (const raster::Pixel& p : pixels)
+		{
+			rgb.insert(rgb.end(), { p.r, p.g, p.b });
+		}
+		return rgb;
+	}
+}
+
+TEST(ImageWriter, PngDecodesToThePixelsWritten)
+{
+	constexpr int WIDTH = 301;
+	constexpr int HEIGHT = 257;
+	const std::vector<raster::Pixel> pixels = makeImage(WIDTH, HEIGHT);
+	const image::RowSource row = [&pixels](int y) { return pixels.data() + (size_t)y * WIDTH; };
+	const std::string png = test::viewTempDir() + "/image.png";
+	const std::string ppm = test::viewTempDir() + "/image.ppm";
+	image::write(png, image::Format::PNG, WIDTH, HEIGHT, row);
+	image::write(ppm, image::Format::PPM, WIDTH, HEIGHT, row);
+
+	const test::RgbImage decoded = test::readPng(png);
+	CHECK_EQ(decoded.width, WIDTH);
+	CHECK_EQ(decoded.height, HEIGHT);
+	CHECK(decoded.rgb == toRgb(pixels));
+	const test::RgbImage raw = test::readPpm(ppm);
+	CHECK(raw.rgb == decoded.rgb);
+	std::remove(png.c_str());
+	std::remove(ppm.c_str());
+}
+
+TEST(ImageWriter, PicksTheFormatFromTheExtension)
+{
+	image::Format format;
+	CHECK(image::findFormat("a/b.PNG", format) && format == image::Format::PNG);
+	CHECK(image::findFormat("x.bmp", format) && format == image::Format::BMP);
+	CHECK(image::findFormat("x.Ppm", format) && format == image::Format::PPM);
+	CHECK(!image::findFormat("x.jpg", format));
+	CHECK(!image::findFormat("png", format));
+}
@@ -0,0 +1,146 @@
+#include "Test.h"
+#include "Decode.h"
+#include "Recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int WIDTH = 120;
+	constexpr int HEIGHT = 90;
+
+	using Pixels = std::vector<raster::Pixel>;
+
+	// Noise in 200 colors, enough codes to fill the LZW table more than once
+	Pixels makeNoise()
+	{
+		std::mt19937 rng(5);
+		Pixels palette;
+		for (int i = 0; i < 200; i++)
+		{
+			palette.push_back(raster::Pixel{ (std::uint8_t)rng(), (std::uint8_t)rng(), (std::uint8_t)rng(), 255 });
+		}
+		Pixels pixels((size_t)WIDTH * HEIGHT);
+		for (raster::Pixel& p : pixels)
+		{
+			p = palette[rng() % palette.size()];
+		}
+		return pixels;
+	}
+
+	void fillRect(Pixels& pixels, int left, int top, int right, int bottom, const raster::Pixel& color)
+	{
+		for (int y = top; y < bottom; y++)
+		{
+			for (int x = left; x < right; x++)
+			{
+				pixels[(size_t)y * WIDTH + x] = color;
+			}
+		}
+	}
+
+	// Largest difference between a channel of pixels and of rgb in the
+	// rectangle, or out of it if isOutside
+	int maxError(const Pixels& pixels, const test::RgbImage& image, int left, int top, int right, int bottom, bool isOutside)
+	{
+		int error = 0;
+		for (int y = 0; y < HEIGHT; y++)
+		{
+			for (int x = 0; x < WIDTH; x++)
+			{
+				const bool isIn = x >= left && x < right && y >= top && y < bottom;
+				if (isIn == isOutside)
+				{
+					continue;
+				}
+				const raster::Pixel& p = pixels[(size_t)y * WIDTH + x];
+				const std::uint8_t* rgb = &image.rgb[((size_t)y * WIDTH + x) * 3];
+				error = (std::max)({ error, std::abs(p.r - rgb[0]), std::abs(p.g - rgb[1]), std::abs(p.b - rgb[2]) });
+			}
+		}
+		return error;
+	}
+}
+
+TEST(Recorder, GifDecodesToTheFramesRecorded)
+{
+	const std::string path = test::viewTempDir() + "/frames.gif";
+	const Pixels first = makeNoise();
+	Pixels second = first;
+	fillRect(second, 10, 20, 40, 50, raster::Pixel{ 255, 0, 0, 255 });
+	// A gradient of far more than 256 colors
+	Pixels third = second;
+	for (int y = 0; y < HEIGHT; y++)
+	{
+		for (int x = 60; x < WIDTH; x++)
+		{
+			third[(size_t)y * WIDTH + x] = raster::Pixel{ (std::uint8_t)(x * 2), (std::uint8_t)(y * 2), (std::uint8_t)(x + y), 255 };
+		}
+	}
+	{
+		image::Recorder recorder(path, image::VideoFormat::GIF, 10);
+		for (const Pixels* frame : std::vector<const Pixels*>{ &first, &first, &second, &third })
+		{
+			recorder.addFrame(WIDTH, HEIGHT, [frame](int y) { return frame->data() + (size_t)y * WIDTH; });
+		}
+		CHECK_EQ(recorder.finish(), std::string());
+	}
+
+	const std::vector<test::GifFrame> frames = test::readGif(path);
+	REQUIRE(frames.size() == 3);
+
+	// The first frame is the whole screen, and lasts for the one after it,
+	// which changed nothing
+	CHECK_EQ(frames[0].left, 0);
+	CHECK_EQ(frames[0].top, 0);
+	CHECK_EQ(frames[0].width, WIDTH);
+	CHECK_EQ(frames[0].height, HEIGHT);
+	CHECK_EQ(frames[0].delay, 20);
+	CHECK_EQ(maxError(first, frames[0].screen, 0, 0, 0, 0, true), 0);
+
+	// Only what changed is stored
+	CHECK_EQ(frames[1].left, 10);
+	CHECK_EQ(frames[1].top, 20);
+	CHECK_EQ(frames[1].width, 30);
+	CHECK_EQ(frames[1].height, 30);
+	CHECK_EQ(frames[1].delay, 10);
+	CHECK_EQ(maxError(second, frames[1].screen, 0, 0, 0, 0, true), 0);
+
+	// Too many colors for a palette of their own: the changed part takes the
+	// nearest of the color cube, within half a step of 255 / 5, and the rest
+	// stays as it was
+	CHECK_EQ(frames[2].left, 60);
+	CHECK_EQ(frames[2].top, 0);
+	CHECK_EQ(frames[2].width, WIDTH - 60);
+	CHECK_EQ(frames[2].height, HEIGHT);
+	CHECK_EQ(frames[2].delay, 10);
+	CHECK(maxError(third, frames[2].screen, 60, 0, WIDTH, HEIGHT, false) <= 26);
+	CHECK_EQ(maxError(third, frames[2].screen, 60, 0, WIDTH, HEIGHT, true), 0);
+	std::remove(path.c_str());
+}
+
+TEST(Recorder, GifOfUnchangedFramesIsOneFrame)
+{
+	const std::string path = test::viewTempDir() + "/still.gif";
+	Pixels pixels((size_t)WIDTH * HEIGHT, raster::Pixel{ 255, 255, 255, 255 });
+	fillRect(pixels, 30, 30, 50, 40, raster::Pixel{ 0, 0, 255, 255 });
+	{
+		image::Recorder recorder(path, image::VideoFormat::GIF, 25);
+		for (int i = 0; i < 5; i++)
+		{
+			recorder.addFrame(WIDTH, HEIGHT, [&pixels](int y) { return pixels.data() + (size_t)y * WIDTH; });
+		}
+		CHECK_EQ(recorder.finish(), std::string());
+	}
+
+	const std::vector<test::GifFrame> frames = test::readGif(path);
+	REQUIRE(frames.size() == 1);
+	// Five frames at 25 fps
+	CHECK_EQ(frames[0].delay, 20);
+	CHECK_EQ(maxError(pixels, frames[0].screen, 0, 0, 0, 0, true), 0);
+	std::remove(path.c_str());
+}
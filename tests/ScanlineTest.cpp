@@ -0,0 +1,283 @@
+#include "Test.h"
+#include "Decode.h"
+#include "Render.h"
+#include "Scanline.h"
+#include "cwt.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+
+	// Coverage of every pixel of a width x height canvas
+	struct Coverage
+	{
+		int width;
+		int height;
+		std::vector<int> values;
+		// Times each row was handed to the sink
+		std::vector<int> rowCalls;
+
+		Coverage(int width, int height)
+			: width(width), height(height), values((size_t)width * height, 0), rowCalls(height, 0) {}
+	};
+
+	Coverage fill(int width, int height, const std::vector<float>& xy, raster::ThreadPool* pool = nullptr)
+	{
+		Coverage coverage(width, height);
+		std::mutex mutex;
+		raster::ScanlineFiller filler(pool);
+		filler.fill(width, height, xy.data(), xy.size() / 2,
+			[&coverage, &mutex](int y, int x, const std::uint8_t* values, int count)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				coverage.rowCalls[y]++;
+				for (int i = 0; i < count; i++)
+				{
+					coverage.values[(size_t)y * coverage.width + x + i] = values[i];
+				}
+			});
+		return coverage;
+	}
+
+	// Even-odd rule by counting the edges a ray to the right crosses
+	bool isInside(const std::vector<float>& xy, double px, double py)
+	{
+		const size_t n = xy.size() / 2;
+		bool inside = false;
+		for (size_t i = 0, j = n - 1; i < n; j = i++)
+		{
+			const double xi = xy[2 * i];
+			const double yi = xy[2 * i + 1];
+			const double xj = xy[2 * j];
+			const double yj = xy[2 * j + 1];
+			if ((yi > py) != (yj > py) && px < xi + (py - yi) * (xj - xi) / (yj - yi))
+			{
+				inside = !inside;
+			}
+		}
+		return inside;
+	}
+
+	// Coverage sampled on a SAMPLES x SAMPLES grid in every pixel
+	Coverage supersample(int width, int height, const std::vector<float>& xy)
+	{
+		constexpr int SAMPLES = 16;
+		Coverage coverage(width, height);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int hits = 0;
+				for (int sy = 0; sy < SAMPLES; sy++)
+				{
+					for (int sx = 0; sx < SAMPLES; sx++)
+					{
+						hits += isInside(xy, x + (sx + 0.5) / SAMPLES, y + (sy + 0.5) / SAMPLES) ? 1 : 0;
+					}
+				}
+				coverage.values[(size_t)y * width + x] = (hits * 255 + SAMPLES * SAMPLES / 2) / (SAMPLES * SAMPLES);
+			}
+		}
+		return coverage;
+	}
+
+	// Pixels holding a point where two edges of xy cross, and their neighbours
+	// in the row. The filler sums the signed area of the edges across a pixel
+	// before it applies the even-odd rule, so there it only approximates the
+	// coverage.
+	std::vector<bool> findCrossings(int width, int height, const std::vector<float>& xy)
+	{
+		std::vector<bool> crossings((size_t)width * height, false);
+		const size_t n = xy.size() / 2;
+		for (size_t i = 0; i < n; i++)
+		{
+			const double ax = xy[2 * i];
+			const double ay = xy[2 * i + 1];
+			const double bx = xy[2 * ((i + 1) % n)];
+			const double by = xy[2 * ((i + 1) % n) + 1];
+			for (size_t j = i + 2; j < n; j++)
+			{
+				const double cx = xy[2 * j];
+				const double cy = xy[2 * j + 1];
+				const double dx = xy[2 * ((j + 1) % n)];
+				const double dy = xy[2 * ((j + 1) % n) + 1];
+				const double denominator = (bx - ax) * (dy - cy) - (by - ay) * (dx - cx);
+				if (denominator == 0.0)
+				{
+					continue;
+				}
+				const double t = ((cx - ax) * (dy - cy) - (cy - ay) * (dx - cx)) / denominator;
+				const double u = ((cx - ax) * (by - ay) - (cy - ay) * (bx - ax)) / denominator;
+				const int x = (int)std::floor(ax + t * (bx - ax));
+				const int y = (int)std::floor(ay + t * (by - ay));
+				if (t <= 0.0 || t >= 1.0 || u <= 0.0 || u >= 1.0 || y < 0 || y >= height)
+				{
+					continue;
+				}
+				for (int k = (std::max)(x - 1, 0); k <= (std::min)(x + 1, width - 1); k++)
+				{
+					crossings[(size_t)y * width + k] = true;
+				}
+			}
+		}
+		return crossings;
+	}
+
+	// Fills xy and checks it against the supersampled reference: every pixel
+	// but those holding a crossing within the error of the sampling, and no
+	// bias overall
+	void checkAgainstReference(int width, int height, const std::vector<float>& xy)
+	{
+		const Coverage actual = fill(width, height, xy);
+		const Coverage expected = supersample(width, height, xy);
+		const std::vector<bool> crossings = findCrossings(width, height, xy);
+		int maxError = 0;
+		double totalError = 0.0;
+		for (size_t i = 0; i < actual.values.size(); i++)
+		{
+			if (crossings[i])
+			{
+				continue;
+			}
+			const int error = actual.values[i] - expected.values[i];
+			maxError = (std::max)(maxError, std::abs(error));
+			totalError += error;
+		}
+		CHECK(maxError <= 20);
+		CHECK(std::abs(totalError) / actual.values.size() < 0.5);
+		for (int calls : actual.rowCalls)
+		{
+			CHECK(calls <= 1);
+		}
+	}
+
+	double area(const std::vector<float>& xy)
+	{
+		const size_t n = xy.size() / 2;
+		double sum = 0.0;
+		for (size_t i = 0, j = n - 1; i < n; j = i++)
+		{
+			sum += (double)xy[2 * j] * xy[2 * i + 1] - (double)xy[2 * i] * xy[2 * j + 1];
+		}
+		return std::abs(sum) / 2;
+	}
+}
+
+TEST(Scanline, MatchesSupersampledTriangle)
+{
+	checkAgainstReference(40, 30, { 3.3f, 2.1f, 37.5f, 9.7f, 12.25f, 28.9f });
+}
+
+TEST(Scanline, MatchesSupersampledThinSlivers)
+{
+	// Nearly horizontal and nearly vertical edges, both within a pixel
+	checkAgainstReference(40, 30, { 1.0f, 5.0f, 39.0f, 5.4f, 39.0f, 6.1f, 1.0f, 5.2f });
+	checkAgainstReference(40, 30, { 20.1f, 1.0f, 20.3f, 1.0f, 20.9f, 29.0f, 20.6f, 29.0f });
+}
+
+TEST(Scanline, MatchesSupersampledSelfIntersectingStar)
+{
+	// The pentagon in the middle of a pentagram is outside under even-odd
+	std::vector<float> xy;
+	for (int i = 0; i < 5; i++)
+	{
+		const double angle = PI / 2 + i * 4 * PI / 5;
+		xy.push_back((float)(32 + 28 * std::cos(angle)));
+		xy.push_back((float)(32 - 28 * std::sin(angle)));
+	}
+	checkAgainstReference(64, 64, xy);
+	const Coverage coverage = fill(64, 64, xy);
+	CHECK_EQ(coverage.values[32 * 64 + 32], 0);
+}
+
+TEST(Scanline, ClipsPolygonsReachingOffTheCanvas)
+{
+	checkAgainstReference(32, 24, { -10.5f, -7.25f, 50.0f, 3.5f, 20.0f, 40.0f, -3.0f, 12.0f });
+	// Far off the canvas on every side, covering all of it
+	const Coverage coverage = fill(16, 16, { -1e6f, -1e6f, 1e6f, -1e6f, 1e6f, 1e6f, -1e6f, 1e6f });
+	for (int value : coverage.values)
+	{
+		CHECK_EQ(value, 255);
+	}
+}
+
+TEST(Scanline, SurvivesNonFiniteVertices)
+{
+	constexpr float INF = std::numeric_limits<float>::infinity();
+	constexpr float NOT_A_NUMBER = std::numeric_limits<float>::quiet_NaN();
+	// A vertex at infinity is very far away
+	const Coverage everything = fill(16, 16, { -INF, -INF, INF, -INF, INF, INF, -INF, INF });
+	for (int value : everything.values)
+	{
+		CHECK_EQ(value, 255);
+	}
+	const Coverage wedge = fill(16, 16, { 0.5f, 0.5f, 0.6f, 0.5f, INF, INF });
+	const Coverage farWedge = fill(16, 16, { 0.5f, 0.5f, 0.6f, 0.5f, 1e30f, 1e30f });
+	CHECK(wedge.values == farWedge.values);
+
+	// A vertex with a NaN is left out
+	const Coverage square = fill(16, 16, { 2, 2, 10, 2, 10, 10, 2, 10 });
+	CHECK(fill(16, 16, { 2, 2, 10, 2, NOT_A_NUMBER, 5, 10, 10, 2, 10 }).values == square.values);
+	CHECK(fill(16, 16, { 2, 2, 10, 2, 10, 10, 2, 10, 7, NOT_A_NUMBER }).values == square.values);
+	CHECK(fill(16, 16, { NOT_A_NUMBER, NOT_A_NUMBER, NOT_A_NUMBER, 1, 1, NOT_A_NUMBER }).values == Coverage(16, 16).values);
+}
+
+TEST(Scanline, RenderFillsPolygonsBeyondFloatRange)
+{
+	// 1e40 is finite, until the display list stores it as a float
+	const std::string path = test::viewTempDir() + "/beyond.ppm";
+	{
+		Render render(cwt::Pen{ cwt::ColorRgba{ 255, 0, 0, 255 }, 0.01 }, 40, 30, L"test");
+		render.clear(cwt::ColorRgba{ 255, 255, 255, 255 });
+		render.fillPolygon(std::vector<double>{ 20, 15, 24, 15, 1e40, 1e40 });
+		render.save(path.c_str());
+	}
+	const test::RgbImage image = test::readPpm(path);
+	CHECK_EQ(image.width, 40);
+	CHECK_EQ(image.height, 30);
+	// The wedge heads down and to the right, four pixels wide
+	const size_t inside = 3 * ((size_t)28 * 40 + 35);
+	CHECK_EQ((int)image.rgb[inside], 255);
+	CHECK_EQ((int)image.rgb[inside + 1], 0);
+	const size_t outside = 3 * ((size_t)28 * 40 + 30);
+	CHECK_EQ((int)image.rgb[outside + 1], 255);
+	std::remove(path.c_str());
+}
+
+TEST(Scanline, FillsLargePolygonsInBands)
+{
+	// Enough edges and rows to be split across threads, however many cores
+	// run the test
+	raster::ThreadPool pool(4);
+	constexpr int N = 20000;
+	constexpr int SIZE = 512;
+	std::vector<float> xy;
+	for (int i = 0; i < N; i++)
+	{
+		const double angle = 2 * PI * i / N;
+		xy.push_back((float)(SIZE / 2 + 200 * std::cos(angle)));
+		xy.push_back((float)(SIZE / 2 + 200 * std::sin(angle)));
+	}
+	const Coverage coverage = fill(SIZE, SIZE, xy, &pool);
+	CHECK(coverage.values == fill(SIZE, SIZE, xy).values);
+	double sum = 0.0;
+	for (int value : coverage.values)
+	{
+		sum += value / 255.0;
+	}
+	CHECK_NEAR(sum, area(xy), area(xy) * 1e-3);
+	CHECK_EQ(coverage.values[(size_t)SIZE / 2 * SIZE + SIZE / 2], 255);
+	CHECK_EQ(coverage.values[10 * SIZE + 10], 0);
+	for (int y = 0; y < SIZE; y++)
+	{
+		const bool crossesCircle = std::abs(y + 0.5 - SIZE / 2) < 200;
+		CHECK_EQ(coverage.rowCalls[y], crossesCircle ? 1 : 0);
+	}
+}
@@ -0,0 +1,179 @@
+#include "Test.h"
+#include "Simd.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Puts back the level the kernels dispatched to when it was made
+	struct LevelGuard
+	{
+		const simd::Level level = simd::viewLevel();
+
+		~LevelGuard()
+		{
+			simd::setLevel(level);
+		}
+	};
+
+	// Vector levels the CPU runs; each is compared with the scalar kernels
+	std::vector<simd::Level> findVectorLevels()
+	{
+		const LevelGuard guard;
+		std::vector<simd::Level> levels;
+		for (simd::Level level : { simd::Level::SSE2, simd::Level::AVX2 })
+		{
+			if (simd::setLevel(level))
+			{
+				levels.push_back(level);
+			}
+		}
+		return levels;
+	}
+
+	// Lengths around every vector width and alignment, tails included
+	const size_t LENGTHS[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1000 };
+
+	// Pixels with the channels of any premultiplied color: none above alpha
+	std::vector<std::uint8_t> makePixels(std::mt19937& rng, size_t n)
+	{
+		std::vector<std::uint8_t> pixels(4 * n);
+		for (size_t i = 0; i < n; i++)
+		{
+			const int alpha = i % 5 == 0 ? 255 : i % 5 == 1 ? 0 : (int)(rng() % 256);
+			for (int c = 0; c < 3; c++)
+			{
+				pixels[4 * i + c] = (std::uint8_t)(rng() % (alpha + 1));
+			}
+			pixels[4 * i + 3] = (std::uint8_t)alpha;
+		}
+		return pixels;
+	}
+
+	std::uint32_t makeColor(std::mt19937& rng, int round)
+	{
+		// Opaque, fully transparent and everything in between
+		const std::uint32_t alpha = round % 4 == 0 ? 255 : round % 4 == 1 ? 0 : rng() % 256;
+		return (std::uint32_t)(rng() & 0xFFFFFF00u) | alpha;
+	}
+}
+
+TEST(Simd, VectorLevelsBlendSpansAsScalar)
+{
+	const LevelGuard guard;
+	std::mt19937 rng(1);
+	for (simd::Level level : findVectorLevels())
+	{
+		for (int round = 0; round < 20; round++)
+		{
+			for (size_t n : LENGTHS)
+			{
+				// One pixel of offset shifts the span off the vector alignment
+				const std::vector<std::uint8_t> pixels = makePixels(rng, n + 1);
+				const std::uint32_t color = makeColor(rng, round);
+				std::vector<std::uint8_t> expected = pixels;
+				std::vector<std::uint8_t> actual = pixels;
+				simd::setLevel(simd::Level::Scalar);
+				simd::blendSpan(expected.data() + 4, n, color);
+				simd::setLevel(level);
+				simd::blendSpan(actual.data() + 4, n, color);
+				CHECK(actual == expected);
+			}
+		}
+	}
+}
+
+TEST(Simd, VectorLevelsBlendMasksAsScalar)
+{
+	const LevelGuard guard;
+	std::mt19937 rng(2);
+	for (simd::Level level : findVectorLevels())
+	{
+		for (int round = 0; round < 20; round++)
+		{
+			for (size_t n : LENGTHS)
+			{
+				const std::vector<std::uint8_t> pixels = makePixels(rng, n + 1);
+				std::vector<std::uint8_t> coverage(n + 1);
+				for (size_t i = 0; i < coverage.size(); i++)
+				{
+					coverage[i] = (std::uint8_t)(i % 3 == 0 ? 255 : i % 3 == 1 ? 0 : rng() % 256);
+				}
+				const std::uint32_t color = makeColor(rng, round);
+				std::vector<std::uint8_t> expected = pixels;
+				std::vector<std::uint8_t> actual = pixels;
+				simd::setLevel(simd::Level::Scalar);
+				simd::blendMask(expected.data() + 4, coverage.data() + 1, n, color);
+				simd::setLevel(level);
+				simd::blendMask(actual.data() + 4, coverage.data() + 1, n, color);
+				CHECK(actual == expected);
+			}
+		}
+	}
+}
+
+TEST(Simd, ScalarBlendIsSourceOver)
+{
+	const LevelGuard guard;
+	simd::setLevel(simd::Level::Scalar);
+	// Opaque over anything replaces it, transparent leaves it
+	std::uint8_t pixel[4] = { 10, 20, 30, 40 };
+	simd::blendSpan(pixel, 1, 0x11223300u);
+	CHECK(pixel[0] == 10 && pixel[1] == 20 && pixel[2] == 30 && pixel[3] == 40);
+	simd::blendSpan(pixel, 1, 0x112233FFu);
+	CHECK(pixel[0] == 0x11 && pixel[1] == 0x22 && pixel[2] == 0x33 && pixel[3] == 255);
+
+	// Half of white over opaque black is mid grey, still opaque
+	std::uint8_t black[4] = { 0, 0, 0, 255 };
+	simd::blendSpan(black, 1, 0xFFFFFF80u);
+	CHECK_NEAR(black[0], 128, 1);
+	CHECK_EQ((int)black[3], 255);
+
+	// Coverage 0 leaves the pixel, 255 blends as a span
+	std::uint8_t pixels[8] = { 1, 2, 3, 4, 1, 2, 3, 4 };
+	const std::uint8_t coverage[2] = { 0, 255 };
+	simd::blendMask(pixels, coverage, 2, 0x102030FFu);
+	CHECK(pixels[0] == 1 && pixels[3] == 4);
+	CHECK(pixels[4] == 0x10 && pixels[5] == 0x20 && pixels[6] == 0x30 && pixels[7] == 255);
+}
+
+TEST(Simd, VectorLevelsValidateAndTransformAsScalar)
+{
+	const LevelGuard guard;
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+	for (simd::Level level : findVectorLevels())
+	{
+		for (size_t n : LENGTHS)
+		{
+			std::vector<double> values(n);
+			for (double& v : values)
+			{
+				v = uniform(rng) + 0.5;
+			}
+			for (size_t bad = 0; bad <= n; bad += 1 + n / 7)
+			{
+				std::vector<double> tested = values;
+				if (bad < n)
+				{
+					tested[bad] = bad % 2 == 0 ? std::numeric_limits<double>::quiet_NaN() : -std::numeric_limits<double>::infinity();
+				}
+				simd::setLevel(simd::Level::Scalar);
+				const size_t nonFinite = simd::findNonFinite(tested.data(), n);
+				const size_t negative = simd::findNegative(values.data(), n);
+				std::vector<double> expected(2 * n + 1);
+				simd::affine(values.data(), n, 2.5, -0.75, expected.data() + 1, 2);
+				simd::setLevel(level);
+				CHECK_EQ(simd::findNonFinite(tested.data(), n), nonFinite);
+				CHECK_EQ(nonFinite, bad);
+				CHECK_EQ(simd::findNegative(values.data(), n), negative);
+				std::vector<double> actual(2 * n + 1);
+				simd::affine(values.data(), n, 2.5, -0.75, actual.data() + 1, 2);
+				CHECK(std::memcmp(actual.data(), expected.data(), actual.size() * sizeof(double)) == 0);
+			}
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#include "Test.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <vector>
+
+namespace
+{
+	struct Case
+	{
+		const char* suite;
+		const char* name;
+		void (*body)();
+	};
+
+	// Built by static initializers, so created on first use
+	std::vector<Case>& getCases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	size_t failures = 0;
+}
+
+bool test::add(const char* suite, const char* name, void (*body)())
+{
+	getCases().push_back(Case{ suite, name, body });
+	return true;
+}
+
+void test::fail(const char* file, int line, const std::string& message)
+{
+	std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message.c_str());
+	failures++;
+}
+
+std::string test::viewTempDir()
+{
+	static const std::string dir = []()
+		{
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / "algs4_tests";
+			std::filesystem::create_directories(path);
+			return path.string();
+		}();
+	return dir;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> suites(argv + 1, argv + argc);
+	size_t run = 0;
+	size_t failed = 0;
+	for (const Case& c : getCases())
+	{
+		if (!suites.empty() && std::find(suites.begin(), suites.end(), c.suite) == suites.end())
+		{
+			continue;
+		}
+
+		const size_t before = failures;
+		try
+		{
+			c.body();
+		}
+		catch (const test::Abort&)
+		{
+		}
+		catch (const std::exception& e)
+		{
+			test::fail(__FILE__, __LINE__, std::string("exception: ") + e.what());
+		}
+		run++;
+		const bool passed = failures == before;
+		failed += passed ? 0 : 1;
+		std::printf("%s %s.%s\n", passed ? "[  OK  ]" : "[ FAIL ]", c.suite, c.name);
+	}
+
+	if (run == 0)
+	{
+		std::fprintf(stderr, "no test case matches\n");
+		return 1;
+	}
+	std::printf("%zu of %zu test cases passed\n", run - failed, run);
+	return failed == 0 ? 0 : 1;
+}
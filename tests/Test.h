@@ -0,0 +1,83 @@
+#pragma once
+#include <sstream>
+#include <string>
+
+// Minimal test harness: TEST() defines a test case, CHECK() and its variants
+// record failures and go on, REQUIRE() ends the test case at the first one.
+//
+//   TEST(Suite, Name)
+//   {
+//   	CHECK_EQ(1 + 1, 2);
+//   }
+//
+// algs4_tests runs every case, or those of the suites named on its command
+// line, and exits with 1 if any failed.
+namespace test
+{
+	// Thrown by REQUIRE() to end the running test case
+	struct Abort {};
+
+	// Registers body as test case name of suite; returns true, so that a
+	// static initializer can call it
+	bool add(const char* suite, const char* name, void (*body)());
+
+	// Records a failed check of the running test case
+	void fail(const char* file, int line, const std::string& message);
+
+	template <class A, class B>
+	std::string describe(const char* expression, const A& a, const B& b)
+	{
+		std::ostringstream stream;
+		stream << expression << " (" << a << " vs " << b << ")";
+		return stream.str();
+	}
+
+	// Directory the test cases write their files to
+	std::string viewTempDir();
+}
+
+#define TEST(suite, name) \
+	static void test_##suite##_##name(); \
+	[[maybe_unused]] static const bool registered_##suite##_##name = test::add(#suite, #name, test_##suite##_##name); \
+	static void test_##suite##_##name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			test::fail(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+#define CHECK_EQ(a, b) \
+	do \
+	{ \
+		const auto& checkA = (a); \
+		const auto& checkB = (b); \
+		if (!(checkA == checkB)) \
+		{ \
+			test::fail(__FILE__, __LINE__, test::describe(#a " == " #b, checkA, checkB)); \
+		} \
+	} while (false)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do \
+	{ \
+		const double checkA = (a); \
+		const double checkB = (b); \
+		if (!(checkA - checkB <= (tolerance) && checkB - checkA <= (tolerance))) \
+		{ \
+			test::fail(__FILE__, __LINE__, test::describe(#a " ~= " #b, checkA, checkB)); \
+		} \
+	} while (false)
+
+#define REQUIRE(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			test::fail(__FILE__, __LINE__, #condition); \
+			throw test::Abort{}; \
+		} \
+	} while (false)
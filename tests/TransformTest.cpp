@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "Draw.h"
+#include "Transform.h"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	constexpr double TOLERANCE = 1e-9;
+
+	// Whether call throws std::invalid_argument
+	template <class Call>
+	bool isRefused(Call call)
+	{
+		try
+		{
+			call();
+		}
+		catch (const std::invalid_argument&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// Checks that apply() and transformPoints() agree on (x, y) -> (px, py)
+	void checkPoint(const geom::Transform& transform, double x, double y, double px, double py)
+	{
+		double ax;
+		double ay;
+		transform.apply(x, y, ax, ay);
+		CHECK_NEAR(ax, px, TOLERANCE);
+		CHECK_NEAR(ay, py, TOLERANCE);
+
+		double bx;
+		double by;
+		transform.visit([&](const auto& t) { geom::transformPoints(t, &x, &y, 1, &bx, &by, 1, 0.5); });
+		CHECK_NEAR(bx, px + 0.5, TOLERANCE);
+		CHECK_NEAR(by, py + 0.5, TOLERANCE);
+	}
+}
+
+TEST(Transform, IdentityLeavesPixelsAlone)
+{
+	geom::Transform transform;
+	checkPoint(transform, 3.25, -7.5, 3.25, -7.5);
+	CHECK_NEAR(transform.lengthX(2.5), 2.5, TOLERANCE);
+	CHECK_NEAR(transform.lengthY(4.0), 4.0, TOLERANCE);
+	CHECK(!transform.isCurved());
+
+	// A scale mapping the canvas onto itself, y going down, is the identity
+	transform.setScale(0, 200, 100, 0, 200, 100);
+	checkPoint(transform, 10, 20, 10, 20);
+	CHECK_NEAR(transform.lengthY(3.0), 3.0, TOLERANCE);
+}
+
+TEST(Transform, ScaleMapsTheRangeOntoTheCanvas)
+{
+	geom::Transform transform;
+	transform.setScale(-1, 1, 0, 10, 400, 200);
+	checkPoint(transform, -1, 0, 0, 200);
+	checkPoint(transform, 1, 10, 400, 0);
+	checkPoint(transform, 0, 5, 200, 100);
+	CHECK_NEAR(transform.lengthX(0.5), 100, TOLERANCE);
+	// Lengths are positive though y goes up
+	CHECK_NEAR(transform.lengthY(2.0), 40, TOLERANCE);
+}
+
+TEST(Transform, LogScalesTakeDecades)
+{
+	geom::Transform transform;
+	// Draw::setXscaleLog(1, 1000) and setYscaleLog(10, 100)
+	transform.setScale(0, 3, 1, 2, 300, 100);
+	transform.setLogX(true);
+	transform.setLogY(true);
+	CHECK(transform.isCurved());
+	checkPoint(transform, 1, 100, 0, 0);
+	checkPoint(transform, 10, 10, 100, 100);
+	checkPoint(transform, 1000, std::sqrt(1000.0), 300, 50);
+	// Lengths are measured in decades
+	CHECK_NEAR(transform.lengthX(1.0), 100, TOLERANCE);
+	CHECK_NEAR(transform.lengthY(0.5), 50, TOLERANCE);
+
+	// Points that are not positive have no image
+	double px;
+	double py;
+	transform.apply(0, 10, px, py);
+	CHECK(!std::isfinite(px));
+	transform.apply(10, -1, px, py);
+	CHECK(!std::isfinite(py));
+
+	transform.setLogY(false);
+	checkPoint(transform, 10, 1.5, 100, 50);
+}
+
+TEST(Transform, PolarCoordinatesTurnIntoCartesian)
+{
+	geom::Transform transform;
+	transform.setScale(-2, 2, -2, 2, 400, 400);
+	transform.setPolar(true);
+	CHECK(transform.isCurved());
+	checkPoint(transform, 1, 0, 300, 200);
+	checkPoint(transform, 1, 90, 200, 100);
+	checkPoint(transform, 2, 180, 0, 200);
+	checkPoint(transform, std::sqrt(2.0), -45, 300, 300);
+	// Lengths are not turned
+	CHECK_NEAR(transform.lengthX(1.0), 100, TOLERANCE);
+	CHECK_NEAR(transform.lengthY(1.0), 100, TOLERANCE);
+
+	// Polar coordinates come before a log scale
+	transform.setScale(0, 2, -2, 2, 200, 400);
+	transform.setLogX(true);
+	checkPoint(transform, 10, 0, 100, 200);
+	double px;
+	double py;
+	transform.apply(10, 180, px, py);
+	CHECK(!std::isfinite(px));
+
+	transform.setPolar(false);
+	transform.setLogX(false);
+	CHECK(!transform.isCurved());
+	checkPoint(transform, 1, 1, 100, 100);
+}
+
+TEST(Transform, DrawRefusesPointsWithoutAnImage)
+{
+	Draw draw;
+	CHECK(isRefused([&] { draw.setXscaleLog(0, 10); }));
+	CHECK(isRefused([&] { draw.setYscaleLog(-1, 10); }));
+
+	draw.setXscaleLog(1, 100);
+	draw.setYscale(0, 1);
+	draw.point(10, 0.5);
+	CHECK(isRefused([&] { draw.point(0, 0.5); }));
+	CHECK(isRefused([&] { draw.line(1, 0, -5, 1); }));
+	CHECK(isRefused([&] { draw.filledCircles(std::vector<double>{ 1, -1 }, std::vector<double>{ 0.5, 0.5 }, std::vector<double>{ 0.1, 0.1 }); }));
+	// Arrays of different lengths are refused, even when one is empty
+	const std::vector<double> none;
+	const std::vector<double> one{ 0.5 };
+	CHECK(isRefused([&] { draw.polygon(none, one); }));
+	CHECK(isRefused([&] { draw.filledPolygon(one, none); }));
+	draw.polygon(none, none);
+
+	// In polar coordinates (1, 180) lies at x = -1, off a log scale
+	draw.enablePolarCoordinates();
+	draw.point(10, 0);
+	CHECK(isRefused([&] { draw.point(1, 180); }));
+
+	// Back on linear scales everything has an image
+	draw.disablePolarCoordinates();
+	draw.setXscale(-1, 1);
+	draw.point(0, 0.5);
+	draw.point(-1, 0.5);
+}
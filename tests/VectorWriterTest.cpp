@@ -0,0 +1,118 @@
+#include "Test.h"
+#include "Decode.h"
+#include "Render.h"
+#include "VectorWriter.h"
+#include "cwt.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const cwt::ColorRgba WHITE{ 255, 255, 255, 255 };
+	const cwt::ColorRgba BLACK{ 0, 0, 0, 255 };
+	const cwt::ColorRgba RED{ 255, 0, 0, 255 };
+	const cwt::ColorRgba TRANSLUCENT_BLUE{ 0, 0, 255, 128 };
+
+	// Draws the same scene on a 100 x 80 canvas and exports it to path
+	void exportScene(const std::string& path)
+	{
+		Render render(cwt::Pen{ BLACK, 0.01 }, 100, 80, L"test");
+		render.clear(WHITE);
+		render.drawLine(10, 10, 50, 10);
+		render.drawLine(50, 10, 50, 50);
+		render.getPen().color = RED;
+		render.fillRectangle(20, 20, 30, 10);
+		render.fillRectangle(60, 20, 10, 10);
+		render.fillPolygon(std::vector<double>{ 10, 60, 40, 60, 25, 75 });
+		render.getPen().color = TRANSLUCENT_BLUE;
+		render.fillRectangle(0, 0, 5, 5);
+		render.fillRectangle(2, 2, 5, 5);
+		render.saveVector(path.c_str(), false);
+	}
+
+	size_t count(const std::string& text, const std::string& part)
+	{
+		size_t n = 0;
+		for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1))
+		{
+			n++;
+		}
+		return n;
+	}
+}
+
+TEST(VectorWriter, SvgSharesPathsOfOpaqueShapes)
+{
+	const std::string path = test::viewTempDir() + "/scene.svg";
+	exportScene(path);
+	const std::vector<std::uint8_t> bytes = test::readFile(path);
+	const std::string svg(bytes.begin(), bytes.end());
+	std::remove(path.c_str());
+
+	CHECK(svg.find("width=\"100\" height=\"80\" viewBox=\"0 0 100 80\"") != std::string::npos);
+	CHECK(svg.find("fill=\"#ffffff\"") != std::string::npos);
+	// The two lines are one path, stroked in black
+	CHECK(svg.find("<path d=\"M10 10l40 0l0 40\"/>") != std::string::npos);
+	CHECK(svg.find("stroke:#000000") != std::string::npos);
+	// Both red rectangles share a path, the polygon keeps its fill rule
+	CHECK(svg.find("<path d=\"M20 20v10h30v-10zM60 20v10h10v-10z\"/>") != std::string::npos);
+	CHECK(svg.find("fill-rule=\"evenodd\" d=\"M10 60l30 0l-15 15z\"") != std::string::npos);
+	// Translucent shapes darken each other, so each has its own path
+	CHECK(svg.find("fill:#0000ff;fill-opacity:0.502") != std::string::npos);
+	CHECK_EQ(count(svg, "<path"), size_t{ 5 });
+	CHECK_EQ(count(svg, "<g"), count(svg, "</g>"));
+	CHECK(svg.rfind("</svg>") != std::string::npos);
+}
+
+TEST(VectorWriter, PdfHasValidCrossReferencesAndContent)
+{
+	const std::string path = test::viewTempDir() + "/scene.pdf";
+	exportScene(path);
+	const std::vector<std::uint8_t> bytes = test::readFile(path);
+	const std::string pdf(bytes.begin(), bytes.end());
+	std::remove(path.c_str());
+	REQUIRE(pdf.rfind("%PDF-1.", 0) == 0);
+	CHECK(pdf.find("/MediaBox [0 0 100 80]") != std::string::npos);
+
+	// startxref points at the table, whose entries point at their objects
+	const size_t startxref = pdf.rfind("startxref\n");
+	REQUIRE(startxref != std::string::npos);
+	const size_t xref = std::strtoull(pdf.c_str() + startxref + 10, nullptr, 10);
+	REQUIRE(pdf.compare(xref, 5, "xref\n") == 0);
+	const int objects = std::atoi(pdf.c_str() + xref + 7);
+	REQUIRE(objects > 1);
+	const size_t table = pdf.find('\n', xref + 5) + 1;
+	for (int i = 1; i < objects; i++)
+	{
+		// Entries are 20 bytes: offset, generation, n and the end of line
+		const size_t offset = std::strtoull(pdf.c_str() + table + 20 * i, nullptr, 10);
+		const std::string header = std::to_string(i) + " 0 obj\n";
+		CHECK(pdf.compare(offset, header.size(), header) == 0);
+	}
+
+	// The content stream inflates to the drawing, in canvas coordinates once
+	// y is flipped
+	const size_t streamStart = pdf.find("stream\n") + 7;
+	const size_t streamEnd = pdf.find("\nendstream");
+	REQUIRE(streamStart < streamEnd);
+	const std::vector<std::uint8_t> content = test::inflateZlib(bytes.data() + streamStart, streamEnd - streamStart);
+	const std::string text(content.begin(), content.end());
+	CHECK(text.rfind("1 0 0 -1 0 80 cm", 0) == 0);
+	CHECK(text.find("10 10 m 50 10 l 50 50 l") != std::string::npos);
+	CHECK(text.find(" re") != std::string::npos);
+	CHECK(text.find("f*") != std::string::npos);
+	// The stream length is an indirect object written after it
+	const size_t lengthObject = pdf.find("6 0 obj\n");
+	REQUIRE(lengthObject != std::string::npos);
+	CHECK_EQ(std::strtoull(pdf.c_str() + lengthObject + 8, nullptr, 10), (unsigned long long)(streamEnd - streamStart));
+}
+
+TEST(VectorWriter, PicksTheFormatFromTheExtension)
+{
+	image::VectorFormat format;
+	CHECK(image::findVectorFormat("a.SVG", format) && format == image::VectorFormat::SVG);
+	CHECK(image::findVectorFormat("a.pdf", format) && format == image::VectorFormat::PDF);
+	CHECK(!image::findVectorFormat("a.png", format));
+}
@@ -0,0 +1,65 @@
+#include "Test.h"
+#include "Decode.h"
+#include "Zlib.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	std::vector<std::uint8_t> compress(const std::vector<std::uint8_t>& data, size_t piece)
+	{
+		image::ZlibWriter zlib;
+		for (size_t i = 0; i < data.size(); i += piece)
+		{
+			zlib.write(data.data() + i, (std::min)(piece, data.size() - i));
+		}
+		zlib.finish();
+		return zlib.output();
+	}
+
+	void checkRoundTrip(const std::vector<std::uint8_t>& data)
+	{
+		// Whole, and in pieces that split matches across writes
+		for (size_t piece : { data.size() + 1, size_t{ 1000 }, size_t{ 7 } })
+		{
+			const std::vector<std::uint8_t> compressed = compress(data, piece);
+			CHECK(test::inflateZlib(compressed.data(), compressed.size()) == data);
+		}
+	}
+}
+
+TEST(Zlib, RoundTripsEmptyInput)
+{
+	checkRoundTrip({});
+}
+
+TEST(Zlib, RoundTripsRandomBytes)
+{
+	std::mt19937 rng(1);
+	std::vector<std::uint8_t> data(200000);
+	for (std::uint8_t& byte : data)
+	{
+		byte = (std::uint8_t)rng();
+	}
+	checkRoundTrip(data);
+}
+
+TEST(Zlib, RoundTripsAndShrinksRepetitiveData)
+{
+	// Runs and repeats reaching back across more than one window
+	std::mt19937 rng(2);
+	std::vector<std::uint8_t> data;
+	std::vector<std::uint8_t> phrase(300);
+	for (std::uint8_t& byte : phrase)
+	{
+		byte = (std::uint8_t)(rng() % 4);
+	}
+	while (data.size() < 1000000)
+	{
+		data.insert(data.end(), rng() % 2000, (std::uint8_t)rng());
+		data.insert(data.end(), phrase.begin(), phrase.begin() + rng() % phrase.size());
+	}
+	checkRoundTrip(data);
+	CHECK(compress(data, data.size()).size() < data.size() / 10);
+}
@@ -0,0 +1,375 @@
+// Draws a capture written by Draw::startCapture() again, without the program
+// that drew it, and saves the result.
+//
+// The capture is mapped in memory and its records are handed to a Render one
+// by one, scaled from the canvas they were captured on to the size asked
+// for: coordinates, pen widths, which follow the canvas, and font sizes. The
+// format of the output follows its extension: an image (.png, .bmp, .ppm)
+// or a vector file (.svg, .pdf) of the canvas at the end of the capture, or
+// an animation (.gif, .y4m) of every frame presented during it. With the
+// GDI+ backend the replay is shown in a window as well, which stays open
+// until it is closed.
+//
+// --width= and --height= size the first canvas of the capture, and scale
+// the later ones in proportion; with only one of them the aspect ratio is
+// kept.
+//
+//   algs4_replay capture output [--width=W] [--height=H] [--fps=30]
+#include "Capture.h"
+#include "ImageWriter.h"
+#include "Recorder.h"
+#include "Render.h"
+#include "VectorWriter.h"
+#include "cwt.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr int DEFAULT_FPS = 30;
+
+	enum class Output
+	{
+		Image,
+		Vector,
+		Video
+	};
+
+	struct Options
+	{
+		std::string capture;
+		std::string output;
+		int width = 0;
+		int height = 0;
+		int fps = DEFAULT_FPS;
+	};
+
+	bool parse(int argc, char* argv[], Options& options)
+	{
+		std::vector<std::string> files;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			if (arg.rfind("--width=", 0) == 0)
+			{
+				options.width = std::atoi(arg.c_str() + 8);
+				if (options.width <= 0)
+				{
+					return false;
+				}
+			}
+			else if (arg.rfind("--height=", 0) == 0)
+			{
+				options.height = std::atoi(arg.c_str() + 9);
+				if (options.height <= 0)
+				{
+					return false;
+				}
+			}
+			else if (arg.rfind("--fps=", 0) == 0)
+			{
+				options.fps = std::atoi(arg.c_str() + 6);
+				if (options.fps <= 0)
+				{
+					return false;
+				}
+			}
+			else if (arg.rfind("--", 0) == 0)
+			{
+				return false;
+			}
+			else
+			{
+				files.push_back(arg);
+			}
+		}
+		if (files.size() != 2)
+		{
+			return false;
+		}
+		options.capture = files[0];
+		options.output = files[1];
+		return true;
+	}
+
+	bool findOutput(const std::string& path, Output& output)
+	{
+		image::Format format;
+		image::VectorFormat vectorFormat;
+		image::VideoFormat videoFormat;
+		if (image::findFormat(path, format))
+		{
+			output = Output::Image;
+		}
+		else if (image::findVectorFormat(path, vectorFormat))
+		{
+			output = Output::Vector;
+		}
+		else if (image::findVideoFormat(path, videoFormat))
+		{
+			output = Output::Video;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Hands the records of a capture to a render, scaled by (sx, sy). Pens
+	 * and fonts are kept in the tables the capture builds up, and set on the
+	 * render before each command that uses them.
+	 */
+	class Player
+	{
+	public:
+		Player(Render& render, double sx, double sy)
+			: render(render), sx(sx), sy(sy) {}
+
+		void play(const capture::Record& record)
+		{
+			using capture::Op;
+			switch (record.op)
+			{
+			case Op::Pen:
+			{
+				const capture::PenData& data = record.viewData<capture::PenData>();
+				if (record.pen >= pens.size())
+				{
+					pens.resize((size_t)record.pen + 1);
+				}
+				pens[record.pen] = cwt::Pen{ cwt::ColorRgba::unpack(data.color), data.radius };
+				break;
+			}
+			case Op::Font:
+			{
+				const capture::FontData& data = record.viewData<capture::FontData>();
+				if (record.pen >= fonts.size())
+				{
+					fonts.resize((size_t)record.pen + 1);
+				}
+				// Text keeps its size relative to the canvas
+				const double size = std::max(1.0, std::round(data.size * std::min(sx, sy)));
+				fonts[record.pen] = cwt::Font(capture::toWide(record.viewString<capture::FontData>(), record.count),
+					(cwt::Font::Style)data.style, (size_t)size);
+				break;
+			}
+			case Op::Canvas:
+			{
+				const capture::CanvasData& data = record.viewData<capture::CanvasData>();
+				render.setCanvasSize(scaleSize(data.width, sx), scaleSize(data.height, sy));
+				break;
+			}
+			case Op::Clear:
+				render.clear(cwt::ColorRgba::unpack(record.viewData<capture::ClearData>().color));
+				break;
+			case Op::Buffering:
+				render.setDoubleBuffering(record.viewData<capture::BufferingData>().enabled != 0);
+				break;
+			case Op::Present:
+				render.present();
+				break;
+			case Op::Text:
+			{
+				const capture::TextData& data = record.viewData<capture::TextData>();
+				usePen(record.pen);
+				if (data.font >= fonts.size())
+				{
+					throw std::runtime_error("corrupt capture file: undefined font");
+				}
+				render.getFont() = fonts[data.font];
+				const std::wstring text = capture::toWide(record.viewString<capture::TextData>(), record.count);
+				render.drawString(text, data.x * sx, data.y * sy);
+				break;
+			}
+			default:
+				playShapes(record);
+				break;
+			}
+		}
+
+	private:
+		static int scaleSize(int size, double scale)
+		{
+			return std::max(1, (int)std::lround(size * scale));
+		}
+
+		void usePen(std::uint32_t pen)
+		{
+			if (pen >= pens.size())
+			{
+				throw std::runtime_error("corrupt capture file: undefined pen");
+			}
+			render.getPen() = pens[pen];
+		}
+
+		void playShapes(const capture::Record& record)
+		{
+			using capture::Op;
+			usePen(record.pen);
+
+			// The coordinates, scaled; only those of arcs end with angles
+			const size_t arity = capture::viewArity(record.op);
+			const size_t scaled = record.op == Op::Arc ? 4 : arity;
+			const float* coords = record.viewCoords();
+			values.resize(record.count * arity);
+			for (size_t i = 0; i < values.size(); i++)
+			{
+				const size_t j = i % arity;
+				values[i] = j >= scaled ? coords[i] : coords[i] * (j % 2 == 0 ? sx : sy);
+			}
+
+			const double* v = values.data();
+			switch (record.op)
+			{
+			case Op::Polygon:
+				render.drawPolygon(values);
+				return;
+			case Op::FilledPolygon:
+				render.fillPolygon(values);
+				return;
+			case Op::Lines:
+				render.drawLines(values);
+				return;
+			case Op::FilledEllipses:
+				render.fillElipses(values);
+				return;
+			case Op::FilledRectangles:
+				render.fillRectangles(values);
+				return;
+			default:
+				break;
+			}
+
+			// Calls of one primitive each, made one at a time as when captured
+			for (std::uint32_t i = 0; i < record.count; i++, v += arity)
+			{
+				switch (record.op)
+				{
+				case Op::Line:
+					render.drawLine(v[0], v[1], v[2], v[3]);
+					break;
+				case Op::Ellipse:
+					render.drawElipse(v[0], v[1], v[2], v[3]);
+					break;
+				case Op::FilledEllipse:
+					render.fillElipse(v[0], v[1], v[2], v[3]);
+					break;
+				case Op::Arc:
+					render.drawArc(v[0], v[1], v[2], v[3], v[4], v[5]);
+					break;
+				case Op::Rectangle:
+					render.drawRectangle(v[0], v[1], v[2], v[3]);
+					break;
+				case Op::FilledRectangle:
+					render.fillRectangle(v[0], v[1], v[2], v[3]);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		Render& render;
+		const double sx;
+		const double sy;
+		std::vector<cwt::Pen> pens;
+		std::vector<cwt::Font> fonts;
+		std::vector<double> values;
+	};
+
+	void replay(const Options& options, Output output)
+	{
+		capture::Reader reader(options.capture);
+
+		// Every capture starts with the canvas it is drawn on
+		const capture::Record* record = reader.next();
+		if (!record || record->op != capture::Op::Canvas)
+		{
+			throw std::runtime_error("corrupt capture file: no canvas");
+		}
+		const capture::CanvasData& canvas = record->viewData<capture::CanvasData>();
+		double sx = 1.0;
+		double sy = 1.0;
+		if (options.width > 0)
+		{
+			sx = (double)options.width / canvas.width;
+			sy = options.height > 0 ? (double)options.height / canvas.height : sx;
+		}
+		else if (options.height > 0)
+		{
+			sy = (double)options.height / canvas.height;
+			sx = sy;
+		}
+
+		const cwt::Pen pen{ cwt::getRgba(cwt::Color::DEFAULT_PEN_COLOR), 0.0 };
+		const std::wstring caption = L"algs4_replay";
+		Render render(pen, std::max(1, (int)std::lround(canvas.width * sx)),
+			std::max(1, (int)std::lround(canvas.height * sy)), caption.c_str());
+		std::thread renderThread([&render] { render.show(); });
+
+		try
+		{
+			if (output == Output::Video)
+			{
+				render.startRecording(options.output.c_str(), options.fps);
+			}
+			Player player(render, sx, sy);
+			for (; record; record = reader.next())
+			{
+				player.play(*record);
+			}
+			switch (output)
+			{
+			case Output::Image:
+				render.save(options.output.c_str());
+				break;
+			case Output::Vector:
+			{
+				constexpr bool isCoalesced = false;
+				render.saveVector(options.output.c_str(), isCoalesced);
+				break;
+			}
+			case Output::Video:
+				render.stopRecording();
+				break;
+			}
+		}
+		catch (...)
+		{
+			renderThread.join();
+			throw;
+		}
+		renderThread.join();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	Output output;
+	if (!parse(argc, argv, options) || !findOutput(options.output, output))
+	{
+		std::fprintf(stderr, "usage: %s capture output.(png|bmp|ppm|svg|pdf|gif|y4m) [--width=W] [--height=H] [--fps=30]\n", argv[0]);
+		return 2;
+	}
+
+	try
+	{
+		replay(options, output);
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}